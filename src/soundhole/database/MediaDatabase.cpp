@@ -16,16 +16,47 @@
 
 namespace sh {
 	MediaDatabase::MediaDatabase(Options options)
-	: options(options), db(nullptr), queue(new DispatchQueue("MediaDatabase")) {
-		//
+	: options(options), db(nullptr),
+	statementCache(new SQLiteStatementCache({
+		.capacity = options.statementCacheCapacity
+	})),
+	queryMonitor(new SQLiteQueryMonitor(options.queryMonitor)),
+	queue(new DispatchQueue("MediaDatabase")),
+	nextReadConnectionIndex(0),
+	pendingWriteCount(0) {
+		if(canUseReadConnections()) {
+			readConnections.reserve(options.readConnectionCount);
+			for(size_t i=0; i<options.readConnectionCount; i++) {
+				auto reader = new ReadConnection();
+				reader->db = nullptr;
+				reader->statementCache = new SQLiteStatementCache({
+					.capacity = options.statementCacheCapacity
+				});
+				reader->queue = new DispatchQueue((String)"MediaDatabase-read"+i);
+				readConnections.pushBack(reader);
+			}
+		}
 	}
 
 	MediaDatabase::~MediaDatabase() {
 		delete queue;
 		queue = nullptr;
+		for(auto reader : readConnections) {
+			delete reader->queue;
+			reader->queue = nullptr;
+		}
 		if(isOpen()) {
 			close();
 		}
+		for(auto reader : readConnections) {
+			delete reader->statementCache;
+			delete reader;
+		}
+		readConnections.clear();
+		delete statementCache;
+		statementCache = nullptr;
+		delete queryMonitor;
+		queryMonitor = nullptr;
 	}
 
 	MediaProviderStash* MediaDatabase::mediaProviderStash() {
@@ -59,7 +90,22 @@ namespace sh {
 			String errorMsg = sqlite3_errstr(retVal);
 			throw std::runtime_error(errorMsg);
 		}
+		try {
+			applyConnectionPragmas(tmpDb, options.connection, true);
+		} catch(...) {
+			sqlite3_close(tmpDb);
+			throw;
+		}
 		db = tmpDb;
+		try {
+			openReadConnections();
+		} catch(...) {
+			closeReadConnections();
+			statementCache->clear();
+			sqlite3_close(db);
+			db = nullptr;
+			throw;
+		}
 	}
 
 	bool MediaDatabase::isOpen() const {
@@ -71,6 +117,9 @@ namespace sh {
 		if(db == nullptr) {
 			return;
 		}
+		closeReadConnections();
+		// cached statements must be finalized before the connection can close
+		statementCache->clear();
 		int retVal = sqlite3_close(db);
 		if(retVal != 0) {
 			throw std::runtime_error(sqlite3_errstr(retVal));
@@ -78,7 +127,96 @@ namespace sh {
 		db = nullptr;
 	}
 
+	void MediaDatabase::applyConnectionPragmas(sqlite3* db, const ConnectionOptions& options, bool writable) {
+		LinkedList<String> pragmas;
+		if(writable) {
+			if(!options.autoVacuum.empty()) {
+				pragmas.pushBack("PRAGMA auto_vacuum = "+options.autoVacuum+";");
+			}
+			if(!options.journalMode.empty()) {
+				pragmas.pushBack("PRAGMA journal_mode = "+options.journalMode+";");
+			}
+			if(!options.synchronous.empty()) {
+				pragmas.pushBack("PRAGMA synchronous = "+options.synchronous+";");
+			}
+		}
+		if(options.cacheSize) {
+			pragmas.pushBack((String)"PRAGMA cache_size = "+options.cacheSize.value()+";");
+		}
+		if(options.mmapSize) {
+			pragmas.pushBack((String)"PRAGMA mmap_size = "+options.mmapSize.value()+";");
+		}
+		if(!options.tempStore.empty()) {
+			pragmas.pushBack("PRAGMA temp_store = "+options.tempStore+";");
+		}
+		pragmas.pushBack((String)"PRAGMA busy_timeout = "+options.busyTimeout+";");
+		for(auto& pragma : pragmas) {
+			char* errorMsg = nullptr;
+			int retVal = sqlite3_exec(db, pragma.c_str(), nullptr, nullptr, &errorMsg);
+			if(retVal != SQLITE_OK) {
+				String error = (errorMsg != nullptr) ? String(errorMsg) : String(sqlite3_errstr(retVal));
+				sqlite3_free(errorMsg);
+				throw std::runtime_error("Failed to apply \""+pragma+"\": "+error);
+			}
+		}
+	}
+
+	bool MediaDatabase::canUseReadConnections() const {
+		// readers can only run alongside the writer in WAL mode, and can't share an in-memory database
+		auto& journalMode = options.connection.journalMode;
+		return (options.readConnectionCount > 0 && (journalMode == "WAL" || journalMode == "wal")
+			&& !options.path.empty() && options.path != ":memory:");
+	}
+
+	void MediaDatabase::openReadConnections() {
+		for(auto reader : readConnections) {
+			std::unique_lock<std::mutex> readerLock(reader->mutex);
+			if(reader->db != nullptr) {
+				continue;
+			}
+			sqlite3* readerDb = nullptr;
+			int retVal = sqlite3_open_v2(options.path.c_str(), &readerDb, SQLITE_OPEN_READONLY, nullptr);
+			if(retVal != SQLITE_OK) {
+				sqlite3_close(readerDb);
+				throw std::runtime_error((String)"Failed to open read connection: "+sqlite3_errstr(retVal));
+			}
+			try {
+				applyConnectionPragmas(readerDb, options.connection, false);
+			} catch(...) {
+				sqlite3_close(readerDb);
+				throw;
+			}
+			reader->db = readerDb;
+		}
+	}
+
+	void MediaDatabase::closeReadConnections() {
+		for(auto reader : readConnections) {
+			std::unique_lock<std::mutex> readerLock(reader->mutex);
+			reader->statementCache->clear();
+			if(reader->db != nullptr) {
+				sqlite3_close(reader->db);
+				reader->db = nullptr;
+			}
+		}
+	}
+
+	MediaDatabase::ReadConnection* MediaDatabase::nextReadConnection() {
+		if(readConnections.size() == 0) {
+			return nullptr;
+		}
+		size_t index = nextReadConnectionIndex.fetch_add(1);
+		return readConnections[index % readConnections.size()];
+	}
+
 	Promise<std::map<String,LinkedList<Json>>> MediaDatabase::transaction(TransactionOptions options, Function<void(SQLiteTransaction&)> executor) {
+		// while writes are queued, reads go through the write queue too, so that they see every write issued before them
+		if(options.readOnly && pendingWriteCount.load() == 0) {
+			if(auto reader = nextReadConnection()) {
+				return readTransaction(reader, options, executor);
+			}
+		}
+		bool isWrite = !options.readOnly;
 		return Promise<std::map<String,LinkedList<Json>>>([=](auto resolve, auto reject) {
 			std::unique_lock<std::recursive_mutex> lock(this->dbMutex);
 			if(this->db == nullptr) {
@@ -97,33 +235,179 @@ namespace sh {
 				reject(std::current_exception());
 				return;
 			}
+			auto queuedTime = std::chrono::steady_clock::now();
+			if(isWrite) {
+				pendingWriteCount++;
+			}
 			queue->async([=]() {
 				std::unique_lock<std::recursive_mutex> lock(this->dbMutex);
 				if(this->db == nullptr) {
+					if(isWrite) {
+						pendingWriteCount--;
+					}
 					lock.unlock();
 					reject(std::runtime_error("database was unexpectedly closed"));
 					return;
 				}
+				auto startTime = std::chrono::steady_clock::now();
 				auto exTx = std::move(tx);
 				exTx.setDB(this->db);
+				exTx.setStatementCache(this->statementCache);
+				exTx.setQueryMonitor(this->queryMonitor);
+				std::map<String,LinkedList<Json>> results;
+				try {
+					results = exTx.execute();
+				} catch(...) {
+					if(isWrite) {
+						pendingWriteCount--;
+					}
+					recordTransaction(queuedTime, startTime, false);
+					lock.unlock();
+					reject(std::current_exception());
+					return;
+				}
+				if(isWrite) {
+					pendingWriteCount--;
+				}
+				recordTransaction(queuedTime, startTime, false);
+				lock.unlock();
+				resolve(results);
+			});
+		});
+	}
+
+	Promise<std::map<String,LinkedList<Json>>> MediaDatabase::readTransaction(ReadConnection* reader, TransactionOptions options, Function<void(SQLiteTransaction&)> executor) {
+		return Promise<std::map<String,LinkedList<Json>>>([=](auto resolve, auto reject) {
+			std::unique_lock<std::recursive_mutex> lock(this->dbMutex);
+			if(this->db == nullptr) {
+				lock.unlock();
+				reject(std::runtime_error("Cannot query an unopened database"));
+				return;
+			}
+			auto tx = SQLiteTransaction(nullptr, {
+				.useSQLTransaction=options.useSQLTransaction
+			});
+			try {
+				executor(tx);
+			}
+			catch(...) {
+				lock.unlock();
+				reject(std::current_exception());
+				return;
+			}
+			lock.unlock();
+			// outside of a sql transaction, each statement on a reader sees its own WAL snapshot,
+			// so wrap multiple statements in a deferred read transaction to keep their results consistent
+			if(tx.statementCount() > 1) {
+				tx.setUseSQLTransaction(true);
+			}
+			auto queuedTime = std::chrono::steady_clock::now();
+			reader->queue->async([=]() {
+				std::unique_lock<std::mutex> lock(reader->mutex);
+				if(reader->db == nullptr) {
+					lock.unlock();
+					reject(std::runtime_error("database was unexpectedly closed"));
+					return;
+				}
+				auto startTime = std::chrono::steady_clock::now();
+				auto exTx = std::move(tx);
+				exTx.setDB(reader->db);
+				exTx.setStatementCache(reader->statementCache);
+				exTx.setQueryMonitor(this->queryMonitor);
 				std::map<String,LinkedList<Json>> results;
 				try {
 					results = exTx.execute();
 				} catch(...) {
+					recordTransaction(queuedTime, startTime, true);
 					lock.unlock();
 					reject(std::current_exception());
 					return;
 				}
+				recordTransaction(queuedTime, startTime, true);
 				lock.unlock();
 				resolve(results);
 			});
 		});
 	}
 
+	SQLiteStatementCache::Stats MediaDatabase::statementCacheStats() {
+		std::unique_lock<std::recursive_mutex> lock(dbMutex);
+		auto stats = statementCache->stats();
+		for(auto reader : readConnections) {
+			std::unique_lock<std::mutex> readerLock(reader->mutex);
+			auto readerStats = reader->statementCache->stats();
+			stats.hits += readerStats.hits;
+			stats.misses += readerStats.misses;
+			stats.evictions += readerStats.evictions;
+			stats.size += readerStats.size;
+		}
+		return stats;
+	}
+
+	void MediaDatabase::resetStatementCacheStats() {
+		std::unique_lock<std::recursive_mutex> lock(dbMutex);
+		statementCache->resetStats();
+		for(auto reader : readConnections) {
+			std::unique_lock<std::mutex> readerLock(reader->mutex);
+			reader->statementCache->resetStats();
+		}
+	}
+
+	SQLiteQueryMonitor::Snapshot MediaDatabase::queryStats() const {
+		return queryMonitor->snapshot();
+	}
+
+	void MediaDatabase::resetQueryStats() {
+		queryMonitor->reset();
+	}
+
+	void MediaDatabase::recordTransaction(std::chrono::steady_clock::time_point queuedTime, std::chrono::steady_clock::time_point startTime, bool readOnly) {
+		if(!queryMonitor->isEnabled()) {
+			return;
+		}
+		auto endTime = std::chrono::steady_clock::now();
+		queryMonitor->recordTransaction({
+			.queueWait = std::chrono::duration_cast<SQLiteQueryMonitor::Duration>(startTime - queuedTime),
+			.duration = std::chrono::duration_cast<SQLiteQueryMonitor::Duration>(endTime - startTime),
+			.readOnly = readOnly
+		});
+	}
+
 	Promise<void> MediaDatabase::initialize(InitializeOptions options) {
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
-			tx.addSQL(sql::createDB(), {});
-		}).toVoid();
+		return transaction({}, [=](auto& tx) {
+			sql::selectSchemaVersion(tx, "version");
+		}).then([=](std::map<String,LinkedList<Json>> results) {
+			int version = 0;
+			if(!options.purge) {
+				auto& rows = results["version"];
+				if(rows.size() > 0) {
+					version = rows.front()["user_version"].int_value();
+				}
+			}
+			if(version > sql::latestSchemaVersion()) {
+				FGL_WARN((String)"Database schema version "+version+" is newer than the latest known version "+sql::latestSchemaVersion());
+			}
+			// DBState only exists once the first migration has been applied
+			auto storagePromise = (version > 0) ?
+				getStateValue(stateKey_mediaAttributeStorage(), String())
+				: Promise<String>::resolve(String());
+			return storagePromise.then([=](String storedStorage) {
+				auto storage = this->options.attributeStorage;
+				bool convertStorage = (sql::MediaAttributeStorage_fromString(storedStorage) != storage);
+				return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+					if(options.purge) {
+						tx.addSQL(sql::purgeDB(), {});
+					}
+					sql::applyMigrations(tx, version);
+					if(convertStorage) {
+						sql::applyMediaAttributeStorage(tx, storage);
+						sql::applyDBState(tx, {
+							{ stateKey_mediaAttributeStorage(), sql::MediaAttributeStorage_toString(storage) }
+						});
+					}
+				}).toVoid();
+			});
+		});
 	}
 
 	Promise<void> MediaDatabase::reset() {
@@ -143,9 +427,11 @@ namespace sh {
 						return;
 					}
 				}
-				// delete file
+				// delete file, along with any leftover WAL files
 				try {
 					fs::remove(this->options.path);
+					fs::remove(this->options.path+"-wal");
+					fs::remove(this->options.path+"-shm");
 				} catch(...) {
 					// reopen if needed and rethrow error
 					error = std::current_exception();
@@ -167,8 +453,16 @@ namespace sh {
 					auto tx = SQLiteTransaction(tmpDb, {
 						.useSQLTransaction=true
 					});
-					tx.addSQL(sql::createDB(), {});
+					sql::applyMigrations(tx, 0);
+					if(this->options.attributeStorage != sql::MediaAttributeStorage::JSON) {
+						sql::applyMediaAttributeStorage(tx, this->options.attributeStorage);
+						sql::applyDBState(tx, {
+							{ stateKey_mediaAttributeStorage(), sql::MediaAttributeStorage_toString(this->options.attributeStorage) }
+						});
+					}
 					try {
+						// auto_vacuum can only be enabled before any tables are created
+						applyConnectionPragmas(tmpDb, this->options.connection, true);
 						tx.execute();
 					} catch(...) {
 						error = std::current_exception();
@@ -218,7 +512,7 @@ namespace sh {
 		if(uris.size() == 0) {
 			return Promise<LinkedList<Json>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			for(size_t i=0; i<uris.size(); i++) {
 				sql::selectTrack(tx, std::to_string(i), uris[i]);
 			}
@@ -246,7 +540,7 @@ namespace sh {
 	}
 
 	Promise<size_t> MediaDatabase::getTrackCount() {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectTrackCount(tx, "count");
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -278,8 +572,20 @@ namespace sh {
 		}).toVoid();
 	}
 
+	Promise<void> MediaDatabase::updateTrackCollectionVersionIds(ArrayList<$<TrackCollection>> collections, CacheOptions options) {
+		if(collections.size() == 0 && options.dbState.size() == 0) {
+			return Promise<void>::resolve();
+		}
+		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+			for(auto& collection : collections) {
+				sql::updateTrackCollectionVersionId(tx, collection->uri(), collection->versionId());
+			}
+			sql::applyDBState(tx, options.dbState);
+		}).toVoid();
+	}
+
 	Promise<LinkedList<Json>> MediaDatabase::getTrackCollectionsJson(ArrayList<String> uris) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			for(size_t i=0; i<uris.size(); i++) {
 				sql::selectTrackCollectionWithOwner(tx, std::to_string(i), uris[i]);
 			}
@@ -298,7 +604,7 @@ namespace sh {
 	}
 
 	Promise<Json> MediaDatabase::getTrackCollectionJson(String uri, Optional<sql::IndexRange> itemsRange) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectTrackCollectionWithOwner(tx, "collection", uri);
 			if(itemsRange) {
 				sql::selectTrackCollectionItemsWithTracks(tx, "items", uri, itemsRange);
@@ -327,8 +633,104 @@ namespace sh {
 		}).toVoid();
 	}
 
+	Promise<$<MediaDatabase::TrackCollectionItemsSyncState>> MediaDatabase::getTrackCollectionItemsSyncState(String collectionURI) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
+			sql::selectTrackCollectionItemChunks(tx, "chunks", collectionURI);
+		}).map(nullptr, [=](auto results) -> $<TrackCollectionItemsSyncState> {
+			auto state = fgl::new$<TrackCollectionItemsSyncState>();
+			for(auto& chunkJson : results["chunks"]) {
+				state->chunks[(size_t)chunkJson["startIndex"].number_value()] = TrackCollectionItemsSyncState::Chunk{
+					.endIndex = (size_t)chunkJson["endIndex"].number_value(),
+					.fingerprint = chunkJson["fingerprint"].string_value()
+				};
+			}
+			return state;
+		});
+	}
+
+	Promise<void> MediaDatabase::loadTrackCollectionItemKeys(String collectionURI, $<TrackCollectionItemsSyncState> syncState) {
+		if(syncState->itemKeysLoaded) {
+			return Promise<void>::resolve();
+		}
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
+			sql::selectTrackCollectionItemKeys(tx, "items", collectionURI);
+		}).map(nullptr, [=](auto results) -> $<TrackCollectionItemsSyncState> {
+			for(auto& itemJson : results["items"]) {
+				auto indexNum = itemJson["indexNum"];
+				if(!indexNum.is_number()) {
+					continue;
+				}
+				size_t index = (size_t)indexNum.number_value();
+				auto key = sql::trackCollectionItemKey(
+					itemJson["trackURI"].string_value(),
+					itemJson["trackFingerprint"].string_value(),
+					itemJson["uniqueId"].string_value(),
+					itemJson["addedAt"].string_value());
+				syncState->itemKeys[index] = key;
+			}
+			syncState->itemKeysLoaded = true;
+			return syncState;
+		}).toVoid();
+	}
+
+	Promise<size_t> MediaDatabase::cacheTrackCollectionItemsDelta($<TrackCollection> collection, sql::IndexRange itemsRange, $<TrackCollectionItemsSyncState> syncState, CacheOptions options) {
+		auto delta = sql::TrackCollectionItemsDelta{
+			.range = itemsRange,
+			.includeTrackAlbums = (std::dynamic_pointer_cast<Album>(collection) == nullptr)
+		};
+		// fingerprint the fetched range
+		ArrayList<std::pair<size_t,String>> itemKeys;
+		itemKeys.reserve(itemsRange.endIndex - itemsRange.startIndex);
+		bool complete = true;
+		collection->forEachInRange(itemsRange.startIndex, itemsRange.endIndex, [&]($<TrackCollectionItem> item, size_t index) {
+			if(!item) {
+				complete = false;
+				return;
+			}
+			itemKeys.pushBack({ index, sql::trackCollectionItemKey(item) });
+		});
+		complete = complete && itemKeys.size() == (itemsRange.endIndex - itemsRange.startIndex);
+		if(complete) {
+			delta.fingerprint = sql::trackCollectionItemsFingerprint(itemKeys.map([](auto& pair) -> String {
+				return pair.second;
+			}));
+		}
+		auto writeDelta = [=](sql::TrackCollectionItemsDelta delta) -> Promise<size_t> {
+			size_t writeCount = delta.changedIndexes.size();
+			return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+				sql::applyTrackCollectionItemsDelta(tx, collection, delta);
+				sql::applyDBState(tx, options.dbState);
+			}).map(nullptr, [=](auto results) -> size_t {
+				return writeCount;
+			});
+		};
+		// item keys include the track data, so an unchanged range has nothing to write.
+		// it only needs a transaction if it's the last range, so that any items past the end get removed, or if there's state to store
+		auto chunkIt = syncState->chunks.find(itemsRange.startIndex);
+		if(complete && chunkIt != syncState->chunks.end()
+		   && chunkIt->second.endIndex == itemsRange.endIndex && chunkIt->second.fingerprint == delta.fingerprint) {
+			bool isLastRange = collection->itemCount() && itemsRange.endIndex >= collection->itemCount().value();
+			if(!isLastRange && options.dbState.empty()) {
+				return Promise<size_t>::resolve(0);
+			}
+			return writeDelta(delta);
+		}
+		// compare each item with the stored rows
+		return loadTrackCollectionItemKeys(collection->uri(), syncState).then([=]() {
+			auto changedDelta = delta;
+			for(auto& [index, key] : itemKeys) {
+				auto storedKeyIt = syncState->itemKeys.find(index);
+				if(storedKeyIt != syncState->itemKeys.end() && storedKeyIt->second == key) {
+					continue;
+				}
+				changedDelta.changedIndexes.pushBack(index);
+			}
+			return writeDelta(changedDelta);
+		});
+	}
+
 	Promise<std::map<size_t,Json>> MediaDatabase::getTrackCollectionItemsJson(String collectionURI, sql::IndexRange range) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectTrackCollectionItemsWithTracks(tx, "items", collectionURI, range);
 		}).map(nullptr, [=](auto results) -> std::map<size_t,Json> {
 			std::map<size_t,Json> items;
@@ -359,7 +761,7 @@ namespace sh {
 		if(uris.size() == 0) {
 			return Promise<LinkedList<Json>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=false},[=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true},[=](auto& tx) {
 			for(size_t i=0; i<uris.size(); i++) {
 				sql::selectArtist(tx, std::to_string(i), uris[i]);
 			}
@@ -405,7 +807,7 @@ namespace sh {
 	#pragma mark SavedTrack
 
 	Promise<size_t> MediaDatabase::getSavedTracksCount(GetSavedItemsCountOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedTrackCount(tx, "count", options.libraryProvider);
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -416,14 +818,32 @@ namespace sh {
 		});
 	}
 
+	sql::LibraryItemCursor MediaDatabase::savedItemCursor(const Json& savedItemJson, sql::LibraryItemOrderBy orderBy) {
+		auto mediaItemJson = savedItemJson["mediaItem"];
+		Json sortValueJson;
+		switch(orderBy) {
+			case sql::LibraryItemOrderBy::ADDED_AT:
+				sortValueJson = savedItemJson["addedAt"];
+				break;
+			case sql::LibraryItemOrderBy::NAME:
+				sortValueJson = mediaItemJson["name"];
+				break;
+		}
+		return sql::LibraryItemCursor{
+			.sortValue = sortValueJson.is_string() ? maybe((String)sortValueJson.string_value()) : std::nullopt,
+			.uri = mediaItemJson["uri"].string_value()
+		};
+	}
+
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getSavedTracksJson(sql::IndexRange range, GetSavedTracksOptions options) {
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedTrackCount(tx, "count", options.libraryProvider);
 			sql::selectSavedTracksWithTracks(tx, "items", {
 				.libraryProvider = options.libraryProvider,
 				.range = range,
 				.order = options.order,
-				.orderBy = options.orderBy
+				.orderBy = options.orderBy,
+				.after = options.after
 			});
 		}).map(nullptr, [=](auto results) -> GetJsonItemsListResult {
 			auto countItems = results["count"];
@@ -439,8 +859,35 @@ namespace sh {
 		});
 	}
 
+	Promise<MediaDatabase::GetItemsListResult<sql::SavedTrackItem>> MediaDatabase::getSavedTracks(sql::IndexRange range, GetSavedTracksOptions options) {
+		auto items = fgl::new$<LinkedList<sql::DBSavedTrackRow>>();
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
+			sql::selectSavedTrackCount(tx, "count", options.libraryProvider);
+			sql::selectSavedTracksWithTracks(tx, items, this->options.attributeStorage, {
+				.libraryProvider = options.libraryProvider,
+				.range = range,
+				.order = options.order,
+				.orderBy = options.orderBy,
+				.after = options.after
+			});
+		}).map([=](auto results) -> GetItemsListResult<sql::SavedTrackItem> {
+			auto countItems = results["count"];
+			if(countItems.size() == 0) {
+				throw std::runtime_error("failed to get items count");
+			}
+			size_t total = (size_t)countItems.front().number_value();
+			return GetItemsListResult<sql::SavedTrackItem>{
+				// create the tracks here rather than in the row handlers, so that media items are only created on the default queue
+				.items = ArrayList<sql::DBSavedTrackRow>(items->begin(), items->end()).map([=](auto& row) {
+					return sql::createDBSavedTrack(row, this->mediaProviderStash());
+				}),
+				.total = total
+			};
+		});
+	}
+
 	Promise<Json> MediaDatabase::getSavedTrackJson(String uri) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedTrackWithTrack(tx, "items", uri);
 		}).map(nullptr, [=](auto results) -> Json {
 			auto rows = results["items"];
@@ -456,7 +903,7 @@ namespace sh {
 		if(uriCount == 0) {
 			return Promise<ArrayList<bool>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			size_t i = 0;
 			for(auto& uri : uris) {
 				sql::selectSavedTrack(tx, std::to_string(i), uri);
@@ -484,7 +931,7 @@ namespace sh {
 	#pragma mark SavedAlbum
 
 	Promise<size_t> MediaDatabase::getSavedAlbumsCount(GetSavedItemsCountOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedAlbumCount(tx, "count", options.libraryProvider);
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -496,13 +943,14 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getSavedAlbumsJson(GetSavedAlbumsOptions options) {
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedAlbumCount(tx, "count", options.libraryProvider);
 			sql::selectSavedAlbumsWithAlbums(tx, "items", {
 				.libraryProvider = options.libraryProvider,
 				.range = options.range,
 				.order = options.order,
-				.orderBy = options.orderBy
+				.orderBy = options.orderBy,
+				.after = options.after
 			});
 		}).map(nullptr, [=](auto results) -> GetJsonItemsListResult {
 			auto countItems = results["count"];
@@ -519,7 +967,7 @@ namespace sh {
 	}
 
 	Promise<Json> MediaDatabase::getSavedAlbumJson(String uri) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedAlbumWithAlbum(tx, "items", uri);
 		}).map(nullptr, [=](auto results) -> Json {
 			auto rows = results["items"];
@@ -535,7 +983,7 @@ namespace sh {
 		if(uriCount == 0) {
 			return Promise<ArrayList<bool>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			size_t i = 0;
 			for(auto& uri : uris) {
 				sql::selectSavedAlbum(tx, std::to_string(i), uri);
@@ -563,7 +1011,7 @@ namespace sh {
 	#pragma mark SavedPlaylist
 
 	Promise<size_t> MediaDatabase::getSavedPlaylistsCount(GetSavedItemsCountOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedPlaylistCount(tx, "count", options.libraryProvider);
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -575,13 +1023,14 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getSavedPlaylistsJson(GetSavedPlaylistsOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedPlaylistCount(tx, "count", options.libraryProvider);
 			sql::selectSavedPlaylistsWithPlaylistsAndOwners(tx, "items", {
 				.libraryProvider = options.libraryProvider,
 				.range = options.range,
 				.order = options.order,
-				.orderBy = options.orderBy
+				.orderBy = options.orderBy,
+				.after = options.after
 			});
 		}).map(nullptr, [=](auto results) -> GetJsonItemsListResult {
 			auto countItems = results["count"];
@@ -598,7 +1047,7 @@ namespace sh {
 	}
 
 	Promise<Json> MediaDatabase::getSavedPlaylistJson(String uri) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectSavedPlaylistWithPlaylistAndOwner(tx, "items", uri);
 		}).map(nullptr, [=](auto results) -> Json {
 			auto rows = results["items"];
@@ -614,7 +1063,7 @@ namespace sh {
 		if(uriCount == 0) {
 			return Promise<ArrayList<bool>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			size_t i = 0;
 			for(auto& uri : uris) {
 				sql::selectSavedPlaylist(tx, std::to_string(i), uri);
@@ -642,7 +1091,7 @@ namespace sh {
 	#pragma mark FollowedArtist
 
 	Promise<size_t> MediaDatabase::getFollowedArtistsCount(GetSavedItemsCountOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedArtistCount(tx, "count", options.libraryProvider);
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -654,7 +1103,7 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getFollowedArtistsJson(GetFollowedArtistsOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedArtistCount(tx, "count", options.libraryProvider);
 			sql::selectFollowedArtistsWithArtists(tx, "items", {
 				.libraryProvider = options.libraryProvider,
@@ -677,7 +1126,7 @@ namespace sh {
 	}
 
 	Promise<Json> MediaDatabase::getFollowedArtistJson(String uri) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedArtistWithArtist(tx, "items", uri);
 		}).map(nullptr, [=](auto results) -> Json {
 			auto rows = results["items"];
@@ -693,7 +1142,7 @@ namespace sh {
 		if(uriCount == 0) {
 			return Promise<ArrayList<bool>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			size_t i = 0;
 			for(auto& uri : uris) {
 				sql::selectFollowedArtist(tx, std::to_string(i), uri);
@@ -721,7 +1170,7 @@ namespace sh {
 	#pragma mark FollowedUserAccount
 
 	Promise<size_t> MediaDatabase::getFollowedUserAccountsCount(GetSavedItemsCountOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedUserAccountCount(tx, "count", options.libraryProvider);
 		}).map(nullptr, [=](auto results) -> size_t {
 			auto items = results["count"];
@@ -733,7 +1182,7 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getFollowedUserAccountsJson(GetFollowedUserAccountsOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedUserAccountCount(tx, "count", options.libraryProvider);
 			sql::selectFollowedUserAccountsWithUserAccounts(tx, "items", {
 				.libraryProvider = options.libraryProvider,
@@ -756,7 +1205,7 @@ namespace sh {
 	}
 
 	Promise<Json> MediaDatabase::getFollowedUserAccountJson(String uri) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectFollowedUserAccountWithUserAccount(tx, "items", uri);
 		}).map(nullptr, [=](auto results) -> Json {
 			auto rows = results["items"];
@@ -772,7 +1221,7 @@ namespace sh {
 		if(uriCount == 0) {
 			return Promise<ArrayList<bool>>::resolve({});
 		}
-		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
 			size_t i = 0;
 			for(auto& uri : uris) {
 				sql::selectFollowedUserAccount(tx, std::to_string(i), uri);
@@ -810,7 +1259,7 @@ namespace sh {
 	}
 
 	Promise<size_t> MediaDatabase::getPlaybackHistoryItemCount(PlaybackHistoryItemFilters filters) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectPlaybackHistoryItemCount(tx, "count", {
 				.provider = filters.provider,
 				.trackURIs = filters.trackURIs,
@@ -835,7 +1284,7 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getPlaybackHistoryItemsJson(GetPlaybackHistoryItemsOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			auto& filters = options.filters;
 			auto sqlFilters = sql::PlaybackHistorySelectFilters{
 				.provider = filters.provider,
@@ -851,17 +1300,23 @@ namespace sh {
 				.scrobbledBy = filters.scrobbledBy,
 				.notScrobbledBy = filters.notScrobbledBy
 			};
-			sql::selectPlaybackHistoryItemCount(tx, "count", sqlFilters);
+			if(options.includeTotal) {
+				sql::selectPlaybackHistoryItemCount(tx, "count", sqlFilters);
+			}
 			sql::selectPlaybackHistoryItemsWithTracks(tx, "items", sqlFilters, {
 				.range = options.range,
-				.order = options.order
+				.order = options.order,
+				.after = options.after
 			});
 		}).map(nullptr, [=](auto results) {
-			auto countItems = results["count"];
-			if(countItems.size() == 0) {
-				throw std::runtime_error("failed to get items count");
+			size_t total = 0;
+			if(options.includeTotal) {
+				auto countItems = results["count"];
+				if(countItems.size() == 0) {
+					throw std::runtime_error("failed to get items count");
+				}
+				total = (size_t)countItems.front().number_value();
 			}
-			size_t total = (size_t)countItems.front().number_value();
 			auto rows = LinkedList<Json>(results["items"]);
 			return GetJsonItemsListResult{
 				.items = rows,
@@ -870,6 +1325,50 @@ namespace sh {
 		});
 	}
 
+	Promise<MediaDatabase::GetItemsListResult<$<PlaybackHistoryItem>>> MediaDatabase::getPlaybackHistoryItems(GetPlaybackHistoryItemsOptions options) {
+		auto items = fgl::new$<LinkedList<sql::DBPlaybackHistoryItemRow>>();
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
+			auto& filters = options.filters;
+			auto sqlFilters = sql::PlaybackHistorySelectFilters{
+				.provider = filters.provider,
+				.trackURIs = filters.trackURIs,
+				.minDate = filters.minDate,
+				.minDateInclusive = filters.minDateInclusive,
+				.maxDate = filters.maxDate,
+				.maxDateInclusive = filters.maxDateInclusive,
+				.minDuration = filters.minDuration,
+				.minDurationRatio = filters.minDurationRatio,
+				.includeNullDuration = filters.includeNullDuration,
+				.visibility = filters.visibility,
+				.scrobbledBy = filters.scrobbledBy,
+				.notScrobbledBy = filters.notScrobbledBy
+			};
+			if(options.includeTotal) {
+				sql::selectPlaybackHistoryItemCount(tx, "count", sqlFilters);
+			}
+			sql::selectPlaybackHistoryItemsWithTracks(tx, items, this->options.attributeStorage, sqlFilters, {
+				.range = options.range,
+				.order = options.order,
+				.after = options.after
+			});
+		}).map([=](auto results) -> GetItemsListResult<$<PlaybackHistoryItem>> {
+			size_t total = 0;
+			if(options.includeTotal) {
+				auto countItems = results["count"];
+				if(countItems.size() == 0) {
+					throw std::runtime_error("failed to get items count");
+				}
+				total = (size_t)countItems.front().number_value();
+			}
+			return GetItemsListResult<$<PlaybackHistoryItem>>{
+				.items = ArrayList<sql::DBPlaybackHistoryItemRow>(items->begin(), items->end()).map([=](auto& row) {
+					return sql::createDBPlaybackHistoryItem(row, this->mediaProviderStash());
+				}),
+				.total = total
+			};
+		});
+	}
+
 	Promise<void> MediaDatabase::deletePlaybackHistoryItem(Date startTime, String trackURI) {
 		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
 			sql::deleteUnmatchedScrobbles(tx, startTime, trackURI);
@@ -893,7 +1392,7 @@ namespace sh {
 	}
 
 	Promise<size_t> MediaDatabase::getScrobbleCount(ScrobbleFilters filters) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectScrobbleCount(tx, "count", {
 				.scrobbler = filters.scrobbler,
 				.startTimes = filters.startTimes,
@@ -913,7 +1412,7 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getScrobblesJson(GetScrobblesOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			auto& filters = options.filters;
 			auto sqlFilters = sql::ScrobbleSelectFilters{
 				.scrobbler = filters.scrobbler,
@@ -960,7 +1459,7 @@ namespace sh {
 		if(scrobbleCount == 0) {
 			return resolveWith(ArrayList<bool>());
 		}
-		return transaction({}, [=](auto& tx) {
+		return transaction({.readOnly=true}, [=](auto& tx) {
 			for(auto [i, scrobble] : enumerate(scrobbles)) {
 				sql::selectMatchingScrobbleLocalID(tx, std::to_string(i), scrobble);
 			}
@@ -996,7 +1495,7 @@ namespace sh {
 	}
 
 	Promise<size_t> MediaDatabase::getUnmatchedScrobbleCount(UnmatchedScrobbleFilters filters) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			sql::selectUnmatchedScrobbleCount(tx, "count", {
 				.scrobbler = filters.scrobbler,
 				.startTimes = filters.startTimes,
@@ -1015,7 +1514,7 @@ namespace sh {
 	}
 
 	Promise<MediaDatabase::GetJsonItemsListResult> MediaDatabase::getUnmatchedScrobblesJson(GetUnmatchedScrobblesOptions options) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			auto& filters = options.filters;
 			auto sqlSelectFilters = sql::UnmatchedScrobbleSelectFilters{
 				.scrobbler = filters.scrobbler,
@@ -1150,6 +1649,173 @@ namespace sh {
 
 
 
+	#pragma mark Search
+
+	Promise<MediaDatabase::SearchLibraryJsonResult> MediaDatabase::searchLibraryJson(String query, SearchLibraryOptions options) {
+		auto matchQuery = sql::searchMatchQuery(query);
+		if(matchQuery.empty()) {
+			return Promise<SearchLibraryJsonResult>::resolve(SearchLibraryJsonResult{
+				.items = {},
+				.total = 0
+			});
+		}
+		auto includesType = [=](const String& type) {
+			return options.types.empty() || options.types.contains(type);
+		};
+		bool includesAlbums = includesType("album");
+		bool includesPlaylists = includesType("playlist");
+		String collectionType = (includesAlbums && includesPlaylists) ? String() : (includesAlbums ? "album" : "playlist");
+		// in the order that items at the same position are merged
+		ArrayList<String> tableKeys;
+		if(includesType("track")) {
+			tableKeys.pushBack("tracks");
+		}
+		if(includesAlbums || includesPlaylists) {
+			tableKeys.pushBack("collections");
+		}
+		if(includesType("artist")) {
+			tableKeys.pushBack("artists");
+		}
+		if(includesType("user")) {
+			tableKeys.pushBack("userAccounts");
+		}
+		auto cursor = options.after.valueOr(sql::SearchCursor());
+		auto tablePosition = [=](const String& key) -> Optional<sql::SearchCursor::Position> {
+			auto it = cursor.tables.find(key);
+			if(it == cursor.tables.end()) {
+				return std::nullopt;
+			}
+			return it->second;
+		};
+		size_t limit = options.limit;
+		return transaction({.useSQLTransaction=true, .readOnly=true}, [=](auto& tx) {
+			for(auto& key : tableKeys) {
+				auto after = tablePosition(key);
+				if(key == "tracks") {
+					sql::selectTrackSearchResultCount(tx, key+"Count", matchQuery);
+					sql::selectTrackSearchResults(tx, key, matchQuery, after, limit);
+				} else if(key == "collections") {
+					sql::selectTrackCollectionSearchResultCount(tx, key+"Count", matchQuery, collectionType);
+					sql::selectTrackCollectionSearchResults(tx, key, matchQuery, collectionType, after, limit);
+				} else if(key == "artists") {
+					sql::selectArtistSearchResultCount(tx, key+"Count", matchQuery);
+					sql::selectArtistSearchResults(tx, key, matchQuery, after, limit);
+				} else if(key == "userAccounts") {
+					sql::selectUserAccountSearchResultCount(tx, key+"Count", matchQuery);
+					sql::selectUserAccountSearchResults(tx, key, matchQuery, after, limit);
+				}
+			}
+		}).map(nullptr, [=](auto results) -> SearchLibraryJsonResult {
+			size_t total = 0;
+			ArrayList<ArrayList<Json>> tableRows;
+			tableRows.reserve(tableKeys.size());
+			for(auto& key : tableKeys) {
+				auto countItems = results[key+"Count"];
+				if(countItems.size() > 0) {
+					total += (size_t)countItems.front().number_value();
+				}
+				auto& rows = results[key];
+				tableRows.pushBack(ArrayList<Json>(rows.begin(), rows.end()));
+			}
+			// bm25 depends on each table's own statistics, so instead of comparing ranks across tables,
+			// merge by each row's position within its table, breaking ties by the table order
+			ArrayList<size_t> tableStarts = tableKeys.map([&](auto& key) -> size_t {
+				auto position = tablePosition(key);
+				return position ? position->count : 0;
+			});
+			ArrayList<size_t> takenCounts(tableKeys.size(), 0);
+			auto next = cursor;
+			LinkedList<Json> items;
+			while(items.size() < limit) {
+				Optional<size_t> nextTable;
+				for(size_t i=0; i<tableKeys.size(); i++) {
+					if(takenCounts[i] >= tableRows[i].size()) {
+						continue;
+					}
+					if(!nextTable || (tableStarts[i] + takenCounts[i]) < (tableStarts[nextTable.value()] + takenCounts[nextTable.value()])) {
+						nextTable = i;
+					}
+				}
+				if(!nextTable) {
+					break;
+				}
+				size_t i = nextTable.value();
+				auto& row = tableRows[i][takenCounts[i]];
+				takenCounts[i]++;
+				items.pushBack(row);
+				next.tables[tableKeys[i]] = sql::SearchCursor::Position{
+					.rank = row["rank"].number_value(),
+					.uri = row["mediaItem"]["uri"].string_value(),
+					.count = tableStarts[i] + takenCounts[i]
+				};
+			}
+			return SearchLibraryJsonResult{
+				.items = items,
+				.total = total,
+				.next = next
+			};
+		});
+	}
+
+
+
+	#pragma mark Garbage Collection
+
+	Promise<MediaDatabase::CollectGarbageResult> MediaDatabase::collectGarbage(CollectGarbageOptions options) {
+		auto startTime = fgl::new$<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
+		return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+			*startTime = std::chrono::steady_clock::now();
+			sql::deleteUnreferencedRowsBatch(tx, "gc", options.batchSize);
+		}).then([=](std::map<String,LinkedList<Json>> results) -> Promise<CollectGarbageResult> {
+			auto result = CollectGarbageResult{
+				.scannedRows = 0,
+				.deletedRows = {},
+				.totalDeletedRows = 0
+			};
+			String scannedPrefix = "gc_scanned_";
+			String deletedPrefix = "gc_deleted_";
+			for(auto& pair : results) {
+				if(pair.second.size() == 0) {
+					continue;
+				}
+				size_t count = (size_t)pair.second.front().number_value();
+				if(pair.first.startsWith(scannedPrefix)) {
+					result.scannedRows += count;
+				} else if(pair.first.startsWith(deletedPrefix)) {
+					result.deletedRows[pair.first.substring(deletedPrefix.length())] = count;
+					result.totalDeletedRows += count;
+				}
+			}
+			auto finish = [=](CollectGarbageResult result) {
+				result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *startTime);
+				return result;
+			};
+			if(!options.incrementalVacuum || result.totalDeletedRows == 0) {
+				return Promise<CollectGarbageResult>::resolve(finish(result));
+			}
+			// release the freed pages from the file. this does nothing unless auto_vacuum is INCREMENTAL
+			return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+				tx.addSQL("PRAGMA incremental_vacuum", {});
+			}).map(nullptr, [=](auto vacuumResults) -> CollectGarbageResult {
+				return finish(result);
+			});
+		});
+	}
+
+	Promise<void> MediaDatabase::vacuum() {
+		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+			tx.addSQL((String)"PRAGMA auto_vacuum = "+(options.connection.autoVacuum.empty() ? String("NONE") : options.connection.autoVacuum), {});
+			tx.addSQL("VACUUM", {});
+		}).then([=](auto results) {
+			// VACUUM can renumber the rowids that the search index is keyed by
+			return transaction({.useSQLTransaction=true}, [=](auto& tx) {
+				tx.addSQL(sql::rebuildSearchIndex(), {});
+			}).toVoid();
+		});
+	}
+
+
+
 	#pragma mark DBState
 
 	Promise<void> MediaDatabase::setState(std::map<String,String> state) {
@@ -1159,7 +1825,7 @@ namespace sh {
 	}
 
 	Promise<std::map<String,String>> MediaDatabase::getState(ArrayList<String> keys) {
-		return transaction({.useSQLTransaction=false}, [=](auto& tx) {
+		return transaction({.useSQLTransaction=false, .readOnly=true}, [=](auto& tx) {
 			for(auto& key : keys) {
 				sql::selectDBState(tx, key, key);
 			}
@@ -1197,4 +1863,8 @@ namespace sh {
 	String MediaDatabase::stateKey_scrobblerMatchHistoryDate(const Scrobbler* scrobbler) const {
 		return "scrobblerMatchHistoryDate_"+scrobbler->name();
 	}
+
+	String MediaDatabase::stateKey_mediaAttributeStorage() const {
+		return "mediaAttributeStorage";
+	}
 }
@@ -10,6 +10,8 @@
 
 #include <string>
 #include <map>
+#include <atomic>
+#include <chrono>
 #include <soundhole/common.hpp>
 #include <soundhole/media/Track.hpp>
 #include <soundhole/media/Album.hpp>
@@ -20,9 +22,13 @@
 #include <soundhole/media/UnmatchedScrobble.hpp>
 #include <soundhole/media/MediaProviderStash.hpp>
 #include <soundhole/media/ScrobblerStash.hpp>
+#include "MediaDatabaseSQL.hpp"
 #include "SQLIndexRange.hpp"
+#include "SQLKeysetCursor.hpp"
 #include "SQLOrder.hpp"
 #include "SQLOrderBy.hpp"
+#include "SQLiteStatementCache.hpp"
+#include "SQLiteQueryMonitor.hpp"
 
 struct sqlite3;
 
@@ -31,10 +37,36 @@ namespace sh {
 
 	class MediaDatabase {
 	public:
+		struct ConnectionOptions {
+			/// PRAGMA auto_vacuum. This only takes effect when the database is created, or on the next vacuum()
+			String autoVacuum = "INCREMENTAL";
+			/// PRAGMA journal_mode. Read connections are only opened in WAL mode
+			String journalMode = "WAL";
+			/// PRAGMA synchronous
+			String synchronous = "NORMAL";
+			/// PRAGMA cache_size. Negative values are in KiB, positive values are in pages
+			Optional<long> cacheSize;
+			/// PRAGMA mmap_size, in bytes
+			Optional<long> mmapSize;
+			/// PRAGMA temp_store
+			String tempStore = "MEMORY";
+			/// PRAGMA busy_timeout, in milliseconds
+			long busyTimeout = 5000;
+		};
+		
 		struct Options {
 			String path;
 			MediaProviderStash* mediaProviderStash;
 			ScrobblerStash* scrobblerStash;
+			/// the maximum number of prepared statements to keep cached per connection
+			size_t statementCacheCapacity = 64;
+			ConnectionOptions connection;
+			/// the number of read-only connections used for read transactions, alongside the single writer connection
+			size_t readConnectionCount = 2;
+			/// how media item images are stored. an existing database is converted when it's initialized with a different value
+			sql::MediaAttributeStorage attributeStorage = sql::MediaAttributeStorage::JSON;
+			/// statement and transaction timing, shared by every connection
+			SQLiteQueryMonitor::Options queryMonitor;
 		};
 		
 		MediaDatabase(Options);
@@ -52,9 +84,19 @@ namespace sh {
 		
 		struct TransactionOptions {
 			bool useSQLTransaction = true;
+			/// Read-only transactions run on the read connection pool, concurrently with writes.
+			/// While any write is queued or running, they run on the write queue instead, so a read always sees the writes issued before it
+			bool readOnly = false;
 		};
 		Promise<std::map<String,LinkedList<Json>>> transaction(TransactionOptions options, Function<void(SQLiteTransaction&)> executor);
 		
+		SQLiteStatementCache::Stats statementCacheStats();
+		void resetStatementCacheStats();
+		
+		/// Aggregate timing of the statements and transactions run since the last reset, including how long transactions waited to run
+		SQLiteQueryMonitor::Snapshot queryStats() const;
+		void resetQueryStats();
+		
 		struct InitializeOptions {
 			bool purge = false;
 		};
@@ -79,6 +121,9 @@ namespace sh {
 			size_t total;
 		};
 		
+		/// Creates a cursor for selecting the saved items that come after the given saved item json
+		static sql::LibraryItemCursor savedItemCursor(const Json& savedItemJson, sql::LibraryItemOrderBy orderBy);
+		
 		
 		Promise<void> cacheTracks(ArrayList<$<Track>> tracks, CacheOptions options = CacheOptions());
 		Promise<LinkedList<Json>> getTracksJson(ArrayList<String> uris);
@@ -93,8 +138,27 @@ namespace sh {
 		
 		Promise<void> cacheTrackCollectionItems($<TrackCollection> collection, Optional<sql::IndexRange> itemsRange = std::nullopt, CacheOptions options = CacheOptions());
 		Promise<void> updateTrackCollectionVersionId($<TrackCollection> collection, CacheOptions options = CacheOptions());
+		Promise<void> updateTrackCollectionVersionIds(ArrayList<$<TrackCollection>> collections, CacheOptions options = CacheOptions());
 		Promise<std::map<size_t,Json>> getTrackCollectionItemsJson(String collectionURI, sql::IndexRange range);
 		
+		/// The stored items of a collection, used to only write the items that changed while syncing it
+		struct TrackCollectionItemsSyncState {
+			struct Chunk {
+				size_t endIndex;
+				String fingerprint;
+			};
+			/// fingerprints of stored runs of items, keyed by start index
+			std::map<size_t,Chunk> chunks;
+			/// whether the item keys have been loaded. they're only loaded once a range doesn't match its fingerprint
+			bool itemKeysLoaded = false;
+			/// keys of the stored items, keyed by index
+			std::map<size_t,String> itemKeys;
+		};
+		Promise<$<TrackCollectionItemsSyncState>> getTrackCollectionItemsSyncState(String collectionURI);
+		/// Writes the items in the range that differ from the sync state, along with their tracks, and records the range's fingerprint.
+		/// Resolves with the number of item rows written, which is 0 if the range was unchanged
+		Promise<size_t> cacheTrackCollectionItemsDelta($<TrackCollection> collection, sql::IndexRange itemsRange, $<TrackCollectionItemsSyncState> syncState, CacheOptions options = CacheOptions());
+		
 		
 		Promise<void> cacheArtists(ArrayList<$<Artist>> artists, CacheOptions options = CacheOptions());
 		Promise<LinkedList<Json>> getArtistsJson(ArrayList<String> uris);
@@ -113,10 +177,16 @@ namespace sh {
 			String libraryProvider;
 			sql::LibraryItemOrderBy orderBy = sql::LibraryItemOrderBy::ADDED_AT;
 			sql::Order order = sql::Order::DESC;
+			/// continue after the last item of a previous page. The range is then relative to the cursor
+			Optional<sql::LibraryItemCursor> after;
 		};
 		Promise<GetJsonItemsListResult> getSavedTracksJson(sql::IndexRange range, GetSavedTracksOptions options = GetSavedTracksOptions{
 			.orderBy=sql::LibraryItemOrderBy::ADDED_AT,
 			.order=sql::Order::DESC});
+		/// Decodes rows directly into tracks, without building intermediate json
+		Promise<GetItemsListResult<sql::SavedTrackItem>> getSavedTracks(sql::IndexRange range, GetSavedTracksOptions options = GetSavedTracksOptions{
+			.orderBy=sql::LibraryItemOrderBy::ADDED_AT,
+			.order=sql::Order::DESC});
 		Promise<Json> getSavedTrackJson(String uri);
 		Promise<ArrayList<bool>> hasSavedTracks(ArrayList<String> uris);
 		Promise<void> deleteSavedTrack(String uri);
@@ -128,6 +198,8 @@ namespace sh {
 			Optional<sql::IndexRange> range;
 			sql::LibraryItemOrderBy orderBy = sql::LibraryItemOrderBy::NAME;
 			sql::Order order = sql::Order::ASC;
+			/// continue after the last item of a previous page. The range is then relative to the cursor
+			Optional<sql::LibraryItemCursor> after;
 		};
 		Promise<GetJsonItemsListResult> getSavedAlbumsJson(GetSavedAlbumsOptions options = GetSavedAlbumsOptions{
 			.orderBy=sql::LibraryItemOrderBy::NAME,
@@ -143,6 +215,8 @@ namespace sh {
 			Optional<sql::IndexRange> range;
 			sql::LibraryItemOrderBy orderBy = sql::LibraryItemOrderBy::NAME;
 			sql::Order order = sql::Order::ASC;
+			/// continue after the last item of a previous page. The range is then relative to the cursor
+			Optional<sql::LibraryItemCursor> after;
 		};
 		Promise<GetJsonItemsListResult> getSavedPlaylistsJson(GetSavedPlaylistsOptions options = GetSavedPlaylistsOptions{
 			.orderBy=sql::LibraryItemOrderBy::NAME,
@@ -205,6 +279,10 @@ namespace sh {
 			PlaybackHistoryItemFilters filters;
 			Optional<sql::IndexRange> range;
 			sql::Order order = sql::Order::DESC;
+			/// continue after the last item of a previous page. The range is then relative to the cursor
+			Optional<sql::PlaybackHistoryCursor> after;
+			/// counting the matching items scans all of them, so generators skip it. total is 0 when false
+			bool includeTotal = true;
 		};
 		Promise<GetJsonItemsListResult> getPlaybackHistoryItemsJson(GetPlaybackHistoryItemsOptions options = GetPlaybackHistoryItemsOptions{
 			.filters = PlaybackHistoryItemFilters{
@@ -213,6 +291,14 @@ namespace sh {
 			},
 			.order = sql::Order::DESC
 		});
+		/// Decodes rows directly into history items, without building intermediate json
+		Promise<GetItemsListResult<$<PlaybackHistoryItem>>> getPlaybackHistoryItems(GetPlaybackHistoryItemsOptions options = GetPlaybackHistoryItemsOptions{
+			.filters = PlaybackHistoryItemFilters{
+				.minDateInclusive = true,
+				.maxDateInclusive = false
+			},
+			.order = sql::Order::DESC
+		});
 		Promise<void> deletePlaybackHistoryItem(Date startTime, String trackURI);
 		
 		
@@ -293,6 +379,46 @@ namespace sh {
 		Promise<void> loadPlaylistItems($<Playlist> playlist, Playlist::Mutator* mutator, size_t index, size_t count);
 		
 		
+		struct SearchLibraryOptions {
+			/// "track", "album", "playlist", "artist", or "user". Every type is searched if empty
+			ArrayList<String> types;
+			/// the cursor of the previous page, or empty for the first page
+			Optional<sql::SearchCursor> after;
+			size_t limit = 20;
+		};
+		struct SearchLibraryJsonResult {
+			LinkedList<Json> items;
+			size_t total;
+			/// pass as the "after" option to get the next page
+			sql::SearchCursor next;
+		};
+		/// Searches the names of all cached media items, matching each word of the query as a prefix.
+		/// Each item has a "rank" (lower is better) and a "mediaItem". Ranks are only comparable within a type,
+		/// so items are ordered by their position within their type's results, and items at the same position
+		/// are ordered by type: tracks, then albums and playlists, then artists, then users
+		Promise<SearchLibraryJsonResult> searchLibraryJson(String query, SearchLibraryOptions options = SearchLibraryOptions());
+		
+		
+		struct CollectGarbageOptions {
+			/// the number of rows of each table to check for references per run, or 0 to check every row
+			size_t batchSize = 500;
+			/// whether to release the freed pages from the file afterwards
+			bool incrementalVacuum = true;
+		};
+		struct CollectGarbageResult {
+			size_t scannedRows;
+			/// the number of rows deleted from each table
+			std::map<String,size_t> deletedRows;
+			size_t totalDeletedRows;
+			std::chrono::milliseconds duration;
+		};
+		/// Deletes cached media that is no longer referenced by the library, history, or scrobbles.
+		/// Each run checks a bounded batch of each table, resuming where the last run stopped, so it can run in idle time without holding the database for long.
+		Promise<CollectGarbageResult> collectGarbage(CollectGarbageOptions options = CollectGarbageOptions());
+		/// Rewrites the database file to reclaim all of its free space. This blocks writes for the whole rewrite
+		Promise<void> vacuum();
+		
+		
 		Promise<void> setState(std::map<String,String> state);
 		Promise<std::map<String,String>> getState(ArrayList<String> keys);
 		Promise<String> getStateValue(String key, String defaultValue);
@@ -301,13 +427,38 @@ namespace sh {
 		String stateKey_syncLibraryResumeData(const MediaProvider*) const;
 		/// The DBState key used for the last date a scrobbler has matched against the user's playback history
 		String stateKey_scrobblerMatchHistoryDate(const Scrobbler*) const;
+		/// The DBState key for the MediaAttributeStorage that the database was last converted to
+		String stateKey_mediaAttributeStorage() const;
 		
 	private:
+		struct ReadConnection {
+			std::mutex mutex;
+			sqlite3* db;
+			SQLiteStatementCache* statementCache;
+			DispatchQueue* queue;
+		};
+		
 		static void applyDBState(SQLiteTransaction& tx, std::map<String,String> state);
+		static void applyConnectionPragmas(sqlite3* db, const ConnectionOptions& options, bool writable);
+		
+		Promise<void> loadTrackCollectionItemKeys(String collectionURI, $<TrackCollectionItemsSyncState> syncState);
+		
+		void openReadConnections();
+		void closeReadConnections();
+		ReadConnection* nextReadConnection();
+		bool canUseReadConnections() const;
+		Promise<std::map<String,LinkedList<Json>>> readTransaction(ReadConnection* reader, TransactionOptions options, Function<void(SQLiteTransaction&)> executor);
+		void recordTransaction(std::chrono::steady_clock::time_point queuedTime, std::chrono::steady_clock::time_point startTime, bool readOnly);
 		
 		Options options;
 		std::recursive_mutex dbMutex;
 		sqlite3* db;
+		SQLiteStatementCache* statementCache;
+		SQLiteQueryMonitor* queryMonitor;
 		DispatchQueue* queue;
+		ArrayList<ReadConnection*> readConnections;
+		std::atomic<size_t> nextReadConnectionIndex;
+		/// writes that have been queued but haven't finished running
+		std::atomic<size_t> pendingWriteCount;
 	};
 }
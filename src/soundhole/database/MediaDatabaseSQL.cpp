@@ -8,6 +8,9 @@
 
 #include "MediaDatabaseSQL.hpp"
 #include <any>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
 
 namespace sh::sql {
 
@@ -32,14 +35,30 @@ Any sqlStringOrNull(String str) {
 	return str;
 }
 
-#define COALESCE_FIELD(params, field, table, uri) \
-	sqlOptParam(params, Any(), \
-		"(SELECT " field " FROM " table " WHERE uri = ?)", { Any((String)uri) })
-#define MAYBE_COALESCE_FIELD(coalesce, params, field, table, item, value) \
-	(coalesce ? \
-		sqlOptParam(params, value, \
-			"(SELECT " field " FROM " table " WHERE uri = ?)", { Any(item->uri()) }) \
-		: sqlParam(params, value))
+String upsertSQL(String table, const ArrayList<String>& columns, const ArrayList<String>& conflictColumns, const ArrayList<String>& coalesceColumns) {
+	LinkedList<String> values;
+	LinkedList<String> updates;
+	for(auto& column : columns) {
+		if(column == "lastRowUpdateTime") {
+			values.pushBack("CURRENT_TIMESTAMP");
+		} else {
+			values.pushBack("?");
+		}
+		if(conflictColumns.contains(column)) {
+			continue;
+		}
+		if(coalesceColumns.contains(column)) {
+			updates.pushBack(String::join({ column," = COALESCE(excluded.",column,", ",column,")" }));
+		} else {
+			updates.pushBack(String::join({ column," = excluded.",column }));
+		}
+	}
+	return String::join({
+		"INSERT INTO ",table," (",String::join(columns, ", "),") VALUES (",String::join(values, ", "),")",
+		" ON CONFLICT(",String::join(conflictColumns, ", "),") DO ",
+		(updates.size() > 0) ? ("UPDATE SET "+String::join(updates, ", ")) : String("NOTHING")
+	});
+}
 
 #define EXISTING_FIELD_OR(params, value, fallback) \
 	String::join({ \
@@ -89,6 +108,9 @@ ArrayList<String> scrobbleColumns() {
 ArrayList<String> unmatchedScrobbleColumns() {
 	return { "scrobbler", "startTime", "trackURI", "lastRowUpdateTime" };
 }
+ArrayList<String> imageColumns() {
+	return { "mediaItemURI", "indexNum", "url", "size", "width", "height" };
+}
 
 
 
@@ -256,6 +278,270 @@ CREATE TABLE IF NOT EXISTS DBState (
 )SQL";
 }
 
+String createIndexes() {
+	return R"SQL(
+CREATE INDEX IF NOT EXISTS Track_albumURI ON Track(albumURI);
+CREATE INDEX IF NOT EXISTS TrackArtist_artistURI ON TrackArtist(artistURI);
+CREATE INDEX IF NOT EXISTS TrackCollectionArtist_artistURI ON TrackCollectionArtist(artistURI);
+CREATE INDEX IF NOT EXISTS TrackCollectionItem_trackURI ON TrackCollectionItem(trackURI);
+CREATE INDEX IF NOT EXISTS SavedTrack_addedAt ON SavedTrack(addedAt, trackURI);
+CREATE INDEX IF NOT EXISTS SavedTrack_libraryProvider_addedAt ON SavedTrack(libraryProvider, addedAt, trackURI);
+CREATE INDEX IF NOT EXISTS SavedAlbum_addedAt ON SavedAlbum(addedAt, albumURI);
+CREATE INDEX IF NOT EXISTS SavedAlbum_libraryProvider_addedAt ON SavedAlbum(libraryProvider, addedAt, albumURI);
+CREATE INDEX IF NOT EXISTS SavedPlaylist_addedAt ON SavedPlaylist(addedAt, playlistURI);
+CREATE INDEX IF NOT EXISTS SavedPlaylist_libraryProvider_addedAt ON SavedPlaylist(libraryProvider, addedAt, playlistURI);
+CREATE INDEX IF NOT EXISTS Track_sortName ON Track(TRIM(TRIM(TRIM(LOWER(name),'"'),"'"),'-'));
+CREATE INDEX IF NOT EXISTS TrackCollection_sortName ON TrackCollection(TRIM(TRIM(TRIM(LOWER(name),'"'),"'"),'-'));
+CREATE INDEX IF NOT EXISTS PlaybackHistoryItem_trackURI ON PlaybackHistoryItem(trackURI, startTime);
+CREATE INDEX IF NOT EXISTS PlaybackHistoryItem_visibility_startTime ON PlaybackHistoryItem(visibility, startTime);
+CREATE INDEX IF NOT EXISTS Scrobble_scrobbler_uploaded_startTime ON Scrobble(scrobbler, uploaded, startTime);
+CREATE INDEX IF NOT EXISTS Scrobble_scrobbler_startTime ON Scrobble(scrobbler, startTime);
+CREATE INDEX IF NOT EXISTS Scrobble_historyItem ON Scrobble(historyItemStartTime, trackURI);
+CREATE INDEX IF NOT EXISTS UnmatchedScrobble_historyItem ON UnmatchedScrobble(startTime, trackURI);
+)SQL";
+}
+
+String searchArtistNames(String artistsColumn) {
+	return String::join({
+		"(CASE WHEN json_valid(",artistsColumn,") THEN "
+			"(SELECT group_concat(json_extract(value, '$.name'), ' ') FROM json_each(",artistsColumn,")) "
+		"END)"
+	});
+}
+
+String createSearchIndex() {
+	// each search table shares its rowid with the indexed row, and is kept in sync with triggers.
+	// the uri is stored as well, so that a stale rowid can never join to the wrong row.
+	// upserts rewrite every column, so the update triggers only reindex when a searched column changed.
+	auto trackArtists = [](String row) { return searchArtistNames(row+".artists"); };
+	return String::join({ R"SQL(
+CREATE VIRTUAL TABLE IF NOT EXISTS TrackSearch USING fts5(
+	uri UNINDEXED, name, albumName, artistNames,
+	tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'
+);
+CREATE VIRTUAL TABLE IF NOT EXISTS TrackCollectionSearch USING fts5(
+	uri UNINDEXED, name, artistNames,
+	tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'
+);
+CREATE VIRTUAL TABLE IF NOT EXISTS ArtistSearch USING fts5(
+	uri UNINDEXED, name,
+	tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'
+);
+CREATE VIRTUAL TABLE IF NOT EXISTS UserAccountSearch USING fts5(
+	uri UNINDEXED, name,
+	tokenize = 'unicode61 remove_diacritics 2', prefix = '2 3'
+);
+CREATE TRIGGER IF NOT EXISTS Track_searchInsert AFTER INSERT ON Track BEGIN
+	INSERT INTO TrackSearch (rowid, uri, name, albumName, artistNames) VALUES (new.rowid, new.uri, new.name, new.albumName, )SQL",trackArtists("new"),R"SQL();
+END;
+CREATE TRIGGER IF NOT EXISTS Track_searchUpdate AFTER UPDATE OF uri, name, albumName, artists ON Track
+	WHEN old.uri IS NOT new.uri OR old.name IS NOT new.name OR old.albumName IS NOT new.albumName OR old.artists IS NOT new.artists
+BEGIN
+	DELETE FROM TrackSearch WHERE rowid = old.rowid;
+	INSERT INTO TrackSearch (rowid, uri, name, albumName, artistNames) VALUES (new.rowid, new.uri, new.name, new.albumName, )SQL",trackArtists("new"),R"SQL();
+END;
+CREATE TRIGGER IF NOT EXISTS Track_searchDelete AFTER DELETE ON Track BEGIN
+	DELETE FROM TrackSearch WHERE rowid = old.rowid;
+END;
+CREATE TRIGGER IF NOT EXISTS TrackCollection_searchInsert AFTER INSERT ON TrackCollection BEGIN
+	INSERT INTO TrackCollectionSearch (rowid, uri, name, artistNames) VALUES (new.rowid, new.uri, new.name, )SQL",trackArtists("new"),R"SQL();
+END;
+CREATE TRIGGER IF NOT EXISTS TrackCollection_searchUpdate AFTER UPDATE OF uri, name, artists ON TrackCollection
+	WHEN old.uri IS NOT new.uri OR old.name IS NOT new.name OR old.artists IS NOT new.artists
+BEGIN
+	DELETE FROM TrackCollectionSearch WHERE rowid = old.rowid;
+	INSERT INTO TrackCollectionSearch (rowid, uri, name, artistNames) VALUES (new.rowid, new.uri, new.name, )SQL",trackArtists("new"),R"SQL();
+END;
+CREATE TRIGGER IF NOT EXISTS TrackCollection_searchDelete AFTER DELETE ON TrackCollection BEGIN
+	DELETE FROM TrackCollectionSearch WHERE rowid = old.rowid;
+END;
+CREATE TRIGGER IF NOT EXISTS Artist_searchInsert AFTER INSERT ON Artist BEGIN
+	INSERT INTO ArtistSearch (rowid, uri, name) VALUES (new.rowid, new.uri, new.name);
+END;
+CREATE TRIGGER IF NOT EXISTS Artist_searchUpdate AFTER UPDATE OF uri, name ON Artist
+	WHEN old.uri IS NOT new.uri OR old.name IS NOT new.name
+BEGIN
+	DELETE FROM ArtistSearch WHERE rowid = old.rowid;
+	INSERT INTO ArtistSearch (rowid, uri, name) VALUES (new.rowid, new.uri, new.name);
+END;
+CREATE TRIGGER IF NOT EXISTS Artist_searchDelete AFTER DELETE ON Artist BEGIN
+	DELETE FROM ArtistSearch WHERE rowid = old.rowid;
+END;
+CREATE TRIGGER IF NOT EXISTS UserAccount_searchInsert AFTER INSERT ON UserAccount BEGIN
+	INSERT INTO UserAccountSearch (rowid, uri, name) VALUES (new.rowid, new.uri, new.name);
+END;
+CREATE TRIGGER IF NOT EXISTS UserAccount_searchUpdate AFTER UPDATE OF uri, name ON UserAccount
+	WHEN old.uri IS NOT new.uri OR old.name IS NOT new.name
+BEGIN
+	DELETE FROM UserAccountSearch WHERE rowid = old.rowid;
+	INSERT INTO UserAccountSearch (rowid, uri, name) VALUES (new.rowid, new.uri, new.name);
+END;
+CREATE TRIGGER IF NOT EXISTS UserAccount_searchDelete AFTER DELETE ON UserAccount BEGIN
+	DELETE FROM UserAccountSearch WHERE rowid = old.rowid;
+END;
+)SQL", rebuildSearchIndex() });
+}
+
+String rebuildSearchIndex() {
+	return String::join({ R"SQL(
+DELETE FROM TrackSearch;
+INSERT INTO TrackSearch (rowid, uri, name, albumName, artistNames) SELECT rowid, uri, name, albumName, )SQL",searchArtistNames("Track.artists"),R"SQL( FROM Track;
+DELETE FROM TrackCollectionSearch;
+INSERT INTO TrackCollectionSearch (rowid, uri, name, artistNames) SELECT rowid, uri, name, )SQL",searchArtistNames("TrackCollection.artists"),R"SQL( FROM TrackCollection;
+DELETE FROM ArtistSearch;
+INSERT INTO ArtistSearch (rowid, uri, name) SELECT rowid, uri, name FROM Artist;
+DELETE FROM UserAccountSearch;
+INSERT INTO UserAccountSearch (rowid, uri, name) SELECT rowid, uri, name FROM UserAccount;
+)SQL" });
+}
+
+String createGarbageCollectionIndexes() {
+	// lookups for whether a row is still referenced by another table
+	return R"SQL(
+CREATE INDEX IF NOT EXISTS TrackCollection_ownerURI ON TrackCollection(ownerURI);
+CREATE INDEX IF NOT EXISTS PlaybackHistoryItem_contextURI ON PlaybackHistoryItem(contextURI);
+CREATE INDEX IF NOT EXISTS Scrobble_trackURI ON Scrobble(trackURI);
+)SQL";
+}
+
+String createMediaAttributeTables() {
+	// join table rows are ordered the same as the artists column, and images are stored one per row.
+	// the Image table is only filled when images are normalized, but rows are always removed along with their media item.
+	auto artistIndexNum = [](String table, String joinTable, String joinColumn) {
+		return String::join({
+			"UPDATE ",joinTable," SET indexNum = ("
+				"SELECT CAST(je.key AS INT) FROM ",table,", json_each(CASE WHEN json_valid(",table,".artists) THEN ",table,".artists END) AS je "
+				"WHERE ",table,".uri = ",joinTable,".",joinColumn," AND json_extract(je.value, '$.uri') = ",joinTable,".artistURI"
+			");"
+		});
+	};
+	return String::join({ R"SQL(
+ALTER TABLE TrackArtist ADD COLUMN indexNum INT;
+ALTER TABLE TrackCollectionArtist ADD COLUMN indexNum INT;
+)SQL",
+	artistIndexNum("Track", "TrackArtist", "trackURI"),"\n",
+	artistIndexNum("TrackCollection", "TrackCollectionArtist", "collectionURI"),R"SQL(
+CREATE TABLE IF NOT EXISTS Image (
+	mediaItemURI TEXT NOT NULL,
+	indexNum INT NOT NULL,
+	url TEXT NOT NULL,
+	size TEXT NOT NULL,
+	width INT,
+	height INT,
+	PRIMARY KEY(mediaItemURI, indexNum)
+) WITHOUT ROWID;
+)SQL",
+	String::join(imageTables().map([](auto& table) {
+		return String::join({
+			"CREATE TRIGGER IF NOT EXISTS ",table,"_imagesDelete AFTER DELETE ON ",table," BEGIN\n"
+			"\tDELETE FROM Image WHERE mediaItemURI = old.uri;\n"
+			"END;\n"
+		});
+	}), "")
+	});
+}
+
+ArrayList<String> imageTables() {
+	return { "Track", "TrackCollection", "Artist", "UserAccount" };
+}
+
+String selectImageRowsFromJson(String uriExpr, String imagesExpr, String fromTable) {
+	return String::join({
+		"SELECT ",uriExpr,", CAST(je.key AS INT), json_extract(je.value, '$.url'), json_extract(je.value, '$.size'), "
+			"json_extract(je.value, '$.dimensions.width'), json_extract(je.value, '$.dimensions.height') "
+		"FROM ",(fromTable.empty() ? String() : fromTable+", "),"json_each(CASE WHEN json_valid(",imagesExpr,") THEN ",imagesExpr," END) AS je"
+	});
+}
+
+String imagesJsonFromTable(String uriExpr) {
+	// evaluates to null rather than an empty array when there are no rows, to match an unset images column
+	return String::join({
+		"(SELECT CASE WHEN count(*) > 0 THEN json_group_array(json_object("
+			"'url', url, 'size', size, "
+			"'dimensions', json(CASE WHEN width IS NOT NULL AND height IS NOT NULL THEN json_object('width', width, 'height', height) END)"
+		")) END FROM (SELECT * FROM Image WHERE Image.mediaItemURI = ",uriExpr," ORDER BY Image.indexNum))"
+	});
+}
+
+String normalizeMediaAttributes() {
+	// moves every images column into the Image table, then keeps them there with triggers.
+	// the triggers clear the column after copying it, so writers don't need to know which layout is in use.
+	LinkedList<String> statements;
+	for(auto& table : imageTables()) {
+		statements.pushBack(String::join({
+			"DELETE FROM Image WHERE mediaItemURI IN (SELECT uri FROM ",table," WHERE images IS NOT NULL);\n"
+			"INSERT OR REPLACE INTO Image (mediaItemURI, indexNum, url, size, width, height) ",
+				selectImageRowsFromJson(table+".uri", table+".images", table)," WHERE ",table,".images IS NOT NULL;\n"
+			"UPDATE ",table," SET images = NULL WHERE images IS NOT NULL;\n"
+		}));
+		for(auto& event : { String("INSERT"), String("UPDATE OF images") }) {
+			statements.pushBack(String::join({
+				"CREATE TRIGGER IF NOT EXISTS ",table,"_images",(event == "INSERT") ? "Insert" : "Update"," AFTER ",event," ON ",table,"\n"
+				"\tWHEN new.images IS NOT NULL\n"
+				"BEGIN\n"
+				"\tDELETE FROM Image WHERE mediaItemURI = new.uri;\n"
+				"\tINSERT INTO Image (mediaItemURI, indexNum, url, size, width, height) ",selectImageRowsFromJson("new.uri", "new.images"),";\n"
+				"\tUPDATE ",table," SET images = NULL WHERE rowid = new.rowid;\n"
+				"END;\n"
+			}));
+		}
+	}
+	return String::join(statements, "");
+}
+
+String denormalizeMediaAttributes() {
+	LinkedList<String> statements;
+	for(auto& table : imageTables()) {
+		statements.pushBack(String::join({
+			"DROP TRIGGER IF EXISTS ",table,"_imagesInsert;\n"
+			"DROP TRIGGER IF EXISTS ",table,"_imagesUpdate;\n"
+			"UPDATE ",table," SET images = ",imagesJsonFromTable(table+".uri"),
+				" WHERE EXISTS (SELECT mediaItemURI FROM Image WHERE Image.mediaItemURI = ",table,".uri);\n"
+		}));
+	}
+	statements.pushBack("DELETE FROM Image;\n");
+	return String::join(statements, "");
+}
+
+String createTrackCollectionItemChunks() {
+	// fingerprints of stored runs of collection items, so that unchanged runs can be skipped when a collection is synced
+	return R"SQL(
+CREATE TABLE IF NOT EXISTS TrackCollectionItemChunk (
+	collectionURI TEXT NOT NULL,
+	startIndex INT NOT NULL,
+	endIndex INT NOT NULL,
+	fingerprint TEXT NOT NULL,
+	PRIMARY KEY(collectionURI, startIndex)
+) WITHOUT ROWID;
+)SQL";
+}
+
+String createTrackCollectionItemTrackFingerprints() {
+	// fingerprints of the track data that collection items were stored with, so that changed track metadata gets rewritten by a delta sync
+	return R"SQL(
+ALTER TABLE TrackCollectionItem ADD COLUMN trackFingerprint TEXT;
+)SQL";
+}
+
+String MediaAttributeStorage_toString(MediaAttributeStorage storage) {
+	switch(storage) {
+		case MediaAttributeStorage::JSON:
+			return "json";
+		case MediaAttributeStorage::NORMALIZED:
+			return "normalized";
+	}
+	throw std::invalid_argument("invalid MediaAttributeStorage value");
+}
+
+MediaAttributeStorage MediaAttributeStorage_fromString(const String& str) {
+	if(str == "json" || str.empty()) {
+		return MediaAttributeStorage::JSON;
+	} else if(str == "normalized") {
+		return MediaAttributeStorage::NORMALIZED;
+	}
+	throw std::invalid_argument("invalid MediaAttributeStorage "+str);
+}
+
 String purgeDB() {
 	return R"SQL(
 DROP TABLE IF EXISTS UnmatchedScrobble;
@@ -274,9 +560,62 @@ DROP TABLE IF EXISTS TrackCollection;
 DROP TABLE IF EXISTS UserAccount;
 DROP TABLE IF EXISTS Artist;
 DROP TABLE IF EXISTS DBState;
+DROP TABLE IF EXISTS TrackSearch;
+DROP TABLE IF EXISTS TrackCollectionSearch;
+DROP TABLE IF EXISTS ArtistSearch;
+DROP TABLE IF EXISTS UserAccountSearch;
+DROP TABLE IF EXISTS Image;
+DROP TABLE IF EXISTS TrackCollectionItemChunk;
+PRAGMA user_version = 0;
 )SQL";
 }
 
+const ArrayList<Migration>& migrations() {
+	// versions must be ascending, and existing migrations must never be modified once released
+	static const ArrayList<Migration> migrations = {
+		{ .version=1, .sql=createDB() },
+		{ .version=2, .sql=createIndexes() },
+		{ .version=3, .sql=createSearchIndex() },
+		{ .version=4, .sql=createGarbageCollectionIndexes() },
+		{ .version=5, .sql=createMediaAttributeTables() },
+		{ .version=6, .sql=createTrackCollectionItemChunks() },
+		{ .version=7, .sql=createTrackCollectionItemTrackFingerprints() }
+	};
+	return migrations;
+}
+
+int latestSchemaVersion() {
+	auto& list = migrations();
+	if(list.size() == 0) {
+		return 0;
+	}
+	return list.back().version;
+}
+
+String searchMatchQuery(String text) {
+	// quote each word so that FTS5 syntax in the input is matched literally
+	LinkedList<String> terms;
+	std::string term;
+	auto flushTerm = [&]() {
+		if(!term.empty()) {
+			terms.pushBack(String::join({ "\"",String(term),"\"*" }));
+			term.clear();
+		}
+	};
+	auto chars = (std::string)text;
+	for(char c : chars) {
+		if(std::isspace((unsigned char)c)) {
+			flushTerm();
+		} else if(c == '"') {
+			term += "\"\"";
+		} else {
+			term += c;
+		}
+	}
+	flushTerm();
+	return String::join(terms, " ");
+}
+
 
 
 
@@ -314,29 +653,32 @@ Any imagesJson(Optional<ArrayList<MediaItem::Image>> images) {
 ArrayList<String> trackTupleColumns() {
 	return { "uri", "provider", "name", "albumName", "albumURI", "artists", "images", "duration", "playable", "lastRowUpdateTime" };
 }
-String trackTuple(LinkedList<Any>& params, $<Track> track, const TupleOptions& options) {
-	return String::join({ "(",
+String trackUpsertSQL() {
+	return upsertSQL("Track", trackTupleColumns(), { "uri" }, {
+		"albumName", "albumURI", "artists", "images", "duration", "playable"
+	});
+}
+LinkedList<Any> trackTupleParams($<Track> track) {
+	return {
 		// uri
-		sqlParam(params, track->uri()),",",
+		track->uri(),
 		// provider
-		sqlParam(params, track->mediaProvider()->name()),",",
+		track->mediaProvider()->name(),
 		// name
-		sqlParam(params, track->name()),",",
+		track->name(),
 		// albumName
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "albumName", "Track", track, sqlStringOrNull(track->albumName())),",",
+		sqlStringOrNull(track->albumName()),
 		// albumURI
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "albumURI", "Track", track, sqlStringOrNull(track->albumURI())),",",
+		sqlStringOrNull(track->albumURI()),
 		// artists
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "artists", "Track", track, nonEmptyArtistsJson(track->artists())),",",
+		nonEmptyArtistsJson(track->artists()),
 		// images
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "images", "Track", track, imagesJson(track->images())),",",
+		imagesJson(track->images()),
 		// duration
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "duration", "Track", track, track->duration().toAny()),",",
+		track->duration().toAny(),
 		// playable
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "playable", "Track", track, track->playable().toAny()),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		track->playable().toAny()
+	};
 }
 
 
@@ -344,44 +686,50 @@ String trackTuple(LinkedList<Any>& params, $<Track> track, const TupleOptions& o
 ArrayList<String> albumTupleFromTrackColumns() {
 	return { "uri", "provider", "type", "name", "versionId", "itemCount", "artists", "images", "lastRowUpdateTime" };
 }
-String albumTupleFromTrack(LinkedList<Any>& params, $<Track> track, const TupleOptions& options) {
+String albumFromTrackUpsertSQL() {
+	return upsertSQL("TrackCollection", albumTupleFromTrackColumns(), { "uri" }, {
+		"versionId", "itemCount", "artists", "images"
+	});
+}
+LinkedList<Any> albumTupleParamsFromTrack($<Track> track) {
 	if(track->albumURI().empty()) {
 		throw std::runtime_error("Cannot create album from track with empty album URI");
 	}
-	return String::join({ "(",
+	return {
 		// uri
-		sqlParam(params, track->albumURI()),",",
+		track->albumURI(),
 		// provider
-		sqlParam(params, track->mediaProvider()->name()),",",
+		track->mediaProvider()->name(),
 		// type
-		sqlParam(params, String("album")),",",
+		String("album"),
 		// name
-		sqlParam(params, track->albumName()),",",
+		track->albumName(),
 		// versionId
-		COALESCE_FIELD(params, "versionId", "TrackCollection", track->albumURI()),",",
+		Any(),
 		// itemCount
-		COALESCE_FIELD(params, "itemCount", "TrackCollection", track->albumURI()),",",
+		Any(),
 		// artists
-		COALESCE_FIELD(params, "artists", "TrackCollection", track->albumURI()),",",
+		Any(),
 		// images
-		COALESCE_FIELD(params, "images", "TrackCollection", track->albumURI()),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		Any()
+	};
 }
 
 ArrayList<String> trackArtistTupleColumns() {
-	return { "trackURI", "artistURI", "lastRowUpdateTime" };
+	return { "trackURI", "artistURI", "indexNum", "lastRowUpdateTime" };
 }
-String trackArtistTuple(LinkedList<Any>& params, const TrackArtist& trackArtist) {
-	return String::join({ "(",
+String trackArtistUpsertSQL() {
+	return upsertSQL("TrackArtist", trackArtistTupleColumns(), { "trackURI", "artistURI" }, {});
+}
+LinkedList<Any> trackArtistTupleParams(const TrackArtist& trackArtist) {
+	return {
 		// trackURI
-		sqlParam(params, trackArtist.trackURI),",",
+		trackArtist.trackURI,
 		// artistURI
-		sqlParam(params, trackArtist.artistURI),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		trackArtist.artistURI,
+		// indexNum
+		trackArtist.indexNum
+	};
 }
 
 
@@ -415,44 +763,51 @@ Optional<Playlist::Privacy> trackCollectionPrivacy($<TrackCollection> collection
 ArrayList<String> trackCollectionTupleColumns() {
 	return { "uri", "provider", "type", "name", "versionId", "itemCount", "ownerURI", "privacy", "artists", "images", "lastRowUpdateTime" };
 }
-String trackCollectionTuple(LinkedList<Any>& params, $<TrackCollection> collection, const TrackCollectionTupleOptions& options) {
+String trackCollectionUpsertSQL(const TrackCollectionTupleOptions& options) {
+	ArrayList<String> coalesceColumns;
+	if(!options.updateVersionId) {
+		coalesceColumns.pushBack("versionId");
+	}
+	if(options.coalesce) {
+		coalesceColumns.pushBackList(ArrayList<String>{ "itemCount", "privacy", "artists", "images" });
+	}
+	return upsertSQL("TrackCollection", trackCollectionTupleColumns(), { "uri" }, coalesceColumns);
+}
+LinkedList<Any> trackCollectionTupleParams($<TrackCollection> collection, const TrackCollectionTupleOptions& options) {
 	auto artists = trackCollectionArtists(collection);
 	auto owner = trackCollectionOwner(collection);
 	auto privacy = trackCollectionPrivacy(collection);
-	return String::join({ "(",
+	return {
 		// uri
-		sqlParam(params, collection->uri()),",",
+		collection->uri(),
 		// provider
-		sqlParam(params, collection->mediaProvider()->name()),",",
+		collection->mediaProvider()->name(),
 		// type
-		sqlParam(params, collection->type()),",",
+		collection->type(),
 		// name
-		sqlParam(params, collection->name()),",",
+		collection->name(),
 		// versionId
-		options.updateVersionId ? (
-			sqlParam(params, collection->versionId())
-		) : (
-			COALESCE_FIELD(params, "versionId", "TrackCollection", collection->uri())
-		),",",
+		options.updateVersionId ? Any(collection->versionId()) : Any(),
 		// itemCount
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "itemCount", "TrackCollection", collection, collection->itemCount().toAny()),",",
+		collection->itemCount().toAny(),
 		// ownerURI
-		sqlParam(params, owner ? Any(owner->uri()) : Any()),",",
+		owner ? Any(owner->uri()) : Any(),
 		// privacy
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "privacy", "TrackCollection", collection, privacy ? Playlist::Privacy_toString(privacy.value()) : Any()),",",
+		privacy ? Any(Playlist::Privacy_toString(privacy.value())) : Any(),
 		// artists
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "artists", "TrackCollection", collection, artists ? nonEmptyArtistsJson(artists.value()) : Any()),",",
+		artists ? nonEmptyArtistsJson(artists.value()) : Any(),
 		// images
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "images", "TrackCollection", collection, imagesJson(collection->images())),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		imagesJson(collection->images())
+	};
 }
 
 ArrayList<String> trackCollectionItemTupleColumns() {
-	return { "collectionURI", "indexNum", "trackURI", "uniqueId", "addedAt", "addedBy", "lastRowUpdateTime" };
+	return { "collectionURI", "indexNum", "trackURI", "uniqueId", "addedAt", "addedBy", "trackFingerprint", "lastRowUpdateTime" };
 }
-String trackCollectionItemTuple(LinkedList<Any>& params, $<TrackCollectionItem> item) {
+String trackCollectionItemUpsertSQL() {
+	return upsertSQL("TrackCollectionItem", trackCollectionItemTupleColumns(), { "collectionURI", "indexNum" }, {});
+}
+LinkedList<Any> trackCollectionItemTupleParams($<TrackCollectionItem> item) {
 	auto collection = item->context().lock();
 	if(!collection) {
 		throw std::invalid_argument("Cannot create track collection item tuple without valid collection");
@@ -469,28 +824,72 @@ String trackCollectionItemTuple(LinkedList<Any>& params, $<TrackCollectionItem>
 		addedAt = playlistItem->addedAt().toISOString();
 		addedBy = playlistItem->addedBy();
 	}
-	return String::join({ "(",
+	return {
 		// collectionURI
-		sqlParam(params, collection->uri()),",",
+		collection->uri(),
 		// indexNum
-		sqlParam(params, indexNum.value()),",",
+		indexNum.value(),
 		// trackURI
-		sqlParam(params, item->track()->uri()),",",
+		item->track()->uri(),
 		// uniqueId
-		sqlParam(params, sqlStringOrNull(uniqueId)),",",
+		sqlStringOrNull(uniqueId),
 		// addedAt
-		sqlParam(params, sqlStringOrNull(addedAt)),",",
+		sqlStringOrNull(addedAt),
 		// addedBy
-		sqlParam(params, addedBy ? String(addedBy->toJson().dump()) : Any()),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		addedBy ? Any(String(addedBy->toJson().dump())) : Any(),
+		// trackFingerprint
+		trackFingerprint(item->track())
+	};
+}
+
+String trackCollectionItemKey(const String& trackURI, const String& trackFingerprint, const String& uniqueId, const String& addedAt) {
+	return String::join({ trackURI, "\t", trackFingerprint, "\t", uniqueId, "\t", addedAt });
+}
+
+String trackCollectionItemKey($<TrackCollectionItem> item) {
+	String uniqueId;
+	String addedAt;
+	if(auto playlistItem = std::dynamic_pointer_cast<PlaylistItem>(item)) {
+		uniqueId = playlistItem->uniqueId();
+		addedAt = playlistItem->addedAt().toISOString();
+	}
+	auto track = item->track();
+	return trackCollectionItemKey(track->uri(), trackFingerprint(track), uniqueId, addedAt);
+}
+
+String fingerprintStrings(const ArrayList<String>& strings) {
+	// 64-bit FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto addByte = [&](unsigned char byte) {
+		hash ^= byte;
+		hash *= 1099511628211ull;
+	};
+	for(auto& str : strings) {
+		for(char c : (std::string)str) {
+			addByte((unsigned char)c);
+		}
+		addByte('\n');
+	}
+	char hex[17];
+	std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+	return String(hex);
+}
+
+String trackFingerprint($<Track> track) {
+	return fingerprintStrings({ String(track->toJson().dump()) });
+}
+
+String trackCollectionItemsFingerprint(const ArrayList<String>& itemKeys) {
+	return fingerprintStrings(itemKeys);
 }
 
 ArrayList<String> albumItemTupleFromTrackColumns() {
 	return { "collectionURI", "indexNum", "trackURI", "lastRowUpdateTime" };
 }
-String albumItemTupleFromTrack(LinkedList<Any>& params, $<Track> track) {
+String albumItemFromTrackUpsertSQL() {
+	return upsertSQL("TrackCollectionItem", albumItemTupleFromTrackColumns(), { "collectionURI", "indexNum" }, {});
+}
+LinkedList<Any> albumItemTupleParamsFromTrack($<Track> track) {
 	auto albumURI = track->albumURI();
 	if(albumURI.empty()) {
 		throw std::invalid_argument("Cannot create album item tuple without albumURI");
@@ -501,50 +900,53 @@ String albumItemTupleFromTrack(LinkedList<Any>& params, $<Track> track) {
 	} else if(trackNum == 0) {
 		throw std::invalid_argument("Cannot create album item tuple with a track number equal to 0");
 	}
-	return String::join({ "(",
+	return {
 		// collectionURI
-		sqlParam(params, albumURI),",",
+		albumURI,
 		// indexNum
-		sqlParam(params, trackNum.value() - 1),",",
+		trackNum.value() - 1,
 		// trackURI
-		sqlParam(params, track->uri()),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		track->uri()
+	};
 }
 
 ArrayList<String> trackCollectionArtistTupleColumns() {
-	return { "collectionURI", "artistURI", "lastRowUpdateTime" };
+	return { "collectionURI", "artistURI", "indexNum", "lastRowUpdateTime" };
 }
-String trackCollectionArtistTuple(LinkedList<Any>& params, const TrackCollectionArtist& collectionArtist) {
-	return String::join({ "(",
+String trackCollectionArtistUpsertSQL() {
+	return upsertSQL("TrackCollectionArtist", trackCollectionArtistTupleColumns(), { "collectionURI", "artistURI" }, {});
+}
+LinkedList<Any> trackCollectionArtistTupleParams(const TrackCollectionArtist& collectionArtist) {
+	return {
 		// collectionURI
-		sqlParam(params, collectionArtist.collectionURI),",",
+		collectionArtist.collectionURI,
 		// artistURI
-		sqlParam(params, collectionArtist.artistURI),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		collectionArtist.artistURI,
+		// indexNum
+		collectionArtist.indexNum
+	};
 }
 
 ArrayList<String> artistTupleColumns() {
 	return { "uri", "provider", "type", "name", "images", "lastRowUpdateTime" };
 }
-String artistTuple(LinkedList<Any>& params, $<Artist> artist, const TupleOptions& options) {
-	return String::join({ "(",
+String artistUpsertSQL(const TupleOptions& options) {
+	return upsertSQL("Artist", artistTupleColumns(), { "uri" },
+		options.coalesce ? ArrayList<String>{ "images" } : ArrayList<String>{});
+}
+LinkedList<Any> artistTupleParams($<Artist> artist) {
+	return {
 		// uri
-		sqlParam(params, artist->uri()),",",
+		artist->uri(),
 		// provider
-		sqlParam(params, artist->mediaProvider()->name()),",",
+		artist->mediaProvider()->name(),
 		// type
-		sqlParam(params, artist->type()),",",
+		artist->type(),
 		// name
-		sqlParam(params, artist->name()),",",
+		artist->name(),
 		// images
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "images", "Artist", artist, imagesJson(artist->images())),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		imagesJson(artist->images())
+	};
 }
 
 ArrayList<String> followedArtistTupleColumns() {
@@ -568,21 +970,23 @@ String followedArtistTuple(LinkedList<Any>& params, const FollowedArtist& artist
 ArrayList<String> userAccountTupleColumns() {
 	return { "uri", "provider", "type", "name", "images", "lastRowUpdateTime" };
 }
-String userAccountTuple(LinkedList<Any>& params, $<UserAccount> userAccount, const TupleOptions& options) {
-	return String::join({ "(",
+String userAccountUpsertSQL(const TupleOptions& options) {
+	return upsertSQL("UserAccount", userAccountTupleColumns(), { "uri" },
+		options.coalesce ? ArrayList<String>{ "images" } : ArrayList<String>{});
+}
+LinkedList<Any> userAccountTupleParams($<UserAccount> userAccount) {
+	return {
 		// uri
-		sqlParam(params, userAccount->uri()),",",
+		userAccount->uri(),
 		// provider
-		sqlParam(params, userAccount->mediaProvider()->name()),",",
+		userAccount->mediaProvider()->name(),
 		// type
-		sqlParam(params, userAccount->type()),",",
+		userAccount->type(),
 		// name
-		sqlParam(params, userAccount->name()),",",
+		userAccount->name(),
 		// images
-		MAYBE_COALESCE_FIELD(options.coalesce, params, "images", "UserAccount", userAccount, imagesJson(userAccount->images())),",",
-		// lastRowUpdateTime
-		"CURRENT_TIMESTAMP"
-	")" });
+		imagesJson(userAccount->images())
+	};
 }
 
 ArrayList<String> followedUserAccountTupleColumns() {
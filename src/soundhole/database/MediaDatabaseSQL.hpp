@@ -25,6 +25,8 @@ namespace sh::sql {
 String sqlParam(LinkedList<Any>& params, Any param);
 String sqlOptParam(LinkedList<Any>& params, Any param, String defaultQuery, ArrayList<Any> defaultParams);
 Any sqlStringOrNull(String str);
+/// Builds a single-row "INSERT ... ON CONFLICT DO UPDATE" statement. Coalesced columns keep their existing value when the new value is null.
+String upsertSQL(String table, const ArrayList<String>& columns, const ArrayList<String>& conflictColumns, const ArrayList<String>& coalesceColumns);
 
 ArrayList<String> artistColumns();
 ArrayList<String> followedArtistColumns();
@@ -39,10 +41,52 @@ ArrayList<String> savedPlaylistColumns();
 ArrayList<String> playbackHistoryItemColumns();
 ArrayList<String> scrobbleColumns();
 ArrayList<String> unmatchedScrobbleColumns();
+ArrayList<String> imageColumns();
 
 String createDB();
+String createIndexes();
+String createSearchIndex();
+/// Reindexes every searchable row. This is needed after a VACUUM, which can renumber rowids
+String rebuildSearchIndex();
+String createGarbageCollectionIndexes();
+String createMediaAttributeTables();
+String createTrackCollectionItemChunks();
+String createTrackCollectionItemTrackFingerprints();
 String purgeDB();
 
+struct Migration {
+	int version;
+	String sql;
+};
+/// Schema migrations in ascending version order. The applied version is stored in the database's user_version.
+const ArrayList<Migration>& migrations();
+int latestSchemaVersion();
+
+/// How the images of tracks, collections, artists, and user accounts are stored.
+/// Artists of tracks and collections are always written to both the artists column and the join tables.
+enum class MediaAttributeStorage {
+	/// images are stored as json text in each row's images column
+	JSON,
+	/// images are stored in the Image table, one per row, and the images columns are left null
+	NORMALIZED
+};
+String MediaAttributeStorage_toString(MediaAttributeStorage storage);
+MediaAttributeStorage MediaAttributeStorage_fromString(const String& str);
+
+/// The tables that have an images column
+ArrayList<String> imageTables();
+/// Selects Image rows (without column names) from a json images array, optionally joined with the table the expressions refer to
+String selectImageRowsFromJson(String uriExpr, String imagesExpr, String fromTable = String());
+/// An expression that rebuilds the json images array of a media item from the Image table, or null if it has no images
+String imagesJsonFromTable(String uriExpr);
+/// Moves the images columns into the Image table, and adds triggers to move any images written afterwards
+String normalizeMediaAttributes();
+/// Moves the Image table back into the images columns, and removes the normalizing triggers
+String denormalizeMediaAttributes();
+
+/// Converts user input into an FTS5 query that prefix-matches every word
+String searchMatchQuery(String text);
+
 struct TupleOptions {
 	bool coalesce = false;
 };
@@ -52,37 +96,56 @@ struct TrackCollectionTupleOptions {
 };
 
 ArrayList<String> trackTupleColumns();
-String trackTuple(LinkedList<Any>& params, $<Track> track, const TupleOptions& options);
+String trackUpsertSQL();
+LinkedList<Any> trackTupleParams($<Track> track);
 
 ArrayList<String> albumTupleFromTrackColumns();
-String albumTupleFromTrack(LinkedList<Any>& params, $<Track> track, const TupleOptions& options);
+String albumFromTrackUpsertSQL();
+LinkedList<Any> albumTupleParamsFromTrack($<Track> track);
 
 struct TrackArtist {
 	String trackURI;
 	String artistURI;
+	size_t indexNum;
 };
 ArrayList<String> trackArtistTupleColumns();
-String trackArtistTuple(LinkedList<Any>& params, const TrackArtist& trackArtist);
+String trackArtistUpsertSQL();
+LinkedList<Any> trackArtistTupleParams(const TrackArtist& trackArtist);
 
 Optional<ArrayList<$<Artist>>> trackCollectionArtists($<TrackCollection> collection);
 $<UserAccount> trackCollectionOwner($<TrackCollection> collection);
 
 ArrayList<String> trackCollectionTupleColumns();
-String trackCollectionTuple(LinkedList<Any>& params, $<TrackCollection> collection, const TrackCollectionTupleOptions& options);
+String trackCollectionUpsertSQL(const TrackCollectionTupleOptions& options);
+LinkedList<Any> trackCollectionTupleParams($<TrackCollection> collection, const TrackCollectionTupleOptions& options);
 ArrayList<String> trackCollectionItemTupleColumns();
-String trackCollectionItemTuple(LinkedList<Any>& params, $<TrackCollectionItem> item);
+String trackCollectionItemUpsertSQL();
+LinkedList<Any> trackCollectionItemTupleParams($<TrackCollectionItem> item);
+/// Identifies the content of a collection item independently of its index, for comparing stored items with fetched ones
+String trackCollectionItemKey(const String& trackURI, const String& trackFingerprint, const String& uniqueId, const String& addedAt);
+String trackCollectionItemKey($<TrackCollectionItem> item);
+/// A 64-bit FNV-1a hash of the strings, as hex
+String fingerprintStrings(const ArrayList<String>& strings);
+/// A fingerprint of the track data, which changes whenever any stored field of the track does
+String trackFingerprint($<Track> track);
+/// A fingerprint of the keys of a run of consecutive collection items
+String trackCollectionItemsFingerprint(const ArrayList<String>& itemKeys);
 ArrayList<String> albumItemTupleFromTrackColumns();
-String albumItemTupleFromTrack(LinkedList<Any>& params, $<Track> track);
+String albumItemFromTrackUpsertSQL();
+LinkedList<Any> albumItemTupleParamsFromTrack($<Track> track);
 
 struct TrackCollectionArtist {
 	String collectionURI;
 	String artistURI;
+	size_t indexNum;
 };
 ArrayList<String> trackCollectionArtistTupleColumns();
-String trackCollectionArtistTuple(LinkedList<Any>& params, const TrackCollectionArtist& collectionArtist);
+String trackCollectionArtistUpsertSQL();
+LinkedList<Any> trackCollectionArtistTupleParams(const TrackCollectionArtist& collectionArtist);
 
 ArrayList<String> artistTupleColumns();
-String artistTuple(LinkedList<Any>& params, $<Artist> artist, const TupleOptions& options);
+String artistUpsertSQL(const TupleOptions& options);
+LinkedList<Any> artistTupleParams($<Artist> artist);
 
 struct FollowedArtist {
 	String artistURI;
@@ -93,7 +156,8 @@ ArrayList<String> followedArtistTupleColumns();
 String followedArtistTuple(LinkedList<Any>& params, const FollowedArtist& followedArtist);
 
 ArrayList<String> userAccountTupleColumns();
-String userAccountTuple(LinkedList<Any>& params, $<UserAccount> userAccount, const TupleOptions& options);
+String userAccountUpsertSQL(const TupleOptions& options);
+LinkedList<Any> userAccountTupleParams($<UserAccount> userAccount);
 
 struct FollowedUserAccount {
 	String userURI;
@@ -108,6 +172,11 @@ struct SavedTrack {
 	String libraryProvider;
 	String addedAt;
 };
+struct SavedTrackItem {
+	$<Track> track;
+	String libraryProvider;
+	Date addedAt;
+};
 ArrayList<String> savedTrackTupleColumns();
 String savedTrackTuple(LinkedList<Any>& params, const SavedTrack& track);
 
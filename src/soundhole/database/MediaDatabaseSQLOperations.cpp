@@ -17,12 +17,21 @@ struct JoinTable {
 	String name;
 	String prefix;
 	ArrayList<String> columns;
+	/// select the images column as it's stored, instead of falling back to the Image table when it's null
+	bool rawImages = false;
 };
 
+String joinedTableColumn(const JoinTable& table, const String& column) {
+	if(column == "images" && !table.rawImages) {
+		return String::join({ "COALESCE(",table.name,".images, ",imagesJsonFromTable(table.name+".uri"),")" });
+	}
+	return String::join({ table.name,".",column });
+}
+
 String joinedTableColumns(ArrayList<JoinTable> tables) {
 	return String::join(tables.reduce(LinkedList<String>{}, [](auto list, auto& table) {
 		for(auto& column : table.columns) {
-			list.pushBack(String::join({ table.name,".",column," as ",table.prefix,column }));
+			list.pushBack(String::join({ joinedTableColumn(table, column)," as ",table.prefix,column }));
 		}
 		return list;
 	}), ", ");
@@ -62,6 +71,109 @@ String sqlOffsetAndLimitFromRange(Optional<sql::IndexRange> range, LinkedList<An
 	});
 }
 
+String sqlOrderDirection(Order order) {
+	switch(order) {
+		case Order::DEFAULT:
+			return "";
+		case Order::ASC:
+			return " ASC";
+		case Order::DESC:
+			return " DESC";
+	}
+	throw std::invalid_argument("invalid Order value");
+}
+
+String libraryItemNameSortKey(String nameExpr) {
+	return String::join({ "TRIM(TRIM(TRIM(LOWER(",nameExpr,"),'\"'),\"'\"),'-')" });
+}
+
+struct LibraryItemSortColumns {
+	String addedAt;
+	String name;
+	String uri;
+};
+
+String libraryItemSortKey(LibraryItemOrderBy orderBy, const LibraryItemSortColumns& columns) {
+	switch(orderBy) {
+		case LibraryItemOrderBy::ADDED_AT:
+			return columns.addedAt;
+		case LibraryItemOrderBy::NAME:
+			return libraryItemNameSortKey(columns.name);
+	}
+	throw std::runtime_error("invalid LibraryItemOrderBy value");
+}
+
+String sqlLibraryItemOrderBy(const LibraryItemSelectOptions& options, const LibraryItemSortColumns& columns) {
+	// order by uri as well, so that the order is stable and can be resumed from a cursor
+	auto direction = sqlOrderDirection(options.order);
+	return String::join({
+		" ORDER BY ",libraryItemSortKey(options.orderBy, columns),direction,
+		", ",columns.uri,direction
+	});
+}
+
+String sqlLibraryItemSeek(const LibraryItemSelectOptions& options, const LibraryItemSortColumns& columns, LinkedList<Any>& params) {
+	if(!options.after) {
+		return String();
+	}
+	auto& cursor = options.after.value();
+	bool descending = (options.order == Order::DESC);
+	auto sortKey = libraryItemSortKey(options.orderBy, columns);
+	if(!cursor.sortValue) {
+		// null sort keys are ordered before everything else
+		if(descending) {
+			return String::join({ " AND (",sortKey," IS NULL AND ",columns.uri," < ",sqlParam(params, cursor.uri),")" });
+		}
+		return String::join({ " AND ((",sortKey," IS NULL AND ",columns.uri," > ",sqlParam(params, cursor.uri),") OR ",sortKey," IS NOT NULL)" });
+	}
+	// let sqlite compute the cursor's sort key, so that it matches the column's sort key exactly
+	auto cursorKey = (options.orderBy == LibraryItemOrderBy::NAME) ?
+		libraryItemNameSortKey(sqlParam(params, cursor.sortValue.value()))
+		: sqlParam(params, cursor.sortValue.value());
+	auto cursorURI = sqlParam(params, cursor.uri);
+	if(descending) {
+		return String::join({ " AND ((",sortKey,", ",columns.uri,") < (",cursorKey,", ",cursorURI,") OR ",sortKey," IS NULL)" });
+	}
+	return String::join({ " AND (",sortKey,", ",columns.uri,") > (",cursorKey,", ",cursorURI,")" });
+}
+
+
+
+#pragma mark Schema
+
+void selectSchemaVersion(SQLiteTransaction& tx, String outKey) {
+	tx.addSQL("PRAGMA user_version", {}, {
+		.outKey = outKey
+	});
+}
+
+void applyMigrations(SQLiteTransaction& tx, int fromVersion) {
+	int toVersion = fromVersion;
+	for(auto& migration : migrations()) {
+		if(migration.version <= fromVersion) {
+			continue;
+		}
+		tx.addSQL(migration.sql, {});
+		toVersion = migration.version;
+	}
+	if(toVersion != fromVersion) {
+		// pragma values can't be bound as parameters
+		tx.addSQL((String)"PRAGMA user_version = "+toVersion, {});
+	}
+}
+
+void applyMediaAttributeStorage(SQLiteTransaction& tx, MediaAttributeStorage storage) {
+	switch(storage) {
+		case MediaAttributeStorage::JSON:
+			tx.addSQL(denormalizeMediaAttributes(), {});
+			return;
+		case MediaAttributeStorage::NORMALIZED:
+			tx.addSQL(normalizeMediaAttributes(), {});
+			return;
+	}
+	throw std::invalid_argument("invalid MediaAttributeStorage value");
+}
+
 
 
 #pragma mark Insert
@@ -70,33 +182,17 @@ void insertOrReplaceArtists(SQLiteTransaction& tx, const ArrayList<$<Artist>>& a
 	if(artists.size() == 0) {
 		return;
 	}
-	LinkedList<Any> fullArtistParams;
-	LinkedList<String> fullArtistTuples;
-	LinkedList<Any> partialArtistParams;
-	LinkedList<String> partialArtistTuples;
+	LinkedList<LinkedList<Any>> fullArtistRows;
+	LinkedList<LinkedList<Any>> partialArtistRows;
 	for(auto& artist : artists) {
 		if(artist->needsData()) {
-			partialArtistTuples.pushBack(artistTuple(partialArtistParams, artist, {.coalesce=true}));
+			partialArtistRows.pushBack(artistTupleParams(artist));
 		} else {
-			fullArtistTuples.pushBack(artistTuple(fullArtistParams, artist, {.coalesce=false}));
+			fullArtistRows.pushBack(artistTupleParams(artist));
 		}
 	}
-	if(fullArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(fullArtistTuples, ", ")
-		}), fullArtistParams);
-	}
-	if(partialArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(partialArtistTuples, ", ")
-		}), partialArtistParams);
-	}
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=false}), fullArtistRows);
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=true}), partialArtistRows);
 }
 
 void insertOrReplaceFollowedArtists(SQLiteTransaction& tx, const ArrayList<FollowedArtist>& followedArtists) {
@@ -116,245 +212,191 @@ void insertOrReplaceFollowedArtists(SQLiteTransaction& tx, const ArrayList<Follo
 	}), followedArtistParams);
 }
 
-struct TrackTuplesAndParams {
-	LinkedList<String> trackTuples;
-	LinkedList<Any> trackParams;
-	LinkedList<String> fullArtistTuples;
-	LinkedList<Any> fullArtistParams;
-	LinkedList<String> partialArtistTuples;
-	LinkedList<Any> partialArtistParams;
-	LinkedList<String> trackArtistTuples;
-	LinkedList<Any> trackArtistParams;
-	LinkedList<String> albumTuples;
-	LinkedList<Any> albumParams;
-	LinkedList<String> albumItemTuples;
-	LinkedList<Any> albumItemParams;
+struct TrackTupleRows {
+	LinkedList<LinkedList<Any>> trackRows;
+	LinkedList<LinkedList<Any>> fullArtistRows;
+	LinkedList<LinkedList<Any>> partialArtistRows;
+	LinkedList<LinkedList<Any>> trackArtistRows;
+	LinkedList<LinkedList<Any>> replacedTrackArtistRows;
+	LinkedList<LinkedList<Any>> albumRows;
+	LinkedList<LinkedList<Any>> albumItemRows;
 };
 
-void addTrackTuples($<Track> track, TrackTuplesAndParams& tuples, bool includeAlbum) {
-	tuples.trackTuples.pushBack(trackTuple(tuples.trackParams, track, {.coalesce=true}));
-	for(auto& artist : track->artists()) {
+void addTrackTuples($<Track> track, TrackTupleRows& tuples, bool includeAlbum) {
+	tuples.trackRows.pushBack(trackTupleParams(track));
+	auto& artists = track->artists();
+	if(artists.size() > 0) {
+		tuples.replacedTrackArtistRows.pushBack({ track->uri() });
+	}
+	for(size_t i=0; i<artists.size(); i++) {
+		auto& artist = artists[i];
 		if(artist->uri().empty()) {
 			continue;
 		}
 		if(artist->needsData()) {
-			tuples.partialArtistTuples.pushBack(artistTuple(tuples.partialArtistParams, artist, {.coalesce=true}));
+			tuples.partialArtistRows.pushBack(artistTupleParams(artist));
 		} else {
-			tuples.fullArtistTuples.pushBack(artistTuple(tuples.fullArtistParams, artist, {.coalesce=false}));
+			tuples.fullArtistRows.pushBack(artistTupleParams(artist));
 		}
-		tuples.trackArtistTuples.pushBack(trackArtistTuple(tuples.trackArtistParams, {
+		tuples.trackArtistRows.pushBack(trackArtistTupleParams({
 			.trackURI=track->uri(),
-			.artistURI=artist->uri()
+			.artistURI=artist->uri(),
+			.indexNum=i
 		}));
 	}
 	if(includeAlbum) {
 		if(!track->albumURI().empty()) {
-			tuples.albumTuples.pushBack(albumTupleFromTrack(tuples.albumParams, track, {.coalesce=true}));
+			tuples.albumRows.pushBack(albumTupleParamsFromTrack(track));
 			if(track->trackNumber().value_or(0) >= 1) {
-				tuples.albumItemTuples.pushBack(albumItemTupleFromTrack(tuples.albumItemParams, track));
+				tuples.albumItemRows.pushBack(albumItemTupleParamsFromTrack(track));
 			}
 		}
 	}
 }
 
-void applyTrackTuples(SQLiteTransaction& tx, TrackTuplesAndParams& tuples) {
-	if(tuples.fullArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.fullArtistTuples, ", ")
-		}), tuples.fullArtistParams);
-	}
-	if(tuples.partialArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.partialArtistTuples, ", ")
-		}), tuples.partialArtistParams);
-	}
-	if(tuples.albumTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackCollection (",
-			String::join(albumTupleFromTrackColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.albumTuples, ", ")
-		}), tuples.albumParams);
-	}
-	if(tuples.trackTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Track (",
-			String::join(trackTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.trackTuples, ", ")
-		}), tuples.trackParams);
-	}
-	if(tuples.trackArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackArtist (",
-			String::join(trackArtistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.trackArtistTuples, ", ")
-		}), tuples.trackArtistParams);
-	}
-	if(tuples.albumItemTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackCollectionItem (",
-			String::join(albumItemTupleFromTrackColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.albumItemTuples, ", ")
-		}), tuples.albumItemParams);
-	}
+void applyTrackTuples(SQLiteTransaction& tx, TrackTupleRows& tuples) {
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=false}), tuples.fullArtistRows);
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=true}), tuples.partialArtistRows);
+	tx.addBatchSQL(albumFromTrackUpsertSQL(), tuples.albumRows);
+	tx.addBatchSQL(trackUpsertSQL(), tuples.trackRows);
+	tx.addBatchSQL("DELETE FROM TrackArtist WHERE trackURI = ?", tuples.replacedTrackArtistRows);
+	tx.addBatchSQL(trackArtistUpsertSQL(), tuples.trackArtistRows);
+	tx.addBatchSQL(albumItemFromTrackUpsertSQL(), tuples.albumItemRows);
 }
 
 void insertOrReplaceTracks(SQLiteTransaction& tx, const ArrayList<$<Track>>& tracks, bool includeAlbums) {
 	if(tracks.size() == 0) {
 		return;
 	}
-	TrackTuplesAndParams tuples;
+	TrackTupleRows tuples;
 	for(auto& track : tracks) {
 		addTrackTuples(track, tuples, includeAlbums);
 	}
 	applyTrackTuples(tx, tuples);
 }
 
-struct TrackCollectionTuplesAndParams {
-	LinkedList<String> collectionTuples;
-	LinkedList<Any> collectionParams;
-	LinkedList<String> fullUserAccountTuples;
-	LinkedList<Any> fullUserAccountParams;
-	LinkedList<String> partialUserAccountTuples;
-	LinkedList<Any> partialUserAccountParams;
-	LinkedList<String> fullArtistTuples;
-	LinkedList<Any> fullArtistParams;
-	LinkedList<String> partialArtistTuples;
-	LinkedList<Any> partialArtistParams;
-	LinkedList<String> collectionArtistTuples;
-	LinkedList<Any> collectionArtistParams;
+struct TrackCollectionTupleRows {
+	LinkedList<LinkedList<Any>> collectionRows;
+	LinkedList<LinkedList<Any>> fullUserAccountRows;
+	LinkedList<LinkedList<Any>> partialUserAccountRows;
+	LinkedList<LinkedList<Any>> fullArtistRows;
+	LinkedList<LinkedList<Any>> partialArtistRows;
+	LinkedList<LinkedList<Any>> collectionArtistRows;
+	LinkedList<LinkedList<Any>> replacedCollectionArtistRows;
 };
 
-void addTrackCollectionTuples($<TrackCollection> collection, TrackCollectionTuplesAndParams& tuples) {
-	tuples.collectionTuples.pushBack(trackCollectionTuple(tuples.collectionParams, collection, {.coalesce=true}));
+void addTrackCollectionTuples($<TrackCollection> collection, TrackCollectionTupleRows& tuples) {
+	tuples.collectionRows.pushBack(trackCollectionTupleParams(collection, {.coalesce=true}));
 	auto owner = trackCollectionOwner(collection);
 	if(owner) {
 		if(owner->needsData()) {
-			tuples.partialUserAccountTuples.pushBack(userAccountTuple(tuples.partialUserAccountParams, owner, {.coalesce = true}));
+			tuples.partialUserAccountRows.pushBack(userAccountTupleParams(owner));
 		} else {
-			tuples.fullUserAccountTuples.pushBack(userAccountTuple(tuples.fullUserAccountParams, owner, {.coalesce = false}));
+			tuples.fullUserAccountRows.pushBack(userAccountTupleParams(owner));
 		}
 	}
-	auto artists = trackCollectionArtists(collection);
-	for(auto& artist : artists.valueOr(ArrayList<$<Artist>>())) {
+	auto artists = trackCollectionArtists(collection).valueOr(ArrayList<$<Artist>>());
+	if(artists.size() > 0) {
+		tuples.replacedCollectionArtistRows.pushBack({ collection->uri() });
+	}
+	for(size_t i=0; i<artists.size(); i++) {
+		auto& artist = artists[i];
 		if(artist->uri().empty()) {
 			continue;
 		}
 		if(artist->needsData()) {
-			tuples.partialArtistTuples.pushBack(artistTuple(tuples.partialArtistParams, artist, {.coalesce=true}));
+			tuples.partialArtistRows.pushBack(artistTupleParams(artist));
 		} else {
-			tuples.fullArtistTuples.pushBack(artistTuple(tuples.fullArtistParams, artist, {.coalesce=false}));
+			tuples.fullArtistRows.pushBack(artistTupleParams(artist));
 		}
-		tuples.collectionArtistTuples.pushBack(trackCollectionArtistTuple(tuples.collectionArtistParams, {
+		tuples.collectionArtistRows.pushBack(trackCollectionArtistTupleParams({
 			.collectionURI=collection->uri(),
-			.artistURI=artist->uri()
+			.artistURI=artist->uri(),
+			.indexNum=i
 		}));
 	}
 }
 
-void applyTrackCollectionTuples(SQLiteTransaction& tx, TrackCollectionTuplesAndParams& tuples) {
-	if(tuples.fullUserAccountTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO UserAccount (",
-			String::join(userAccountTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.fullUserAccountTuples, ", ")
-		}), tuples.fullUserAccountParams);
-	}
-	if(tuples.partialUserAccountTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO UserAccount (",
-			String::join(userAccountTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.partialUserAccountTuples, ", ")
-		}), tuples.partialUserAccountParams);
-	}
-	if(tuples.fullArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.fullArtistTuples, ", ")
-		}), tuples.fullArtistParams);
-	}
-	if(tuples.partialArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO Artist (",
-			String::join(artistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.partialArtistTuples, ", ")
-		}), tuples.partialArtistParams);
-	}
-	if(tuples.collectionTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackCollection (",
-			String::join(trackCollectionTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.collectionTuples, ", ")
-		}), tuples.collectionParams);
-	}
-	if(tuples.collectionArtistTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackCollectionArtist (",
-			String::join(trackCollectionArtistTupleColumns(), ", "),
-			") VALUES ",
-			String::join(tuples.collectionArtistTuples, ", ")
-		}), tuples.collectionArtistParams);
-	}
+void applyTrackCollectionTuples(SQLiteTransaction& tx, TrackCollectionTupleRows& tuples) {
+	tx.addBatchSQL(userAccountUpsertSQL({.coalesce=false}), tuples.fullUserAccountRows);
+	tx.addBatchSQL(userAccountUpsertSQL({.coalesce=true}), tuples.partialUserAccountRows);
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=false}), tuples.fullArtistRows);
+	tx.addBatchSQL(artistUpsertSQL({.coalesce=true}), tuples.partialArtistRows);
+	tx.addBatchSQL(trackCollectionUpsertSQL({.coalesce=true}), tuples.collectionRows);
+	tx.addBatchSQL("DELETE FROM TrackCollectionArtist WHERE collectionURI = ?", tuples.replacedCollectionArtistRows);
+	tx.addBatchSQL(trackCollectionArtistUpsertSQL(), tuples.collectionArtistRows);
 }
 
 void insertOrReplaceTrackCollections(SQLiteTransaction& tx, const ArrayList<$<TrackCollection>>& collections) {
 	if(collections.size() == 0) {
 		return;
 	}
-	TrackCollectionTuplesAndParams tuples;
+	TrackCollectionTupleRows tuples;
 	for(auto& collection : collections) {
 		addTrackCollectionTuples(collection, tuples);
 	}
 	applyTrackCollectionTuples(tx, tuples);
 }
 
-void insertOrReplaceItemsFromTrackCollection(SQLiteTransaction& tx, $<TrackCollection> collection, InsertTrackCollectionItemsOptions options) {
+void deleteTrackCollectionItemsAfterEnd(SQLiteTransaction& tx, $<TrackCollection> collection) {
 	if(collection->itemCount()) {
 		tx.addSQL(
 			"DELETE FROM TrackCollectionItem WHERE collectionURI = ? AND indexNum >= ?",
 			{ collection->uri(), collection->itemCount().toAny() });
+		tx.addSQL(
+			"DELETE FROM TrackCollectionItemChunk WHERE collectionURI = ? AND endIndex > ?",
+			{ collection->uri(), collection->itemCount().toAny() });
 	}
-	TrackTuplesAndParams tuples;
-	LinkedList<String> collectionItemTuples;
-	LinkedList<Any> collectionItemParams;
+}
+
+void deleteTrackCollectionItemChunks(SQLiteTransaction& tx, String collectionURI, IndexRange range) {
+	tx.addSQL(
+		"DELETE FROM TrackCollectionItemChunk WHERE collectionURI = ? AND startIndex < ? AND endIndex > ?",
+		{ collectionURI, range.endIndex, range.startIndex });
+}
+
+void insertOrReplaceItemsFromTrackCollection(SQLiteTransaction& tx, $<TrackCollection> collection, InsertTrackCollectionItemsOptions options) {
+	deleteTrackCollectionItemsAfterEnd(tx, collection);
+	TrackTupleRows tuples;
+	LinkedList<LinkedList<Any>> collectionItemRows;
 	if(options.range) {
+		// the rewritten rows no longer match any stored fingerprints
+		deleteTrackCollectionItemChunks(tx, collection->uri(), options.range.value());
 		collection->forEachInRange(options.range->startIndex, options.range->endIndex, [&]($<TrackCollectionItem> item, size_t index) {
 			if(!item) {
 				return;
 			}
-			collectionItemTuples.pushBack(trackCollectionItemTuple(collectionItemParams, item));
+			collectionItemRows.pushBack(trackCollectionItemTupleParams(item));
 			addTrackTuples(item->track(), tuples, options.includeTrackAlbums);
 		});
 	}
 	applyTrackTuples(tx, tuples);
-	if(collectionItemTuples.size() > 0) {
-		tx.addSQL(String::join({
-			"INSERT OR REPLACE INTO TrackCollectionItem (",
-			String::join(trackCollectionItemTupleColumns(), ", "),
-			") VALUES ",
-			String::join(collectionItemTuples, ", ")
-		}), collectionItemParams);
+	tx.addBatchSQL(trackCollectionItemUpsertSQL(), collectionItemRows);
+}
+
+void applyTrackCollectionItemsDelta(SQLiteTransaction& tx, $<TrackCollection> collection, const TrackCollectionItemsDelta& delta) {
+	deleteTrackCollectionItemsAfterEnd(tx, collection);
+	deleteTrackCollectionItemChunks(tx, collection->uri(), delta.range);
+	TrackTupleRows tuples;
+	LinkedList<LinkedList<Any>> collectionItemRows;
+	for(size_t index : delta.changedIndexes) {
+		if(auto item = collection->itemAt(index)) {
+			collectionItemRows.pushBack(trackCollectionItemTupleParams(item));
+			addTrackTuples(item->track(), tuples, delta.includeTrackAlbums);
+		}
+	}
+	applyTrackTuples(tx, tuples);
+	tx.addBatchSQL(trackCollectionItemUpsertSQL(), collectionItemRows);
+	if(!delta.fingerprint.empty()) {
+		tx.addSQL(
+			"INSERT OR REPLACE INTO TrackCollectionItemChunk (collectionURI, startIndex, endIndex, fingerprint) VALUES (?, ?, ?, ?)",
+			{ collection->uri(), delta.range.startIndex, delta.range.endIndex, delta.fingerprint });
 	}
 }
 
 void insertOrReplaceLibraryItems(SQLiteTransaction& tx, const ArrayList<MediaProvider::LibraryItem>& items) {
-	TrackTuplesAndParams trackTuples;
-	TrackCollectionTuplesAndParams collectionTuples;
+	TrackTupleRows trackTuples;
+	TrackCollectionTupleRows collectionTuples;
 	LinkedList<String> savedTrackTuples;
 	LinkedList<Any> savedTrackParams;
 	LinkedList<String> savedAlbumTuples;
@@ -397,9 +439,9 @@ void insertOrReplaceLibraryItems(SQLiteTransaction& tx, const ArrayList<MediaPro
 				.addedAt = item.addedAt.toISOString()
 			}));
 			if(artist->needsData()) {
-				trackTuples.partialArtistTuples.pushBack(artistTuple(trackTuples.partialArtistParams, artist, {.coalesce=true}));
+				trackTuples.partialArtistRows.pushBack(artistTupleParams(artist));
 			} else {
-				trackTuples.fullArtistTuples.pushBack(artistTuple(trackTuples.fullArtistParams, artist, {.coalesce=false}));
+				trackTuples.fullArtistRows.pushBack(artistTupleParams(artist));
 			}
 		}
 		else if(auto userAccount = std::dynamic_pointer_cast<UserAccount>(item.mediaItem)) {
@@ -408,10 +450,10 @@ void insertOrReplaceLibraryItems(SQLiteTransaction& tx, const ArrayList<MediaPro
 				.libraryProvider = userAccount->mediaProvider()->name(),
 				.addedAt = item.addedAt.toISOString()
 			}));
-			if(artist->needsData()) {
-				collectionTuples.partialUserAccountTuples.pushBack(userAccountTuple(collectionTuples.partialUserAccountParams, userAccount, {.coalesce=true}));
+			if(userAccount->needsData()) {
+				collectionTuples.partialUserAccountRows.pushBack(userAccountTupleParams(userAccount));
 			} else {
-				collectionTuples.fullUserAccountTuples.pushBack(userAccountTuple(collectionTuples.fullUserAccountParams, userAccount, {.coalesce=false}));
+				collectionTuples.fullUserAccountRows.pushBack(userAccountTupleParams(userAccount));
 			}
 		}
 		else {
@@ -495,7 +537,7 @@ void insertOrReplaceSavedPlaylists(SQLiteTransaction& tx, const ArrayList<SavedP
 }
 
 void insertOrReplacePlaybackHistoryItems(SQLiteTransaction& tx, const ArrayList<$<PlaybackHistoryItem>>& items) {
-	TrackTuplesAndParams trackTuples;
+	TrackTupleRows trackTuples;
 	LinkedList<String> historyItemTuples;
 	LinkedList<Any> historyItemParams;
 	for(auto& item : items) {
@@ -584,7 +626,10 @@ void applyDBState(SQLiteTransaction& tx, std::map<String,String> state) {
 #pragma mark Select
 
 void selectTrack(SQLiteTransaction& tx, String outKey, String uri) {
-	tx.addSQL("SELECT * FROM Track WHERE uri = ?", { uri }, {
+	auto columns = joinedTableColumns({
+		{ .name = "Track", .prefix = "", .columns = trackColumns() }
+	});
+	tx.addSQL("SELECT "+columns+" FROM Track WHERE uri = ?", { uri }, {
 		.outKey = outKey,
 		.mapper = [](auto json) {
 			return transformDBTrack(json);
@@ -663,8 +708,27 @@ void selectTrackCollectionItemsWithTracks(SQLiteTransaction& tx, String outKey,
 	});
 }
 
+void selectTrackCollectionItemKeys(SQLiteTransaction& tx, String outKey, String collectionURI) {
+	tx.addSQL(
+		"SELECT indexNum, trackURI, trackFingerprint, uniqueId, addedAt FROM TrackCollectionItem WHERE collectionURI = ? ORDER BY indexNum ASC",
+		{ collectionURI }, {
+			.outKey = outKey
+		});
+}
+
+void selectTrackCollectionItemChunks(SQLiteTransaction& tx, String outKey, String collectionURI) {
+	tx.addSQL(
+		"SELECT startIndex, endIndex, fingerprint FROM TrackCollectionItemChunk WHERE collectionURI = ?",
+		{ collectionURI }, {
+			.outKey = outKey
+		});
+}
+
 void selectArtist(SQLiteTransaction& tx, String outKey, String uri) {
-	tx.addSQL("SELECT * FROM Artist WHERE uri = ?", { uri }, {
+	auto columns = joinedTableColumns({
+		{ .name = "Artist", .prefix = "", .columns = artistColumns() }
+	});
+	tx.addSQL("SELECT "+columns+" FROM Artist WHERE uri = ?", { uri }, {
 		.outKey = outKey,
 		.mapper = [](auto json) {
 			return transformDBArtist(json);
@@ -674,8 +738,63 @@ void selectArtist(SQLiteTransaction& tx, String outKey, String uri) {
 
 
 
-void selectSavedTracksWithTracks(SQLiteTransaction& tx, String outKey, LibraryItemSelectOptions options) {
-	auto joinTables = ArrayList<JoinTable>{
+$<MediaAttributeLookup> selectTrackAttributes(SQLiteTransaction& tx, Function<String(LinkedList<Any>&)> trackURIsQuery) {
+	// each lookup selects from the same page of tracks, so the page query is repeated for every use of it
+	auto attributes = fgl::new$<MediaAttributeLookup>();
+	auto pageURIs = [&](LinkedList<Any>& params) {
+		return String::join({ "SELECT uri FROM (",trackURIsQuery(params),")" });
+	};
+	// images of the tracks and of their artists. these have to be fetched before the artists are decoded
+	LinkedList<Any> imageParams;
+	auto imagesQuery = String::join({
+		"SELECT ",String::join(imageColumns().map([](auto& column) { return "Image."+column; }), ", ")," FROM Image "
+		"WHERE Image.mediaItemURI IN (",
+			pageURIs(imageParams),
+			" UNION SELECT TrackArtist.artistURI FROM TrackArtist WHERE TrackArtist.trackURI IN (",pageURIs(imageParams),")"
+		") ORDER BY Image.mediaItemURI, Image.indexNum"
+	});
+	tx.addSQL(imagesQuery, imageParams, {
+		.rowHandler = [=](const SQLiteRow& row) {
+			attributes->images[row.stringValue(0)].pushBack(decodeDBImage(row, 0));
+		}
+	});
+	// artists of the tracks, along with how many artists the track has in total
+	LinkedList<Any> artistParams;
+	auto artistsQuery = String::join({
+		"SELECT TrackArtist.trackURI, "
+			"json_array_length(CASE WHEN json_valid(Track.artists) THEN Track.artists END) AS artistCount, ",
+			String::join(artistColumns().map([](auto& column) { return "Artist."+column; }), ", "),
+		" FROM TrackArtist "
+		"INNER JOIN Track ON Track.uri = TrackArtist.trackURI "
+		"INNER JOIN Artist ON Artist.uri = TrackArtist.artistURI "
+		"WHERE TrackArtist.trackURI IN (",pageURIs(artistParams),") "
+		"ORDER BY TrackArtist.trackURI, TrackArtist.indexNum"
+	});
+	tx.addSQL(artistsQuery, artistParams, {
+		.rowHandler = [=](const SQLiteRow& row) {
+			auto& artistList = attributes->artists[row.stringValue(0)];
+			artistList.totalCount = row.isNull(1) ? 0 : (size_t)row.integerValue(1);
+			artistList.artists.pushBack(decodeDBArtist(row, 2, attributes.get()));
+		}
+	});
+	return attributes;
+}
+
+$<MediaAttributeLookup> selectTrackAttributesIfNormalized(SQLiteTransaction& tx, MediaAttributeStorage attributeStorage, ArrayList<JoinTable>& joinTables, Function<String(LinkedList<Any>&)> trackURIsQuery) {
+	if(attributeStorage != MediaAttributeStorage::NORMALIZED) {
+		return nullptr;
+	}
+	// the images are decoded from the lookup, so there's no need to rebuild them as json
+	for(auto& table : joinTables) {
+		table.rawImages = true;
+	}
+	return selectTrackAttributes(tx, trackURIsQuery);
+}
+
+
+
+ArrayList<JoinTable> savedTrackWithTrackJoinTables() {
+	return {
 		{
 			.name = "SavedTrack",
 			.prefix = "r1_",
@@ -686,36 +805,29 @@ void selectSavedTracksWithTracks(SQLiteTransaction& tx, String outKey, LibraryIt
 			.columns = trackColumns()
 		}
 	};
-	auto columns = joinedTableColumns(joinTables);
-	LinkedList<Any> params;
-	auto query = String::join({
+}
+String selectSavedTracksWithTracksQuery(String columns, const LibraryItemSelectOptions& options, LinkedList<Any>& params) {
+	auto sortColumns = LibraryItemSortColumns{
+		.addedAt = "SavedTrack.addedAt",
+		.name = "Track.name",
+		.uri = "SavedTrack.trackURI"
+	};
+	return String::join({
 		"SELECT ",columns," FROM SavedTrack, Track WHERE SavedTrack.trackURI = Track.uri",
 		(options.libraryProvider.empty()) ?
 			String()
 			: String::join({
 				" AND libraryProvider = ",sqlParam(params, options.libraryProvider),
 			}),
-		" ORDER BY ",([&]() {
-			switch(options.orderBy) {
-				case LibraryItemOrderBy::ADDED_AT:
-					return "SavedTrack.addedAt";
-				case LibraryItemOrderBy::NAME:
-					return "TRIM(TRIM(TRIM(LOWER(Track.name),'\"'),\"'\"),'-')";
-			}
-			throw std::runtime_error("invalid LibraryItemOrderBy value");
-		})(),([&]() {
-			switch(options.order) {
-				case Order::DEFAULT:
-					return "";
-				case Order::ASC:
-					return " ASC";
-				case Order::DESC:
-					return " DESC";
-			}
-			return "";
-		})(),
+		sqlLibraryItemSeek(options, sortColumns, params),
+		sqlLibraryItemOrderBy(options, sortColumns),
 		sqlOffsetAndLimitFromRange(options.range, params)
 	});
+}
+void selectSavedTracksWithTracks(SQLiteTransaction& tx, String outKey, LibraryItemSelectOptions options) {
+	auto joinTables = savedTrackWithTrackJoinTables();
+	LinkedList<Any> params;
+	auto query = selectSavedTracksWithTracksQuery(joinedTableColumns(joinTables), options, params);
 	tx.addSQL(query, params, {
 		.outKey=outKey,
 		.mapper=[=](auto row) {
@@ -724,6 +836,18 @@ void selectSavedTracksWithTracks(SQLiteTransaction& tx, String outKey, LibraryIt
 		}
 	});
 }
+void selectSavedTracksWithTracks(SQLiteTransaction& tx, $<LinkedList<DBSavedTrackRow>> output, MediaAttributeStorage attributeStorage, LibraryItemSelectOptions options) {
+	auto joinTables = savedTrackWithTrackJoinTables();
+	auto attributes = selectTrackAttributesIfNormalized(tx, attributeStorage, joinTables, [&](LinkedList<Any>& params) {
+		return selectSavedTracksWithTracksQuery("Track.uri AS uri", options, params);
+	});
+	LinkedList<Any> params;
+	auto query = selectSavedTracksWithTracksQuery(joinedTableColumns(joinTables), options, params);
+	size_t trackOffset = joinTables[0].columns.size();
+	tx.addSQL(query, params, output, [=](const SQLiteRow& row) {
+		return decodeDBSavedTrack(row, 0, decodeDBTrack(row, trackOffset, attributes.get()));
+	});
+}
 
 void selectSavedTrackCount(SQLiteTransaction& tx, String outKey, String libraryProvider) {
 	LinkedList<Any> params;
@@ -793,6 +917,11 @@ void selectSavedAlbumsWithAlbums(SQLiteTransaction& tx, String outKey, LibraryIt
 	};
 	auto columns = joinedTableColumns(joinTables);
 	LinkedList<Any> params;
+	auto sortColumns = LibraryItemSortColumns{
+		.addedAt = "SavedAlbum.addedAt",
+		.name = "TrackCollection.name",
+		.uri = "SavedAlbum.albumURI"
+	};
 	auto query = String::join({
 		"SELECT ",columns," FROM SavedAlbum, TrackCollection WHERE SavedAlbum.albumURI = TrackCollection.uri",
 		(options.libraryProvider.empty()) ?
@@ -800,25 +929,8 @@ void selectSavedAlbumsWithAlbums(SQLiteTransaction& tx, String outKey, LibraryIt
 			: String::join({
 				" AND libraryProvider = ",sqlParam(params, options.libraryProvider),
 			}),
-		" ORDER BY ",([&]() {
-			switch(options.orderBy) {
-				case LibraryItemOrderBy::ADDED_AT:
-					return "SavedAlbum.addedAt";
-				case LibraryItemOrderBy::NAME:
-					return "TRIM(TRIM(TRIM(LOWER(TrackCollection.name),'\"'),\"'\"),'-')";
-			}
-			throw std::runtime_error("invalid LibraryItemOrderBy value");
-		})(),([&]() {
-			switch(options.order) {
-				case Order::DEFAULT:
-					return "";
-				case Order::ASC:
-					return " ASC";
-				case Order::DESC:
-					return " DESC";
-			}
-			return "";
-		})(),
+		sqlLibraryItemSeek(options, sortColumns, params),
+		sqlLibraryItemOrderBy(options, sortColumns),
 		sqlOffsetAndLimitFromRange(options.range, params)
 	});
 	tx.addSQL(query, params, {
@@ -902,6 +1014,11 @@ void selectSavedPlaylistsWithPlaylistsAndOwners(SQLiteTransaction& tx, String ou
 	};
 	auto columns = joinedTableColumns(joinTables);
 	LinkedList<Any> params;
+	auto sortColumns = LibraryItemSortColumns{
+		.addedAt = "SavedPlaylist.addedAt",
+		.name = "TrackCollection.name",
+		.uri = "SavedPlaylist.playlistURI"
+	};
 	auto query = String::join({
 		"SELECT ",columns," FROM SavedPlaylist, "
 			"TrackCollection LEFT OUTER JOIN UserAccount ON TrackCollection.ownerURI = UserAccount.uri "
@@ -911,25 +1028,8 @@ void selectSavedPlaylistsWithPlaylistsAndOwners(SQLiteTransaction& tx, String ou
 			: String::join({
 				" AND libraryProvider = ",sqlParam(params, options.libraryProvider),
 			}),
-		" ORDER BY ",([&]() {
-			switch(options.orderBy) {
-				case LibraryItemOrderBy::ADDED_AT:
-					return "SavedPlaylist.addedAt";
-				case LibraryItemOrderBy::NAME:
-					return "TRIM(TRIM(TRIM(LOWER(TrackCollection.name),'\"'),\"'\"),'-')";
-			}
-			throw std::runtime_error("invalid LibraryItemOrderBy value");
-		})(),([&]() {
-			switch(options.order) {
-				case Order::DEFAULT:
-					return "";
-				case Order::ASC:
-					return " ASC";
-				case Order::DESC:
-					return " DESC";
-			}
-			return "";
-		})(),
+		sqlLibraryItemSeek(options, sortColumns, params),
+		sqlLibraryItemOrderBy(options, sortColumns),
 		sqlOffsetAndLimitFromRange(options.range, params)
 	});
 	tx.addSQL(query, params, {
@@ -1212,9 +1312,12 @@ void selectFollowedUserAccountWithUserAccount(SQLiteTransaction& tx, String outK
 
 
 void selectLibraryArtists(SQLiteTransaction& tx, String outKey, LibraryItemSelectOptions options) {
+	auto columns = joinedTableColumns({
+		{ .name = "a", .prefix = "", .columns = artistColumns() }
+	});
 	LinkedList<Any> params;
 	auto query = String::join({
-		"SELECT * FROM Artist AS a "
+		"SELECT ",columns," FROM Artist AS a "
 		"WHERE ",
 		(options.libraryProvider.empty()) ?
 			String()
@@ -1229,12 +1332,12 @@ void selectLibraryArtists(SQLiteTransaction& tx, String outKey, LibraryItemSelec
 			") "
 			"OR EXISTS("
 				// if artist is attached to a saved album
-				"SELECT TrackCollectionArtist.trackURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedAlbum "
+				"SELECT TrackCollectionArtist.collectionURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedAlbum "
 					"WHERE TrackCollectionArtist.artistURI = a.uri AND TrackCollectionArtist.collectionURI = SavedAlbum.albumURI"
 			") "
 			"OR EXISTS("
 				// if artist is attached to a saved playlist
-				"SELECT TrackCollectionArtist.trackURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedPlaylist "
+				"SELECT TrackCollectionArtist.collectionURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedPlaylist "
 					"WHERE TrackCollectionArtist.artistURI = a.uri AND TrackCollectionArtist.collectionURI = SavedPlaylist.playlistURI"
 			") "
 			"OR EXISTS("
@@ -1246,9 +1349,9 @@ void selectLibraryArtists(SQLiteTransaction& tx, String outKey, LibraryItemSelec
 		"ORDER BY ",([&]() {
 			switch(options.orderBy) {
 				case LibraryItemOrderBy::ADDED_AT:
-					return "Artist.name";
+					return "a.name";
 				case LibraryItemOrderBy::NAME:
-					return "TRIM(TRIM(TRIM(LOWER(Artist.name),'\"'),\"'\"),'-')";
+					return "TRIM(TRIM(TRIM(LOWER(a.name),'\"'),\"'\"),'-')";
 			}
 			throw std::runtime_error("invalid LibraryItemOrderBy value");
 		})(),([&]() {
@@ -1290,12 +1393,12 @@ void selectLibraryArtistCount(SQLiteTransaction& tx, String outKey, String libra
 			") "
 			"OR EXISTS("
 				// if artist is attached to saved album
-				"SELECT TrackCollectionArtist.trackURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedAlbum "
+				"SELECT TrackCollectionArtist.collectionURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedAlbum "
 					"WHERE TrackCollectionArtist.artistURI = a.uri AND TrackCollectionArtist.collectionURI = SavedAlbum.albumURI"
 			") "
 			"OR EXISTS("
 				// if artist is attached to saved playlist
-				"SELECT TrackCollectionArtist.trackURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedPlaylist "
+				"SELECT TrackCollectionArtist.collectionURI, TrackCollectionArtist.artistURI FROM TrackCollectionArtist, SavedPlaylist "
 					"WHERE TrackCollectionArtist.artistURI = a.uri AND TrackCollectionArtist.collectionURI = SavedPlaylist.playlistURI"
 			") "
 		")"
@@ -1385,8 +1488,8 @@ String PlaybackHistorySelectFilters::sql(LinkedList<Any>& params) const {
 	}.where([](auto& str) {return !str.empty();}), " AND ");
 }
 
-void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options) {
-	auto joinTables = ArrayList<JoinTable>{
+ArrayList<JoinTable> playbackHistoryItemWithTrackJoinTables() {
+	return {
 		{
 			.name = "PlaybackHistoryItem",
 			.prefix = "r1_",
@@ -1397,9 +1500,9 @@ void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey,
 			.columns = trackColumns()
 		}
 	};
-	auto columns = joinedTableColumns(joinTables);
-	LinkedList<Any> params;
-	auto query = String::join({
+}
+String selectPlaybackHistoryItemsWithTracksQuery(String columns, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options, LinkedList<Any>& params) {
+	return String::join({
 		"SELECT ",columns," FROM PlaybackHistoryItem, Track WHERE PlaybackHistoryItem.trackURI = Track.uri",
 		([&]() {
 			auto sql = filters.sql(params);
@@ -1408,19 +1511,22 @@ void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey,
 			}
 			return " AND " + sql;
 		})(),
-		" ORDER BY PlaybackHistoryItem.startTime",([&]() -> String {
-			switch(options.order) {
-				case Order::DEFAULT:
-					return "";
-				case Order::ASC:
-					return " ASC";
-				case Order::DESC:
-					return " DESC";
-			}
-			throw std::invalid_argument("invalid value for options.order");
-		})(),
+		(options.after) ?
+			String::join({
+				" AND (PlaybackHistoryItem.startTime, PlaybackHistoryItem.trackURI) ",
+				(options.order == Order::DESC) ? "<" : ">",
+				" (",sqlParam(params, options.after->startTime.toISOString()),", ",sqlParam(params, options.after->trackURI),")"
+			})
+			: String(),
+		" ORDER BY PlaybackHistoryItem.startTime",sqlOrderDirection(options.order),
+		", PlaybackHistoryItem.trackURI",sqlOrderDirection(options.order),
 		sqlOffsetAndLimitFromRange(options.range, params)
 	});
+}
+void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options) {
+	auto joinTables = playbackHistoryItemWithTrackJoinTables();
+	LinkedList<Any> params;
+	auto query = selectPlaybackHistoryItemsWithTracksQuery(joinedTableColumns(joinTables), filters, options, params);
 	tx.addSQL(query, params, {
 		.outKey=outKey,
 		.mapper=[=](auto row) {
@@ -1429,6 +1535,18 @@ void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey,
 		}
 	});
 }
+void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, $<LinkedList<DBPlaybackHistoryItemRow>> output, MediaAttributeStorage attributeStorage, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options) {
+	auto joinTables = playbackHistoryItemWithTrackJoinTables();
+	auto attributes = selectTrackAttributesIfNormalized(tx, attributeStorage, joinTables, [&](LinkedList<Any>& params) {
+		return selectPlaybackHistoryItemsWithTracksQuery("Track.uri AS uri", filters, options, params);
+	});
+	LinkedList<Any> params;
+	auto query = selectPlaybackHistoryItemsWithTracksQuery(joinedTableColumns(joinTables), filters, options, params);
+	size_t trackOffset = joinTables[0].columns.size();
+	tx.addSQL(query, params, output, [=](const SQLiteRow& row) {
+		return decodeDBPlaybackHistoryItem(row, 0, decodeDBTrack(row, trackOffset, attributes.get()));
+	});
+}
 
 void selectPlaybackHistoryItemCount(SQLiteTransaction& tx, String outKey, const PlaybackHistorySelectFilters& filters) {
 	LinkedList<Any> params;
@@ -1670,6 +1788,183 @@ void selectDBState(SQLiteTransaction& tx, String outKey, String stateKey) {
 
 
 
+String sqlSearchResultsPage(String resultsQuery, const Optional<SearchCursor::Position>& after, size_t limit, LinkedList<Any>& params) {
+	// bm25 can't be filtered on directly, so seek past the cursor in an outer query.
+	// results are ordered by uri as well, so that equally ranked results have a stable order to resume from
+	return String::join({
+		"SELECT * FROM (",resultsQuery,")",
+		(after) ?
+			String::join({ " WHERE (searchRank, r1_uri) > (",sqlParam(params, after->rank),", ",sqlParam(params, after->uri),")" })
+			: String(),
+		" ORDER BY searchRank, r1_uri LIMIT ",sqlParam(params, limit)
+	});
+}
+
+void selectTrackSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit) {
+	auto joinTables = ArrayList<JoinTable>{
+		{
+			.name = "Track",
+			.prefix = "r1_",
+			.columns = trackColumns()
+		}
+	};
+	auto columns = joinedTableColumns(joinTables);
+	LinkedList<Any> params;
+	auto query = sqlSearchResultsPage(String::join({
+		"SELECT ",columns,", bm25(TrackSearch, 0.0, 10.0, 2.0, 4.0) AS searchRank FROM TrackSearch "
+			"INNER JOIN Track ON Track.rowid = TrackSearch.rowid AND Track.uri = TrackSearch.uri "
+			"WHERE TrackSearch MATCH ",sqlParam(params, matchQuery)
+	}), after, limit, params);
+	tx.addSQL(query, params, {
+		.outKey = outKey,
+		.mapper = [=](auto row) -> Json {
+			auto results = splitJoinedResults(joinTables, row);
+			return Json::object{
+				{ "rank", row["searchRank"] },
+				{ "mediaItem", transformDBTrack(results[0]) }
+			};
+		}
+	});
+}
+
+void selectTrackSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery) {
+	tx.addSQL("SELECT count(*) AS total FROM TrackSearch WHERE TrackSearch MATCH ?", { matchQuery }, {
+		.outKey = outKey,
+		.mapper = [=](auto row) {
+			return row["total"];
+		}
+	});
+}
+
+void selectTrackCollectionSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, String collectionType, Optional<SearchCursor::Position> after, size_t limit) {
+	auto joinTables = ArrayList<JoinTable>{
+		{
+			.name = "TrackCollection",
+			.prefix = "r1_",
+			.columns = trackCollectionColumns()
+		}, {
+			.name = "UserAccount",
+			.prefix = "r2_",
+			.columns = userAccountColumns()
+		}
+	};
+	auto columns = joinedTableColumns(joinTables);
+	LinkedList<Any> params;
+	auto query = sqlSearchResultsPage(String::join({
+		"SELECT ",columns,", bm25(TrackCollectionSearch, 0.0, 10.0, 4.0) AS searchRank FROM TrackCollectionSearch "
+			"INNER JOIN TrackCollection ON TrackCollection.rowid = TrackCollectionSearch.rowid AND TrackCollection.uri = TrackCollectionSearch.uri "
+			"LEFT OUTER JOIN UserAccount ON TrackCollection.ownerURI = UserAccount.uri "
+			"WHERE TrackCollectionSearch MATCH ",sqlParam(params, matchQuery),
+		(collectionType.empty()) ?
+			String()
+			: String::join({ " AND TrackCollection.type = ",sqlParam(params, collectionType) })
+	}), after, limit, params);
+	tx.addSQL(query, params, {
+		.outKey = outKey,
+		.mapper = [=](auto row) -> Json {
+			auto results = splitJoinedResults(joinTables, row);
+			return Json::object{
+				{ "rank", row["searchRank"] },
+				{ "mediaItem", transformDBTrackCollection(results[0], results[1]) }
+			};
+		}
+	});
+}
+
+void selectTrackCollectionSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery, String collectionType) {
+	LinkedList<Any> params;
+	auto query = String::join({
+		"SELECT count(*) AS total FROM TrackCollectionSearch",
+		(collectionType.empty()) ?
+			String()
+			: " INNER JOIN TrackCollection ON TrackCollection.rowid = TrackCollectionSearch.rowid",
+		" WHERE TrackCollectionSearch MATCH ",sqlParam(params, matchQuery),
+		(collectionType.empty()) ?
+			String()
+			: String::join({ " AND TrackCollection.type = ",sqlParam(params, collectionType) })
+	});
+	tx.addSQL(query, params, {
+		.outKey = outKey,
+		.mapper = [=](auto row) {
+			return row["total"];
+		}
+	});
+}
+
+void selectArtistSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit) {
+	auto joinTables = ArrayList<JoinTable>{
+		{
+			.name = "Artist",
+			.prefix = "r1_",
+			.columns = artistColumns()
+		}
+	};
+	auto columns = joinedTableColumns(joinTables);
+	LinkedList<Any> params;
+	auto query = sqlSearchResultsPage(String::join({
+		"SELECT ",columns,", bm25(ArtistSearch, 0.0, 10.0) AS searchRank FROM ArtistSearch "
+			"INNER JOIN Artist ON Artist.rowid = ArtistSearch.rowid AND Artist.uri = ArtistSearch.uri "
+			"WHERE ArtistSearch MATCH ",sqlParam(params, matchQuery)
+	}), after, limit, params);
+	tx.addSQL(query, params, {
+		.outKey = outKey,
+		.mapper = [=](auto row) -> Json {
+			auto results = splitJoinedResults(joinTables, row);
+			return Json::object{
+				{ "rank", row["searchRank"] },
+				{ "mediaItem", transformDBArtist(results[0]) }
+			};
+		}
+	});
+}
+
+void selectArtistSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery) {
+	tx.addSQL("SELECT count(*) AS total FROM ArtistSearch WHERE ArtistSearch MATCH ?", { matchQuery }, {
+		.outKey = outKey,
+		.mapper = [=](auto row) {
+			return row["total"];
+		}
+	});
+}
+
+void selectUserAccountSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit) {
+	auto joinTables = ArrayList<JoinTable>{
+		{
+			.name = "UserAccount",
+			.prefix = "r1_",
+			.columns = userAccountColumns()
+		}
+	};
+	auto columns = joinedTableColumns(joinTables);
+	LinkedList<Any> params;
+	auto query = sqlSearchResultsPage(String::join({
+		"SELECT ",columns,", bm25(UserAccountSearch, 0.0, 10.0) AS searchRank FROM UserAccountSearch "
+			"INNER JOIN UserAccount ON UserAccount.rowid = UserAccountSearch.rowid AND UserAccount.uri = UserAccountSearch.uri "
+			"WHERE UserAccountSearch MATCH ",sqlParam(params, matchQuery)
+	}), after, limit, params);
+	tx.addSQL(query, params, {
+		.outKey = outKey,
+		.mapper = [=](auto row) -> Json {
+			auto results = splitJoinedResults(joinTables, row);
+			return Json::object{
+				{ "rank", row["searchRank"] },
+				{ "mediaItem", transformDBUserAccount(results[0]) }
+			};
+		}
+	});
+}
+
+void selectUserAccountSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery) {
+	tx.addSQL("SELECT count(*) AS total FROM UserAccountSearch WHERE UserAccountSearch MATCH ?", { matchQuery }, {
+		.outKey = outKey,
+		.mapper = [=](auto row) {
+			return row["total"];
+		}
+	});
+}
+
+
+
 #pragma mark Update
 
 void updateTrackCollectionVersionId(SQLiteTransaction& tx, String collectionURI, String versionId) {
@@ -1736,152 +2031,239 @@ void deleteUnmatchedScrobbles(SQLiteTransaction& tx, Date startTime, String trac
 	tx.addSQL("DELETE FROM UnmatchedScrobble WHERE startTime = ? AND trackURI = ?", { startTime.toISOString(), trackURI });
 }
 
-void deleteUnreferencedCollectionItems(SQLiteTransaction& tx) {
-	tx.addSQL(
-		"DELETE FROM TrackCollectionItem AS tci "
-		"WHERE NOT EXISTS("
+String unreferencedCollectionItemsCondition(String collectionURI) {
+	return String::join({
+		"NOT EXISTS("
 			// check if collection is a saved album
-			"SELECT albumURI FROM SavedAlbum WHERE SavedAlbum.albumURI = tci.collectionURI"
+			"SELECT albumURI FROM SavedAlbum WHERE SavedAlbum.albumURI = ",collectionURI,
 		") "
 		"AND NOT EXISTS("
 			// check if collection is a saved playlist
-			"SELECT playlistURI FROM SavedPlaylist WHERE SavedPlaylist.playlistURI = tci.collectionURI"
-		")", {});
+			"SELECT playlistURI FROM SavedPlaylist WHERE SavedPlaylist.playlistURI = ",collectionURI,
+		")"
+	});
 }
 
-void deleteUnreferencedTracks(SQLiteTransaction& tx) {
-	// delete from track artists
-	tx.addSQL(
-		"DELETE FROM TrackArtist AS ta "
-		"WHERE NOT EXISTS("
-			// check if track is a saved track
-			"SELECT trackURI, libraryProvider FROM SavedTrack WHERE SavedTrack.trackURI = ta.trackURI"
-		") "
-		"AND NOT EXISTS("
-			// check if a collection item from a saved album references this track
-			"SELECT TrackCollectionItem.collectionURI, TrackCollectionItem.indexNum, TrackCollectionItem.trackURI "
-				"FROM TrackCollectionItem, SavedAlbum "
-				"WHERE TrackCollectionItem.trackURI = ta.trackURI AND TrackCollectionItem.collectionURI = SavedAlbum.albumURI"
-		") "
-		"AND NOT EXISTS("
-			// check if a collection item from a saved playlist references this track
-			"SELECT TrackCollectionItem.collectionURI, TrackCollectionItem.indexNum, TrackCollectionItem.trackURI "
-				"FROM TrackCollectionItem, SavedPlaylist "
-				"WHERE TrackCollectionItem.trackURI = ta.trackURI AND TrackCollectionItem.collectionURI = SavedPlaylist.playlistURI"
-		") "
-		"AND NOT EXISTS("
-			// check if track is from a saved album
-			"SELECT Track.uri FROM Track, SavedAlbum WHERE Track.uri = ta.trackURI AND Track.albumURI = SavedAlbum.albumURI"
-		") "
-		"AND NOT EXISTS("
-			// check if track is referenced by a PlaybackHistoryItem
-			"SELECT PlaybackHistoryItem.trackURI FROM PlaybackHistoryItem WHERE ta.trackURI = PlaybackHistoryItem.trackURI"
-		") "
-		"AND NOT EXISTS("
-			// check if track is referenced by a Scrobble
-			"SELECT Scrobble.trackURI FROM Scrobble WHERE ta.trackURI = Scrobble.trackURI"
-		")", {});
-	// delete from tracks
-	tx.addSQL(
-		"DELETE FROM Track AS t "
-		"WHERE NOT EXISTS("
+String unreferencedTrackCondition(String trackURI, String albumURI) {
+	return String::join({
+		"NOT EXISTS("
 			// check if track is a saved track
-			"SELECT trackURI, libraryProvider FROM SavedTrack WHERE SavedTrack.trackURI = t.uri"
-		") "
-		"AND NOT EXISTS("
-			// check if a collection item from a saved album references this track
-			"SELECT TrackCollectionItem.collectionURI, TrackCollectionItem.indexNum, TrackCollectionItem.trackURI "
-				"FROM TrackCollectionItem, SavedAlbum "
-				"WHERE TrackCollectionItem.trackURI = t.uri AND TrackCollectionItem.collectionURI = SavedAlbum.albumURI"
+			"SELECT trackURI FROM SavedTrack WHERE SavedTrack.trackURI = ",trackURI,
 		") "
 		"AND NOT EXISTS("
-			// check if a collection item from a saved playlist references this track
-			"SELECT TrackCollectionItem.collectionURI, TrackCollectionItem.indexNum, TrackCollectionItem.trackURI "
-				"FROM TrackCollectionItem, SavedPlaylist "
-				"WHERE TrackCollectionItem.trackURI = t.uri AND TrackCollectionItem.collectionURI = SavedPlaylist.playlistURI"
+			// check if track is an item of a collection. unsaved collections have their items deleted first
+			"SELECT trackURI FROM TrackCollectionItem WHERE TrackCollectionItem.trackURI = ",trackURI,
 		") "
 		"AND NOT EXISTS("
 			// check if track is from a saved album
-			"SELECT SavedAlbum.uri FROM SavedAlbum WHERE t.albumURI = SavedAlbum.albumURI"
+			"SELECT albumURI FROM SavedAlbum WHERE SavedAlbum.albumURI = ",albumURI,
 		") "
 		"AND NOT EXISTS("
 			// check if track is referenced by a PlaybackHistoryItem
-			"SELECT PlaybackHistoryItem.trackURI FROM PlaybackHistoryItem WHERE t.uri = PlaybackHistoryItem.trackURI"
+			"SELECT trackURI FROM PlaybackHistoryItem WHERE PlaybackHistoryItem.trackURI = ",trackURI,
 		") "
 		"AND NOT EXISTS("
 			// check if track is referenced by a Scrobble
-			"SELECT Scrobble.trackURI FROM Scrobble WHERE t.uri = Scrobble.trackURI"
-		")", {});
+			"SELECT trackURI FROM Scrobble WHERE Scrobble.trackURI = ",trackURI,
+		")"
+	});
 }
 
-void deleteUnreferencedCollections(SQLiteTransaction& tx) {
-	// delete from collection artists
-	tx.addSQL(
-		"DELETE FROM TrackCollectionArtist AS tca "
-		"WHERE NOT EXISTS("
+String unreferencedCollectionCondition(String collectionURI) {
+	return String::join({
+		"NOT EXISTS("
 			// check if collection is a saved album
-			"SELECT albumURI, libraryProvider FROM SavedAlbum WHERE SavedAlbum.albumURI = tca.collectionURI"
-		") "
-		"WHERE NOT EXISTS("
-			// check if collection is a saved playlist
-			"SELECT playlistURI, libraryProvider FROM SavedPlaylist WHERE SavedPlaylist.playlistURI = tca.collectionURI"
+			"SELECT albumURI FROM SavedAlbum WHERE SavedAlbum.albumURI = ",collectionURI,
 		") "
 		"AND NOT EXISTS("
-			// check if collection is the album of a saved track
-			"SELECT Track.albumURI FROM Track WHERE Track.albumURI = tca.collectionURI"
+			// check if collection is a saved playlist
+			"SELECT playlistURI FROM SavedPlaylist WHERE SavedPlaylist.playlistURI = ",collectionURI,
 		") "
 		"AND NOT EXISTS("
-			// check if collection is referenced by PlaybackHistoryItem.contextURI
-			"SELECT PlaybackHistoryItem.contextURI FROM PlaybackHistoryItem WHERE tca.collectionURI = PlaybackHistoryItem.contextURI"
-		")", {});
-	tx.addSQL(
-		"DELETE FROM TrackCollection AS tc "
-		"WHERE NOT EXISTS("
-			// check if collection is a saved album
-			"SELECT albumURI, libraryProvider FROM SavedAlbum WHERE SavedAlbum.albumURI = tc.uri"
-		") "
-		"WHERE NOT EXISTS("
-			// check if collection is a saved playlist
-			"SELECT playlistURI, libraryProvider FROM SavedPlaylist WHERE SavedPlaylist.playlistURI = tc.uri"
+			// check if collection is the album of a cached track
+			"SELECT albumURI FROM Track WHERE Track.albumURI = ",collectionURI,
 		") "
 		"AND NOT EXISTS("
-			// check if collection is the album of a saved track
-			"SELECT Track.albumURI FROM Track WHERE Track.albumURI = tc.uri"
+			// check if collection still has items
+			"SELECT collectionURI FROM TrackCollectionItem WHERE TrackCollectionItem.collectionURI = ",collectionURI,
 		") "
 		"AND NOT EXISTS("
 			// check if collection is referenced by PlaybackHistoryItem.contextURI
-			"SELECT PlaybackHistoryItem.contextURI FROM PlaybackHistoryItem WHERE tc.collectionURI = PlaybackHistoryItem.contextURI"
-		")", {});
+			"SELECT contextURI FROM PlaybackHistoryItem WHERE PlaybackHistoryItem.contextURI = ",collectionURI,
+		")"
+	});
 }
 
-void deleteUnreferencedArtists(SQLiteTransaction& tx) {
-	tx.addSQL(
-		"DELETE FROM Artist AS a "
-		"WHERE NOT EXISTS("
+String unreferencedArtistCondition(String artistURI) {
+	return String::join({
+		"NOT EXISTS("
 			// check if artist is referenced by a track artist
-			"SELECT artistURI FROM TrackArtist WHERE TrackArtist.artistURI = a.uri"
+			"SELECT artistURI FROM TrackArtist WHERE TrackArtist.artistURI = ",artistURI,
 		") "
 		"AND NOT EXISTS("
 			// check if artist is referenced by a collection artist
-			"SELECT artistURI FROM TrackCollectionArtist WHERE TrackCollectionArtist.artistURI = a.uri"
+			"SELECT artistURI FROM TrackCollectionArtist WHERE TrackCollectionArtist.artistURI = ",artistURI,
 		") "
 		"AND NOT EXISTS("
 			// check if artist is a followed artist
-			"SELECT artistURI FROM FollowedArtist WHERE FollowedArtist.artistURI = a.uri"
-		")", {});
+			"SELECT artistURI FROM FollowedArtist WHERE FollowedArtist.artistURI = ",artistURI,
+		")"
+	});
 }
 
-void deleteUnreferencedUserAccounts(SQLiteTransaction& tx) {
-	tx.addSQL(
-		"DELETE FROM UserAccount AS u "
-		"WHERE NOT EXISTS("
-			  // check if user is referenced by a track collection
-			  "SELECT ownerURI FROM TrackCollection WHERE TrackCollection.ownerURI = u.uri"
+String unreferencedUserAccountCondition(String userURI) {
+	return String::join({
+		"NOT EXISTS("
+			// check if user is referenced by a track collection
+			"SELECT ownerURI FROM TrackCollection WHERE TrackCollection.ownerURI = ",userURI,
 		") "
 		"AND NOT EXISTS("
-			  // check if user is a followed user
-			  "SELECT userURI FROM FollowedUserAccount WHERE FollowedUserAccount.userURI = u.uri"
-		")", {});
+			// check if user is a followed user
+			"SELECT userURI FROM FollowedUserAccount WHERE FollowedUserAccount.userURI = ",userURI,
+		")"
+	});
+}
+
+void deleteUnreferencedCollectionItems(SQLiteTransaction& tx) {
+	tx.addSQL(String::join({
+		"DELETE FROM TrackCollectionItemChunk AS tcic WHERE ",unreferencedCollectionItemsCondition("tcic.collectionURI")
+	}), {});
+	tx.addSQL(String::join({
+		"DELETE FROM TrackCollectionItem AS tci WHERE ",unreferencedCollectionItemsCondition("tci.collectionURI")
+	}), {});
+}
+
+void deleteUnreferencedTracks(SQLiteTransaction& tx) {
+	auto unreferencedTracks = String::join({
+		"SELECT t.uri FROM Track AS t WHERE ",unreferencedTrackCondition("t.uri", "t.albumURI")
+	});
+	// delete from track artists
+	tx.addSQL(String::join({ "DELETE FROM TrackArtist WHERE trackURI IN (",unreferencedTracks,")" }), {});
+	// delete from tracks
+	tx.addSQL(String::join({ "DELETE FROM Track WHERE uri IN (",unreferencedTracks,")" }), {});
+}
+
+void deleteUnreferencedCollections(SQLiteTransaction& tx) {
+	auto unreferencedCollections = String::join({
+		"SELECT tc.uri FROM TrackCollection AS tc WHERE ",unreferencedCollectionCondition("tc.uri")
+	});
+	// delete from collection artists
+	tx.addSQL(String::join({ "DELETE FROM TrackCollectionArtist WHERE collectionURI IN (",unreferencedCollections,")" }), {});
+	// delete from collections
+	tx.addSQL(String::join({ "DELETE FROM TrackCollection WHERE uri IN (",unreferencedCollections,")" }), {});
+}
+
+void deleteUnreferencedArtists(SQLiteTransaction& tx) {
+	tx.addSQL(String::join({
+		"DELETE FROM Artist AS a WHERE ",unreferencedArtistCondition("a.uri")
+	}), {});
+}
+
+void deleteUnreferencedUserAccounts(SQLiteTransaction& tx) {
+	tx.addSQL(String::join({
+		"DELETE FROM UserAccount AS u WHERE ",unreferencedUserAccountCondition("u.uri")
+	}), {});
+}
+
+
+
+#pragma mark Garbage Collection
+
+String garbageCollectionCursorKey(String stepName) {
+	return "gcCursor_"+stepName;
+}
+
+struct GarbageCollectionStep {
+	/// identifies the step's cursor
+	String name;
+	/// the table whose rows are scanned by uri
+	String table;
+	/// whether a row of the scanned table (aliased as w) is unreferenced
+	String condition;
+	/// the tables to delete unreferenced rows from, paired with the column matching the scanned uri.
+	/// dependent tables come first, and the scanned table last.
+	ArrayList<std::pair<String,String>> deletions;
+};
+
+void addGarbageCollectionStep(SQLiteTransaction& tx, String outKey, const GarbageCollectionStep& step, size_t batchSize) {
+	auto cursorKey = garbageCollectionCursorKey(step.name);
+	// copy the next batch of uris after the stored cursor, so every statement below sees the same window
+	tx.addSQL("CREATE TEMP TABLE IF NOT EXISTS GCWindow (uri TEXT NOT NULL PRIMARY KEY)", {});
+	tx.addSQL("DELETE FROM temp.GCWindow", {});
+	if(batchSize == 0) {
+		tx.addSQL(String::join({ "INSERT INTO temp.GCWindow (uri) SELECT uri FROM ",step.table }), {});
+	} else {
+		tx.addSQL(String::join({
+			"INSERT INTO temp.GCWindow (uri) SELECT uri FROM ",step.table,
+			" WHERE uri > COALESCE((SELECT stateValue FROM DBState WHERE stateKey = ?), '')"
+			" ORDER BY uri LIMIT ?"
+		}), { cursorKey, batchSize });
+	}
+	tx.addSQL("SELECT count(*) AS total FROM temp.GCWindow", {}, {
+		.outKey = outKey+"_scanned_"+step.name,
+		.mapper = [=](auto row) {
+			return row["total"];
+		}
+	});
+	// advance the cursor past the window, or wrap around once the window reaches the end of the table
+	if(batchSize == 0) {
+		tx.addSQL("DELETE FROM DBState WHERE stateKey = ?", { cursorKey });
+	} else {
+		tx.addSQL(
+			"INSERT OR REPLACE INTO DBState (stateKey, stateValue) "
+			"SELECT ?, CASE WHEN count(*) < ? THEN '' ELSE max(uri) END FROM temp.GCWindow",
+			{ cursorKey, batchSize });
+	}
+	// delete the unreferenced rows of the window
+	for(auto& deletion : step.deletions) {
+		tx.addSQL(String::join({
+			"DELETE FROM ",deletion.first," WHERE ",deletion.second," IN ("
+				"SELECT w.uri FROM temp.GCWindow AS g INNER JOIN ",step.table," AS w ON w.uri = g.uri "
+				"WHERE ",step.condition,
+			")"
+		}), {});
+		tx.addSQL("SELECT changes() AS total", {}, {
+			.outKey = outKey+"_deleted_"+deletion.first,
+			.mapper = [=](auto row) {
+				return row["total"];
+			}
+		});
+	}
+}
+
+void deleteUnreferencedRowsBatch(SQLiteTransaction& tx, String outKey, size_t batchSize) {
+	// ordered so that rows freed by an earlier step can be collected by a later one
+	auto steps = ArrayList<GarbageCollectionStep>{
+		{
+			.name = "TrackCollectionItem",
+			.table = "TrackCollection",
+			.condition = unreferencedCollectionItemsCondition("w.uri"),
+			.deletions = { { "TrackCollectionItemChunk", "collectionURI" }, { "TrackCollectionItem", "collectionURI" } }
+		}, {
+			.name = "Track",
+			.table = "Track",
+			.condition = unreferencedTrackCondition("w.uri", "w.albumURI"),
+			.deletions = { { "TrackArtist", "trackURI" }, { "Track", "uri" } }
+		}, {
+			.name = "TrackCollection",
+			.table = "TrackCollection",
+			.condition = unreferencedCollectionCondition("w.uri"),
+			.deletions = { { "TrackCollectionArtist", "collectionURI" }, { "TrackCollection", "uri" } }
+		}, {
+			.name = "Artist",
+			.table = "Artist",
+			.condition = unreferencedArtistCondition("w.uri"),
+			.deletions = { { "Artist", "uri" } }
+		}, {
+			.name = "UserAccount",
+			.table = "UserAccount",
+			.condition = unreferencedUserAccountCondition("w.uri"),
+			.deletions = { { "UserAccount", "uri" } }
+		}
+	};
+	for(auto& step : steps) {
+		addGarbageCollectionStep(tx, outKey, step, batchSize);
+	}
 }
 
 }
@@ -10,13 +10,21 @@
 
 #include <soundhole/common.hpp>
 #include "MediaDatabaseSQL.hpp"
+#include "MediaDatabaseSQLTransformations.hpp"
 #include "SQLiteTransaction.hpp"
 #include "SQLIndexRange.hpp"
+#include "SQLKeysetCursor.hpp"
 #include "SQLOrder.hpp"
 #include "SQLOrderBy.hpp"
 
 namespace sh::sql {
 
+void selectSchemaVersion(SQLiteTransaction& tx, String outKey);
+/// Adds every migration newer than the given version, and then stores the latest version
+void applyMigrations(SQLiteTransaction& tx, int fromVersion);
+/// Converts the stored images to the given layout. This is safe to apply to a database that already uses it
+void applyMediaAttributeStorage(SQLiteTransaction& tx, MediaAttributeStorage storage);
+
 void insertOrReplaceArtists(SQLiteTransaction& tx, const ArrayList<$<Artist>>& artists);
 void insertOrReplaceFollowedArtists(SQLiteTransaction& tx, const ArrayList<FollowedArtist>& followedArtists);
 void insertOrReplaceTracks(SQLiteTransaction& tx, const ArrayList<$<Track>>& tracks, bool includeAlbums);
@@ -26,6 +34,15 @@ struct InsertTrackCollectionItemsOptions {
 	bool includeTrackAlbums = false;
 };
 void insertOrReplaceItemsFromTrackCollection(SQLiteTransaction& tx, $<TrackCollection> collection, InsertTrackCollectionItemsOptions options = InsertTrackCollectionItemsOptions());
+struct TrackCollectionItemsDelta {
+	IndexRange range;
+	/// the fingerprint of the items in the range, or empty if it couldn't be computed
+	String fingerprint;
+	/// indexes of items that differ from the stored rows, including their track data. only these items and their tracks are written
+	LinkedList<size_t> changedIndexes;
+	bool includeTrackAlbums = false;
+};
+void applyTrackCollectionItemsDelta(SQLiteTransaction& tx, $<TrackCollection> collection, const TrackCollectionItemsDelta& delta);
 void insertOrReplaceLibraryItems(SQLiteTransaction& tx, const ArrayList<MediaProvider::LibraryItem>& items);
 void insertOrReplaceSavedTracks(SQLiteTransaction& tx, const ArrayList<SavedTrack>& savedTracks);
 void insertOrReplaceSavedAlbums(SQLiteTransaction& tx, const ArrayList<SavedAlbum>& savedAlbums);
@@ -41,6 +58,8 @@ void selectTrack(SQLiteTransaction& tx, String outKey, String uri);
 void selectTrackCount(SQLiteTransaction& tx, String outKey);
 void selectTrackCollectionWithOwner(SQLiteTransaction& tx, String outKey, String uri);
 void selectTrackCollectionItemsWithTracks(SQLiteTransaction& tx, String outKey, String collectionURI, Optional<IndexRange> range);
+void selectTrackCollectionItemKeys(SQLiteTransaction& tx, String outKey, String collectionURI);
+void selectTrackCollectionItemChunks(SQLiteTransaction& tx, String outKey, String collectionURI);
 void selectArtist(SQLiteTransaction& tx, String outKey, String uri);
 
 struct LibraryItemSelectOptions {
@@ -48,8 +67,12 @@ struct LibraryItemSelectOptions {
 	Optional<IndexRange> range;
 	Order order = Order::DEFAULT;
 	LibraryItemOrderBy orderBy = LibraryItemOrderBy::ADDED_AT;
+	/// only select items after this cursor. Supported for saved tracks, albums, and playlists
+	Optional<LibraryItemCursor> after;
 };
 void selectSavedTracksWithTracks(SQLiteTransaction& tx, String outKey, LibraryItemSelectOptions options = LibraryItemSelectOptions());
+/// When the attribute storage is normalized, the artists and images of the tracks are looked up in a batch instead of being parsed from json
+void selectSavedTracksWithTracks(SQLiteTransaction& tx, $<LinkedList<DBSavedTrackRow>> output, MediaAttributeStorage attributeStorage, LibraryItemSelectOptions options = LibraryItemSelectOptions());
 void selectSavedTrackCount(SQLiteTransaction& tx, String outKey, String libraryProvider = String());
 void selectSavedTrack(SQLiteTransaction& tx, String outKey, String uri);
 void selectSavedTrackWithTrack(SQLiteTransaction& tx, String outKey, String uri);
@@ -96,8 +119,11 @@ struct PlaybackHistorySelectFilters {
 struct PlaybackHistorySelectOptions {
 	Optional<IndexRange> range;
 	Order order = Order::DEFAULT;
+	/// only select items after this cursor
+	Optional<PlaybackHistoryCursor> after;
 };
 void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, String outKey, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options);
+void selectPlaybackHistoryItemsWithTracks(SQLiteTransaction& tx, $<LinkedList<DBPlaybackHistoryItemRow>> output, MediaAttributeStorage attributeStorage, const PlaybackHistorySelectFilters& filters, const PlaybackHistorySelectOptions& options);
 void selectPlaybackHistoryItemCount(SQLiteTransaction& tx, String outKey, const PlaybackHistorySelectFilters& filters);
 
 struct ScrobbleSelectFilters {
@@ -136,6 +162,17 @@ struct UnmatchedScrobbleSelectOptions {
 void selectUnmatchedScrobbles(SQLiteTransaction& tx, String outKey, const UnmatchedScrobbleSelectFilters& filters, const UnmatchedScrobbleSelectOptions& options);
 void selectUnmatchedScrobbleCount(SQLiteTransaction& tx, String outKey, const UnmatchedScrobbleSelectFilters& filters);
 
+/// Search results are ordered by rank, where a lower rank is a better match. Each row has "rank" and "mediaItem"
+void selectTrackSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit);
+void selectTrackSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery);
+/// collectionType can be "album" or "playlist", or empty to match either
+void selectTrackCollectionSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, String collectionType, Optional<SearchCursor::Position> after, size_t limit);
+void selectTrackCollectionSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery, String collectionType);
+void selectArtistSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit);
+void selectArtistSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery);
+void selectUserAccountSearchResults(SQLiteTransaction& tx, String outKey, String matchQuery, Optional<SearchCursor::Position> after, size_t limit);
+void selectUserAccountSearchResultCount(SQLiteTransaction& tx, String outKey, String matchQuery);
+
 void selectDBState(SQLiteTransaction& tx, String outKey, String stateKey);
 
 
@@ -159,5 +196,8 @@ void deleteUnreferencedTracks(SQLiteTransaction& tx);
 void deleteUnreferencedCollections(SQLiteTransaction& tx);
 void deleteUnreferencedArtists(SQLiteTransaction& tx);
 void deleteUnreferencedUserAccounts(SQLiteTransaction& tx);
+/// Checks the next batch of rows of each table for references, resuming from cursors stored in DBState, and deletes the unreferenced ones.
+/// A batch size of 0 checks every row. The rows checked per step are output to "<outKey>_scanned_<step>", and the rows deleted to "<outKey>_deleted_<table>"
+void deleteUnreferencedRowsBatch(SQLiteTransaction& tx, String outKey, size_t batchSize);
 
 }
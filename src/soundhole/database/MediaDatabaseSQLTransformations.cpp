@@ -164,4 +164,204 @@ Json transformDBUnmatchedScrobble(Json scrobbleJson, Json historyItemJson, Json
 	return obj;
 }
 
+
+
+
+// these must match the order of imageColumns(), artistColumns(), trackColumns(), savedTrackColumns(), and playbackHistoryItemColumns()
+enum class DBImageColumn: size_t {
+	mediaItemURI, indexNum, url, size, width, height
+};
+enum class DBArtistColumn: size_t {
+	uri, provider, type, name, images, lastRowUpdateTime
+};
+enum class DBTrackColumn: size_t {
+	uri, provider, name, albumName, albumURI, artists, images, duration, playable, lastRowUpdateTime
+};
+enum class DBSavedTrackColumn: size_t {
+	trackURI, libraryProvider, addedAt, lastRowUpdateTime
+};
+enum class DBPlaybackHistoryItemColumn: size_t {
+	startTime, trackURI, contextURI, duration, chosenByUser, visibility, lastRowUpdateTime
+};
+
+MediaItem::Image decodeDBImage(const SQLiteRow& row, size_t offset) {
+	auto col = [=](DBImageColumn column) {
+		return offset + (size_t)column;
+	};
+	bool hasDimensions = !row.isNull(col(DBImageColumn::width)) && !row.isNull(col(DBImageColumn::height));
+	return MediaItem::Image{
+		.url = row.stringValue(col(DBImageColumn::url)),
+		.size = MediaItem::Image::Size_fromJson(Json(row.stringValue(col(DBImageColumn::size)))),
+		.dimensions = hasDimensions ? maybe(MediaItem::Image::Dimensions{
+			.width = (size_t)row.integerValue(col(DBImageColumn::width)),
+			.height = (size_t)row.integerValue(col(DBImageColumn::height))
+		}) : std::nullopt
+	};
+}
+
+Optional<ArrayList<MediaItem::Image>> decodeDBImages(const SQLiteRow& row, size_t index, const String& uri, const MediaAttributeLookup* attributes, const char* rowType) {
+	if(row.isNull(index)) {
+		if(attributes == nullptr) {
+			return std::nullopt;
+		}
+		auto it = attributes->images.find(uri);
+		if(it == attributes->images.end()) {
+			return std::nullopt;
+		}
+		return it->second;
+	}
+	auto imagesJson = row.parsedJsonValue(index);
+	if(!imagesJson.is_array()) {
+		throw std::invalid_argument((String)"Invalid db row for "+rowType+": 'images' must be an array or null");
+	}
+	return ArrayList<Json>(imagesJson.array_items()).map([](auto& imgJson) -> MediaItem::Image {
+		return MediaItem::Image::fromJson(imgJson);
+	});
+}
+
+DBArtistRow decodeDBArtist(const SQLiteRow& row, size_t offset, const MediaAttributeLookup* attributes) {
+	auto col = [=](DBArtistColumn column) {
+		return offset + (size_t)column;
+	};
+	auto uri = row.stringValue(col(DBArtistColumn::uri));
+	return DBArtistRow{
+		.provider = row.stringValue(col(DBArtistColumn::provider)),
+		.data = Artist::Data{{
+			.partial = true,
+			.type = row.stringValue(col(DBArtistColumn::type)),
+			.name = row.stringValue(col(DBArtistColumn::name)),
+			.uri = uri,
+			.images = decodeDBImages(row, col(DBArtistColumn::images), uri, attributes, "Artist"),
+			.additionalInfo = Json()
+			},
+			.musicBrainzID = String(),
+			.description = std::nullopt
+		}
+	};
+}
+
+DBTrackRow decodeDBTrack(const SQLiteRow& row, size_t offset, const MediaAttributeLookup* attributes) {
+	auto col = [=](DBTrackColumn column) {
+		return offset + (size_t)column;
+	};
+	auto uri = row.stringValue(col(DBTrackColumn::uri));
+	// use the joined artists only if none of them were skipped for lacking a uri
+	Optional<ArrayList<DBArtistRow>> artists;
+	Json artistsJson;
+	if(attributes != nullptr) {
+		auto it = attributes->artists.find(uri);
+		if(it != attributes->artists.end() && it->second.artists.size() == it->second.totalCount) {
+			artists = it->second.artists;
+		}
+	}
+	if(!artists) {
+		artistsJson = row.parsedJsonValue(col(DBTrackColumn::artists));
+		if(!artistsJson.is_array()) {
+			throw std::invalid_argument("Invalid db row for Track: 'artists' is required");
+		}
+	}
+	return DBTrackRow{
+		.provider = row.stringValue(col(DBTrackColumn::provider)),
+		.data = Track::Data{{
+			.partial = true,
+			.type = "track",
+			.name = row.stringValue(col(DBTrackColumn::name)),
+			.uri = uri,
+			.images = decodeDBImages(row, col(DBTrackColumn::images), uri, attributes, "Track"),
+			.additionalInfo = Json()
+			},
+			.musicBrainzID = String(),
+			.albumName = row.stringValue(col(DBTrackColumn::albumName)),
+			.albumURI = row.stringValue(col(DBTrackColumn::albumURI)),
+			.artists = ArrayList<$<Artist>>(),
+			.tags = ArrayList<String>(),
+			.discNumber = std::nullopt,
+			.trackNumber = std::nullopt,
+			.duration = row.optDoubleValue(col(DBTrackColumn::duration)),
+			.audioSources = ArrayList<Track::AudioSource>(),
+			.playable = row.optBoolValue(col(DBTrackColumn::playable))
+		},
+		.artists = artists,
+		.artistsJson = artistsJson
+	};
+}
+
+DBSavedTrackRow decodeDBSavedTrack(const SQLiteRow& row, size_t offset, DBTrackRow track) {
+	return DBSavedTrackRow{
+		.track = track,
+		.libraryProvider = row.stringValue(offset + (size_t)DBSavedTrackColumn::libraryProvider),
+		.addedAt = Date::maybeFromISOString(row.stringValue(offset + (size_t)DBSavedTrackColumn::addedAt)).valueOr(Date::epoch())
+	};
+}
+
+DBPlaybackHistoryItemRow decodeDBPlaybackHistoryItem(const SQLiteRow& row, size_t offset, DBTrackRow track) {
+	auto col = [=](DBPlaybackHistoryItemColumn column) {
+		return offset + (size_t)column;
+	};
+	auto startTime = row.stringValue(col(DBPlaybackHistoryItemColumn::startTime));
+	return DBPlaybackHistoryItemRow{
+		.track = track,
+		.data = PlaybackHistoryItem::Data{
+			.track = nullptr,
+			.startTime =
+				Date::maybeFromISOString(startTime)
+					.valueOrThrow(std::invalid_argument("Invalid date string \""+startTime+"\" for PlaybackHistoryItem property 'startTime'")),
+			.contextURI = row.stringValue(col(DBPlaybackHistoryItemColumn::contextURI)),
+			.duration = row.optDoubleValue(col(DBPlaybackHistoryItemColumn::duration)),
+			.chosenByUser = row.optBoolValue(col(DBPlaybackHistoryItemColumn::chosenByUser)).valueOr(true),
+			.visibility = PlaybackHistoryItem::Visibility_fromString(row.stringValue(col(DBPlaybackHistoryItemColumn::visibility)))
+		}
+	};
+}
+
+
+
+$<Artist> createDBArtist(const DBArtistRow& row, MediaProviderStash* stash) {
+	auto provider = stash->getMediaProvider(row.provider);
+	if(provider == nullptr) {
+		throw std::invalid_argument("invalid provider name: "+row.provider);
+	}
+	return provider->artist(row.data);
+}
+
+$<Track> createDBTrack(const DBTrackRow& row, MediaProviderStash* stash) {
+	auto provider = stash->getMediaProvider(row.provider);
+	if(provider == nullptr) {
+		throw std::invalid_argument("invalid provider name: "+row.provider);
+	}
+	auto data = row.data;
+	if(row.artists) {
+		data.artists = row.artists->map([=](auto& artistRow) -> $<Artist> {
+			return createDBArtist(artistRow, stash);
+		});
+	} else {
+		data.artists = ArrayList<Json>(row.artistsJson.array_items()).map([=](auto& artistJson) -> $<Artist> {
+			auto mediaItem = stash->parseMediaItem(artistJson);
+			if(!mediaItem) {
+				throw std::invalid_argument("Invalid db row for Track: elements of artists cannot be null");
+			}
+			auto artist = std::dynamic_pointer_cast<Artist>(mediaItem);
+			if(!artist) {
+				throw std::invalid_argument("Invalid db row for Track: parsed "+mediaItem->type()+" instead of expected type artist");
+			}
+			return artist;
+		});
+	}
+	return provider->track(data);
+}
+
+SavedTrackItem createDBSavedTrack(const DBSavedTrackRow& row, MediaProviderStash* stash) {
+	return SavedTrackItem{
+		.track = createDBTrack(row.track, stash),
+		.libraryProvider = row.libraryProvider,
+		.addedAt = row.addedAt
+	};
+}
+
+$<PlaybackHistoryItem> createDBPlaybackHistoryItem(const DBPlaybackHistoryItemRow& row, MediaProviderStash* stash) {
+	auto data = row.data;
+	data.track = createDBTrack(row.track, stash);
+	return PlaybackHistoryItem::new$(data);
+}
+
 }
@@ -8,7 +8,13 @@
 
 #pragma once
 
+#include <map>
 #include <soundhole/common.hpp>
+#include <soundhole/media/Track.hpp>
+#include <soundhole/media/PlaybackHistoryItem.hpp>
+#include <soundhole/media/MediaProviderStash.hpp>
+#include "MediaDatabaseSQL.hpp"
+#include "SQLiteRow.hpp"
 
 namespace sh::sql {
 
@@ -27,4 +33,57 @@ Json transformDBPlaybackHistoryItem(Json historyItemJson, Json trackJson);
 Json transformDBScrobble(Json scrobbleJson);
 Json transformDBUnmatchedScrobble(Json scrobbleJson, Json historyItemJson, Json trackJson);
 
+/// An artist row decoded into plain data, before an Artist instance is created from it
+struct DBArtistRow {
+	String provider;
+	Artist::Data data;
+};
+
+/// A track row decoded into plain data, before a Track instance is created from it.
+/// The artists are kept as rows (or as the raw artists json) and the data's artists list is left empty
+struct DBTrackRow {
+	String provider;
+	Track::Data data;
+	Optional<ArrayList<DBArtistRow>> artists;
+	Json artistsJson;
+};
+
+struct DBSavedTrackRow {
+	DBTrackRow track;
+	String libraryProvider;
+	Date addedAt;
+};
+
+struct DBPlaybackHistoryItemRow {
+	DBTrackRow track;
+	/// the data of the history item, with a null track
+	PlaybackHistoryItem::Data data;
+};
+
+/// The artists and images of a page of rows, when they're looked up from the join tables and the Image table in a batch
+struct MediaAttributeLookup {
+	struct ArtistList {
+		ArrayList<DBArtistRow> artists;
+		/// the length of the row's artists column. artists without a uri are only stored there, so a shorter list is incomplete
+		size_t totalCount = 0;
+	};
+	std::map<String,ArrayList<MediaItem::Image>> images;
+	std::map<String,ArtistList> artists;
+};
+
+// typed decoders read columns by index, starting at the given column offset, in the order of the matching *Columns() function.
+// when attributes are given, null images columns and the artists of tracks are taken from them instead of being parsed from json.
+// decoders only produce plain data, since they run on the database threads. media item instances are created from the
+// decoded rows with the create* functions, on the queue that receives the results
+MediaItem::Image decodeDBImage(const SQLiteRow& row, size_t offset);
+DBArtistRow decodeDBArtist(const SQLiteRow& row, size_t offset, const MediaAttributeLookup* attributes = nullptr);
+DBTrackRow decodeDBTrack(const SQLiteRow& row, size_t offset, const MediaAttributeLookup* attributes = nullptr);
+DBSavedTrackRow decodeDBSavedTrack(const SQLiteRow& row, size_t offset, DBTrackRow track);
+DBPlaybackHistoryItemRow decodeDBPlaybackHistoryItem(const SQLiteRow& row, size_t offset, DBTrackRow track);
+
+$<Artist> createDBArtist(const DBArtistRow& row, MediaProviderStash* stash);
+$<Track> createDBTrack(const DBTrackRow& row, MediaProviderStash* stash);
+SavedTrackItem createDBSavedTrack(const DBSavedTrackRow& row, MediaProviderStash* stash);
+$<PlaybackHistoryItem> createDBPlaybackHistoryItem(const DBPlaybackHistoryItemRow& row, MediaProviderStash* stash);
+
 }
@@ -0,0 +1,41 @@
+//
+//  SQLKeysetCursor.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <map>
+
+namespace sh::sql {
+	/// The sort key of the last saved item in a page.
+	/// Selecting "after" it seeks straight to the next page, rather than skipping rows with OFFSET.
+	struct LibraryItemCursor {
+		/// the addedAt value when ordering by date added, or the item name when ordering by name
+		Optional<String> sortValue;
+		String uri;
+	};
+
+	/// The key of the last playback history item in a page
+	struct PlaybackHistoryCursor {
+		Date startTime;
+		String trackURI;
+	};
+
+	/// The position of a library search page in the results of each searched table
+	struct SearchCursor {
+		struct Position {
+			/// the rank and uri of the last result taken from the table
+			double rank;
+			String uri;
+			/// the number of results taken from the table so far
+			size_t count;
+		};
+		/// keyed by table: "tracks", "collections", "artists", or "userAccounts"
+		std::map<String,Position> tables;
+	};
+}
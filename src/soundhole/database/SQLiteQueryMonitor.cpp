@@ -0,0 +1,154 @@
+//
+//  SQLiteQueryMonitor.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "SQLiteQueryMonitor.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace sh {
+	#pragma mark Histogram
+
+	SQLiteQueryMonitor::Histogram SQLiteQueryMonitor::Histogram::withDefaultBuckets() {
+		// 50us to 10s, in steps of 1, 2.5, and 5
+		auto histogram = Histogram();
+		histogram.bucketBounds = {
+			50, 100, 250, 500,
+			1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+			1000000, 2500000, 5000000, 10000000
+		};
+		histogram.bucketCounts.reserve(histogram.bucketBounds.size() + 1);
+		for(size_t i=0; i<=histogram.bucketBounds.size(); i++) {
+			histogram.bucketCounts.pushBack(0);
+		}
+		return histogram;
+	}
+
+	void SQLiteQueryMonitor::Histogram::add(Duration value) {
+		size_t bucketIndex = bucketBounds.size();
+		for(size_t i=0; i<bucketBounds.size(); i++) {
+			if(value.count() <= bucketBounds[i]) {
+				bucketIndex = i;
+				break;
+			}
+		}
+		bucketCounts[bucketIndex]++;
+		count++;
+		total += value;
+		if(value > max) {
+			max = value;
+		}
+	}
+
+	SQLiteQueryMonitor::Duration SQLiteQueryMonitor::Histogram::percentile(double fraction) const {
+		if(count == 0) {
+			return Duration::zero();
+		}
+		size_t target = (size_t)std::ceil(fraction * (double)count);
+		size_t seen = 0;
+		for(size_t i=0; i<bucketCounts.size(); i++) {
+			seen += bucketCounts[i];
+			if(seen >= target && bucketCounts[i] > 0) {
+				if(i >= bucketBounds.size()) {
+					return max;
+				}
+				return std::min(Duration(bucketBounds[i]), max);
+			}
+		}
+		return max;
+	}
+
+
+
+	#pragma mark SQLiteQueryMonitor
+
+	SQLiteQueryMonitor::SQLiteQueryMonitor(Options options)
+	: options(options), stats(emptySnapshot()) {
+		//
+	}
+
+	bool SQLiteQueryMonitor::isEnabled() const {
+		return options.enabled;
+	}
+
+	SQLiteQueryMonitor::Snapshot SQLiteQueryMonitor::emptySnapshot() const {
+		auto snapshot = Snapshot();
+		snapshot.statementDuration = Histogram::withDefaultBuckets();
+		snapshot.transactionDuration = Histogram::withDefaultBuckets();
+		snapshot.readQueueWait = Histogram::withDefaultBuckets();
+		snapshot.writeQueueWait = Histogram::withDefaultBuckets();
+		return snapshot;
+	}
+
+	void SQLiteQueryMonitor::recordStatement(const StatementRecord& record) {
+		if(!options.enabled) {
+			return;
+		}
+		bool slow = (options.slowStatementThreshold > Duration::zero() && record.duration >= options.slowStatementThreshold);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stats.statementDuration.add(record.duration);
+			stats.statementCount++;
+			stats.rowsReturned += record.rowsReturned;
+			stats.bytesBound += record.bytesBound;
+			if(slow) {
+				stats.slowStatementCount++;
+			}
+			auto it = stats.statements.find(record.sql);
+			if(it == stats.statements.end() && stats.statements.size() < options.maxTrackedStatements) {
+				auto statementStats = StatementStats();
+				statementStats.duration = Histogram::withDefaultBuckets();
+				it = stats.statements.insert({ record.sql, statementStats }).first;
+			}
+			if(it != stats.statements.end()) {
+				auto& statementStats = it->second;
+				statementStats.duration.add(record.duration);
+				statementStats.executions += record.executions;
+				statementStats.rowsReturned += record.rowsReturned;
+				statementStats.bytesBound += record.bytesBound;
+			}
+		}
+		if(slow) {
+			reportSlowStatement(record);
+		}
+	}
+
+	void SQLiteQueryMonitor::recordTransaction(const TransactionRecord& record) {
+		if(!options.enabled) {
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		stats.transactionDuration.add(record.duration);
+		if(record.readOnly) {
+			stats.readQueueWait.add(record.queueWait);
+		} else {
+			stats.writeQueueWait.add(record.queueWait);
+		}
+	}
+
+	void SQLiteQueryMonitor::reportSlowStatement(const StatementRecord& record) {
+		if(options.onSlowStatement) {
+			options.onSlowStatement(record);
+			return;
+		}
+		// keep the log readable for large multi-row statements
+		size_t maxSQLLength = 500;
+		String sql = (record.sql.length() > maxSQLLength) ? (record.sql.substring(0, maxSQLLength)+"...") : record.sql;
+		FGL_WARN((String)"Slow SQL statement took "+(double)record.duration.count() / 1000.0+"ms, returned "+record.rowsReturned+" rows: "+sql);
+	}
+
+	SQLiteQueryMonitor::Snapshot SQLiteQueryMonitor::snapshot() const {
+		std::unique_lock<std::mutex> lock(mutex);
+		return stats;
+	}
+
+	void SQLiteQueryMonitor::reset() {
+		auto snapshot = emptySnapshot();
+		std::unique_lock<std::mutex> lock(mutex);
+		stats = snapshot;
+	}
+}
@@ -0,0 +1,105 @@
+//
+//  SQLiteQueryMonitor.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace sh {
+	/// Collects timing and size stats of the statements and transactions run by SQLiteTransaction.
+	/// It's shared between connections, so every method is thread safe.
+	class SQLiteQueryMonitor {
+	public:
+		using Duration = std::chrono::microseconds;
+
+		struct StatementRecord {
+			String sql;
+			/// time spent preparing, binding, and stepping the statement
+			Duration duration;
+			size_t rowsReturned;
+			size_t bytesBound;
+			/// the number of times the statement was stepped to completion. batch statements run once per set of params
+			size_t executions;
+		};
+
+		struct Options {
+			bool enabled = true;
+			/// statements slower than this are logged. zero disables logging
+			Duration slowStatementThreshold = std::chrono::milliseconds(250);
+			/// called for each slow statement instead of logging it. it's called on the queue of the connection that ran the statement
+			Function<void(const StatementRecord&)> onSlowStatement;
+			/// the maximum number of distinct SQL strings to keep stats for. statements beyond this only count towards the totals
+			size_t maxTrackedStatements = 256;
+		};
+
+		struct TransactionRecord {
+			/// time between the transaction being queued and starting to run
+			Duration queueWait;
+			Duration duration;
+			bool readOnly;
+		};
+
+		/// Counts of values in exponentially sized buckets
+		struct Histogram {
+			/// the inclusive upper bound of each bucket, in microseconds. the last bucket has no upper bound
+			ArrayList<int64_t> bucketBounds;
+			ArrayList<size_t> bucketCounts;
+			size_t count = 0;
+			Duration total = Duration::zero();
+			Duration max = Duration::zero();
+
+			static Histogram withDefaultBuckets();
+			void add(Duration value);
+			/// An estimate of the given percentile (0 to 1), as the upper bound of the bucket that contains it
+			Duration percentile(double fraction) const;
+		};
+
+		struct StatementStats {
+			Histogram duration;
+			size_t executions = 0;
+			size_t rowsReturned = 0;
+			size_t bytesBound = 0;
+		};
+
+		struct Snapshot {
+			Histogram statementDuration;
+			Histogram transactionDuration;
+			Histogram readQueueWait;
+			Histogram writeQueueWait;
+			size_t statementCount = 0;
+			size_t slowStatementCount = 0;
+			size_t rowsReturned = 0;
+			size_t bytesBound = 0;
+			/// stats of each distinct SQL string
+			std::map<String,StatementStats> statements;
+		};
+
+		SQLiteQueryMonitor(Options options);
+		SQLiteQueryMonitor(const SQLiteQueryMonitor&) = delete;
+		SQLiteQueryMonitor& operator=(const SQLiteQueryMonitor&) = delete;
+
+		bool isEnabled() const;
+
+		void recordStatement(const StatementRecord& record);
+		void recordTransaction(const TransactionRecord& record);
+
+		Snapshot snapshot() const;
+		void reset();
+
+	private:
+		Snapshot emptySnapshot() const;
+		void reportSlowStatement(const StatementRecord& record);
+
+		Options options;
+		mutable std::mutex mutex;
+		Snapshot stats;
+	};
+}
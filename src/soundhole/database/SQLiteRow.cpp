@@ -0,0 +1,121 @@
+//
+//  SQLiteRow.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "SQLiteRow.hpp"
+#include <sqlite3.h>
+
+namespace sh {
+	SQLiteRow::SQLiteRow(sqlite3_stmt* stmt)
+	: stmt(stmt) {
+		//
+	}
+
+	size_t SQLiteRow::columnCount() const {
+		return (size_t)sqlite3_column_count(stmt);
+	}
+
+	String SQLiteRow::columnName(size_t index) const {
+		return sqlite3_column_name(stmt, (int)index);
+	}
+
+	bool SQLiteRow::isNull(size_t index) const {
+		return sqlite3_column_type(stmt, (int)index) == SQLITE_NULL;
+	}
+
+	String SQLiteRow::stringValue(size_t index) const {
+		auto text = (const char*)sqlite3_column_text(stmt, (int)index);
+		if(text == nullptr) {
+			return String();
+		}
+		return String(text, (size_t)sqlite3_column_bytes(stmt, (int)index));
+	}
+
+	long long SQLiteRow::integerValue(size_t index) const {
+		return (long long)sqlite3_column_int64(stmt, (int)index);
+	}
+
+	double SQLiteRow::doubleValue(size_t index) const {
+		return sqlite3_column_double(stmt, (int)index);
+	}
+
+	Optional<String> SQLiteRow::optStringValue(size_t index) const {
+		if(isNull(index)) {
+			return std::nullopt;
+		}
+		return stringValue(index);
+	}
+
+	Optional<double> SQLiteRow::optDoubleValue(size_t index) const {
+		if(isNull(index)) {
+			return std::nullopt;
+		}
+		return doubleValue(index);
+	}
+
+	Optional<bool> SQLiteRow::optBoolValue(size_t index) const {
+		if(isNull(index)) {
+			return std::nullopt;
+		}
+		auto value = integerValue(index);
+		if(value == 0) {
+			return false;
+		} else if(value == 1) {
+			return true;
+		}
+		return std::nullopt;
+	}
+
+	Json SQLiteRow::jsonValue(size_t index) const {
+		auto sqlType = sqlite3_column_type(stmt, (int)index);
+		switch(sqlType) {
+			case SQLITE_NULL:
+				return Json();
+			case SQLITE_INTEGER: {
+				sqlite_int64 intVal = sqlite3_column_int64(stmt, (int)index);
+				if(intVal >= std::numeric_limits<int>::max() || intVal <= std::numeric_limits<int>::min()) {
+					return (double)intVal;
+				}
+				return (int)intVal;
+			}
+			case SQLITE_FLOAT:
+				return sqlite3_column_double(stmt, (int)index);
+			case SQLITE_TEXT: {
+				auto text = (const char*)sqlite3_column_text(stmt, (int)index);
+				return (text != nullptr) ? Json(text) : Json();
+			}
+			case SQLITE_BLOB: {
+				auto blob = sqlite3_column_blob(stmt, (int)index);
+				auto bytes = sqlite3_column_bytes(stmt, (int)index);
+				return Json(std::string((const char*)blob, (size_t)bytes));
+			}
+		}
+		throw std::runtime_error((String)"Invalid sql type "+sqlType+" for column \""+columnName(index)+"\"");
+	}
+
+	Json SQLiteRow::parsedJsonValue(size_t index) const {
+		auto text = (const char*)sqlite3_column_text(stmt, (int)index);
+		if(text == nullptr) {
+			return Json();
+		}
+		std::string error;
+		auto json = Json::parse(text, error);
+		if(!error.empty()) {
+			throw std::invalid_argument("Failed to parse "+columnName(index)+" json: "+error);
+		}
+		return json;
+	}
+
+	Json SQLiteRow::toJson() const {
+		Json::object row;
+		size_t colCount = columnCount();
+		for(size_t i=0; i<colCount; i++) {
+			row[columnName(i)] = jsonValue(i);
+		}
+		return row;
+	}
+}
@@ -0,0 +1,44 @@
+//
+//  SQLiteRow.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+
+struct sqlite3_stmt;
+
+namespace sh {
+	/// A view of the current result row of a statement, accessed by column index.
+	/// It is only valid until the statement is stepped again, so values must be copied out of it.
+	class SQLiteRow {
+	public:
+		explicit SQLiteRow(sqlite3_stmt* stmt);
+
+		size_t columnCount() const;
+		String columnName(size_t index) const;
+
+		bool isNull(size_t index) const;
+		String stringValue(size_t index) const;
+		long long integerValue(size_t index) const;
+		double doubleValue(size_t index) const;
+
+		Optional<String> optStringValue(size_t index) const;
+		Optional<double> optDoubleValue(size_t index) const;
+		Optional<bool> optBoolValue(size_t index) const;
+
+		/// Returns the column value as json, the same way that untyped results are decoded
+		Json jsonValue(size_t index) const;
+		/// Parses a text column that stores json. Null columns return null json
+		Json parsedJsonValue(size_t index) const;
+		/// Returns an object of all columns keyed by column name
+		Json toJson() const;
+
+	private:
+		sqlite3_stmt* stmt;
+	};
+}
@@ -0,0 +1,94 @@
+//
+//  SQLiteStatementCache.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "SQLiteStatementCache.hpp"
+#include <sqlite3.h>
+
+namespace sh {
+	SQLiteStatementCache::SQLiteStatementCache(Options options)
+	: options(options) {
+		//
+	}
+
+	SQLiteStatementCache::~SQLiteStatementCache() {
+		clear();
+	}
+
+	bool SQLiteStatementCache::isCacheable(const String& sql) const {
+		return (options.capacity > 0 && sql.length() <= options.maxSQLLength);
+	}
+
+	sqlite3_stmt* SQLiteStatementCache::checkout(const String& sql) {
+		if(!isCacheable(sql)) {
+			return nullptr;
+		}
+		auto it = entryMap.find(sql);
+		if(it == entryMap.end()) {
+			counters.misses++;
+			return nullptr;
+		}
+		counters.hits++;
+		auto stmt = it->second->stmt;
+		entries.erase(it->second);
+		entryMap.erase(it);
+		return stmt;
+	}
+
+	void SQLiteStatementCache::checkin(const String& sql, sqlite3_stmt* stmt) {
+		if(stmt == nullptr) {
+			return;
+		}
+		if(!isCacheable(sql)) {
+			sqlite3_finalize(stmt);
+			return;
+		}
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		auto it = entryMap.find(sql);
+		if(it != entryMap.end()) {
+			// an identical statement was checked in while this one was in use
+			sqlite3_finalize(stmt);
+			entries.splice(entries.begin(), entries, it->second);
+			return;
+		}
+		entries.push_front(Entry{
+			.sql = sql,
+			.stmt = stmt
+		});
+		entryMap[sql] = entries.begin();
+		evictIfNeeded();
+	}
+
+	void SQLiteStatementCache::evictIfNeeded() {
+		while(entries.size() > options.capacity) {
+			auto& entry = entries.back();
+			sqlite3_finalize(entry.stmt);
+			entryMap.erase(entry.sql);
+			entries.pop_back();
+			counters.evictions++;
+		}
+	}
+
+	void SQLiteStatementCache::clear() {
+		for(auto& entry : entries) {
+			sqlite3_finalize(entry.stmt);
+		}
+		entries.clear();
+		entryMap.clear();
+	}
+
+	SQLiteStatementCache::Stats SQLiteStatementCache::stats() const {
+		auto stats = counters;
+		stats.size = entries.size();
+		return stats;
+	}
+
+	void SQLiteStatementCache::resetStats() {
+		counters = Stats();
+	}
+}
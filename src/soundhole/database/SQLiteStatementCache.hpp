@@ -0,0 +1,67 @@
+//
+//  SQLiteStatementCache.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <list>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+namespace sh {
+	/// An LRU cache of prepared statements for a single sqlite connection, keyed by SQL text.
+	/// Statements are checked out while they're being stepped, and reset and returned to the cache afterwards.
+	class SQLiteStatementCache {
+	public:
+		struct Options {
+			size_t capacity = 64;
+			/// SQL longer than this (ie: large multi-row inserts) is never cached
+			size_t maxSQLLength = 8192;
+		};
+
+		struct Stats {
+			size_t hits = 0;
+			size_t misses = 0;
+			size_t evictions = 0;
+			size_t size = 0;
+		};
+
+		SQLiteStatementCache(Options options = Options{.capacity=64,.maxSQLLength=8192});
+		SQLiteStatementCache(const SQLiteStatementCache&) = delete;
+		SQLiteStatementCache& operator=(const SQLiteStatementCache&) = delete;
+		~SQLiteStatementCache();
+
+		bool isCacheable(const String& sql) const;
+
+		/// Removes a prepared statement for the given SQL from the cache, or returns null if none is cached
+		sqlite3_stmt* checkout(const String& sql);
+		/// Resets the statement, clears its bindings, and stores it as the most recently used entry
+		void checkin(const String& sql, sqlite3_stmt* stmt);
+
+		/// Finalizes all cached statements. This must be called before closing the connection.
+		void clear();
+
+		Stats stats() const;
+		void resetStats();
+
+	private:
+		struct Entry {
+			String sql;
+			sqlite3_stmt* stmt;
+		};
+		using EntryList = std::list<Entry>;
+
+		void evictIfNeeded();
+
+		Options options;
+		EntryList entries;
+		std::map<String,EntryList::iterator> entryMap;
+		Stats counters;
+	};
+}
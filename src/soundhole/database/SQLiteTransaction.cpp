@@ -7,6 +7,9 @@
 //
 
 #include "SQLiteTransaction.hpp"
+#include "SQLiteStatementCache.hpp"
+#include "SQLiteQueryMonitor.hpp"
+#include <chrono>
 #include <thread>
 #include <sqlite3.h>
 
@@ -24,12 +27,40 @@ namespace sh {
 		return db;
 	}
 
+	void SQLiteTransaction::setStatementCache(SQLiteStatementCache* statementCache) {
+		options.statementCache = statementCache;
+	}
+
+	void SQLiteTransaction::setQueryMonitor(SQLiteQueryMonitor* queryMonitor) {
+		options.queryMonitor = queryMonitor;
+	}
+
+	void SQLiteTransaction::setUseSQLTransaction(bool useSQLTransaction) {
+		options.useSQLTransaction = useSQLTransaction;
+	}
+
+	size_t SQLiteTransaction::statementCount() const {
+		return blocks.size();
+	}
+
 	void SQLiteTransaction::addSQL(String sql, LinkedList<Any> params, AddSQLOptions options) {
 		blocks.pushBack({
 			.sql=sql,
 			.params=params,
 			.outKey=options.outKey,
-			.mapper=options.mapper
+			.mapper=options.mapper,
+			.rowHandler=options.rowHandler
+		});
+	}
+
+	void SQLiteTransaction::addBatchSQL(String sql, LinkedList<LinkedList<Any>> paramsList) {
+		if(paramsList.size() == 0) {
+			return;
+		}
+		blocks.pushBack({
+			.sql=sql,
+			.batchParams=paramsList,
+			.batch=true
 		});
 	}
 
@@ -43,8 +74,13 @@ namespace sh {
 		std::map<String,LinkedList<Json>> results;
 		try {
 			for(auto& block : blocks) {
+				if(block.batch) {
+					executeBatchSQL(block.sql, block.batchParams);
+					continue;
+				}
 				auto blockResults = executeSQL(block.sql, block.params, {
 					.mapper=block.mapper,
+					.rowHandler=block.rowHandler,
 					.returnResults=(!block.outKey.empty())
 				});
 				if(!block.outKey.empty()) {
@@ -73,120 +109,103 @@ namespace sh {
 		LinkedList<Json> rows;
 		sql = sql.trim();
 		const char* nextSQL = sql.c_str();
-		while(nextSQL != nullptr && nextSQL != (sql.c_str()+sql.length())) {
-			// prepare statement
+		const char* endSQL = sql.c_str()+sql.length();
+		auto cache = this->options.statementCache;
+		auto monitor = this->options.queryMonitor;
+		if(monitor != nullptr && !monitor->isEnabled()) {
+			monitor = nullptr;
+		}
+		while(nextSQL != nullptr && nextSQL != endSQL) {
+			auto startTime = std::chrono::steady_clock::now();
+			size_t rowCount = 0;
+			size_t bytesBound = 0;
+			// prepare statement, or take it from the cache if possible
 			sqlite3_stmt* stmt = nullptr;
+			bool cacheStmt = false;
+			int retVal = SQLITE_OK;
 			const char* currentSQL = nextSQL;
-			int retVal = sqlite3_prepare_v2(db, currentSQL, (int)sql.length(), &stmt, &nextSQL);
-			if(retVal != SQLITE_OK) {
-				String errorMsg = sqlite3_errmsg(db);
+			if(cache != nullptr && currentSQL == sql.c_str()) {
+				stmt = cache->checkout(sql);
 				if(stmt != nullptr) {
-					sqlite3_finalize(stmt);
+					nextSQL = endSQL;
+					cacheStmt = true;
 				}
-				throw std::runtime_error("Failed to prepare SQL statement: "+errorMsg);
 			}
+			if(stmt == nullptr) {
+				retVal = sqlite3_prepare_v2(db, currentSQL, (int)(endSQL - currentSQL), &stmt, &nextSQL);
+				if(retVal != SQLITE_OK) {
+					String errorMsg = sqlite3_errmsg(db);
+					if(stmt != nullptr) {
+						sqlite3_finalize(stmt);
+					}
+					throw std::runtime_error("Failed to prepare SQL statement: "+errorMsg);
+				}
+				if(stmt == nullptr) {
+					// statement was only whitespace or a comment
+					continue;
+				}
+				// only cache SQL that consists of a single statement
+				cacheStmt = (cache != nullptr && currentSQL == sql.c_str() && nextSQL == endSQL && cache->isCacheable(sql));
+			}
+			auto releaseStmt = [&]() {
+				if(monitor != nullptr) {
+					monitor->recordStatement({
+						.sql = (cacheStmt ? sql : String(sqlite3_sql(stmt))),
+						.duration = std::chrono::duration_cast<SQLiteQueryMonitor::Duration>(std::chrono::steady_clock::now() - startTime),
+						.rowsReturned = rowCount,
+						.bytesBound = bytesBound,
+						.executions = 1
+					});
+				}
+				if(cacheStmt) {
+					cache->checkin(sql, stmt);
+				} else {
+					sqlite3_finalize(stmt);
+				}
+				stmt = nullptr;
+			};
 			// bind parameters
 			size_t stmtParamsCount = sqlite3_bind_parameter_count(stmt);
 			if(params.size() < stmtParamsCount) {
-				sqlite3_finalize(stmt);
+				releaseStmt();
 				throw std::runtime_error((String)"Not enough parameters ("+params.size()+") for statement with "+stmtParamsCount+" parameters");
 			}
 			auto stmtParams = params.extractListFront(stmtParamsCount);
-			size_t i=1;
-			for(auto& param : stmtParams) {
-				retVal = SQLITE_OK;
-				if(param.empty()) {
-					retVal = sqlite3_bind_null(stmt, (int)i);
-				}
-				else if(param.is<String>()) {
-					auto& str = param.as<String>();
-					retVal = sqlite3_bind_text(stmt, (int)i, str.c_str(), (int)str.length(), NULL);
-				}
-				else if(param.is<std::string>()) {
-					auto& str = param.as<std::string>();
-					retVal = sqlite3_bind_text(stmt, (int)i, str.c_str(), (int)str.length(), NULL);
-				}
-				else if(param.is<int>()) {
-					retVal = sqlite3_bind_int(stmt, (int)i, param.as<int>());
-				}
-				else if(param.is<size_t>()) {
-					retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<size_t>());
-				}
-				else if(param.is<double>()) {
-					retVal = sqlite3_bind_double(stmt, (int)i, param.as<double>());
-				}
-				else if(param.is<float>()) {
-					retVal = sqlite3_bind_double(stmt, (int)i, (double)param.as<float>());
-				}
-				else if(param.is<long>()) {
-					retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<long>());
-				}
-				else if(param.is<unsigned long>()) {
-					retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<unsigned long>());
-				}
-				else if(param.is<bool>()) {
-					retVal = sqlite3_bind_int(stmt, (int)i, (int)param.as<bool>());
-				}
-				else {
-					sqlite3_finalize(stmt);
-					throw std::runtime_error((String)"Invalid SQL type "+param.typeName()+" at index "+i);
-				}
-				if(retVal != SQLITE_OK) {
-					String errorMsg = sqlite3_errmsg(db);
-					sqlite3_finalize(stmt);
-					throw std::runtime_error((String)"Failed to bind SQL parameter \""+param.toString()+"\" at index "+i+": "+errorMsg);
-				}
-				i++;
+			try {
+				bytesBound = bindParams(stmt, stmtParams);
+			} catch(...) {
+				releaseStmt();
+				throw;
 			}
 			// execute statement
 			while(true) {
 				retVal = sqlite3_step(stmt);
 				if(retVal == SQLITE_ROW) {
-					if(options.returnResults) {
-						Json::object row;
-						int colCount = sqlite3_column_count(stmt);
-						for(int i=0; i<colCount; i++) {
-							String columnName = sqlite3_column_name(stmt, i);
-							auto sqlType = sqlite3_column_type(stmt, i);
-							switch(sqlType) {
-								case SQLITE_NULL: {
-									row[columnName] = Json();
-								} break;
-								case SQLITE_INTEGER: {
-									sqlite_int64 intVal = sqlite3_column_int64(stmt, i);
-									if(intVal >= std::numeric_limits<int>::max() || intVal <= std::numeric_limits<int>::min()) {
-										row[columnName] = (double)intVal;
-									} else {
-										row[columnName] = (int)intVal;
-									}
-								} break;
-								case SQLITE_FLOAT: {
-									row[columnName] = sqlite3_column_double(stmt, i);
-								} break;
-								case SQLITE_TEXT: {
-									auto text = (const char*)sqlite3_column_text(stmt, i);
-									row[columnName] = (text != nullptr) ? Json(text) : Json();
-								} break;
-								case SQLITE_BLOB: {
-									auto blob = sqlite3_column_blob(stmt, i);
-									auto bytes = sqlite3_column_bytes(stmt, i);
-									row[columnName] = Json(std::string((const char*)blob, (size_t)bytes));
-								} break;
-								default: {
-									sqlite3_finalize(stmt);
-									throw std::runtime_error((String)"Invalid sql type "+sqlType+" for column \""+columnName+"\"");
-								} break;
-							}
+					rowCount++;
+					if(options.rowHandler) {
+						try {
+							options.rowHandler(SQLiteRow(stmt));
+						} catch(...) {
+							releaseStmt();
+							throw;
 						}
-						if(options.mapper) {
-							rows.pushBack(options.mapper(row));
-						} else {
-							rows.pushBack(row);
+					}
+					else if(options.returnResults) {
+						Json row;
+						try {
+							row = SQLiteRow(stmt).toJson();
+							if(options.mapper) {
+								row = options.mapper(row);
+							}
+						} catch(...) {
+							releaseStmt();
+							throw;
 						}
+						rows.pushBack(row);
 					}
 				}
 				else if(retVal == SQLITE_DONE) {
-					sqlite3_finalize(stmt);
+					releaseStmt();
 					break;
 				}
 				else if(retVal == SQLITE_BUSY && options.waitIfBusy) {
@@ -194,11 +213,151 @@ namespace sh {
 					continue;
 				}
 				else {
-					sqlite3_finalize(stmt);
+					releaseStmt();
 					throw std::runtime_error((String)"Failed to step SQL statement: "+sqlite3_errstr(retVal));
 				}
 			}
 		}
 		return rows;
 	}
+
+	void SQLiteTransaction::executeBatchSQL(String sql, const LinkedList<LinkedList<Any>>& paramsList) {
+		if(paramsList.size() == 0) {
+			return;
+		}
+		sql = sql.trim();
+		auto cache = this->options.statementCache;
+		auto monitor = this->options.queryMonitor;
+		if(monitor != nullptr && !monitor->isEnabled()) {
+			monitor = nullptr;
+		}
+		auto startTime = std::chrono::steady_clock::now();
+		size_t executions = 0;
+		size_t bytesBound = 0;
+		// prepare the statement once, or take it from the cache if possible
+		sqlite3_stmt* stmt = nullptr;
+		bool cacheStmt = false;
+		if(cache != nullptr) {
+			stmt = cache->checkout(sql);
+			cacheStmt = (stmt != nullptr);
+		}
+		if(stmt == nullptr) {
+			const char* tail = nullptr;
+			int retVal = sqlite3_prepare_v2(db, sql.c_str(), (int)sql.length(), &stmt, &tail);
+			if(retVal != SQLITE_OK) {
+				String errorMsg = sqlite3_errmsg(db);
+				if(stmt != nullptr) {
+					sqlite3_finalize(stmt);
+				}
+				throw std::runtime_error("Failed to prepare SQL statement: "+errorMsg);
+			}
+			if(stmt == nullptr) {
+				return;
+			}
+			if(tail != nullptr && *tail != '\0') {
+				sqlite3_finalize(stmt);
+				throw std::runtime_error("Batch SQL must consist of a single statement");
+			}
+			cacheStmt = (cache != nullptr && cache->isCacheable(sql));
+		}
+		auto releaseStmt = [&]() {
+			if(monitor != nullptr) {
+				monitor->recordStatement({
+					.sql = sql,
+					.duration = std::chrono::duration_cast<SQLiteQueryMonitor::Duration>(std::chrono::steady_clock::now() - startTime),
+					.rowsReturned = 0,
+					.bytesBound = bytesBound,
+					.executions = executions
+				});
+			}
+			if(cacheStmt) {
+				cache->checkin(sql, stmt);
+			} else {
+				sqlite3_finalize(stmt);
+			}
+			stmt = nullptr;
+		};
+		// bind and step the statement for each set of parameters
+		size_t stmtParamsCount = sqlite3_bind_parameter_count(stmt);
+		for(auto& params : paramsList) {
+			if(params.size() != stmtParamsCount) {
+				releaseStmt();
+				throw std::runtime_error((String)"Wrong number of parameters ("+params.size()+") for batch statement with "+stmtParamsCount+" parameters");
+			}
+			try {
+				bytesBound += bindParams(stmt, params);
+			} catch(...) {
+				releaseStmt();
+				throw;
+			}
+			int retVal = sqlite3_step(stmt);
+			while(retVal == SQLITE_ROW) {
+				retVal = sqlite3_step(stmt);
+			}
+			if(retVal != SQLITE_DONE) {
+				String errorMsg = sqlite3_errmsg(db);
+				releaseStmt();
+				throw std::runtime_error("Failed to step SQL statement: "+errorMsg);
+			}
+			sqlite3_reset(stmt);
+			sqlite3_clear_bindings(stmt);
+			executions++;
+		}
+		releaseStmt();
+	}
+
+	size_t SQLiteTransaction::bindParams(sqlite3_stmt* stmt, const LinkedList<Any>& params) {
+		size_t i=1;
+		size_t bytesBound = 0;
+		for(auto& param : params) {
+			int retVal = SQLITE_OK;
+			if(param.empty()) {
+				retVal = sqlite3_bind_null(stmt, (int)i);
+			}
+			else if(param.is<String>()) {
+				auto& str = param.as<String>();
+				retVal = sqlite3_bind_text(stmt, (int)i, str.c_str(), (int)str.length(), NULL);
+				bytesBound += str.length();
+			}
+			else if(param.is<std::string>()) {
+				auto& str = param.as<std::string>();
+				retVal = sqlite3_bind_text(stmt, (int)i, str.c_str(), (int)str.length(), NULL);
+				bytesBound += str.length();
+			}
+			else if(param.is<int>()) {
+				retVal = sqlite3_bind_int(stmt, (int)i, param.as<int>());
+			}
+			else if(param.is<size_t>()) {
+				retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<size_t>());
+			}
+			else if(param.is<double>()) {
+				retVal = sqlite3_bind_double(stmt, (int)i, param.as<double>());
+			}
+			else if(param.is<float>()) {
+				retVal = sqlite3_bind_double(stmt, (int)i, (double)param.as<float>());
+			}
+			else if(param.is<long>()) {
+				retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<long>());
+			}
+			else if(param.is<unsigned long>()) {
+				retVal = sqlite3_bind_int64(stmt, (int)i, (sqlite3_int64)param.as<unsigned long>());
+			}
+			else if(param.is<bool>()) {
+				retVal = sqlite3_bind_int(stmt, (int)i, (int)param.as<bool>());
+			}
+			else {
+				throw std::runtime_error((String)"Invalid SQL type "+param.typeName()+" at index "+i);
+			}
+			if(retVal != SQLITE_OK) {
+				String errorMsg = sqlite3_errmsg(db);
+				throw std::runtime_error((String)"Failed to bind SQL parameter \""+param.toString()+"\" at index "+i+": "+errorMsg);
+			}
+			if(!param.empty() && !param.is<String>() && !param.is<std::string>()) {
+				// numbers are counted at their stored width
+				bytesBound += 8;
+			}
+			i++;
+		}
+		return bytesBound;
+	}
 }
@@ -9,40 +9,76 @@
 #pragma once
 
 #include <soundhole/common.hpp>
+#include "SQLiteRow.hpp"
 
 struct sqlite3;
+struct sqlite3_stmt;
 
 namespace sh {
+	class SQLiteStatementCache;
+	class SQLiteQueryMonitor;
+
 	class SQLiteTransaction {
 	public:
 		struct Options {
 			bool useSQLTransaction = true;
+			/// single-statement SQL is prepared through this cache when given. It must belong to the same connection as the db
+			SQLiteStatementCache* statementCache = nullptr;
+			/// when given, the timing and size of each executed statement is recorded to it
+			SQLiteQueryMonitor* queryMonitor = nullptr;
 		};
-		SQLiteTransaction(sqlite3* db, Options options = Options{.useSQLTransaction=true});
+		SQLiteTransaction(sqlite3* db, Options options = Options{.useSQLTransaction=true,.statementCache=nullptr,.queryMonitor=nullptr});
 		
 		void setDB(sqlite3* db);
 		sqlite3* getDB();
 		
+		void setStatementCache(SQLiteStatementCache* statementCache);
+		void setQueryMonitor(SQLiteQueryMonitor* queryMonitor);
+		void setUseSQLTransaction(bool useSQLTransaction);
+		
+		/// the number of SQL blocks added to the transaction
+		size_t statementCount() const;
+		
 		struct AddSQLOptions {
 			String outKey;
 			Function<Json(Json)> mapper;
+			/// when given, each row is passed to the handler directly instead of being decoded into json
+			Function<void(const SQLiteRow&)> rowHandler;
 		};
 		void addSQL(String sql, LinkedList<Any> params, AddSQLOptions options = AddSQLOptions());
+		/// Decodes each result row by column index using the given decoder, and appends it to the output list
+		template<typename T, typename Decoder>
+		void addSQL(String sql, LinkedList<Any> params, $<LinkedList<T>> output, Decoder decoder) {
+			addSQL(sql, params, {
+				.rowHandler = [=](const SQLiteRow& row) {
+					output->pushBack(decoder(row));
+				}
+			});
+		}
+		/// Executes a single-statement SQL once for each set of params, reusing the same prepared statement
+		void addBatchSQL(String sql, LinkedList<LinkedList<Any>> paramsList);
 		std::map<String,LinkedList<Json>> execute();
 		
 	private:
 		struct ExecuteSQLOptions {
 			Function<Json(Json)> mapper;
+			Function<void(const SQLiteRow&)> rowHandler;
 			bool waitIfBusy = false;
 			bool returnResults = true;
 		};
 		LinkedList<Json> executeSQL(String sql, LinkedList<Any> params, ExecuteSQLOptions options = ExecuteSQLOptions{.waitIfBusy=false,.returnResults=true});
+		void executeBatchSQL(String sql, const LinkedList<LinkedList<Any>>& paramsList);
+		/// Binds the params to the statement, and returns the number of bytes bound
+		size_t bindParams(sqlite3_stmt* stmt, const LinkedList<Any>& params);
 		
 		struct Block {
 			String sql;
 			LinkedList<Any> params;
 			String outKey;
 			Function<Json(Json)> mapper;
+			Function<void(const SQLiteRow&)> rowHandler;
+			LinkedList<LinkedList<Any>> batchParams;
+			bool batch = false;
 		};
 		
 		sqlite3* db;
@@ -10,11 +10,18 @@
 #include "MediaLibraryProxyProvider.hpp"
 #include <soundhole/providers/soundhole/SoundHoleMediaProvider.hpp>
 #include <soundhole/utils/Utils.hpp>
+#include <soundhole/utils/FanOut.hpp>
 #include <soundhole/utils/js/JSError.hpp>
+#include <algorithm>
 
 namespace sh {
 	MediaLibrary::MediaLibrary(Options options)
-	: libraryProxyProvider(nullptr), db(nullptr), mediaProviderStash(options.mediaProviderStash) {
+	: db(nullptr),
+	mediaProviderStash(options.mediaProviderStash),
+	scrobblerStash(options.scrobblerStash),
+	syncConcurrency(std::max(options.syncConcurrency, (size_t)1)),
+	deltaCollectionSync(options.deltaCollectionSync),
+	libraryProxyProvider(nullptr) {
 		libraryProxyProvider = new MediaLibraryProxyProvider(this);
 		db = new MediaDatabase({
 			.path = options.dbPath,
@@ -138,6 +145,7 @@ namespace sh {
 			co_yield {};
 			// sync provider library
 			auto libraryGenerator = libraryProvider->generateLibrary({.resumeData=syncResumeData});
+			Optional<Promise<MediaProvider::LibraryItemGenerator::YieldResult>> nextLibraryPage;
 			while(true) {
 				// get library items from provider until success
 				task->setStatusText("Synchronizing "+libraryProvider->displayName()+" library");
@@ -145,7 +153,13 @@ namespace sh {
 				bool failed = false;
 				Optional<double> retryAfter;
 				try {
-					yieldResult = co_await libraryGenerator.next();
+					if(nextLibraryPage) {
+						auto libraryPage = std::move(nextLibraryPage.value());
+						nextLibraryPage = std::nullopt;
+						yieldResult = co_await libraryPage;
+					} else {
+						yieldResult = co_await libraryGenerator.next();
+					}
 				} catch(Error& error) {
 					task->setStatusText("Error: "+error.toString());
 					failed = true;
@@ -162,89 +176,96 @@ namespace sh {
 					co_yield {};
 					continue;
 				}
+				// fetch the next page while this one is being written
+				if(!yieldResult.done) {
+					nextLibraryPage = libraryGenerator.next();
+				}
 				// handle yield result
 				if(yieldResult.value) {
-					// cache library items
+					auto& libraryItems = yieldResult.value->items;
 					double prevProgress = task->getStatus().progress;
 					double progressDiff = yieldResult.value->progress - prevProgress;
-					double itemProgressDiff = progressDiff / (double)yieldResult.value->items.size();
-					size_t libraryItemIndex = 0;
-					for(auto libraryItem : yieldResult.value->items) {
-						// get index and start progress
-						size_t index = libraryItemIndex;
-						double itemProgressStart = prevProgress + (itemProgressDiff * (double)index);
-						// fetch missing data if needed
+					double itemProgressDiff = libraryItems.empty() ? 0.0 : (progressDiff / (double)libraryItems.size());
+					auto itemsProgress = fgl::new$<ArrayList<double>>(libraryItems.size(), 0.0);
+					auto setItemProgress = [=](size_t index, double progress) {
+						(*itemsProgress)[index] = progress;
+						double totalProgress = 0;
+						for(double itemProgress : *itemsProgress) {
+							totalProgress += itemProgress;
+						}
+						task->setStatusProgress(prevProgress + (totalProgress * itemProgressDiff));
+					};
+					// fetch missing data
+					ArrayList<$<MediaItem>> fetchItems;
+					for(auto& libraryItem : libraryItems) {
 						if(libraryItem.mediaItem->needsData()) {
-							task->setStatusText("Fetching "+libraryProvider->displayName()+" "+libraryItem.mediaItem->type()+" "+libraryItem.mediaItem->name());
-							task->setStatusProgress(itemProgressStart);
-							co_await libraryItem.mediaItem->fetchDataIfNeeded();
-							task->setStatusText("Synchronizing "+libraryProvider->displayName()+" library");
+							fetchItems.pushBack(libraryItem.mediaItem);
 						}
-						// increment index
-						libraryItemIndex += 1;
-						// fetch tracks if item is a collection
+					}
+					if(!fetchItems.empty()) {
+						task->setStatusText((String)"Fetching "+fetchItems.size()+" "+libraryProvider->displayName()+" library items");
+						co_await utils::FanOut<$<MediaItem>,$<MediaItem>>::all(fetchItems, {.maxConcurrent=syncConcurrency}, [=](auto& mediaItem) {
+							return mediaItem->fetchDataIfNeeded().map([=]() {
+								return mediaItem;
+							});
+						});
+						task->setStatusText("Synchronizing "+libraryProvider->displayName()+" library");
+						co_yield {};
+					}
+					// find the collections whose version ID has changed
+					ArrayList<$<TrackCollection>> collections;
+					ArrayList<size_t> collectionItemIndexes;
+					for(auto [index, libraryItem] : enumerate(libraryItems)) {
 						if(auto collection = std::dynamic_pointer_cast<TrackCollection>(libraryItem.mediaItem)) {
-							// check if version ID has changed
-							auto existingVersionId = (co_await db->getTrackCollectionJson(collection->uri()).exceptReturn(Json()))["versionId"];
+							collections.pushBack(collection);
+							collectionItemIndexes.pushBack(index);
+						} else {
+							setItemProgress(index, 1.0);
+						}
+					}
+					ArrayList<$<TrackCollection>> changedCollections;
+					ArrayList<size_t> changedItemIndexes;
+					if(!collections.empty()) {
+						auto existingCollectionsList = co_await db->getTrackCollectionsJson(collections.map([](auto& collection) -> String {
+							return collection->uri();
+						})).exceptReturn(LinkedList<Json>());
+						auto existingCollections = ArrayList<Json>(existingCollectionsList.begin(), existingCollectionsList.end());
+						for(size_t i=0; i<collections.size(); i++) {
+							auto& collection = collections[i];
+							auto existingVersionId = (i < existingCollections.size()) ? existingCollections[i]["versionId"] : Json();
 							if(existingVersionId.is_string() && collection->versionId() == existingVersionId.string_value()) {
+								setItemProgress(collectionItemIndexes[i], 1.0);
 								continue;
 							}
-							co_await db->cacheTrackCollections({ collection });
-							// cache collection items
-							size_t itemsOffset = 0;
-							task->setStatusText("Synchronizing "+libraryProvider->displayName()+" "+collection->type()+" "+collection->name());
-							auto collectionItemGenerator = collection->generateItems();
-							while(true) {
-								TrackCollection::ItemGenerator::YieldResult itemsYieldResult;
-								failed = false;
-								retryAfter = std::nullopt;
-								try {
-									itemsYieldResult = co_await collectionItemGenerator.next();
-								} catch(Error& error) {
-									task->setStatusText("Error: "+error.toString());
-									failed = true;
-									retryAfter = error.getDetail("retryAfter").maybeAs<double>();
-								} catch(std::exception& error) {
-									task->setStatusText((String)"Error: "+error.what());
-									failed = true;
-								}
-								// handle error
-								if(failed) {
-									co_yield {};
-									// TODO split up await time so it yields multiple times
-									co_await resumeAfter(std::chrono::milliseconds((long)(retryAfter.valueOr(2.0) * 1000)));
-									co_yield {};
-									continue;
-								}
-								// handle yield result
-								if(itemsYieldResult.value) {
-									size_t nextOffset = itemsOffset + itemsYieldResult.value->size();
-									co_await db->cacheTrackCollectionItems(collection, sql::IndexRange{
-										.startIndex = itemsOffset,
-										.endIndex = nextOffset
-									});
-									itemsOffset += itemsYieldResult.value->size();
-									if(collection->itemCount()) {
-										task->setStatusProgress(itemProgressStart + (((double)nextOffset / (double)collection->itemCount().value()) * itemProgressDiff));
-									}
-									// TODO reset items to save memory
-								}
-								if(itemsYieldResult.done) {
-									break;
-								}
-								co_yield {};
-								std::this_thread::sleep_for(std::chrono::milliseconds(200));
-								co_yield {};
+							changedCollections.pushBack(collection);
+							changedItemIndexes.pushBack(collectionItemIndexes[i]);
+						}
+					}
+					// sync the changed collections concurrently
+					if(!changedCollections.empty()) {
+						co_await db->cacheTrackCollections(changedCollections);
+						co_yield {};
+						ArrayList<size_t> changedIndexes;
+						changedIndexes.reserve(changedCollections.size());
+						for(size_t i=0; i<changedCollections.size(); i++) {
+							changedIndexes.pushBack(i);
+						}
+						auto collectionsFinished = co_await utils::FanOut<size_t,bool>::all(changedIndexes, {.maxConcurrent=syncConcurrency}, [=](auto& i) {
+							size_t itemIndex = changedItemIndexes[i];
+							return synchronizeLibraryCollection(task, libraryProvider, changedCollections[i], [=](double progress) {
+								setItemProgress(itemIndex, progress);
+							});
+						});
+						co_yield {};
+						// only mark the collections that were fully synced as up to date
+						ArrayList<$<TrackCollection>> syncedCollections;
+						for(size_t i=0; i<changedCollections.size(); i++) {
+							if(collectionsFinished[i]) {
+								syncedCollections.pushBack(changedCollections[i]);
 							}
-							// update versionId
-							co_await db->updateTrackCollectionVersionId(collection);
-							// sync library item
-							co_await db->cacheLibraryItems({ libraryItem });
-						} else {
-							task->setStatusProgress(itemProgressStart + itemProgressDiff);
 						}
+						co_await db->updateTrackCollectionVersionIds(syncedCollections);
 						task->setStatusText("Synchronizing "+libraryProvider->displayName()+" library");
-						co_yield {};
 					}
 					
 					// sync library items to database
@@ -253,15 +274,13 @@ namespace sh {
 							{ syncResumeDBKey, yieldResult.value->resumeData.dump() }
 						}
 					};
-					co_await db->cacheLibraryItems(yieldResult.value->items, cacheOptions);
+					co_await db->cacheLibraryItems(libraryItems, cacheOptions);
 					task->setStatusProgress(yieldResult.value->progress);
 				}
 				if(yieldResult.done) {
 					break;
 				}
 				co_yield {};
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				co_yield {};
 			}
 			
 			task->setStatus({
@@ -271,6 +290,71 @@ namespace sh {
 		}));
 	}
 
+	Promise<bool> MediaLibrary::synchronizeLibraryCollection($<AsyncQueue::Task> task, MediaProvider* libraryProvider, $<TrackCollection> collection, Function<void(double)> onProgress) {
+		co_await resumeOnQueue(DispatchQueue::main());
+		task->setStatusText("Synchronizing "+libraryProvider->displayName()+" "+collection->type()+" "+collection->name());
+		// load the fingerprints of the stored items, so that unchanged items aren't rewritten
+		$<MediaDatabase::TrackCollectionItemsSyncState> itemsSyncState;
+		if(deltaCollectionSync) {
+			itemsSyncState = co_await db->getTrackCollectionItemsSyncState(collection->uri());
+			co_await resumeOnQueue(DispatchQueue::main());
+		}
+		// cache collection items
+		size_t itemsOffset = 0;
+		auto collectionItemGenerator = collection->generateItems();
+		while(true) {
+			if(task->isCancelled()) {
+				co_return false;
+			}
+			TrackCollection::ItemGenerator::YieldResult itemsYieldResult;
+			bool failed = false;
+			String errorMessage;
+			Optional<double> retryAfter;
+			try {
+				itemsYieldResult = co_await collectionItemGenerator.next();
+			} catch(Error& error) {
+				failed = true;
+				errorMessage = error.toString();
+				retryAfter = error.getDetail("retryAfter").maybeAs<double>();
+			} catch(std::exception& error) {
+				failed = true;
+				errorMessage = error.what();
+			}
+			co_await resumeOnQueue(DispatchQueue::main());
+			// handle error
+			if(failed) {
+				task->setStatusText("Error: "+errorMessage);
+				co_await resumeAfter(std::chrono::milliseconds((long)(retryAfter.valueOr(2.0) * 1000)));
+				co_await resumeOnQueue(DispatchQueue::main());
+				continue;
+			}
+			// handle yield result
+			if(itemsYieldResult.value) {
+				size_t nextOffset = itemsOffset + itemsYieldResult.value->size();
+				auto itemsRange = sql::IndexRange{
+					.startIndex = itemsOffset,
+					.endIndex = nextOffset
+				};
+				if(itemsSyncState) {
+					co_await db->cacheTrackCollectionItemsDelta(collection, itemsRange, itemsSyncState);
+				} else {
+					co_await db->cacheTrackCollectionItems(collection, itemsRange);
+				}
+				co_await resumeOnQueue(DispatchQueue::main());
+				itemsOffset = nextOffset;
+				if(collection->itemCount() && collection->itemCount().value() > 0) {
+					onProgress(std::min((double)nextOffset / (double)collection->itemCount().value(), 1.0));
+				}
+				// TODO reset items to save memory
+			}
+			if(itemsYieldResult.done) {
+				break;
+			}
+		}
+		onProgress(1.0);
+		co_return true;
+	}
+
 	AsyncQueue::TaskNode MediaLibrary::synchronizeAllLibraries() {
 		auto runOptions = AsyncQueue::RunOptions{
 			.tag="sync:all",
@@ -390,7 +474,7 @@ namespace sh {
 			.libraryProvider = (filters.libraryProvider != nullptr) ? filters.libraryProvider->name() : String(),
 			.orderBy=filters.orderBy,
 			.order=filters.order
-		}).map(nullptr, [=](MediaDatabase::GetJsonItemsListResult results) -> LinkedList<$<Album>> {
+		}).map([=](MediaDatabase::GetJsonItemsListResult results) -> LinkedList<$<Album>> {
 			return results.items.map([=](Json json) -> $<Album> {
 				auto mediaItemJson = json["mediaItem"];
 				auto providerName = mediaItemJson["provider"];
@@ -407,10 +491,18 @@ namespace sh {
 	}
 
 	MediaLibrary::LibraryAlbumsGenerator MediaLibrary::generateLibraryAlbums(GenerateLibraryAlbumsOptions options) {
-		auto offset = fgl::new$<size_t>(options.offset);
+		struct SharedData {
+			size_t offset;
+			Optional<sql::LibraryItemCursor> cursor;
+		};
+		auto sharedData = fgl::new$<SharedData>(SharedData{
+			.offset = options.offset,
+			.cursor = std::nullopt
+		});
 		using YieldResult = typename LibraryAlbumsGenerator::YieldResult;
 		return LibraryAlbumsGenerator([=]() {
-			size_t startIndex = *offset;
+			// after the first chunk, seek past the last item instead of using an offset
+			size_t startIndex = sharedData->cursor ? 0 : sharedData->offset;
 			size_t endIndex = (size_t)-1;
 			if(options.chunkSize != (size_t)-1) {
 				endIndex = startIndex + options.chunkSize;
@@ -422,8 +514,9 @@ namespace sh {
 					.endIndex = endIndex
 				},
 				.orderBy = options.filters.orderBy,
-				.order = options.filters.order
-			}).map(nullptr, [=](MediaDatabase::GetJsonItemsListResult results) -> YieldResult {
+				.order = options.filters.order,
+				.after = sharedData->cursor
+			}).map([=](MediaDatabase::GetJsonItemsListResult results) -> YieldResult {
 				auto albums = results.items.map([=](Json json) -> $<Album> {
 					auto mediaItemJson = json["mediaItem"];
 					auto providerName = mediaItemJson["provider"];
@@ -436,9 +529,12 @@ namespace sh {
 					}
 					return provider->album(Album::Data::fromJson(mediaItemJson, this->mediaProviderStash));
 				});
-				size_t albumsOffset = *offset;
-				*offset += options.chunkSize;
-				bool done = (*offset >= results.total);
+				size_t albumsOffset = sharedData->offset;
+				sharedData->offset += results.items.size();
+				if(results.items.size() > 0) {
+					sharedData->cursor = MediaDatabase::savedItemCursor(results.items.back(), options.filters.orderBy);
+				}
+				bool done = (options.chunkSize == (size_t)-1 || results.items.size() < options.chunkSize || sharedData->offset >= results.total);
 				return YieldResult{
 					.value = GenerateLibraryAlbumsResult{
 						.albums = albums,
@@ -460,7 +556,7 @@ namespace sh {
 			.libraryProvider = (filters.libraryProvider != nullptr) ? filters.libraryProvider->name() : String(),
 			.orderBy=filters.orderBy,
 			.order=filters.order
-		}).map(nullptr, [=](MediaDatabase::GetJsonItemsListResult results) -> LinkedList<$<Playlist>> {
+		}).map([=](MediaDatabase::GetJsonItemsListResult results) -> LinkedList<$<Playlist>> {
 			return results.items.map([=](Json json) -> $<Playlist> {
 				auto mediaItemJson = json["mediaItem"];
 				auto providerName = mediaItemJson["provider"];
@@ -477,10 +573,18 @@ namespace sh {
 	}
 
 	MediaLibrary::LibraryPlaylistsGenerator MediaLibrary::generateLibraryPlaylists(GenerateLibraryPlaylistsOptions options) {
-		auto offset = fgl::new$<size_t>(options.offset);
+		struct SharedData {
+			size_t offset;
+			Optional<sql::LibraryItemCursor> cursor;
+		};
+		auto sharedData = fgl::new$<SharedData>(SharedData{
+			.offset = options.offset,
+			.cursor = std::nullopt
+		});
 		using YieldResult = typename LibraryPlaylistsGenerator::YieldResult;
 		return LibraryPlaylistsGenerator([=]() {
-			size_t startIndex = *offset;
+			// after the first chunk, seek past the last item instead of using an offset
+			size_t startIndex = sharedData->cursor ? 0 : sharedData->offset;
 			size_t endIndex = (size_t)-1;
 			if(options.chunkSize != (size_t)-1) {
 				endIndex = startIndex + options.chunkSize;
@@ -492,8 +596,9 @@ namespace sh {
 					.endIndex = endIndex
 				},
 				.orderBy = options.filters.orderBy,
-				.order = options.filters.order
-			}).map(nullptr, [=](MediaDatabase::GetJsonItemsListResult results) -> YieldResult {
+				.order = options.filters.order,
+				.after = sharedData->cursor
+			}).map([=](MediaDatabase::GetJsonItemsListResult results) -> YieldResult {
 				auto playlists = results.items.map([=](Json json) -> $<Playlist> {
 					auto mediaItemJson = json["mediaItem"];
 					auto providerName = mediaItemJson["provider"];
@@ -506,9 +611,12 @@ namespace sh {
 					}
 					return provider->playlist(Playlist::Data::fromJson(mediaItemJson, this->mediaProviderStash));
 				});
-				size_t playlistsOffset = *offset;
-				*offset += options.chunkSize;
-				bool done = (*offset >= results.total);
+				size_t playlistsOffset = sharedData->offset;
+				sharedData->offset += results.items.size();
+				if(results.items.size() > 0) {
+					sharedData->cursor = MediaDatabase::savedItemCursor(results.items.back(), options.filters.orderBy);
+				}
+				bool done = (options.chunkSize == (size_t)-1 || results.items.size() < options.chunkSize || sharedData->offset >= results.total);
 				return YieldResult{
 					.value = GenerateLibraryPlaylistsResult{
 						.playlists = playlists,
@@ -526,7 +634,7 @@ namespace sh {
 	#pragma mark Playback History
 
 	Promise<MediaLibrary::GetPlaybackHistoryItemsResult> MediaLibrary::getPlaybackHistoryItems(GetPlaybackHistoryItemsOptions options) {
-		return db->getPlaybackHistoryItemsJson({
+		return db->getPlaybackHistoryItems({
 			.filters = {
 				.provider = options.filters.provider ? options.filters.provider->name() : String(),
 				.trackURIs = options.filters.trackURIs,
@@ -545,12 +653,12 @@ namespace sh {
 				.startIndex = options.offset,
 				.endIndex = (options.limit == (size_t)-1) ? (size_t)-1 : (options.offset + options.limit)
 			},
-			.order = options.filters.order
+			.order = options.filters.order,
+			.after = options.after,
+			.includeTotal = options.includeTotal
 		}).map(nullptr, [=](auto results) {
 			return GetPlaybackHistoryItemsResult{
-				.items = results.items.map([=](auto& json) {
-					return PlaybackHistoryItem::fromJson(json, mediaProviderStash);
-				}),
+				.items = results.items,
 				.total = results.total
 			};
 		});
@@ -559,42 +667,33 @@ namespace sh {
 	MediaLibrary::PlaybackHistoryItemGenerator MediaLibrary::generatePlaybackHistoryItems(GeneratePlaybackHistoryItemsOptions options) {
 		struct SharedData {
 			size_t offset;
-			Optional<Date> prevDate;
+			Optional<sql::PlaybackHistoryCursor> cursor;
 		};
 		auto sharedData = fgl::new$<SharedData>(SharedData{
 			.offset = options.offset,
-			.prevDate = std::nullopt
+			.cursor = std::nullopt
 		});
 		using YieldResult = typename PlaybackHistoryItemGenerator::YieldResult;
 		return PlaybackHistoryItemGenerator([=]() -> Promise<YieldResult> {
+			// after the first chunk, seek past the last item instead of using an offset
 			auto queryOptions = GetPlaybackHistoryItemsOptions{
-				.offset = sharedData->offset,
+				.offset = sharedData->cursor ? 0 : sharedData->offset,
 				.limit = options.chunkSize,
-				.filters = options.filters
+				.filters = options.filters,
+				.after = sharedData->cursor,
+				.includeTotal = false
 			};
-			// if we're not at the first query, offset by date
-			if(sharedData->prevDate) {
-				if(options.filters.order == sql::Order::DESC) {
-					// update with new max date
-					queryOptions.filters.maxDate = sharedData->prevDate.value();
-					queryOptions.filters.maxDateInclusive = false;
-					queryOptions.offset = 0;
-				}
-				else if(options.filters.order == sql::Order::ASC) {
-					// update with new min date
-					queryOptions.filters.minDate = sharedData->prevDate.value();
-					queryOptions.filters.minDateInclusive = false;
-					queryOptions.offset = 0;
-				}
-			}
-			size_t queryOffset = queryOptions.offset;
 			// get items
 			return this->getPlaybackHistoryItems(queryOptions).map(nullptr, [=](auto result) -> YieldResult {
 				sharedData->offset += result.items.size();
-				bool done = false;
-				if((queryOffset + result.items.size()) >= result.total) {
-					done = true;
+				if(result.items.size() > 0) {
+					auto lastItem = result.items.back();
+					sharedData->cursor = sql::PlaybackHistoryCursor{
+						.startTime = lastItem->startTime(),
+						.trackURI = lastItem->track()->uri()
+					};
 				}
+				bool done = (options.chunkSize == (size_t)-1 || result.items.size() < options.chunkSize);
 				return YieldResult{
 					.value = result.items,
 					.done = done
@@ -609,6 +708,39 @@ namespace sh {
 
 
 
+	#pragma mark Search
+
+	Promise<MediaLibrary::SearchResult> MediaLibrary::search(String query, SearchOptions options) {
+		return db->searchLibraryJson(query, options).map([=](MediaDatabase::SearchLibraryJsonResult results) -> SearchResult {
+			ArrayList<$<MediaItem>> items;
+			items.reserve(results.items.size());
+			for(auto& json : results.items) {
+				items.pushBack(this->mediaProviderStash->parseMediaItem(json["mediaItem"]));
+			}
+			return SearchResult{
+				.items = items,
+				.total = results.total,
+				.next = results.next
+			};
+		});
+	}
+
+
+
+	#pragma mark Garbage Collection
+
+	Promise<Optional<MediaLibrary::CollectGarbageResult>> MediaLibrary::collectGarbage(CollectGarbageOptions options) {
+		if(isSynchronizingLibraries()) {
+			// syncing may temporarily leave items unreferenced, so wait until it finishes
+			return Promise<Optional<CollectGarbageResult>>::resolve(std::nullopt);
+		}
+		return db->collectGarbage(options).map(nullptr, [=](CollectGarbageResult result) -> Optional<CollectGarbageResult> {
+			return result;
+		});
+	}
+
+
+
 	#pragma mark Creating Media
 
 	Promise<$<Playlist>> MediaLibrary::createPlaylist(String name, MediaProvider* provider, CreatePlaylistOptions options) {
@@ -26,6 +26,10 @@ namespace sh {
 			String dbPath;
 			MediaProviderStash* mediaProviderStash;
 			ScrobblerStash* scrobblerStash;
+			/// the maximum number of collections (or missing item data) fetched at once while synchronizing a library
+			size_t syncConcurrency = 4;
+			/// only write the items of a changed collection that differ from the stored items, instead of rewriting every item
+			bool deltaCollectionSync = true;
 		};
 		MediaLibrary(Options);
 		~MediaLibrary();
@@ -125,6 +129,9 @@ namespace sh {
 			size_t offset = 0;
 			size_t limit = 25;
 			PlaybackHistoryFilters filters;
+			/// continue after the last item of a previous page. offset is then relative to the cursor
+			Optional<sql::PlaybackHistoryCursor> after;
+			bool includeTotal = true;
 		};
 		struct GetPlaybackHistoryItemsResult {
 			ArrayList<$<PlaybackHistoryItem>> items;
@@ -145,6 +152,24 @@ namespace sh {
 		Promise<$<PlaybackHistoryTrackCollection>> getPlaybackHistoryCollection(GetPlaybackHistoryCollectionOptions options);
 		
 		
+		using SearchOptions = MediaDatabase::SearchLibraryOptions;
+		struct SearchResult {
+			ArrayList<$<MediaItem>> items;
+			size_t total;
+			/// pass as the "after" option to get the next page
+			sql::SearchCursor next;
+		};
+		/// Searches the locally cached media items, so it works offline
+		Promise<SearchResult> search(String query, SearchOptions options = SearchOptions());
+		
+		
+		using CollectGarbageOptions = MediaDatabase::CollectGarbageOptions;
+		using CollectGarbageResult = MediaDatabase::CollectGarbageResult;
+		/// Deletes one batch of cached media items that are no longer referenced by the library.
+		/// Resolves with an empty value without collecting if a library sync is in progress, so it can be called whenever the app is idle
+		Promise<Optional<CollectGarbageResult>> collectGarbage(CollectGarbageOptions options = CollectGarbageOptions());
+		
+		
 		using CreatePlaylistOptions = MediaProvider::CreatePlaylistOptions;
 		Promise<$<Playlist>> createPlaylist(String name, MediaProvider* provider, CreatePlaylistOptions options);
 		
@@ -170,9 +195,13 @@ namespace sh {
 		Promise<ArrayList<bool>> hasFollowedUserAccounts(ArrayList<$<UserAccount>> users);
 		
 	private:
+		Promise<bool> synchronizeLibraryCollection($<AsyncQueue::Task> task, MediaProvider* libraryProvider, $<TrackCollection> collection, Function<void(double)> onProgress);
+		
 		MediaDatabase* db;
 		MediaProviderStash* mediaProviderStash;
 		ScrobblerStash* scrobblerStash;
+		size_t syncConcurrency;
+		bool deltaCollectionSync;
 		MediaLibraryProxyProvider* libraryProxyProvider;
 		AsyncQueue synchronizeQueue;
 		AsyncQueue synchronizeAllQueue;
@@ -208,24 +208,20 @@ namespace sh {
 		if(options.database != nullptr) {
 			db = options.database;
 		}
-		return db->getSavedTracksJson(sql::IndexRange{
+		return db->getSavedTracks(sql::IndexRange{
 			.startIndex=index,
 			.endIndex=(index+count)
 		}, {
 			.libraryProvider = (_filters.libraryProvider != nullptr) ? _filters.libraryProvider->name() : String(),
 			.orderBy = _filters.orderBy,
 			.order = _filters.order
-		}).then([=](MediaDatabase::GetJsonItemsListResult results) {
-			mutator->applyAndResize(index, results.total, results.items.map([=](auto json) -> $<MediaLibraryTracksCollectionItem> {
-				auto jsonObj = json.object_items();
-				auto trackJsonIt = jsonObj.find("mediaItem");
-				if(trackJsonIt != jsonObj.end()) {
-					auto trackJson = trackJsonIt->second;
-					jsonObj.erase(trackJsonIt);
-					jsonObj["track"] = trackJson;
-				}
-				return std::static_pointer_cast<MediaLibraryTracksCollectionItem>(
-					self->createCollectionItem(jsonObj, db->mediaProviderStash()));
+		}).then([=](MediaDatabase::GetItemsListResult<sql::SavedTrackItem> results) {
+			mutator->applyAndResize(index, results.total, results.items.map([=](auto& savedTrack) -> $<MediaLibraryTracksCollectionItem> {
+				return self->createCollectionItem(MediaLibraryTracksCollectionItem::Data{{
+					.track = savedTrack.track
+					},
+					.addedAt = savedTrack.addedAt
+				});
 			}));
 		});
 	}
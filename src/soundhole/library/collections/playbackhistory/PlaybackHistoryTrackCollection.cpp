@@ -15,8 +15,7 @@ namespace sh {
 
 	#pragma mark PlaybackHistoryTrackCollectionItem::Data
 
-	PlaybackHistoryTrackCollectionItem::Data PlaybackHistoryTrackCollectionItem::Data::fromJson(const Json& json, MediaProviderStash* stash) {
-		auto historyItem = PlaybackHistoryItem::fromJson(json, stash);
+	PlaybackHistoryTrackCollectionItem::Data PlaybackHistoryTrackCollectionItem::Data::forHistoryItem($<PlaybackHistoryItem> historyItem) {
 		return PlaybackHistoryTrackCollectionItem::Data{{
 			.track = historyItem->track()
 			},
@@ -24,6 +23,10 @@ namespace sh {
 		};
 	}
 
+	PlaybackHistoryTrackCollectionItem::Data PlaybackHistoryTrackCollectionItem::Data::fromJson(const Json& json, MediaProviderStash* stash) {
+		return forHistoryItem(PlaybackHistoryItem::fromJson(json, stash));
+	}
+
 
 
 	#pragma mark MediaLibraryTracksCollectionItem
@@ -309,7 +312,7 @@ namespace sh {
 		if(options.database != nullptr) {
 			db = options.database;
 		}
-		return db->getPlaybackHistoryItemsJson({
+		return db->getPlaybackHistoryItems({
 			.filters = {
 				.provider = _filters.provider ? _filters.provider->name() : String(),
 				.trackURIs = _filters.trackURIs,
@@ -330,8 +333,8 @@ namespace sh {
 			},
 			.order = _filters.order
 		}).then([=](auto results) {
-			mutator->applyAndResize(index, results.total, results.items.map([=](const Json& json) {
-				return self->createCollectionItem(json, db->mediaProviderStash()).forceAs<PlaybackHistoryTrackCollectionItem>();
+			mutator->applyAndResize(index, results.total, results.items.map([=](auto& historyItem) {
+				return self->createCollectionItem(PlaybackHistoryTrackCollectionItem::Data::forHistoryItem(historyItem));
 			}));
 		});
 	}
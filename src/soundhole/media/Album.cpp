@@ -89,7 +89,7 @@ namespace sh {
 
 	Promise<void> Album::fetchData() {
 		auto self = std::static_pointer_cast<Album>(shared_from_this());
-		return provider->getAlbumData(_uri).then([=](Data data) {
+		return provider->loadAlbumData(_uri).then([=](Data data) {
 			self->applyData(data);
 		});
 	}
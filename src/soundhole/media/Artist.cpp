@@ -53,7 +53,7 @@ namespace sh {
 
 	Promise<void> Artist::fetchData() {
 		auto self = std::static_pointer_cast<Artist>(shared_from_this());
-		return provider->getArtistData(_uri).then([=](Data data) {
+		return provider->loadArtistData(_uri).then([=](Data data) {
 			self->applyData(data);
 		});
 	}
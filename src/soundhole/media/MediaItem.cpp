@@ -242,7 +242,7 @@ namespace sh {
 
 	void MediaItem::applyData(const Data& data) {
 		bool wasPartial = _partial;
-		if(!_partial) {
+		if(!data.partial) {
 			_partial = false;
 		}
 		if(_type.empty() && !data.type.empty()) {
@@ -0,0 +1,229 @@
+//
+//  MediaItemDataLoader.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+namespace sh {
+	/// Coalesces data requests for single media items into batch requests.
+	/// Requests made within a short window are sent together, up to the batch size,
+	/// and concurrent requests for the same uri share a single result.
+	template<typename Data>
+	class MediaItemDataLoader {
+	public:
+		using FetchBatch = Function<Promise<ArrayList<Data>>(ArrayList<String> uris)>;
+		using GetBatchSize = Function<size_t()>;
+
+		MediaItemDataLoader(FetchBatch fetchBatch, GetBatchSize getBatchSize, std::chrono::milliseconds window = std::chrono::milliseconds(10))
+		: state(fgl::new$<State>(fetchBatch, getBatchSize, window)) {
+			//
+		}
+
+		MediaItemDataLoader(const MediaItemDataLoader&) = delete;
+		MediaItemDataLoader& operator=(const MediaItemDataLoader&) = delete;
+
+		~MediaItemDataLoader() {
+			// the batch functions call into the owner, so they can't outlive it
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->fetchBatch = nullptr;
+			state->getBatchSize = nullptr;
+			auto queued = std::move(state->queued);
+			state->queued.clear();
+			state->queuedOrder.clear();
+			lock.unlock();
+			auto error = std::make_exception_ptr(std::runtime_error("Data loader was destroyed"));
+			for(auto& pair : queued) {
+				for(auto& callback : pair.second) {
+					callback.reject(error);
+				}
+			}
+		}
+
+		Promise<Data> load(String uri) {
+			auto state = this->state;
+			return Promise<Data>([=](auto resolve, auto reject) {
+				std::unique_lock<std::mutex> lock(state->mutex);
+				auto callbacks = Callbacks{
+					.resolve = resolve,
+					.reject = reject
+				};
+				// join a request that's already in flight or queued
+				auto inFlightIt = state->inFlight.find(uri);
+				if(inFlightIt != state->inFlight.end()) {
+					inFlightIt->second.pushBack(callbacks);
+					return;
+				}
+				auto queuedIt = state->queued.find(uri);
+				if(queuedIt != state->queued.end()) {
+					queuedIt->second.pushBack(callbacks);
+					return;
+				}
+				state->queued[uri].pushBack(callbacks);
+				state->queuedOrder.pushBack(uri);
+				size_t batchSize = std::max(state->getBatchSize(), (size_t)1);
+				if(state->queuedOrder.size() >= batchSize) {
+					auto batch = takeBatch(state, batchSize);
+					lock.unlock();
+					dispatch(state, batch);
+					return;
+				}
+				if(!state->dispatchScheduled) {
+					state->dispatchScheduled = true;
+					lock.unlock();
+					w$<State> weakState = state;
+					defaultPromiseQueue()->asyncAfter(std::chrono::steady_clock::now() + state->window, [=]() {
+						if(auto state = weakState.lock()) {
+							dispatchQueued(state);
+						}
+					});
+				}
+			});
+		}
+
+	private:
+		struct Callbacks {
+			Function<void(Data)> resolve;
+			Function<void(std::exception_ptr)> reject;
+		};
+
+		struct State {
+			State(FetchBatch fetchBatch, GetBatchSize getBatchSize, std::chrono::milliseconds window)
+			: fetchBatch(fetchBatch), getBatchSize(getBatchSize), window(window) {}
+
+			/// cleared when the loader is destroyed
+			FetchBatch fetchBatch;
+			GetBatchSize getBatchSize;
+			std::chrono::milliseconds window;
+			std::map<String,LinkedList<Callbacks>> queued;
+			LinkedList<String> queuedOrder;
+			std::map<String,LinkedList<Callbacks>> inFlight;
+			bool dispatchScheduled = false;
+			std::mutex mutex;
+		};
+
+		/// Moves up to batchSize queued uris to the in flight requests. The state must be locked
+		static ArrayList<String> takeBatch($<State> state, size_t batchSize) {
+			ArrayList<String> uris;
+			uris.reserve(std::min(batchSize, state->queuedOrder.size()));
+			while(uris.size() < batchSize && !state->queuedOrder.empty()) {
+				auto uri = state->queuedOrder.extractFront();
+				auto queuedIt = state->queued.find(uri);
+				state->inFlight[uri] = std::move(queuedIt->second);
+				state->queued.erase(queuedIt);
+				uris.pushBack(uri);
+			}
+			return uris;
+		}
+
+		/// Extracts the callbacks waiting on the given uris. The state must be locked
+		static std::map<String,LinkedList<Callbacks>> takeInFlight($<State> state, const ArrayList<String>& uris) {
+			std::map<String,LinkedList<Callbacks>> callbacks;
+			for(auto& uri : uris) {
+				auto it = state->inFlight.find(uri);
+				if(it != state->inFlight.end()) {
+					callbacks[uri] = std::move(it->second);
+					state->inFlight.erase(it);
+				}
+			}
+			return callbacks;
+		}
+
+		static void dispatchQueued($<State> state) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->dispatchScheduled = false;
+			if(!state->getBatchSize) {
+				return;
+			}
+			LinkedList<ArrayList<String>> batches;
+			size_t batchSize = std::max(state->getBatchSize(), (size_t)1);
+			while(!state->queuedOrder.empty()) {
+				batches.pushBack(takeBatch(state, batchSize));
+			}
+			lock.unlock();
+			for(auto& batch : batches) {
+				dispatch(state, batch);
+			}
+		}
+
+		static void dispatch($<State> state, ArrayList<String> uris) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			auto fetchBatch = state->fetchBatch;
+			lock.unlock();
+			if(!fetchBatch) {
+				fail(state, uris, std::make_exception_ptr(std::runtime_error("Data loader was destroyed")));
+				return;
+			}
+			Promise<ArrayList<Data>> promise;
+			try {
+				promise = fetchBatch(uris);
+			} catch(...) {
+				failOrSplit(state, uris, std::current_exception());
+				return;
+			}
+			promise.then([=](ArrayList<Data> results) {
+				// providers may leave out or null out items that weren't found, so match the results by uri
+				std::map<String,Data> resultsByURI;
+				if(uris.size() == 1 && results.size() == 1) {
+					// a single item may come back under its canonical uri (ie bandcamp page urls), so it can't be matched by uri
+					if(!results.front().uri.empty()) {
+						resultsByURI.insert_or_assign(uris.front(), results.front());
+					}
+				} else {
+					for(auto& result : results) {
+						if(!result.uri.empty()) {
+							resultsByURI.insert_or_assign(result.uri, result);
+						}
+					}
+				}
+				std::unique_lock<std::mutex> lock(state->mutex);
+				auto callbacks = takeInFlight(state, uris);
+				lock.unlock();
+				for(auto& [uri, uriCallbacks] : callbacks) {
+					auto resultIt = resultsByURI.find(uri);
+					for(auto& callback : uriCallbacks) {
+						if(resultIt != resultsByURI.end()) {
+							callback.resolve(resultIt->second);
+						} else {
+							callback.reject(std::make_exception_ptr(std::runtime_error("No data was returned for "+uri)));
+						}
+					}
+				}
+			}, [=](std::exception_ptr error) {
+				failOrSplit(state, uris, error);
+			});
+		}
+
+		/// A single bad uri can make a provider reject its whole batch, so a failed batch is retried in halves until the failing uris are isolated
+		static void failOrSplit($<State> state, const ArrayList<String>& uris, std::exception_ptr error) {
+			if(uris.size() <= 1) {
+				fail(state, uris, error);
+				return;
+			}
+			size_t half = uris.size() / 2;
+			dispatch(state, ArrayList<String>(uris.begin(), uris.begin() + half));
+			dispatch(state, ArrayList<String>(uris.begin() + half, uris.end()));
+		}
+
+		static void fail($<State> state, const ArrayList<String>& uris, std::exception_ptr error) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			auto callbacks = takeInFlight(state, uris);
+			lock.unlock();
+			for(auto& pair : callbacks) {
+				for(auto& callback : pair.second) {
+					callback.reject(error);
+				}
+			}
+		}
+
+		$<State> state;
+	};
+}
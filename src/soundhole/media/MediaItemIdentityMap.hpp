@@ -0,0 +1,128 @@
+//
+//  MediaItemIdentityMap.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <map>
+#include <mutex>
+
+namespace sh {
+	/// Keeps weak references to the live media items of a provider by uri,
+	/// so that the same uri resolves to the same instance while anything still holds it.
+	template<typename ItemType>
+	class MediaItemIdentityMap {
+	public:
+		using Data = typename ItemType::Data;
+		using Create = Function<$<ItemType>(const Data&)>;
+
+		struct Stats {
+			/// items that resolved to an existing instance
+			size_t hits = 0;
+			/// items that needed a new instance
+			size_t misses = 0;
+			/// instances that are currently alive
+			size_t liveItems = 0;
+		};
+
+		MediaItemIdentityMap()
+		: pruneThreshold(minPruneThreshold) {
+			//
+		}
+
+		/// Returns the live instance for the data's uri with the data applied to it, or a new instance from create.
+		/// Partial data isn't applied to an instance that already has full data.
+		/// Live instances are only modified on the default promise queue. When called from another queue, the data is merged
+		/// into the live instance asynchronously, and a separate instance created from the data is returned instead.
+		$<ItemType> intern(const Data& data, Create create) {
+			if(data.uri.empty()) {
+				return create(data);
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			auto it = items.find(data.uri);
+			if(it != items.end()) {
+				if(auto existing = it->second.lock()) {
+					currentStats.hits++;
+					lock.unlock();
+					return merge(existing, data, create);
+				}
+			}
+			currentStats.misses++;
+			lock.unlock();
+			auto item = create(data);
+			lock.lock();
+			// another thread may have created the same uri while unlocked
+			it = items.find(data.uri);
+			if(it != items.end()) {
+				if(auto existing = it->second.lock()) {
+					lock.unlock();
+					return merge(existing, data, [=](auto& data) {
+						return item;
+					});
+				}
+			}
+			items.insert_or_assign(data.uri, w$<ItemType>(item));
+			if(items.size() >= pruneThreshold) {
+				prune();
+			}
+			return item;
+		}
+
+		Stats stats() const {
+			std::unique_lock<std::mutex> lock(mutex);
+			auto stats = currentStats;
+			stats.liveItems = 0;
+			for(auto& pair : items) {
+				if(!pair.second.expired()) {
+					stats.liveItems++;
+				}
+			}
+			return stats;
+		}
+
+	private:
+		static constexpr size_t minPruneThreshold = 1024;
+
+		/// Applies data to a live instance on the queue that owns it.
+		/// Returns the live instance if the data was applied, or a new instance with the data if the merge was deferred
+		static $<ItemType> merge($<ItemType> item, const Data& data, const Create& create) {
+			if(DispatchQueue::local() != defaultPromiseQueue()) {
+				defaultPromiseQueue()->async([=]() {
+					applyData(item, data);
+				});
+				return create(data);
+			}
+			applyData(item, data);
+			return item;
+		}
+
+		static void applyData($<ItemType> item, const Data& data) {
+			if(!data.partial || item->needsData()) {
+				item->applyData(data);
+			}
+		}
+
+		/// Removes the entries of destroyed items. The map must be locked
+		void prune() {
+			for(auto it=items.begin(); it!=items.end();) {
+				if(it->second.expired()) {
+					it = items.erase(it);
+				} else {
+					it++;
+				}
+			}
+			// prune again once the map has doubled, so that pruning stays amortized O(1) per insert
+			pruneThreshold = std::max(items.size() * 2, minPruneThreshold);
+		}
+
+		std::map<String,w$<ItemType>> items;
+		size_t pruneThreshold;
+		Stats currentStats;
+		mutable std::mutex mutex;
+	};
+}
@@ -24,6 +24,17 @@ namespace sh {
 
 
 
+	MediaProvider::MediaProvider()
+	: trackDataLoader([=](ArrayList<String> uris) { return this->getTracksData(uris); }, [=]() { return this->dataBatchSizes().tracks; }),
+	artistDataLoader([=](ArrayList<String> uris) { return this->getArtistsData(uris); }, [=]() { return this->dataBatchSizes().artists; }),
+	albumDataLoader([=](ArrayList<String> uris) { return this->getAlbumsData(uris); }, [=]() { return this->dataBatchSizes().albums; }),
+	playlistDataLoader([=](ArrayList<String> uris) { return this->getPlaylistsData(uris); }, [=]() { return this->dataBatchSizes().playlists; }),
+	userDataLoader([=](ArrayList<String> uris) { return this->getUsersData(uris); }, [=]() { return this->dataBatchSizes().users; }) {
+		//
+	}
+
+
+
 	MediaPlaybackProvider* MediaProvider::player() {
 		return nullptr;
 	}
@@ -34,76 +45,82 @@ namespace sh {
 
 
 
+	size_t MediaProvider::maxConcurrentDataRequests() const {
+		return 4;
+	}
+
 	Promise<ArrayList<Track::Data>> MediaProvider::getTracksData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		ArrayList<Track::Data> items;
-		items.reserve(uris.size());
-		for(auto uri : uris) {
-			items.pushBack(co_await this->getTrackData(uri));
-		}
-		co_return items;
+		return utils::FanOut<String,Track::Data>::all(uris, {.maxConcurrent=maxConcurrentDataRequests()}, [=](auto& uri) {
+			return this->getTrackData(uri);
+		});
 	}
 	Promise<ArrayList<Artist::Data>> MediaProvider::getArtistsData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		ArrayList<Artist::Data> items;
-		items.reserve(uris.size());
-		for(auto uri : uris) {
-			items.pushBack(co_await this->getArtistData(uri));
-		}
-		co_return items;
+		return utils::FanOut<String,Artist::Data>::all(uris, {.maxConcurrent=maxConcurrentDataRequests()}, [=](auto& uri) {
+			return this->getArtistData(uri);
+		});
 	}
 	Promise<ArrayList<Album::Data>> MediaProvider::getAlbumsData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		ArrayList<Album::Data> items;
-		items.reserve(uris.size());
-		for(auto uri : uris) {
-			items.pushBack(co_await this->getAlbumData(uri));
-		}
-		co_return items;
+		return utils::FanOut<String,Album::Data>::all(uris, {.maxConcurrent=maxConcurrentDataRequests()}, [=](auto& uri) {
+			return this->getAlbumData(uri);
+		});
 	}
 	Promise<ArrayList<Playlist::Data>> MediaProvider::getPlaylistsData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		ArrayList<Playlist::Data> items;
-		items.reserve(uris.size());
-		for(auto uri : uris) {
-			items.pushBack(co_await this->getPlaylistData(uri));
-		}
-		co_return items;
+		return utils::FanOut<String,Playlist::Data>::all(uris, {.maxConcurrent=maxConcurrentDataRequests()}, [=](auto& uri) {
+			return this->getPlaylistData(uri);
+		});
 	}
 	Promise<ArrayList<UserAccount::Data>> MediaProvider::getUsersData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		ArrayList<UserAccount::Data> items;
-		items.reserve(uris.size());
-		for(auto uri : uris) {
-			items.pushBack(co_await this->getUserData(uri));
-		}
-		co_return items;
+		return utils::FanOut<String,UserAccount::Data>::all(uris, {.maxConcurrent=maxConcurrentDataRequests()}, [=](auto& uri) {
+			return this->getUserData(uri);
+		});
+	}
+
+
+
+	MediaProvider::DataBatchSizes MediaProvider::dataBatchSizes() const {
+		return DataBatchSizes();
+	}
+
+	Promise<Track::Data> MediaProvider::loadTrackData(String uri) {
+		return trackDataLoader.load(uri);
+	}
+	Promise<Artist::Data> MediaProvider::loadArtistData(String uri) {
+		return artistDataLoader.load(uri);
+	}
+	Promise<Album::Data> MediaProvider::loadAlbumData(String uri) {
+		return albumDataLoader.load(uri);
+	}
+	Promise<Playlist::Data> MediaProvider::loadPlaylistData(String uri) {
+		return playlistDataLoader.load(uri);
+	}
+	Promise<UserAccount::Data> MediaProvider::loadUserData(String uri) {
+		return userDataLoader.load(uri);
 	}
 
 
 
 	Promise<$<Track>> MediaProvider::getTrack(String uri) {
-		return getTrackData(uri).map(nullptr, [=](auto data) -> $<Track> {
+		return getTrackData(uri).map([=](auto data) -> $<Track> {
 			return this->track(data);
 		});
 	}
 	Promise<$<Artist>> MediaProvider::getArtist(String uri) {
-		return getArtistData(uri).map(nullptr, [=](auto data) -> $<Artist> {
+		return getArtistData(uri).map([=](auto data) -> $<Artist> {
 			return this->artist(data);
 		});
 	}
 	Promise<$<Album>> MediaProvider::getAlbum(String uri) {
-		return getAlbumData(uri).map(nullptr, [=](auto data) -> $<Album> {
+		return getAlbumData(uri).map([=](auto data) -> $<Album> {
 			return this->album(data);
 		});
 	}
 	Promise<$<Playlist>> MediaProvider::getPlaylist(String uri) {
-		return getPlaylistData(uri).map(nullptr, [=](auto data) -> $<Playlist> {
+		return getPlaylistData(uri).map([=](auto data) -> $<Playlist> {
 			return this->playlist(data);
 		});
 	}
 	Promise<$<UserAccount>> MediaProvider::getUser(String uri) {
-		return getUserData(uri).map(nullptr, [=](auto data) -> $<UserAccount> {
+		return getUserData(uri).map([=](auto data) -> $<UserAccount> {
 			return this->userAccount(data);
 		});
 	}
@@ -111,35 +128,35 @@ namespace sh {
 
 
 	Promise<ArrayList<$<Track>>> MediaProvider::getTracks(ArrayList<String> uris) {
-		return getTracksData(uris).map(nullptr, [=](auto datas) {
+		return getTracksData(uris).map([=](auto datas) {
 			return datas.map([=](auto& data) {
 				return this->track(data);
 			});
 		});
 	}
 	Promise<ArrayList<$<Artist>>> MediaProvider::getArtists(ArrayList<String> uris) {
-		return getArtistsData(uris).map(nullptr, [=](auto datas) {
+		return getArtistsData(uris).map([=](auto datas) {
 			return datas.map([=](auto& data) {
 				return this->artist(data);
 			});
 		});
 	}
 	Promise<ArrayList<$<Album>>> MediaProvider::getAlbums(ArrayList<String> uris) {
-		return getAlbumsData(uris).map(nullptr, [=](auto datas) {
+		return getAlbumsData(uris).map([=](auto datas) {
 			return datas.map([=](auto& data) {
 				return this->album(data);
 			});
 		});
 	}
 	Promise<ArrayList<$<Playlist>>> MediaProvider::getPlaylists(ArrayList<String> uris) {
-		return getPlaylistsData(uris).map(nullptr, [=](auto datas) {
+		return getPlaylistsData(uris).map([=](auto datas) {
 			return datas.map([=](auto& data) {
 				return this->playlist(data);
 			});
 		});
 	}
 	Promise<ArrayList<$<UserAccount>>> MediaProvider::getUsers(ArrayList<String> uris) {
-		return getUsersData(uris).map(nullptr, [=](auto datas) {
+		return getUsersData(uris).map([=](auto datas) {
 			return datas.map([=](auto& data) {
 				return this->userAccount(data);
 			});
@@ -149,11 +166,15 @@ namespace sh {
 
 
 	$<Track> MediaProvider::track(const Track::Data& data) {
-		return Track::new$(this, data);
+		return trackIdentityMap.intern(data, [=](auto& data) {
+			return Track::new$(this, data);
+		});
 	}
 
 	$<Artist> MediaProvider::artist(const Artist::Data& data) {
-		return Artist::new$(this, data);
+		return artistIdentityMap.intern(data, [=](auto& data) {
+			return Artist::new$(this, data);
+		});
 	}
 
 	$<Album> MediaProvider::album(const Album::Data& data) {
@@ -165,7 +186,17 @@ namespace sh {
 	}
 
 	$<UserAccount> MediaProvider::userAccount(const UserAccount::Data& data) {
-		return UserAccount::new$(this, data);
+		return userIdentityMap.intern(data, [=](auto& data) {
+			return UserAccount::new$(this, data);
+		});
+	}
+
+	MediaProvider::IdentityMapStats MediaProvider::identityMapStats() const {
+		return IdentityMapStats{
+			.tracks = trackIdentityMap.stats(),
+			.artists = artistIdentityMap.stats(),
+			.users = userIdentityMap.stats()
+		};
 	}
 
 
@@ -18,6 +18,9 @@
 #include "Album.hpp"
 #include "Playlist.hpp"
 #include "UserAccount.hpp"
+#include "MediaItemDataLoader.hpp"
+#include "MediaItemIdentityMap.hpp"
+#include <soundhole/utils/FanOut.hpp>
 
 namespace sh {
 	class MediaProviderStash;
@@ -50,7 +53,7 @@ namespace sh {
 		MediaProvider(const MediaProvider&) = delete;
 		MediaProvider& operator=(const MediaProvider&) = delete;
 		
-		MediaProvider() {};
+		MediaProvider();
 		virtual ~MediaProvider() {}
 		
 		virtual Promise<Track::Data> getTrackData(String uri) = 0;
@@ -59,12 +62,31 @@ namespace sh {
 		virtual Promise<Playlist::Data> getPlaylistData(String uri) = 0;
 		virtual Promise<UserAccount::Data> getUserData(String uri) = 0;
 		
+		/// The number of get*Data requests that the default batch getters run at once
+		virtual size_t maxConcurrentDataRequests() const;
 		virtual Promise<ArrayList<Track::Data>> getTracksData(ArrayList<String> uris);
 		virtual Promise<ArrayList<Artist::Data>> getArtistsData(ArrayList<String> uris);
 		virtual Promise<ArrayList<Album::Data>> getAlbumsData(ArrayList<String> uris);
 		virtual Promise<ArrayList<Playlist::Data>> getPlaylistsData(ArrayList<String> uris);
 		virtual Promise<ArrayList<UserAccount::Data>> getUsersData(ArrayList<String> uris);
 		
+		/// The maximum number of uris that the batch getters accept in one call
+		struct DataBatchSizes {
+			size_t tracks = 1;
+			size_t artists = 1;
+			size_t albums = 1;
+			size_t playlists = 1;
+			size_t users = 1;
+		};
+		virtual DataBatchSizes dataBatchSizes() const;
+		
+		/// Like get*Data, but coalesced with other loads made around the same time into calls to the batch getters
+		Promise<Track::Data> loadTrackData(String uri);
+		Promise<Artist::Data> loadArtistData(String uri);
+		Promise<Album::Data> loadAlbumData(String uri);
+		Promise<Playlist::Data> loadPlaylistData(String uri);
+		Promise<UserAccount::Data> loadUserData(String uri);
+		
 		Promise<$<Track>> getTrack(String uri);
 		Promise<$<Artist>> getArtist(String uri);
 		Promise<$<Album>> getAlbum(String uri);
@@ -138,5 +160,23 @@ namespace sh {
 		virtual $<Album> album(const Album::Data& data);
 		virtual $<Playlist> playlist(const Playlist::Data& data);
 		virtual $<UserAccount> userAccount(const UserAccount::Data& data);
+		
+		/// How often track(), artist() and userAccount() returned an existing live instance
+		struct IdentityMapStats {
+			MediaItemIdentityMap<Track>::Stats tracks;
+			MediaItemIdentityMap<Artist>::Stats artists;
+			MediaItemIdentityMap<UserAccount>::Stats users;
+		};
+		IdentityMapStats identityMapStats() const;
+		
+	private:
+		MediaItemDataLoader<Track::Data> trackDataLoader;
+		MediaItemDataLoader<Artist::Data> artistDataLoader;
+		MediaItemDataLoader<Album::Data> albumDataLoader;
+		MediaItemDataLoader<Playlist::Data> playlistDataLoader;
+		MediaItemDataLoader<UserAccount::Data> userDataLoader;
+		MediaItemIdentityMap<Track> trackIdentityMap;
+		MediaItemIdentityMap<Artist> artistIdentityMap;
+		MediaItemIdentityMap<UserAccount> userIdentityMap;
 	};
 }
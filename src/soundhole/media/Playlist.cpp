@@ -217,7 +217,7 @@ namespace sh {
 
 	Promise<void> Playlist::fetchData() {
 		auto self = std::static_pointer_cast<Playlist>(shared_from_this());
-		return provider->getPlaylistData(_uri).then([=](Data data) {
+		return provider->loadPlaylistData(_uri).then([=](Data data) {
 			self->applyData(data);
 		});
 	}
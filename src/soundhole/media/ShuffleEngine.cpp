@@ -0,0 +1,75 @@
+//
+//  ShuffleEngine.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "ShuffleEngine.hpp"
+
+namespace sh {
+	uint32_t ShuffleEngine::randomSeed() {
+		std::random_device device;
+		return (uint32_t)device();
+	}
+
+	ShuffleEngine::ShuffleEngine()
+	: ShuffleEngine(0, 0) {
+		//
+	}
+
+	ShuffleEngine::ShuffleEngine(size_t size, uint32_t seed, const ArrayList<size_t>& excludedIndexes)
+	: _seed(seed), _random(seed), _size(size), _position(0), _remainingExcludedCount(0) {
+		for(auto index : excludedIndexes) {
+			if(index < size && _excludedIndexes.insert(index).second) {
+				_remainingExcludedCount++;
+			}
+		}
+	}
+
+	uint32_t ShuffleEngine::seed() const {
+		return _seed;
+	}
+
+	size_t ShuffleEngine::size() const {
+		return _size;
+	}
+
+	size_t ShuffleEngine::remainingCount() const {
+		return (_size - _position) - _remainingExcludedCount;
+	}
+
+	Optional<size_t> ShuffleEngine::next() {
+		while(_position < _size) {
+			size_t swapPosition = _position + randomOffset(_size - _position);
+			size_t value = valueAt(swapPosition);
+			if(swapPosition != _position) {
+				_swappedValues.insert_or_assign(swapPosition, valueAt(_position));
+			}
+			// positions before the current position are never read again
+			_swappedValues.erase(_position);
+			_position++;
+			if(_excludedIndexes.erase(value) > 0) {
+				_remainingExcludedCount--;
+				continue;
+			}
+			return value;
+		}
+		return std::nullopt;
+	}
+
+	size_t ShuffleEngine::valueAt(size_t position) const {
+		auto it = _swappedValues.find(position);
+		if(it != _swappedValues.end()) {
+			return it->second;
+		}
+		return position;
+	}
+
+	size_t ShuffleEngine::randomOffset(size_t range) {
+		// std::uniform_int_distribution differs between standard libraries, so scale the raw 32-bit value
+		// to keep the order the same on every platform
+		return (size_t)(((uint64_t)_random() * (uint64_t)range) >> 32);
+	}
+}
@@ -0,0 +1,48 @@
+//
+//  ShuffleEngine.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace sh {
+	/// Draws the indexes [0, size) in a random order, one at a time.
+	/// The permutation is a Fisher-Yates shuffle that is only materialized as far as it has been drawn,
+	/// and the same seed always produces the same order.
+	class ShuffleEngine {
+	public:
+		static uint32_t randomSeed();
+
+		ShuffleEngine();
+		ShuffleEngine(size_t size, uint32_t seed, const ArrayList<size_t>& excludedIndexes = {});
+
+		uint32_t seed() const;
+		size_t size() const;
+		/// the number of indexes that haven't been drawn yet
+		size_t remainingCount() const;
+
+		/// Draws the next index, or returns null if every index has been drawn
+		Optional<size_t> next();
+
+	private:
+		size_t valueAt(size_t position) const;
+		size_t randomOffset(size_t range);
+
+		uint32_t _seed;
+		std::mt19937 _random;
+		size_t _size;
+		size_t _position;
+		// positions that were swapped with an earlier position and no longer hold their own index
+		std::unordered_map<size_t,size_t> _swappedValues;
+		std::unordered_set<size_t> _excludedIndexes;
+		size_t _remainingExcludedCount;
+	};
+}
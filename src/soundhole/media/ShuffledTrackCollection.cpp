@@ -7,8 +7,7 @@
 //
 
 #include "ShuffledTrackCollection.hpp"
-#include <cmath>
-#include <cstdlib>
+#include <unordered_set>
 
 namespace sh {
 
@@ -64,13 +63,13 @@ namespace sh {
 
 
 
-	$<ShuffledTrackCollection> ShuffledTrackCollection::new$($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems) {
-		auto collection = fgl::new$<ShuffledTrackCollection>(source, initialItems);
+	$<ShuffledTrackCollection> ShuffledTrackCollection::new$($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems, Optional<uint32_t> seed) {
+		auto collection = fgl::new$<ShuffledTrackCollection>(source, initialItems, seed);
 		collection->lazyLoadContentIfNeeded();
 		return collection;
 	}
 
-	ShuffledTrackCollection::ShuffledTrackCollection($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems)
+	ShuffledTrackCollection::ShuffledTrackCollection($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems, Optional<uint32_t> seed)
 	: SpecialTrackCollection<ShuffledTrackCollectionItem>(source->mediaProvider(), SpecialTrackCollection<ShuffledTrackCollectionItem>::Data{{
 		.partial=source->needsData(),
 		.type="shuffled-collection",
@@ -89,7 +88,7 @@ namespace sh {
 			}
 			return items;
 		})()
-	}), _source(source) {
+	}), _source(source), _shuffleSeed(seed.valueOr(ShuffleEngine::randomSeed())) {
 		FGL_ASSERT(std::dynamic_pointer_cast<ShuffledTrackCollection>(source) == nullptr, "Cannot create ShuffledTrackCollection with another ShuffledTrackCollection");
 		
 		auto lazyContentLoader = _lazyContentLoader;
@@ -102,33 +101,26 @@ namespace sh {
 				auto contentLoaderRef = _lazyContentLoader;
 				_lazyContentLoader = nullptr;
 				// get indexes of initialItems
-				LinkedList<size_t> initialIndexes = {};
+				ArrayList<size_t> initialIndexes;
+				initialIndexes.reserve(initialItems.size());
 				for(auto item : initialItems) {
 					auto index = source->indexOfItemInstance(item.get());
 					FGL_ASSERT(index.has_value(), "initialItems must only contains items from the given source collection");
 					initialIndexes.pushBack(index.value());
 				}
 				
-				// build list of remaining indexes
-				LinkedList<size_t> indexes;
+				// watch every source index so that shifts and removals in the source are tracked until the index is drawn
 				size_t itemCount = this->itemCount().value_or(0);
+				std::unordered_set<size_t> initialIndexesSet(initialIndexes.begin(), initialIndexes.end());
+				_sourceIndexMarkers.reserve(itemCount);
 				for(size_t i=0; i<itemCount; i++) {
-					auto it = initialIndexes.findEqual(i);
-					if(it != initialIndexes.end()) {
-						initialIndexes.erase(it);
+					if(initialIndexesSet.find(i) != initialIndexesSet.end()) {
+						_sourceIndexMarkers.pushBack(nullptr);
 					} else {
-						indexes.pushBack(i);
+						_sourceIndexMarkers.pushBack(_source->watchIndex(i));
 					}
 				}
-				
-				// randomize list of remaining indexes
-				while(indexes.size() > 0) {
-					size_t index = (size_t)(((double)std::rand() / (double)RAND_MAX) * (double)indexes.size());
-					auto it = std::next(indexes.begin(), index);
-					size_t randomIndex = *it;
-					_remainingIndexes.pushBack(_source->watchIndex(randomIndex));
-					indexes.erase(it);
-				}
+				_shuffleEngine = ShuffleEngine(itemCount, _shuffleSeed, initialIndexes);
 				
 				// TODO subscribe to changes in source
 			});
@@ -136,7 +128,12 @@ namespace sh {
 	}
 
 	ShuffledTrackCollection::~ShuffledTrackCollection() {
-		for(auto indexMarker : _remainingIndexes) {
+		for(auto indexMarker : _sourceIndexMarkers) {
+			if(indexMarker) {
+				_source->unwatchIndex(indexMarker);
+			}
+		}
+		for(auto indexMarker : _returnedIndexes) {
 			_source->unwatchIndex(indexMarker);
 		}
 		// TODO unsubscribe from source
@@ -154,6 +151,10 @@ namespace sh {
 		return std::static_pointer_cast<const TrackCollection>(_source);
 	}
 
+	uint32_t ShuffledTrackCollection::shuffleSeed() const {
+		return _shuffleSeed;
+	}
+
 	Promise<void> ShuffledTrackCollection::fetchData() {
 		auto self = std::static_pointer_cast<ShuffledTrackCollection>(shared_from_this());
 		return _source->fetchDataIfNeeded().then([=]() {
@@ -170,76 +171,84 @@ namespace sh {
 		return 12;
 	}
 
-	void ShuffledTrackCollection::filterRemainingIndexes() {
-		_remainingIndexes.removeWhere([=](auto& indexMarker) {
-			if(indexMarker->state == ItemIndexMarkerState::REMOVED) {
-				_source->unwatchIndex(indexMarker);
-				return true;
-			}
-			return false;
-		});
+	size_t ShuffledTrackCollection::remainingIndexCount() const {
+		// may include source indexes that were removed but haven't been drawn yet
+		return _returnedIndexes.size() + _shuffleEngine.remainingCount();
 	}
 
-	size_t ShuffledTrackCollection::shuffledListSize() const {
-		if(tracksAreAsync()) {
-			return asyncItemsList()->getMap().size() + _remainingIndexes.size();
-		} else if(tracksAreEmpty()) {
-			return _remainingIndexes.size();
-		} else {
-			return _source->itemCount().value_or(0);
+	ShuffledTrackCollection::ItemIndexMarker ShuffledTrackCollection::takeNextIndex() {
+		while(!_returnedIndexes.empty()) {
+			auto indexMarker = _returnedIndexes.extractFront();
+			if(indexMarker->state != ItemIndexMarkerState::REMOVED) {
+				return indexMarker;
+			}
+			_source->unwatchIndex(indexMarker);
 		}
+		while(auto sourceIndex = _shuffleEngine.next()) {
+			auto indexMarker = _sourceIndexMarkers[sourceIndex.value()];
+			_sourceIndexMarkers[sourceIndex.value()] = nullptr;
+			if(!indexMarker) {
+				continue;
+			}
+			if(indexMarker->state != ItemIndexMarkerState::REMOVED) {
+				return indexMarker;
+			}
+			_source->unwatchIndex(indexMarker);
+		}
+		return nullptr;
 	}
 
 	Promise<void> ShuffledTrackCollection::loadItems(Mutator* mutator, size_t index, size_t count, LoadItemOptions options) {
 		auto self = std::static_pointer_cast<ShuffledTrackCollection>(shared_from_this());
 		std::unique_ptr<Promise<void>> promise_ptr;
 		_source->lockItems([&]() {
-			filterRemainingIndexes();
 			size_t endIndex = index+count;
 			FGL_ASSERT(index <= endIndex, "index overflowed");
-			auto items = fgl::new$<LinkedList<$<Item>>>();
-			auto promise = Promise<void>::resolve();
-			auto tmpRemainingIndexes = _remainingIndexes;
+			// load the chosen source items in parallel
+			ArrayList<Promise<$<Item>>> itemPromises;
+			itemPromises.reserve(count);
 			auto chosenIndexes = LinkedList<AsyncListIndexMarker>();
 			for(size_t i=index; i<endIndex; i++) {
 				auto existingItem = std::static_pointer_cast<Item>(itemAt(i));
 				if(existingItem) {
-					promise = promise.then(nullptr, [=]() {
-						items->pushBack(existingItem);
-					});
+					itemPromises.pushBack(Promise<$<Item>>::resolve(existingItem));
 				} else {
-					if(tmpRemainingIndexes.empty()) {
+					auto randomIndex = takeNextIndex();
+					if(!randomIndex) {
 						break;
 					}
-					auto randomIndex = tmpRemainingIndexes.extractFront();
 					chosenIndexes.pushBack(randomIndex);
-					promise = promise.then(nullptr, [=]() {
+					itemPromises.pushBack(self->_source->getItem(randomIndex->index, {.trackIndexChanges=true}).map(nullptr, [=]($<TrackCollectionItem> item) -> $<Item> {
 						if(randomIndex->state == AsyncListIndexMarkerState::REMOVED) {
 							throw std::runtime_error("Random index at "+stringify(randomIndex->index)+" was removed");
 						}
-						return self->_source->getItem(randomIndex->index, {.trackIndexChanges=true}).then(nullptr, [=]($<TrackCollectionItem> item) {
-							if(!item) {
-								throw std::runtime_error("Item not found at index "+stringify(randomIndex->index));
-							}
-							items->pushBack(self->createCollectionItem(Item::Data::forSourceItem(item)));
-						});
-					});
+						if(!item) {
+							throw std::runtime_error("Item not found at index "+stringify(randomIndex->index));
+						}
+						return self->createCollectionItem(Item::Data::forSourceItem(item));
+					}));
 				}
 			}
-			promise_ptr = std::make_unique<Promise<void>>(promise.then(nullptr, [=]() {
+			auto promise = Promise<$<Item>>::all(itemPromises);
+			promise_ptr = std::make_unique<Promise<void>>(promise.then(nullptr, [=](ArrayList<$<Item>> loadedItems) {
+				auto items = LinkedList<$<Item>>(loadedItems.begin(), loadedItems.end());
 				mutator->lock([&]() {
-					_source->lockItems([&]() {
-						filterRemainingIndexes();
-						size_t listSize = shuffledListSize();
+					self->_source->lockItems([&]() {
+						size_t listSize = self->asyncItemsList()->getMap().size() + chosenIndexes.size() + self->remainingIndexCount();
 						for(auto randomIndex : chosenIndexes) {
-							auto it = self->_remainingIndexes.findEqual(randomIndex);
-							if(it != self->_remainingIndexes.end()) {
-								self->_remainingIndexes.erase(it);
-							}
+							self->_source->unwatchIndex(randomIndex);
 						}
-						mutator->applyAndResize(index, listSize, *items);
+						mutator->applyAndResize(index, listSize, items);
 					});
 				});
+			}).except([=](std::exception_ptr error) {
+				// put the chosen indexes back so they get drawn again on the next load
+				self->_source->lockItems([&]() {
+					for(auto it=chosenIndexes.rbegin(); it!=chosenIndexes.rend(); it++) {
+						self->_returnedIndexes.pushFront(*it);
+					}
+				});
+				std::rethrow_exception(error);
 			}));
 		});
 		return std::move(*promise_ptr);
@@ -247,9 +256,16 @@ namespace sh {
 
 
 
+	void ShuffledTrackCollection::unloadItemsOutsideRange(size_t startIndex, size_t endIndex) {
+		// loaded items hold the drawn shuffle order, which can't be loaded again
+	}
+
+
+
 	Json ShuffledTrackCollection::toJson(const ToJsonOptions& options) const {
 		auto json = SpecialTrackCollection<ShuffledTrackCollectionItem>::toJson(options).object_items();
 		json.merge(Json::object{
+			{ "shuffleSeed", (double)_shuffleSeed },
 			{ "source", _source->toJson({
 				.itemsStartIndex = options.itemsStartIndex,
 				.itemsEndIndex = options.itemsEndIndex
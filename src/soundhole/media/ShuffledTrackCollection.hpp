@@ -10,6 +10,7 @@
 
 #include <soundhole/common.hpp>
 #include "TrackCollection.hpp"
+#include "ShuffleEngine.hpp"
 
 namespace sh {
 	class ShuffledTrackCollection;
@@ -42,8 +43,8 @@ namespace sh {
 	public:
 		using LoadItemOptions = TrackCollection::LoadItemOptions;
 		
-		static $<ShuffledTrackCollection> new$($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems={});
-		ShuffledTrackCollection($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems = {});
+		static $<ShuffledTrackCollection> new$($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems={}, Optional<uint32_t> seed = std::nullopt);
+		ShuffledTrackCollection($<TrackCollection> source, ArrayList<$<TrackCollectionItem>> initialItems = {}, Optional<uint32_t> seed = std::nullopt);
 		virtual ~ShuffledTrackCollection();
 		
 		virtual String versionId() const override;
@@ -51,19 +52,29 @@ namespace sh {
 		$<TrackCollection> source();
 		$<const TrackCollection> source() const;
 		
+		/// the seed that the shuffled order was generated from
+		uint32_t shuffleSeed() const;
+		
 		virtual Promise<void> fetchData() override;
 		
 		virtual Json toJson(const ToJsonOptions& options) const override;
 		
+		virtual void unloadItemsOutsideRange(size_t startIndex, size_t endIndex) override;
+		
 	protected:
 		virtual MutatorDelegate* createMutatorDelegate() override;
 		virtual size_t getChunkSize() const override;
 		virtual Promise<void> loadItems(Mutator* mutator, size_t index, size_t count, LoadItemOptions options) override;
 		
-		size_t shuffledListSize() const;
+		size_t remainingIndexCount() const;
+		ItemIndexMarker takeNextIndex();
 		
 		$<TrackCollection> _source;
-		LinkedList<ItemIndexMarker> _remainingIndexes;
-		void filterRemainingIndexes();
+		uint32_t _shuffleSeed;
+		ShuffleEngine _shuffleEngine;
+		// source index markers by source index at the time of shuffling. null once drawn
+		ArrayList<ItemIndexMarker> _sourceIndexMarkers;
+		// drawn indexes that failed to load and get drawn again first
+		LinkedList<ItemIndexMarker> _returnedIndexes;
 	};
 }
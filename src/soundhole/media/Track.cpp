@@ -242,7 +242,7 @@ namespace sh {
 
 	Promise<void> Track::fetchData() {
 		auto self = std::static_pointer_cast<Track>(shared_from_this());
-		return provider->getTrackData(_uri).then([=](Data data) {
+		return provider->loadTrackData(_uri).then([=](Data data) {
 			self->applyData(data);
 		});
 	}
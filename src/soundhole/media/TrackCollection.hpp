@@ -9,6 +9,8 @@
 #pragma once
 
 #include <variant>
+#include <mutex>
+#include <unordered_map>
 #include <soundhole/common.hpp>
 #include "MediaItem.hpp"
 #include "Track.hpp"
@@ -101,6 +103,10 @@ namespace sh {
 		virtual Optional<size_t> itemCount() const = 0;
 		virtual size_t itemCapacity() const = 0;
 		virtual Promise<void> loadItems(size_t index, size_t count, LoadItemOptions options = LoadItemOptions::defaultOptions()) = 0;
+		/// the number of items that the collection loads at once
+		virtual size_t itemsChunkSize() const = 0;
+		/// Invalidates the loaded items outside of the given range, without changing the item count or the items inside the range
+		virtual void unloadItemsOutsideRange(size_t startIndex, size_t endIndex) = 0;
 		
 		virtual void forEach(Function<void($<TrackCollectionItem>,size_t)>) = 0;
 		virtual void forEach(Function<void($<const TrackCollectionItem>,size_t)>) const = 0;
@@ -216,6 +222,8 @@ namespace sh {
 		virtual Optional<size_t> itemCount() const override final;
 		virtual size_t itemCapacity() const override final;
 		virtual Promise<void> loadItems(size_t index, size_t count, LoadItemOptions options = LoadItemOptions::defaultOptions()) override final;
+		virtual size_t itemsChunkSize() const override;
+		virtual void unloadItemsOutsideRange(size_t startIndex, size_t endIndex) override;
 		
 		virtual void forEach(Function<void($<TrackCollectionItem>,size_t)>) override final;
 		virtual void forEach(Function<void($<const TrackCollectionItem>,size_t)>) const override final;
@@ -262,8 +270,8 @@ namespace sh {
 		
 		inline bool tracksAreEmpty() const;
 		inline bool tracksAreAsync() const;
-		inline LinkedList<$<ItemType>>& itemsList();
-		inline const LinkedList<$<ItemType>>& itemsList() const;
+		inline ArrayList<$<ItemType>>& itemsList();
+		inline const ArrayList<$<ItemType>>& itemsList() const;
 		inline $<AsyncList> asyncItemsList();
 		inline $<const AsyncList> asyncItemsList() const;
 		void makeTracksAsync();
@@ -273,13 +281,25 @@ namespace sh {
 		struct EmptyTracks {
 			size_t total;
 		};
-		using ItemsListVariant = std::variant<std::nullptr_t,EmptyTracks,LinkedList<$<ItemType>>,$<AsyncList>>;
+		// fully loaded lists are stored contiguously, since they are replaced by an AsyncList before being mutated
+		using ItemsListVariant = std::variant<std::nullptr_t,EmptyTracks,ArrayList<$<ItemType>>,$<AsyncList>>;
 		
 		ItemsListVariant _items;
 		ItemsListVariant constructItems(std::map<size_t,typename ItemType::Data> items, Optional<size_t> itemCount);
 		
 		void lazyLoadContentIfNeeded() const;
 		
+		// item instance -> index, rebuilt lazily after the items change
+		mutable std::unordered_map<const ItemType*,size_t> _itemInstanceIndexes;
+		mutable std::mutex _itemInstanceIndexesMutex;
+		mutable bool _itemInstanceIndexesDirty;
+		// the number of loaded items when the table was last rebuilt
+		mutable size_t _itemInstanceIndexesSourceSize;
+		bool isItemInstanceAt(const ItemType* item, size_t index) const;
+		size_t loadedItemCount() const;
+		void rebuildItemInstanceIndexes() const;
+		void invalidateItemInstanceIndexes();
+		
 		MutatorDelegate* _mutatorDelegate;
 		mutable Function<void()> _lazyContentLoader;
 		
@@ -170,7 +170,7 @@ namespace sh {
 
 	template<typename ItemType>
 	SpecialTrackCollection<ItemType>::SpecialTrackCollection(MediaProvider* provider, const Data& data)
-	: TrackCollection(provider, data), _versionId(data.versionId), _items(nullptr), _mutatorDelegate(nullptr), autoDeleteMutatorDelegate(true) {
+	: TrackCollection(provider, data), _versionId(data.versionId), _items(nullptr), _itemInstanceIndexesDirty(true), _itemInstanceIndexesSourceSize(0), _mutatorDelegate(nullptr), autoDeleteMutatorDelegate(true) {
 		auto items = data.items;
 		auto itemCount = data.itemCount;
 		_lazyContentLoader = [=]() {
@@ -219,7 +219,8 @@ namespace sh {
 		} else {
 			if(itemDatas.begin()->first == 0 && itemCount && itemCount == itemDatas.size()
 			   && itemDatas.size() == ((std::prev(itemDatas.end(),1)->first + 1) - itemDatas.begin()->first)) {
-				auto items = LinkedList<$<ItemType>>();
+				auto items = ArrayList<$<ItemType>>();
+				items.reserve(itemDatas.size());
 				for(auto& pair : itemDatas) {
 					items.pushBack(this->createCollectionItem(pair.second));
 				}
@@ -314,28 +315,87 @@ namespace sh {
 	template<typename ItemType>
 	Optional<size_t> SpecialTrackCollection<ItemType>::indexOfItemInstance(const ItemType* item) const {
 		lazyLoadContentIfNeeded();
-		if(tracksAreEmpty()) {
+		if(tracksAreEmpty() || item == nullptr) {
+			return std::nullopt;
+		}
+		std::unique_lock<std::mutex> lock(_itemInstanceIndexesMutex);
+		if(_itemInstanceIndexesDirty) {
+			rebuildItemInstanceIndexes();
+		}
+		auto it = _itemInstanceIndexes.find(item);
+		if(it != _itemInstanceIndexes.end() && isItemInstanceAt(item, it->second)) {
+			return it->second;
+		}
+		// items may have been applied without a mutation event, so rebuild if the entry was stale or more items have loaded since the last rebuild.
+		// otherwise the miss is answered without rescanning the items
+		bool stale = (it != _itemInstanceIndexes.end());
+		if(!stale && loadedItemCount() == _itemInstanceIndexesSourceSize) {
 			return std::nullopt;
 		}
+		rebuildItemInstanceIndexes();
+		it = _itemInstanceIndexes.find(item);
+		if(it != _itemInstanceIndexes.end()) {
+			return it->second;
+		}
+		return std::nullopt;
+	}
+
+	template<typename ItemType>
+	bool SpecialTrackCollection<ItemType>::isItemInstanceAt(const ItemType* item, size_t index) const {
 		if(tracksAreAsync()) {
-			return asyncItemsList()->indexWhere([&](auto& cmpItem) {
-				return (item == cmpItem.get());
-			}, {
-				.onlyValidItems = false
-			});
+			auto& itemsMap = asyncItemsList()->getMap();
+			auto it = itemsMap.find(index);
+			return (it != itemsMap.end() && it->second.item.get() == item);
+		}
+		// the items of a non-async list never change, and replacing the list clears the table
+		return !tracksAreEmpty();
+	}
+
+	template<typename ItemType>
+	size_t SpecialTrackCollection<ItemType>::loadedItemCount() const {
+		if(tracksAreEmpty()) {
+			return 0;
+		}
+		if(tracksAreAsync()) {
+			return asyncItemsList()->getMap().size();
+		}
+		return itemsList().size();
+	}
+
+	template<typename ItemType>
+	void SpecialTrackCollection<ItemType>::rebuildItemInstanceIndexes() const {
+		_itemInstanceIndexes.clear();
+		_itemInstanceIndexesDirty = false;
+		_itemInstanceIndexesSourceSize = loadedItemCount();
+		if(tracksAreEmpty()) {
+			return;
+		}
+		if(tracksAreAsync()) {
+			auto& itemsMap = asyncItemsList()->getMap();
+			_itemInstanceIndexes.reserve(itemsMap.size());
+			for(auto& pair : itemsMap) {
+				if(auto& item = pair.second.item) {
+					_itemInstanceIndexes.insert_or_assign(static_cast<const ItemType*>(item.get()), pair.first);
+				}
+			}
 		} else {
-			size_t index = 0;
 			auto& items = itemsList();
-			for(auto& cmpItem : items) {
-				if(item == cmpItem.get()) {
-					return index;
-				}
+			_itemInstanceIndexes.reserve(items.size());
+			size_t index = 0;
+			for(auto& item : items) {
+				_itemInstanceIndexes.insert_or_assign(item.get(), index);
 				index++;
 			}
-			return std::nullopt;
 		}
 	}
 
+	template<typename ItemType>
+	void SpecialTrackCollection<ItemType>::invalidateItemInstanceIndexes() {
+		std::unique_lock<std::mutex> lock(_itemInstanceIndexesMutex);
+		_itemInstanceIndexes.clear();
+		_itemInstanceIndexesDirty = true;
+	}
+
 	template<typename ItemType>
 	$<TrackCollectionItem> SpecialTrackCollection<ItemType>::itemAt(size_t index) {
 		lazyLoadContentIfNeeded();
@@ -350,7 +410,7 @@ namespace sh {
 			if(index >= items.size()) {
 				return nullptr;
 			}
-			return std::static_pointer_cast<TrackCollectionItem>(*std::next(items.begin(), index));
+			return std::static_pointer_cast<TrackCollectionItem>(items[index]);
 		}
 	}
 
@@ -368,7 +428,7 @@ namespace sh {
 			if(index >= items.size()) {
 				return nullptr;
 			}
-			return std::static_pointer_cast<const TrackCollectionItem>(*std::next(items.begin(), index));
+			return std::static_pointer_cast<const TrackCollectionItem>(items[index]);
 		}
 	}
 
@@ -381,7 +441,7 @@ namespace sh {
 				return Promise<$<TrackCollectionItem>>::resolve(nullptr);
 			}
 			return Promise<$<TrackCollectionItem>>::resolve(
-				std::static_pointer_cast<TrackCollectionItem>(*std::next(items.begin(), index)));
+				std::static_pointer_cast<TrackCollectionItem>(items[index]));
 		}
 		makeTracksAsync();
 		return asyncItemsList()->getItem(index, {
@@ -401,11 +461,10 @@ namespace sh {
 			if(index >= items.size()) {
 				return Promise<LinkedList<$<TrackCollectionItem>>>::resolve(LinkedList<$<TrackCollectionItem>>());
 			}
-			auto startIt = std::next(items.begin(), index);
-			auto endIt = ((index+count) < items.size()) ? std::next(startIt, count) : items.end();
+			size_t endIndex = std::min(index+count, items.size());
 			LinkedList<$<TrackCollectionItem>> loadedItems;
-			for(auto it=startIt; it!=endIt; it++) {
-				loadedItems.pushBack(std::static_pointer_cast<TrackCollectionItem>(*it));
+			for(size_t i=index; i<endIndex; i++) {
+				loadedItems.pushBack(std::static_pointer_cast<TrackCollectionItem>(items[i]));
 			}
 			return Promise<LinkedList<$<TrackCollectionItem>>>::resolve(loadedItems);
 		}
@@ -440,21 +499,17 @@ namespace sh {
 		} else {
 			size_t chunkSize = 50;
 			auto& sourceList = itemsList();
-			auto startIt = sourceList.begin();
-			size_t i=0;
-			while(startIt != sourceList.end() && i < startIndex) {
-				startIt++;
-				i++;
-			}
-			auto items = fgl::new$<LinkedList<$<ItemType>>>(startIt, sourceList.end());
+			auto startIt = std::next(sourceList.begin(), std::min(startIndex, sourceList.size()));
+			auto items = fgl::new$<ArrayList<$<ItemType>>>(startIt, sourceList.end());
+			auto nextIndex = fgl::new$<size_t>(0);
 			return ItemGenerator([=]() {
 				using YieldResult = typename ItemGenerator::YieldResult;
 				LinkedList<$<TrackCollectionItem>> genItems;
-				while(genItems.size() < chunkSize && items->size() > 0) {
-					genItems.pushBack(std::static_pointer_cast<TrackCollectionItem>(items->front()));
-					items->popFront();
+				while(genItems.size() < chunkSize && *nextIndex < items->size()) {
+					genItems.pushBack(std::static_pointer_cast<TrackCollectionItem>((*items)[*nextIndex]));
+					(*nextIndex)++;
 				}
-				if(items->size() == 0) {
+				if(*nextIndex >= items->size()) {
 					return Promise<YieldResult>::resolve(YieldResult{
 						.value=genItems,
 						.done=true
@@ -475,7 +530,7 @@ namespace sh {
 		if(_items.index() == 1) {
 			return std::get<EmptyTracks>(_items).total;
 		} else if(_items.index() == 2) {
-			return std::get<LinkedList<$<ItemType>>>(_items).size();
+			return std::get<ArrayList<$<ItemType>>>(_items).size();
 		} else if(_items.index() == 3) {
 			return asyncItemsList()->size();
 		}
@@ -488,7 +543,7 @@ namespace sh {
 		if(_items.index() == 1) {
 			return std::get<EmptyTracks>(_items).total;
 		} else if(_items.index() == 2) {
-			return std::get<LinkedList<$<ItemType>>>(_items).size();
+			return std::get<ArrayList<$<ItemType>>>(_items).size();
 		} else if(_items.index() == 3) {
 			return asyncItemsList()->capacity();
 		}
@@ -512,6 +567,44 @@ namespace sh {
 		}
 	}
 
+	template<typename ItemType>
+	size_t SpecialTrackCollection<ItemType>::itemsChunkSize() const {
+		lazyLoadContentIfNeeded();
+		if(!tracksAreEmpty() && !tracksAreAsync()) {
+			// every item is already loaded
+			return std::max(itemsList().size(), (size_t)1);
+		}
+		return getAsyncListChunkSize(nullptr);
+	}
+
+	template<typename ItemType>
+	void SpecialTrackCollection<ItemType>::unloadItemsOutsideRange(size_t startIndex, size_t endIndex) {
+		lazyLoadContentIfNeeded();
+		if(!tracksAreAsync()) {
+			return;
+		}
+		auto asyncItems = asyncItemsList();
+		asyncItems->lock([&](auto mutator) {
+			auto& itemsMap = asyncItems->getMap();
+			if(itemsMap.empty()) {
+				return;
+			}
+			size_t firstIndex = itemsMap.begin()->first;
+			size_t lastIndex = std::prev(itemsMap.end())->first;
+			// only touch the items outside the range, so that the kept items and their index markers stay as they are
+			mutator->lock([&]() {
+				if(firstIndex < startIndex) {
+					size_t invalidateEnd = std::min(startIndex, lastIndex + 1);
+					mutator->invalidate(firstIndex, invalidateEnd - firstIndex);
+				}
+				if(lastIndex >= endIndex) {
+					size_t invalidateStart = std::max(endIndex, firstIndex);
+					mutator->invalidate(invalidateStart, (lastIndex + 1) - invalidateStart);
+				}
+			});
+		});
+	}
+
 	template<typename ItemType>
 	void SpecialTrackCollection<ItemType>::forEach(Function<void($<TrackCollectionItem>,size_t)> executor) {
 		lazyLoadContentIfNeeded();
@@ -558,17 +651,10 @@ namespace sh {
 			auto asyncItems = asyncItemsList();
 			asyncItems->forEachInRange(startIndex, endIndex, executor);
 		} else {
-			size_t i=0;
-			for(auto& item : itemsList()) {
-				if(i < startIndex) {
-					i++;
-					continue;
-				}
-				if(i >= endIndex) {
-					break;
-				}
-				executor(item, i);
-				i++;
+			auto& items = itemsList();
+			size_t rangeEndIndex = std::min(endIndex, items.size());
+			for(size_t i=startIndex; i<rangeEndIndex; i++) {
+				executor(items[i], i);
 			}
 		}
 	}
@@ -583,17 +669,10 @@ namespace sh {
 			auto asyncItems = asyncItemsList();
 			asyncItems->forEachInRange(startIndex, endIndex, executor);
 		} else {
-			size_t i=0;
-			for(auto& item : itemsList()) {
-				if(i < startIndex) {
-					i++;
-					continue;
-				}
-				if(i >= endIndex) {
-					break;
-				}
-				executor(item, i);
-				i++;
+			auto& items = itemsList();
+			size_t rangeEndIndex = std::min(endIndex, items.size());
+			for(size_t i=startIndex; i<rangeEndIndex; i++) {
+				executor(items[i], i);
 			}
 		}
 	}
@@ -633,6 +712,7 @@ namespace sh {
 			asyncItems->resetItems();
 			asyncItems->destroy();
 		}
+		invalidateItemInstanceIndexes();
 		if(listSize.has_value()) {
 			_items = EmptyTracks{
 				.total = listSize.value()
@@ -736,6 +816,7 @@ namespace sh {
 		auto newItem = overwritingItem;
 		overwritingItem = existingItem;
 		overwritingItem->merge(newItem.get());
+		invalidateItemInstanceIndexes();
 	}
 
 	template<typename ItemType>
@@ -744,6 +825,8 @@ namespace sh {
 		auto castMutator = new Mutator(mutator);
 		return delegate->loadItems(castMutator, index, count, LoadItemOptions::fromMap(options)).finally(nullptr, [=]() {
 			delete castMutator;
+			// loaded items may have been applied without a mutation event
+			invalidateItemInstanceIndexes();
 		});
 	}
 
@@ -769,6 +852,7 @@ namespace sh {
 
 	template<typename ItemType>
 	void SpecialTrackCollection<ItemType>::onAsyncListMutations(const AsyncList* list, AsyncListChange change) {
+		invalidateItemInstanceIndexes();
 		// pass on mutations to subscribers
 		auto collection = std::static_pointer_cast<TrackCollection>(shared_from_this());
 		auto subscribers = _subscribers;
@@ -809,13 +893,13 @@ namespace sh {
 	}
 
 	template<typename ItemType>
-	LinkedList<$<ItemType>>& SpecialTrackCollection<ItemType>::itemsList() {
-		return std::get<LinkedList<$<ItemType>>>(_items);
+	ArrayList<$<ItemType>>& SpecialTrackCollection<ItemType>::itemsList() {
+		return std::get<ArrayList<$<ItemType>>>(_items);
 	}
 
 	template<typename ItemType>
-	const LinkedList<$<ItemType>>& SpecialTrackCollection<ItemType>::itemsList() const {
-		return std::get<LinkedList<$<ItemType>>>(_items);
+	const ArrayList<$<ItemType>>& SpecialTrackCollection<ItemType>::itemsList() const {
+		return std::get<ArrayList<$<ItemType>>>(_items);
 	}
 
 	template<typename ItemType>
@@ -857,6 +941,7 @@ namespace sh {
 				.initialItems=items,
 				.initialSize=items.size()
 			});
+			invalidateItemInstanceIndexes();
 		}
 	}
 
@@ -871,19 +956,14 @@ namespace sh {
 			.items = ([&]() -> ItemDataMap {
 				if(auto emptyTracks = std::get_if<EmptyTracks>(&_items)) {
 					return ItemDataMap();
-				} else if(auto itemsList = std::get_if<LinkedList<$<ItemType>>>(&_items)) {
+				} else if(auto itemsList = std::get_if<ArrayList<$<ItemType>>>(&_items)) {
 					ItemDataMap items;
-					size_t index = 0;
-					for(auto& item : *itemsList) {
+					size_t endIndex = std::min(options.itemsEndIndex, itemsList->size());
+					for(size_t index=options.itemsStartIndex; index<endIndex; index++) {
 						if(items.size() >= options.itemsLimit) {
 							break;
 						}
-						if(index >= options.itemsEndIndex) {
-							break;
-						} else if(index >= options.itemsStartIndex) {
-							items.insert_or_assign(index, item->toData());
-						}
-						index++;
+						items.insert_or_assign(index, (*itemsList)[index]->toData());
 					}
 					return items;
 				} else if(auto asyncItemsPtr = std::get_if<$<AsyncList>>(&_items)) {
@@ -915,7 +995,7 @@ namespace sh {
 	Json SpecialTrackCollection<ItemType>::toJson(const ToJsonOptions& options) const {
 		lazyLoadContentIfNeeded();
 		auto json = TrackCollection::toJson(options).object_items();
-		if(auto items = std::get_if<LinkedList<$<ItemType>>>(&_items)) {
+		if(auto items = std::get_if<ArrayList<$<ItemType>>>(&_items)) {
 			json.merge(Json::object{
 				{ "items", items->map([&](auto& item) -> Json {
 					return item->toJson();
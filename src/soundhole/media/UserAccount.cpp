@@ -24,7 +24,7 @@ namespace sh {
 
 	Promise<void> UserAccount::fetchData() {
 		auto self = std::static_pointer_cast<UserAccount>(shared_from_this());
-		return provider->getUserData(_uri).then([=](Data data) {
+		return provider->loadUserData(_uri).then([=](Data data) {
 			self->applyData(data);
 		});
 	}
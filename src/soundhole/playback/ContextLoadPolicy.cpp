@@ -0,0 +1,72 @@
+//
+//  ContextLoadPolicy.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "ContextLoadPolicy.hpp"
+
+namespace sh {
+	void ContextLoadPolicy::recordNavigation(Direction direction) {
+		std::unique_lock<std::mutex> lock(mutex);
+		navigations.pushBack(Navigation{
+			.time = std::chrono::steady_clock::now(),
+			.direction = direction
+		});
+		while(navigations.size() > maxNavigationHistory) {
+			navigations.popFront();
+		}
+	}
+
+	ContextLoadPolicy::Window ContextLoadPolicy::window(size_t index, size_t chunkSize, Optional<size_t> itemCount, const Options& options) const {
+		// count recent skips in each direction. moving on after listening for a while (like when a track finishes) isn't a skip
+		size_t forwardSkips = 0;
+		size_t backwardSkips = 0;
+		auto minSkipTime = std::chrono::steady_clock::now() - options.skipWindow;
+		std::unique_lock<std::mutex> lock(mutex);
+		Optional<std::chrono::steady_clock::time_point> prevTime;
+		for(auto& navigation : navigations) {
+			bool isSkip = prevTime && (navigation.time - prevTime.value()) < options.skipWindow;
+			prevTime = navigation.time;
+			if(!isSkip || navigation.time < minSkipTime) {
+				continue;
+			}
+			if(navigation.direction == Direction::FORWARD) {
+				forwardSkips++;
+			} else {
+				backwardSkips++;
+			}
+		}
+		lock.unlock();
+
+		// widen the window in the direction that the user is skipping
+		size_t maxBuffer = std::max(options.maxBuffer, options.minBuffer);
+		size_t aheadCount = std::min(options.minBuffer * (1 + forwardSkips), maxBuffer);
+		size_t behindCount = std::min(options.minBuffer * (1 + backwardSkips), maxBuffer);
+
+		// align the window to whole chunks, so that each load maps to whole provider requests
+		chunkSize = std::max(chunkSize, (size_t)1);
+		size_t startIndex = (index > behindCount) ? (index - behindCount) : 0;
+		size_t endIndex = index + aheadCount + 1;
+		startIndex = (startIndex / chunkSize) * chunkSize;
+		endIndex = ((endIndex + chunkSize - 1) / chunkSize) * chunkSize;
+		if(itemCount && endIndex > itemCount.value()) {
+			endIndex = std::max(itemCount.value(), startIndex);
+		}
+
+		auto window = Window{
+			.loadStartIndex = startIndex,
+			.loadEndIndex = endIndex,
+			.keepRange = std::nullopt
+		};
+		// only unload from contexts that are big enough to hold far away items
+		if(options.unloadDistance > 0 && itemCount && itemCount.value() > (endIndex - startIndex) + (options.unloadDistance * 2)) {
+			size_t keepStartIndex = (startIndex > options.unloadDistance) ? (startIndex - options.unloadDistance) : 0;
+			size_t keepEndIndex = std::min(endIndex + options.unloadDistance, itemCount.value());
+			window.keepRange = std::make_pair(keepStartIndex, keepEndIndex);
+		}
+		return window;
+	}
+}
@@ -0,0 +1,59 @@
+//
+//  ContextLoadPolicy.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <chrono>
+#include <mutex>
+
+namespace sh {
+	/// Decides which items of a playback context to load around the current index,
+	/// based on the collection's chunk size and how quickly the user has been skipping
+	class ContextLoadPolicy {
+	public:
+		enum class Direction {
+			FORWARD,
+			BACKWARD
+		};
+
+		struct Options {
+			/// the minimum number of items loaded on each side of the current index
+			size_t minBuffer = 5;
+			/// the maximum number of items loaded ahead of (or behind) the current index
+			size_t maxBuffer = 100;
+			/// a navigation counts as a skip if it comes this soon after the previous one,
+			/// and skips older than this no longer widen the load window
+			std::chrono::seconds skipWindow = std::chrono::seconds(30);
+			/// loaded items further than this from the load window may be unloaded. 0 to never unload
+			size_t unloadDistance = 500;
+		};
+
+		struct Window {
+			size_t loadStartIndex;
+			size_t loadEndIndex;
+			/// the range of items to keep loaded, if items outside of it should be unloaded
+			Optional<std::pair<size_t,size_t>> keepRange;
+		};
+
+		void recordNavigation(Direction direction);
+
+		Window window(size_t index, size_t chunkSize, Optional<size_t> itemCount, const Options& options) const;
+
+	private:
+		struct Navigation {
+			std::chrono::steady_clock::time_point time;
+			Direction direction;
+		};
+
+		static constexpr size_t maxNavigationHistory = 32;
+
+		LinkedList<Navigation> navigations;
+		mutable std::mutex mutex;
+	};
+}
@@ -11,6 +11,19 @@
 #include <soundhole/utils/Utils.hpp>
 
 namespace sh {
+	namespace {
+		Optional<size_t> indexOfQueueItem(const LinkedList<$<QueueItem>>& items, const $<QueueItem>& item) {
+			size_t index = 0;
+			for(auto& cmpItem : items) {
+				if(cmpItem == item) {
+					return index;
+				}
+				index++;
+			}
+			return std::nullopt;
+		}
+	}
+
 	$<PlaybackOrganizer> PlaybackOrganizer::new$(Delegate* delegate) {
 		return fgl::new$<PlaybackOrganizer>(delegate);
 	}
@@ -20,7 +33,8 @@ namespace sh {
 	PlaybackOrganizer::PlaybackOrganizer(Delegate* delegate)
 	: delegate(delegate),
 	shuffling(false), preparedNext(false),
-	applyingItem(std::nullopt), playingItem(std::nullopt) {
+	applyingItem(std::nullopt), playingItem(std::nullopt),
+	journalNeedsSnapshot(true) {
 		//
 	}
 
@@ -35,7 +49,7 @@ namespace sh {
 
 
 
-	Promise<void> PlaybackOrganizer::save(String path) {
+	Json PlaybackOrganizer::createSaveData() const {
 		auto currentItem = getCurrentItem();
 		if(currentItem.hasValue()) {
 			if(auto contextItem = currentItem->asCollectionItem()) {
@@ -45,8 +59,10 @@ namespace sh {
 			}
 		}
 		auto context = this->context;
+		Optional<uint32_t> shuffleSeed;
 		if(auto shuffledContext = context.as<ShuffledTrackCollection>()) {
 			context = shuffledContext->source();
+			shuffleSeed = shuffledContext->shuffleSeed();
 		}
 		size_t tracksOffset = 0;
 		size_t tracksLimit = 20;
@@ -90,8 +106,7 @@ namespace sh {
 			}
 			queuePast = queuePastArr;
 		}
-		// create json and save to file
-		auto json = Json(Json::object{
+		return Json::object{
 			{ "currentItem", currentItem ? currentItem->toJson() : Json() },
 			{ "context", contextJson },
 			{ "contextIndex", sourceContextIndex ? Json((double)sourceContextIndex->index) : Json() },
@@ -99,26 +114,93 @@ namespace sh {
 			{ "queue", queue.items.map([&](auto& queueItem) -> Json {
 				return queueItem->toJson();
 			}) },
-			{ "shuffling", shuffling }
+			{ "shuffling", shuffling },
+			{ "shuffleSeed", shuffleSeed ? Json((double)shuffleSeed.value()) : Json() }
+		};
+	}
+
+	$<utils::StateJournal> PlaybackOrganizer::journalForPath(const String& path) {
+		std::unique_lock<std::mutex> lock(journalMutex);
+		if(!journal || journal->path() != path) {
+			journal = fgl::new$<utils::StateJournal>(path);
+			journalNeedsSnapshot = true;
+			pendingJournalEntries.clear();
+		}
+		return journal;
+	}
+
+	void PlaybackOrganizer::markSnapshotNeeded() {
+		std::unique_lock<std::mutex> lock(journalMutex);
+		journalNeedsSnapshot = true;
+		pendingJournalEntries.clear();
+	}
+
+	void PlaybackOrganizer::journalQueueChange(Json entry) {
+		std::unique_lock<std::mutex> lock(journalMutex);
+		if(!journalNeedsSnapshot) {
+			pendingJournalEntries.pushBack(entry);
+		}
+	}
+
+	Promise<void> PlaybackOrganizer::save(String path) {
+		auto journal = journalForPath(path);
+		auto json = createSaveData();
+		std::unique_lock<std::mutex> lock(journalMutex);
+		journalNeedsSnapshot = false;
+		pendingJournalEntries.clear();
+		lock.unlock();
+		w$<PlaybackOrganizer> weakSelf = shared_from_this();
+		return promiseThread([=]() {
+			try {
+				journal->writeSnapshot(json);
+			} catch(...) {
+				if(auto self = weakSelf.lock()) {
+					self->markSnapshotNeeded();
+				}
+				throw;
+			}
 		});
+	}
+
+	Promise<void> PlaybackOrganizer::saveChanges(String path) {
+		auto journal = journalForPath(path);
+		std::unique_lock<std::mutex> lock(journalMutex);
+		if(journalNeedsSnapshot || journal->needsCompaction()) {
+			lock.unlock();
+			return save(path);
+		}
+		auto entries = pendingJournalEntries;
+		pendingJournalEntries.clear();
+		lock.unlock();
+		if(entries.empty()) {
+			return Promise<void>::resolve();
+		}
+		w$<PlaybackOrganizer> weakSelf = shared_from_this();
 		return promiseThread([=]() {
-			fs::writeFile(path, json.dump());
+			try {
+				journal->append(entries);
+			} catch(...) {
+				// the journal may be missing some of the entries, so it can't be appended to anymore
+				if(auto self = weakSelf.lock()) {
+					self->markSnapshotNeeded();
+				}
+				throw;
+			}
 		});
 	}
 
 	Promise<bool> PlaybackOrganizer::load(String path, MediaProviderStash* stash) {
+		auto journal = journalForPath(path);
 		return promiseThread([=]() {
 			try {
-				if(!fs::exists(path)) {
-					return Json();
-				}
-				auto data = fs::readFile(path);
-				std::string error;
-				return Json::parse(data, error);
+				return journal->read();
 			} catch(...) {
-				return Json();
+				return utils::StateJournal::Contents{
+					.snapshot = Json()
+				};
 			}
-		}).map([=](Json json) -> bool {
+		}).map([=](utils::StateJournal::Contents contents) -> bool {
+			auto json = contents.snapshot;
 			if(json.is_null()) {
 				return false;
 			}
@@ -128,6 +210,8 @@ namespace sh {
 			auto queuePastJson = json["queuePast"];
 			auto queueJson = json["queue"];
 			auto shuffling = json["shuffling"].bool_value();
+			auto shuffleSeedJson = json["shuffleSeed"];
+			auto shuffleSeed = shuffleSeedJson.is_number() ? maybe((uint32_t)shuffleSeedJson.number_value()) : std::nullopt;
 			// get current item
 			auto context = contextJson.is_null() ? $<TrackCollection>()
 				: std::dynamic_pointer_cast<TrackCollection>(
@@ -165,6 +249,22 @@ namespace sh {
 			for(auto itemJson : queuePastJson.array_items()) {
 				queuePastItems.pushBack(QueueItem::fromJson(itemJson, stash));
 			}
+			// replay queue changes saved after the snapshot
+			for(auto& entry : contents.entries) {
+				auto type = entry["type"].string_value();
+				if(type == "queueInsert") {
+					auto index = std::min((size_t)entry["index"].number_value(), queueNextItems.size());
+					queueNextItems.insert(std::next(queueNextItems.begin(), index), QueueItem::fromJson(entry["item"], stash));
+				} else if(type == "queueRemove") {
+					auto index = (size_t)entry["index"].number_value();
+					if(index < queueNextItems.size()) {
+						queueNextItems.erase(std::next(queueNextItems.begin(), index));
+					}
+				} else if(type == "queueClear") {
+					queueNextItems.clear();
+					queuePastItems.clear();
+				}
+			}
 			if(currentItem.hasValue()) {
 				// if current item is queue item, add to past items
 				if(auto queueItem = currentItem->asQueueItem()) {
@@ -177,7 +277,7 @@ namespace sh {
 			};
 			// update context / current item
 			if(context && contextItem) {
-				this->updateMainContext(context, contextItem, shuffling);
+				this->updateMainContext(context, contextItem, shuffling, shuffleSeed);
 			} else {
 				this->applyingItem = currentItem;
 				this->updateMainContext(nullptr, nullptr, shuffling);
@@ -201,6 +301,7 @@ namespace sh {
 
 
 	Promise<bool> PlaybackOrganizer::previous() {
+		contextLoadPolicy.recordNavigation(ContextLoadPolicy::Direction::BACKWARD);
 		auto valid = fgl::new$<bool>(false);
 		w$<PlaybackOrganizer> weakSelf = shared_from_this();
 		return setPlayingItem([=]() -> Promise<Optional<PlayerItem>> {
@@ -222,6 +323,7 @@ namespace sh {
 	}
 
 	Promise<bool> PlaybackOrganizer::next() {
+		contextLoadPolicy.recordNavigation(ContextLoadPolicy::Direction::FORWARD);
 		auto valid = fgl::new$<bool>(false);
 		w$<PlaybackOrganizer> weakSelf = shared_from_this();
 		return setPlayingItem([=]() -> Promise<Optional<PlayerItem>> {
@@ -324,6 +426,11 @@ namespace sh {
 
 	$<QueueItem> PlaybackOrganizer::addToQueue($<Track> track) {
 		auto queueItem = queue.appendItem(track);
+		journalQueueChange(Json::object{
+			{ "type", "queueInsert" },
+			{ "index", (double)indexOfQueueItem(queue.items, queueItem).value_or(queue.items.size()) },
+			{ "item", queueItem->toJson() }
+		});
 		// emit queue change event
 		std::unique_lock<std::mutex> lock(listenersMutex);
 		auto listeners = this->listeners;
@@ -337,6 +444,11 @@ namespace sh {
 
 	$<QueueItem> PlaybackOrganizer::addToQueueFront($<Track> track) {
 		auto queueItem = queue.prependItem(track);
+		journalQueueChange(Json::object{
+			{ "type", "queueInsert" },
+			{ "index", (double)indexOfQueueItem(queue.items, queueItem).value_or(queue.items.size()) },
+			{ "item", queueItem->toJson() }
+		});
 		// emit queue change event
 		std::unique_lock<std::mutex> lock(listenersMutex);
 		auto listeners = this->listeners;
@@ -350,6 +462,11 @@ namespace sh {
 
 	$<QueueItem> PlaybackOrganizer::addToQueueRandomly($<Track> track) {
 		auto queueItem = queue.insertItemRandomly(track);
+		journalQueueChange(Json::object{
+			{ "type", "queueInsert" },
+			{ "index", (double)indexOfQueueItem(queue.items, queueItem).value_or(queue.items.size()) },
+			{ "item", queueItem->toJson() }
+		});
 		// emit queue change event
 		std::unique_lock<std::mutex> lock(listenersMutex);
 		auto listeners = this->listeners;
@@ -362,7 +479,17 @@ namespace sh {
 	}
 
 	bool PlaybackOrganizer::removeFromQueue($<QueueItem> item) {
+		auto index = indexOfQueueItem(queue.items, item);
 		if(queue.removeItem(item)) {
+			if(index) {
+				journalQueueChange(Json::object{
+					{ "type", "queueRemove" },
+					{ "index", (double)index.value() }
+				});
+			} else {
+				// removed from the past queue, which is saved differently depending on the current item
+				markSnapshotNeeded();
+			}
 			// emit queue change event
 			std::unique_lock<std::mutex> lock(listenersMutex);
 			auto listeners = this->listeners;
@@ -380,6 +507,9 @@ namespace sh {
 		bool hadItems = !queue.pastItems.empty() || !queue.items.empty();
 		queue.clear();
 		if(hadItems) {
+			journalQueueChange(Json::object{
+				{ "type", "queueClear" }
+			});
 			// emit queue change event
 			std::unique_lock<std::mutex> lock(listenersMutex);
 			auto listeners = this->listeners;
@@ -702,12 +832,18 @@ namespace sh {
 
 
 	Promise<void> PlaybackOrganizer::prepareCollectionTracks($<TrackCollection> collection, size_t index) {
-		size_t startIndex = index;
-		if(startIndex <= prefs.contextLoadBuffer) {
-			startIndex = 0;
+		auto window = contextLoadPolicy.window(index, collection->itemsChunkSize(), collection->itemCount(), {
+			.minBuffer = prefs.contextLoadBuffer,
+			.maxBuffer = prefs.maxContextLoadBuffer,
+			.unloadDistance = prefs.contextUnloadDistance
+		});
+		if(window.keepRange) {
+			collection->unloadItemsOutsideRange(window.keepRange->first, window.keepRange->second);
+		}
+		if(window.loadEndIndex <= window.loadStartIndex) {
+			return Promise<void>::resolve();
 		}
-		size_t endIndex = index + prefs.contextLoadBuffer;
-		return collection->loadItems(startIndex, (endIndex - startIndex));
+		return collection->loadItems(window.loadStartIndex, (window.loadEndIndex - window.loadStartIndex));
 	}
 
 	Promise<void> PlaybackOrganizer::setPlayingItem(Function<Promise<Optional<PlayerItem>>()> itemGetter, SetPlayingOptions options) {
@@ -835,6 +971,7 @@ namespace sh {
 				
 				// apply item
 				applyingItem = item;
+				markSnapshotNeeded();
 				applyPlayingItem(item);
 				{// emit item change event
 					std::unique_lock<std::mutex> lock(self->listenersMutex);
@@ -944,8 +1081,9 @@ namespace sh {
 		})).promise;
 	}
 
-	void PlaybackOrganizer::updateMainContext($<TrackCollection> context, $<TrackCollectionItem> contextItem, bool shuffling) {
+	void PlaybackOrganizer::updateMainContext($<TrackCollection> context, $<TrackCollectionItem> contextItem, bool shuffling, Optional<uint32_t> shuffleSeed) {
 		FGL_ASSERT(context || !contextItem, "if context is null, contextItem should also be null");
+		markSnapshotNeeded();
 		auto prevContext = this->context;
 		auto prevContextItem = this->contextItem;
 		$<TrackCollection> prevSourceContext;
@@ -995,7 +1133,7 @@ namespace sh {
 					if(sourceContextItem) {
 						sourceItems.pushBack(sourceContextItem);
 					}
-					shuffledContext = ShuffledTrackCollection::new$(sourceContext, sourceItems);
+					shuffledContext = ShuffledTrackCollection::new$(sourceContext, sourceItems, shuffleSeed);
 					shuffledContextItem = std::static_pointer_cast<ShuffledTrackCollectionItem>(shuffledContext->itemAt(0));
 					context = shuffledContext;
 					contextItem = shuffledContextItem;
@@ -14,6 +14,8 @@
 #include <soundhole/media/QueueItem.hpp>
 #include <soundhole/media/PlayerItem.hpp>
 #include "PlaybackQueue.hpp"
+#include "ContextLoadPolicy.hpp"
+#include <soundhole/utils/StateJournal.hpp>
 
 namespace sh {
 	class PlaybackOrganizer: public std::enable_shared_from_this<PlaybackOrganizer> {
@@ -36,7 +38,12 @@ namespace sh {
 		};
 		
 		struct Preferences {
+			/// The minimum number of context items loaded around the current item
 			size_t contextLoadBuffer = 5;
+			/// The maximum number of context items loaded ahead of the current item when skipping quickly
+			size_t maxContextLoadBuffer = 100;
+			/// Loaded context items further than this from the loaded window get unloaded. 0 to never unload
+			size_t contextUnloadDistance = 500;
 			
 			/// Controls whether the player should keep track of a "past queue" or items from the queue that have been played already or skipped]
 			bool pastQueueEnabled = true;
@@ -61,7 +68,10 @@ namespace sh {
 		void addEventListener(EventListener* listener);
 		void removeEventListener(EventListener* listener);
 		
+		/// Writes the full organizer state to the given path
 		Promise<void> save(String path);
+		/// Appends the queue changes made since the last save to the given path, or writes the full state if needed
+		Promise<void> saveChanges(String path);
 		Promise<bool> load(String path, MediaProviderStash* stash);
 		
 		Promise<bool> previous();
@@ -107,7 +117,12 @@ namespace sh {
 		bool hasPreparedNext() const;
 		
 	private:
-		void updateMainContext($<TrackCollection> context, $<TrackCollectionItem> contextItem, bool shuffling);
+		Json createSaveData() const;
+		$<utils::StateJournal> journalForPath(const String& path);
+		void markSnapshotNeeded();
+		void journalQueueChange(Json entry);
+		
+		void updateMainContext($<TrackCollection> context, $<TrackCollectionItem> contextItem, bool shuffling, Optional<uint32_t> shuffleSeed = std::nullopt);
 		Promise<void> prepareCollectionTracks($<TrackCollection> collection, size_t index);
 		
 		struct SetPlayingOptions {
@@ -139,6 +154,14 @@ namespace sh {
 		Optional<PlayerItem> playingItem;
 		
 		PlaybackQueue queue;
+		ContextLoadPolicy contextLoadPolicy;
+		
+		$<utils::StateJournal> journal;
+		/// queue changes that haven't been appended to the journal yet
+		LinkedList<Json> pendingJournalEntries;
+		/// set when a change can't be expressed as a journal entry, so the next save writes the full state
+		bool journalNeedsSnapshot;
+		std::mutex journalMutex;
 		
 		AsyncQueue playQueue;
 		AsyncQueue continuousPlayQueue;
@@ -24,6 +24,7 @@ namespace sh {
 	streamPlaybackProvider(new StreamPlaybackProvider(streamPlayer)),
 	playbackProvider(nullptr),
 	preparedPlaybackProvider(nullptr),
+	progressJournal(getProgressFilePath()),
 	historyManager(nullptr),
 	scrobbleManager(nullptr) {
 		organizer->addEventListener(this);
@@ -109,17 +110,21 @@ namespace sh {
 				return resolveVoid();
 			}
 			return promiseThread([=]() -> Optional<ProgressData> {
-				// load progress data
-				auto progressPath = self->getProgressFilePath();
-				if(fs::exists(progressPath)) {
-					auto data = fs::readFile(progressPath);
-					std::string jsonError;
-					auto json = Json::parse(data, jsonError);
-					if(!json.is_null()) {
-						return ProgressData::fromJson(json);
+				// load progress data and replay the progress updates saved after it
+				auto contents = self->progressJournal.read();
+				Optional<ProgressData> progressData;
+				if(contents.snapshot.is_object()) {
+					progressData = ProgressData::fromJson(contents.snapshot);
+				}
+				for(auto& entry : contents.entries) {
+					if(entry["progress"].is_object()) {
+						progressData = ProgressData::fromJson(entry["progress"]);
+					} else if(entry["position"].is_number() && progressData) {
+						progressData->position = entry["position"].number_value();
 					}
 				}
-				return std::nullopt;
+				self->journaledProgress = progressData;
+				return progressData;
 			}).then([=](Optional<ProgressData> progressData) {
 				// load organizer
 				auto metadataPath = self->getMetadataFilePath();
@@ -172,10 +177,9 @@ namespace sh {
 		auto metadataPromise = Promise<void>::resolve();
 		if(options.includeMetadata) {
 			auto metadataPath = getMetadataFilePath();
-			metadataPromise = organizer->save(metadataPath);
+			metadataPromise = organizer->saveChanges(metadataPath);
 		}
 		return metadataPromise.then([=]() {
-			auto progressPath = self->getProgressFilePath();
 			if(currentTrack && playbackState) {
 				auto progressData = ProgressData{
 					.uri = currentTrack->uri(),
@@ -184,14 +188,25 @@ namespace sh {
 					.position = playbackState->position
 				};
 				return promiseThread([=]() {
-					auto json = progressData.toJson().dump();
-					fs::writeFile(progressPath, json);
+					auto& prevProgress = self->journaledProgress;
+					if(self->progressJournal.needsCompaction()) {
+						self->progressJournal.writeSnapshot(progressData.toJson());
+					} else if(prevProgress && prevProgress->uri == progressData.uri && prevProgress->providerName == progressData.providerName) {
+						// same track, so only the position has changed
+						self->progressJournal.append(Json(Json::object{
+							{ "position", progressData.position }
+						}));
+					} else {
+						self->progressJournal.append(Json(Json::object{
+							{ "progress", progressData.toJson() }
+						}));
+					}
+					self->journaledProgress = progressData;
 				});
 			} else {
 				return promiseThread([=]() {
-					if(fs::exists(progressPath)) {
-						fs::removeAll(progressPath);
-					}
+					self->progressJournal.clear();
+					self->journaledProgress = std::nullopt;
 				});
 			}
 		});
@@ -14,6 +14,7 @@
 #include <soundhole/media/PlaybackHistoryItem.hpp>
 #include <soundhole/media/ShuffledTrackCollection.hpp>
 #include <soundhole/database/MediaDatabase.hpp>
+#include <soundhole/utils/StateJournal.hpp>
 #include "PlaybackOrganizer.hpp"
 #include "StreamPlaybackProvider.hpp"
 #include "MediaControls.hpp"
@@ -255,6 +256,9 @@ namespace sh {
 		
 		Optional<ProgressData> resumableProgress;
 		Optional<std::chrono::steady_clock::time_point> lastSaveTime;
+		utils::StateJournal progressJournal;
+		/// the progress that the progress journal currently resolves to
+		Optional<ProgressData> journaledProgress;
 		
 		AsyncQueue playQueue;
 		AsyncQueue saveQueue;
@@ -10,6 +10,7 @@
 #include "LastFMAPIRequest.hpp"
 #include <soundhole/utils/js/JSUtils.hpp>
 #include <soundhole/utils/SecureStore.hpp>
+#include <soundhole/utils/RequestScheduler.hpp>
 
 namespace sh {
 	const LastFM::APIConfig LastFM::APICONFIG_LASTFM = LastFM::APIConfig{
@@ -23,6 +24,11 @@ namespace sh {
 
 	LastFM::LastFM(Options options, APIConfig apiConfig): auth(new LastFMAuth(options.auth, apiConfig)) {
 		auth->load();
+		// last.fm asks clients to stay under 5 requests per second
+		utils::RequestScheduler::shared()->setGroupOptions("lastfm", {
+			.requestsPerSecond = 5,
+			.burst = 5
+		});
 	}
 
 	LastFM::~LastFM() {
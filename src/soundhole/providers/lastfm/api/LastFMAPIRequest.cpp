@@ -68,7 +68,8 @@ namespace sh {
 			.url = URL(url),
 			.method = httpMethod,
 			.headers = headers,
-			.data = body
+			.data = body,
+			.rateLimitGroup = "lastfm"
 		};
 	}
 
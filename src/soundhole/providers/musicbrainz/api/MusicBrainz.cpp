@@ -10,6 +10,7 @@
 #include "MusicBrainz.hpp"
 #include "MusicBrainzError.hpp"
 #include <soundhole/scripts/Scripts.hpp>
+#include <soundhole/utils/RequestScheduler.hpp>
 #include <soundhole/utils/js/JSUtils.hpp>
 #include <soundhole/utils/js/JSWrapClass.impl.hpp>
 
@@ -17,6 +18,11 @@ namespace sh {
 	MusicBrainz::MusicBrainz(Options options)
 	: options(options) {
 		// TODO load auth
+		// musicbrainz allows 1 request per second
+		utils::RequestScheduler::shared()->setGroupOptions("musicbrainz", {
+			.requestsPerSecond = 1,
+			.burst = 1
+		});
 	}
 
 	MusicBrainz::~MusicBrainz() {
@@ -66,7 +72,8 @@ namespace sh {
 			.method = method,
 			.headers = utils::HttpHeaders(Map<String,String>{
 				{ "User-Agent", userAgent() }
-			})
+			}),
+			.rateLimitGroup = "musicbrainz"
 		}).map(nullptr, [](auto response) {
 			if(response->statusCode < 200 || response->statusCode >= 300) {
 				throw MusicBrainzError(MusicBrainzError::Code::REQUEST_FAILED, response->statusMessage);
@@ -365,6 +365,16 @@ namespace sh {
 
 
 
+	MediaProvider::DataBatchSizes SpotifyMediaProvider::dataBatchSizes() const {
+		return DataBatchSizes{
+			.tracks = 50,
+			.artists = 50,
+			.albums = 20,
+			.playlists = 1,
+			.users = 1
+		};
+	}
+
 	Promise<ArrayList<Track::Data>> SpotifyMediaProvider::getTracksData(ArrayList<String> uris) {
 		auto ids = uris.map([&](auto& uri) { return parseURI(uri).id; });
 		return spotify->getTracks(ids, {
@@ -692,7 +702,8 @@ namespace sh {
 					return generateMediaItems(nullptr, [=]() {
 						return spotify->getMyPlaylists({
 							.limit = 50,
-							.offset = sharedData->offset
+							.offset = sharedData->offset,
+							.priority = utils::RequestPriority::BACKGROUND
 						}).map([=](SpotifyPage<SpotifyPlaylist> page) {
 							return page.map([=](auto& item) {
 								return LibraryItem{
@@ -709,7 +720,8 @@ namespace sh {
 						return spotify->getMyAlbums({
 							.market = "from_token",
 							.limit = 50,
-							.offset = sharedData->offset
+							.offset = sharedData->offset,
+							.priority = utils::RequestPriority::BACKGROUND
 						}).map([=](SpotifyPage<SpotifySavedAlbum> page) {
 							return page.map([=](auto& item) {
 								return LibraryItem{
@@ -726,7 +738,8 @@ namespace sh {
 						return spotify->getMyTracks({
 							.market = "from_token",
 							.limit = 50,
-							.offset = sharedData->offset
+							.offset = sharedData->offset,
+							.priority = utils::RequestPriority::BACKGROUND
 						}).map([=](SpotifyPage<SpotifySavedTrack> page) {
 							return page.map([=](auto& item) {
 								return LibraryItem{
@@ -60,6 +60,7 @@ namespace sh {
 		virtual Promise<ArrayList<Track::Data>> getTracksData(ArrayList<String> uris) override;
 		virtual Promise<ArrayList<Artist::Data>> getArtistsData(ArrayList<String> uris) override;
 		virtual Promise<ArrayList<Album::Data>> getAlbumsData(ArrayList<String> uris) override;
+		virtual DataBatchSizes dataBatchSizes() const override;
 		
 		virtual Promise<ArrayList<$<Track>>> getArtistTopTracks(String artistURI) override;
 		virtual ArtistAlbumsGenerator getArtistAlbums(String artistURI) override;
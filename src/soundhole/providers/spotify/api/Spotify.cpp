@@ -8,8 +8,17 @@
 
 #include "Spotify.hpp"
 #include <soundhole/utils/HttpClient.hpp>
+#include <soundhole/utils/FanOut.hpp>
 
 namespace sh {
+	// the maximum number of ids accepted by the batch endpoints
+	constexpr size_t SPOTIFY_MAX_TRACK_IDS = 50;
+	constexpr size_t SPOTIFY_MAX_ARTIST_IDS = 50;
+	constexpr size_t SPOTIFY_MAX_ALBUM_IDS = 20;
+	constexpr size_t SPOTIFY_MAX_CONTAINS_IDS = 50;
+	// the maximum number of chunk requests sent at once when a batch call exceeds its id limit
+	constexpr size_t SPOTIFY_MAX_CONCURRENT_CHUNKS = 4;
+
 	Spotify::Spotify(Options options)
 	: playerOptions(options.player),
 	auth(new SpotifyAuth(options.auth)), player(nullptr) {
@@ -227,7 +236,7 @@ namespace sh {
 		});
 	}
 	
-	Promise<Json> Spotify::sendRequest(utils::HttpMethod method, String endpoint, std::map<String,String> queryParams, Json bodyParams) {
+	Promise<Json> Spotify::sendRequest(utils::HttpMethod method, String endpoint, std::map<String,String> queryParams, Json bodyParams, utils::RequestPriority priority) {
 		return prepareForRequest().then([=]() -> Promise<Json> {
 			String url = "https://api.spotify.com/" + endpoint;
 			if(queryParams.size() > 0) {
@@ -247,7 +256,9 @@ namespace sh {
 				.url = URL(url),
 				.method = method,
 				.headers = headers,
-				.data = body
+				.data = body,
+				.rateLimitGroup = "spotify",
+				.priority = priority
 			};
 			return utils::performHttpRequest(request)
 			.then([=](utils::SharedHttpResponse response) -> Promise<utils::SharedHttpResponse> {
@@ -351,7 +362,7 @@ namespace sh {
 		if(options.offset.has_value()) {
 			params["offset"] = std::to_string(options.offset.value());
 		}
-		return sendRequest(utils::HttpMethod::GET, "v1/me/tracks", params).map([](auto json) -> SpotifyPage<SpotifySavedTrack> {
+		return sendRequest(utils::HttpMethod::GET, "v1/me/tracks", params, Json(), options.priority).map([](auto json) -> SpotifyPage<SpotifySavedTrack> {
 			return SpotifyPage<SpotifySavedTrack>::fromJson(json);
 		});
 	}
@@ -367,7 +378,7 @@ namespace sh {
 		if(options.offset.has_value()) {
 			params["offset"] = std::to_string(options.offset.value());
 		}
-		return sendRequest(utils::HttpMethod::GET, "v1/me/albums", params).map([](auto json) -> SpotifyPage<SpotifySavedAlbum> {
+		return sendRequest(utils::HttpMethod::GET, "v1/me/albums", params, Json(), options.priority).map([](auto json) -> SpotifyPage<SpotifySavedAlbum> {
 			return SpotifyPage<SpotifySavedAlbum>::fromJson(json);
 		});
 	}
@@ -380,7 +391,7 @@ namespace sh {
 		if(options.offset.has_value()) {
 			params["offset"] = std::to_string(options.offset.value());
 		}
-		return sendRequest(utils::HttpMethod::GET, "v1/me/playlists", params).map([](auto json) -> SpotifyPage<SpotifyPlaylist> {
+		return sendRequest(utils::HttpMethod::GET, "v1/me/playlists", params, Json(), options.priority).map([](auto json) -> SpotifyPage<SpotifyPlaylist> {
 			return SpotifyPage<SpotifyPlaylist>::fromJson(json);
 		});
 	}
@@ -429,6 +440,11 @@ namespace sh {
 	}
 	
 	Promise<ArrayList<SpotifyAlbum>> Spotify::getAlbums(ArrayList<String> albumIds, GetAlbumsOptions options) {
+		if(albumIds.size() > SPOTIFY_MAX_ALBUM_IDS) {
+			return utils::ChunkedFanOut<String,SpotifyAlbum>::all(albumIds, SPOTIFY_MAX_ALBUM_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return getAlbums(chunk, options);
+			});
+		}
 		std::map<String,String> params;
 		if(!options.market.empty()) {
 			params["market"] = options.market;
@@ -482,6 +498,11 @@ namespace sh {
 	}
 	
 	Promise<ArrayList<SpotifyArtist>> Spotify::getArtists(ArrayList<String> artistIds) {
+		if(artistIds.size() > SPOTIFY_MAX_ARTIST_IDS) {
+			return utils::ChunkedFanOut<String,SpotifyArtist>::all(artistIds, SPOTIFY_MAX_ARTIST_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return getArtists(chunk);
+			});
+		}
 		std::map<String,String> params;
 		params["ids"] = String::join(artistIds, ",");
 		return sendRequest(utils::HttpMethod::GET, "v1/artists", params).map([](auto json) -> ArrayList<SpotifyArtist> {
@@ -580,6 +601,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<SpotifyTrack>> Spotify::getTracks(ArrayList<String> trackIds, GetTracksOptions options) {
+		if(trackIds.size() > SPOTIFY_MAX_TRACK_IDS) {
+			return utils::ChunkedFanOut<String,SpotifyTrack>::all(trackIds, SPOTIFY_MAX_TRACK_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return getTracks(chunk, options);
+			});
+		}
 		std::map<String,String> params;
 		if(!options.market.empty()) {
 			params["market"] = options.market;
@@ -853,6 +879,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<bool>> Spotify::checkFollowingArtists(ArrayList<String> artistIds) {
+		if(artistIds.size() > SPOTIFY_MAX_CONTAINS_IDS) {
+			return utils::ChunkedFanOut<String,bool>::all(artistIds, SPOTIFY_MAX_CONTAINS_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return checkFollowingArtists(chunk);
+			});
+		}
 		return sendRequest(utils::HttpMethod::GET, "v1/me/following/contains", {
 			{ "type", "artist" }
 		}, Json::object{
@@ -903,6 +934,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<bool>> Spotify::checkFollowingUsers(ArrayList<String> userIds) {
+		if(userIds.size() > SPOTIFY_MAX_CONTAINS_IDS) {
+			return utils::ChunkedFanOut<String,bool>::all(userIds, SPOTIFY_MAX_CONTAINS_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return checkFollowingUsers(chunk);
+			});
+		}
 		return sendRequest(utils::HttpMethod::GET, "v1/me/following/contains", {
 			{ "type", "user" }
 		}, Json::object{
@@ -981,6 +1017,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<bool>> Spotify::checkSavedTracks(ArrayList<String> trackIds) {
+		if(trackIds.size() > SPOTIFY_MAX_CONTAINS_IDS) {
+			return utils::ChunkedFanOut<String,bool>::all(trackIds, SPOTIFY_MAX_CONTAINS_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return checkSavedTracks(chunk);
+			});
+		}
 		return sendRequest(utils::HttpMethod::GET, "v1/me/tracks/contains", {
 			{ "ids", String::join(trackIds, ",") }
 		}, nullptr).map([](auto json) -> ArrayList<bool> {
@@ -1010,6 +1051,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<bool>> Spotify::checkSavedAlbums(ArrayList<String> albumIds) {
+		if(albumIds.size() > SPOTIFY_MAX_ALBUM_IDS) {
+			return utils::ChunkedFanOut<String,bool>::all(albumIds, SPOTIFY_MAX_ALBUM_IDS, {.maxConcurrent=SPOTIFY_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return checkSavedAlbums(chunk);
+			});
+		}
 		return sendRequest(utils::HttpMethod::GET, "v1/me/albums/contains", {
 			{ "ids", String::join(albumIds, ",") }
 		}, nullptr).map([](auto json) -> ArrayList<bool> {
@@ -65,7 +65,7 @@ namespace sh {
 		
 		#pragma mark metadata
 		
-		Promise<Json> sendRequest(utils::HttpMethod method, String endpoint, std::map<String,String> queryParams = {}, Json bodyParams = Json());
+		Promise<Json> sendRequest(utils::HttpMethod method, String endpoint, std::map<String,String> queryParams = {}, Json bodyParams = Json(), utils::RequestPriority priority = utils::RequestPriority::INTERACTIVE);
 		
 		#pragma mark metadata: my library
 		
@@ -74,17 +74,20 @@ namespace sh {
 			String market;
 			Optional<size_t> limit;
 			Optional<size_t> offset;
+			utils::RequestPriority priority = utils::RequestPriority::INTERACTIVE;
 		};
 		Promise<SpotifyPage<SpotifySavedTrack>> getMyTracks(GetMyTracksOptions options = {});
 		struct GetMyAlbumsOptions {
 			String market;
 			Optional<size_t> limit;
 			Optional<size_t> offset;
+			utils::RequestPriority priority = utils::RequestPriority::INTERACTIVE;
 		};
 		Promise<SpotifyPage<SpotifySavedAlbum>> getMyAlbums(GetMyAlbumsOptions options = {});
 		struct GetMyPlaylistsOptions {
 		   Optional<size_t> limit;
 		   Optional<size_t> offset;
+		   utils::RequestPriority priority = utils::RequestPriority::INTERACTIVE;
 		};
 		Promise<SpotifyPage<SpotifyPlaylist>> getMyPlaylists(GetMyPlaylistsOptions options = {});
 		
@@ -721,6 +721,16 @@ namespace sh {
 
 
 
+	MediaProvider::DataBatchSizes YoutubeMediaProvider::dataBatchSizes() const {
+		return DataBatchSizes{
+			.tracks = 50,
+			.artists = 50,
+			.albums = 1,
+			.playlists = 50,
+			.users = 50
+		};
+	}
+
 	Promise<ArrayList<Track::Data>> YoutubeMediaProvider::getTracksData(ArrayList<String> uris) {
 		auto ids = uris.map([&](auto& uri) { return parseURI(uri).id; });
 		return youtube->getVideos(ids).map([=](auto videos) {
@@ -62,6 +62,7 @@ namespace sh {
 		virtual Promise<ArrayList<Album::Data>> getAlbumsData(ArrayList<String> uris) override;
 		virtual Promise<ArrayList<Playlist::Data>> getPlaylistsData(ArrayList<String> uris) override;
 		virtual Promise<ArrayList<UserAccount::Data>> getUsersData(ArrayList<String> uris) override;
+		virtual DataBatchSizes dataBatchSizes() const override;
 		
 		virtual Promise<ArrayList<$<Track>>> getArtistTopTracks(String artistURI) override;
 		virtual ArtistAlbumsGenerator getArtistAlbums(String artistURI) override;
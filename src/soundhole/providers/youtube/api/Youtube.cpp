@@ -11,9 +11,39 @@
 #include "YoutubeError.hpp"
 #include <soundhole/scripts/Scripts.hpp>
 #include <soundhole/utils/js/JSWrapClass.impl.hpp>
+#include <soundhole/utils/FanOut.hpp>
 
 namespace sh {
 	String YOUTUBE_API_URL = "https://www.googleapis.com/youtube/v3";
+	// the maximum number of ids accepted by a list request
+	constexpr size_t YOUTUBE_MAX_IDS = 50;
+	// the maximum number of chunk requests sent at once when a list request exceeds the id limit
+	constexpr size_t YOUTUBE_MAX_CONCURRENT_CHUNKS = 4;
+
+	/// Merges the pages of a list request that was split into chunks of ids
+	template<typename T>
+	YoutubePage<T> mergeYoutubeIdPages(ArrayList<YoutubePage<T>> pages) {
+		YoutubePage<T> mergedPage;
+		mergedPage.pageInfo = YoutubePageInfo{
+			.totalResults = 0,
+			.resultsPerPage = 0
+		};
+		if(pages.size() > 0) {
+			mergedPage.kind = pages.front().kind;
+			mergedPage.etag = pages.front().etag;
+		}
+		size_t totalCount = 0;
+		for(auto& page : pages) {
+			totalCount += page.items.size();
+		}
+		mergedPage.items.reserve(totalCount);
+		for(auto& page : pages) {
+			mergedPage.pageInfo.totalResults += page.pageInfo.totalResults;
+			mergedPage.pageInfo.resultsPerPage += page.pageInfo.resultsPerPage;
+			mergedPage.items.pushBackList(std::move(page.items));
+		}
+		return mergedPage;
+	}
 
 	String Youtube::MediaType_toString(MediaType mediaType) {
 		switch(mediaType) {
@@ -131,7 +161,8 @@ namespace sh {
 			.url = URL(YOUTUBE_API_URL+'/'+endpoint+'?'+URL::makeQueryString(query)),
 			.method = method,
 			.headers = headers,
-			.data = bodyData
+			.data = bodyData,
+			.rateLimitGroup = "youtube"
 		};
 		auto response = co_await utils::performHttpRequest(request);
 		// if response is unauthorized, refresh token and try again
@@ -234,6 +265,11 @@ namespace sh {
 	}
 
 	Promise<ArrayList<YoutubeVideo>> Youtube::getVideos(ArrayList<String> ids) {
+		if(ids.size() > YOUTUBE_MAX_IDS) {
+			return utils::ChunkedFanOut<String,YoutubeVideo>::all(ids, YOUTUBE_MAX_IDS, {.maxConcurrent=YOUTUBE_MAX_CONCURRENT_CHUNKS}, [=](auto chunk) {
+				return getVideos(chunk);
+			});
+		}
 		return sendApiRequest(utils::HttpMethod::GET, "videos", {
 			{ "id", String::join(ids, ",") },
 			{ "part", "id,snippet,contentDetails" }
@@ -253,6 +289,16 @@ namespace sh {
 
 
 	Promise<YoutubePage<YoutubeChannel>> Youtube::getChannels(GetChannelsOptions options) {
+		if(options.ids.size() > YOUTUBE_MAX_IDS && options.pageToken.empty()) {
+			auto chunks = utils::ChunkedFanOut<String,String>::chunks(options.ids, YOUTUBE_MAX_IDS);
+			return utils::FanOut<ArrayList<String>,YoutubePage<YoutubeChannel>>::all(chunks, {.maxConcurrent=YOUTUBE_MAX_CONCURRENT_CHUNKS}, [=](auto& chunk) {
+				auto chunkOptions = options;
+				chunkOptions.ids = chunk;
+				return getChannels(chunkOptions);
+			}).map([=](auto pages) -> YoutubePage<YoutubeChannel> {
+				return mergeYoutubeIdPages(std::move(pages));
+			});
+		}
 		auto query = std::map<String,String>{
 			{ "part", "id,snippet,contentDetails,status,statistics,topicDetails" }
 		};
@@ -461,6 +507,16 @@ namespace sh {
 
 
 	Promise<YoutubePage<YoutubePlaylist>> Youtube::getPlaylists(GetPlaylistsOptions options) {
+		if(options.ids.size() > YOUTUBE_MAX_IDS && options.pageToken.empty()) {
+			auto chunks = utils::ChunkedFanOut<String,String>::chunks(options.ids, YOUTUBE_MAX_IDS);
+			return utils::FanOut<ArrayList<String>,YoutubePage<YoutubePlaylist>>::all(chunks, {.maxConcurrent=YOUTUBE_MAX_CONCURRENT_CHUNKS}, [=](auto& chunk) {
+				auto chunkOptions = options;
+				chunkOptions.ids = chunk;
+				return getPlaylists(chunkOptions);
+			}).map([=](auto pages) -> YoutubePage<YoutubePlaylist> {
+				return mergeYoutubeIdPages(std::move(pages));
+			});
+		}
 		auto query = std::map<String,String>{
 			{ "part", "id,snippet,status,contentDetails,player,localizations" }
 		};
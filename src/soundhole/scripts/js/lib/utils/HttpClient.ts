@@ -1,7 +1,8 @@
-
 import { URL } from 'url';
 import http from 'http';
 import https from 'https';
+import zlib from 'zlib';
+import { Readable } from 'stream';
 
 type HttpClient = {
 	request: (url: string | URL, opts: http.RequestOptions, callback: (res: http.IncomingMessage) => void) => http.ClientRequest
@@ -12,13 +13,61 @@ export type HttpRequest = {
 	method: 'GET' | 'POST' | 'PUT' | 'DELETE' | 'OPTIONS'
 	headers?: http.OutgoingHttpHeaders
 	data?: Buffer | null
+	// when given, each chunk of the decoded body is passed here as it arrives, and the response has no chunks
+	onData?: ((chunk: Buffer) => void) | null
 }
 
 export type HttpResponse = {
 	statusCode: number
 	statusMessage: string
 	headers: http.IncomingHttpHeaders,
-	data: Uint8Array
+	// the body, split into the chunks that it arrived in, so that they can be copied straight into the native response
+	chunks: Buffer[]
+	byteLength: number
+}
+
+// keep-alive agents, keyed by protocol and host, so that connections are reused between requests
+const agents: { [key: string]: http.Agent } = {};
+const maxSocketsPerHost = 6;
+
+function getAgent(url: URL): http.Agent {
+	const key = url.protocol+'//'+url.host;
+	let agent = agents[key];
+	if(agent == null) {
+		const agentOptions = {
+			keepAlive: true,
+			maxSockets: maxSocketsPerHost
+		};
+		agent = (url.protocol === 'https:') ? new https.Agent(agentOptions) : new http.Agent(agentOptions);
+		agents[key] = agent;
+	}
+	return agent;
+}
+
+function hasHeader(headers: http.OutgoingHttpHeaders | undefined, name: string): boolean {
+	if(headers == null) {
+		return false;
+	}
+	for(const key of Object.keys(headers)) {
+		if(key.toLowerCase() === name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+function createDecoder(contentEncoding: string | undefined): NodeJS.ReadWriteStream | null {
+	switch((contentEncoding ?? '').trim().toLowerCase()) {
+		case 'gzip':
+		case 'x-gzip':
+			return zlib.createGunzip();
+		case 'deflate':
+			return zlib.createInflate();
+		case 'br':
+			return zlib.createBrotliDecompress();
+		default:
+			return null;
+	}
 }
 
 export function performHttpRequest(request: HttpRequest, callback: (error: Error | null, response: HttpResponse | null) => void) {
@@ -31,39 +80,69 @@ export function performHttpRequest(request: HttpRequest, callback: (error: Error
 	} else {
 		throw new Error("Invalid protocol "+url.protocol);
 	}
-	const buffers: Buffer[] = [];
-	let errored = false;
+	// only decode bodies that we asked to be compressed
+	const decodeResponse = !hasHeader(request.headers, 'accept-encoding');
+	const headers: http.OutgoingHttpHeaders = Object.assign({}, request.headers);
+	if(decodeResponse) {
+		headers['accept-encoding'] = 'gzip, deflate, br';
+	}
+	let finished = false;
+	const finish = (error: Error | null, response: HttpResponse | null) => {
+		if(finished) {
+			return;
+		}
+		finished = true;
+		callback(error, response);
+	};
 	const req = client.request(url, {
 		method: request.method,
-		headers: request.headers
+		headers: headers,
+		agent: getAgent(url)
 	}, (res) => {
-		res.on('data', (chunk) => {
-			buffers.push(chunk);
-		});
-		res.on('end', () => {
-			if(errored) {
-				return;
-			}
-			const buffer = Buffer.concat(buffers);
-			const arrayBuffer = new ArrayBuffer(buffer.length);
-			const data = new Uint8Array(arrayBuffer);
-			for(let i=0; i<buffer.length; i++) {
-				data[i] = buffer[i];
+		let body: Readable | NodeJS.ReadWriteStream = res;
+		const resHeaders = res.headers;
+		const decoder = decodeResponse ? createDecoder(resHeaders['content-encoding']) : null;
+		if(decoder != null) {
+			res.once('error', (error: Error) => {
+				finish(error, null);
+			});
+			body = res.pipe(decoder);
+			delete resHeaders['content-encoding'];
+			delete resHeaders['content-length'];
+		}
+		const chunks: Buffer[] = [];
+		let byteLength = 0;
+		body.on('data', (chunk: Buffer) => {
+			if(request.onData != null) {
+				try {
+					request.onData(chunk);
+				} catch(error) {
+					req.destroy();
+					finish(error as Error, null);
+				}
+			} else {
+				chunks.push(chunk);
+				byteLength += chunk.length;
 			}
-			callback(null, {
+		});
+		body.once('error', (error: Error) => {
+			finish(error, null);
+		});
+		body.once('end', () => {
+			finish(null, {
 				statusCode: res.statusCode as number,
 				statusMessage: res.statusMessage as string,
-				headers: res.headers,
-				data: data
+				headers: resHeaders,
+				chunks: chunks,
+				byteLength: byteLength
 			});
 		});
 	});
 
 	req.once('error', (error) => {
-		errored = true;
-		callback(error, null);
+		finish(error, null);
 	});
-	
+
 	if(request.data != null) {
 		req.write(request.data);
 	}
@@ -14,9 +14,14 @@
 
 namespace sh {
 	SoundHole::SoundHole(Options options)
-	: _mediaLibrary(nullptr), _streamPlayer(nullptr), _player(nullptr) {
+	: _mediaLibrary(nullptr), _streamPlayer(nullptr), _player(nullptr), _httpResponseCache(nullptr) {
 		_streamPlayer = StreamPlayer::new$();
 		
+		if(options.httpResponseCache) {
+			_httpResponseCache = new utils::HttpResponseCache(options.httpResponseCache.value());
+			utils::setHttpResponseCache(_httpResponseCache);
+		}
+		
 		if(options.soundhole) {
 			_mediaProviders.pushBack(new SoundHoleMediaProvider(this, options.soundhole.value()));
 		}
@@ -61,6 +66,12 @@ namespace sh {
 			delete scrobbler;
 		}
 		delete _mediaLibrary;
+		if(_httpResponseCache != nullptr) {
+			if(utils::getHttpResponseCache() == _httpResponseCache) {
+				utils::setHttpResponseCache(nullptr);
+			}
+			delete _httpResponseCache;
+		}
 	}
 
 
@@ -105,6 +116,12 @@ namespace sh {
 
 
 
+	utils::HttpResponseCache* SoundHole::httpResponseCache() {
+		return _httpResponseCache;
+	}
+
+
+
 	void SoundHole::addMediaProvider(MediaProvider* mediaProvider) {
 		_mediaProviders.pushBack(mediaProvider);
 	}
@@ -19,6 +19,7 @@
 #include <soundhole/playback/SystemMediaControls.hpp>
 #include <soundhole/utils/Utils.hpp>
 #include <soundhole/utils/SoundHoleError.hpp>
+#include <soundhole/utils/HttpResponseCache.hpp>
 
 namespace sh {
 	class SoundHole: public MediaProviderStash, public ScrobblerStash {
@@ -26,6 +27,8 @@ namespace sh {
 		struct Options {
 			String dbPath;
 			Optional<Player::Options> player;
+			// when set, provider API responses are cached and revalidated
+			Optional<utils::HttpResponseCache::Options> httpResponseCache;
 			
 			Optional<SoundHoleMediaProvider::Options> soundhole;
 			Optional<SpotifyMediaProvider::Options> spotify;
@@ -48,6 +51,8 @@ namespace sh {
 		$<Player> player();
 		$<const Player> player() const;
 		
+		utils::HttpResponseCache* httpResponseCache();
+		
 		void addMediaProvider(MediaProvider* mediaProvider);
 		
 		virtual $<MediaItem> parseMediaItem(const Json& json) override;
@@ -109,6 +114,7 @@ namespace sh {
 		LinkedList<Scrobbler*> _scrobblers;
 		$<StreamPlayer> _streamPlayer;
 		$<Player> _player;
+		utils::HttpResponseCache* _httpResponseCache;
 	};
 
 
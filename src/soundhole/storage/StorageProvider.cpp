@@ -28,17 +28,15 @@ namespace sh {
 	}
 
 	Promise<ArrayList<Playlist::Data>> StorageProvider::getPlaylistsData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		return Promise<Playlist::Data>::all(uris.map([&](auto& uri) {
+		return utils::FanOut<String,Playlist::Data>::all(uris, {.maxConcurrent=4}, [=](auto& uri) {
 			return this->getPlaylistData(uri);
-		}));
+		});
 	}
 
 	Promise<ArrayList<UserAccount::Data>> StorageProvider::getUsersData(ArrayList<String> uris) {
-		// TODO handle 429 responses and try again
-		return Promise<UserAccount::Data>::all(uris.map([&](auto& uri) {
+		return utils::FanOut<String,UserAccount::Data>::all(uris, {.maxConcurrent=4}, [=](auto& uri) {
 			return this->getUserData(uri);
-		}));
+		});
 	}
 
 	#ifdef NODE_API_MODULE
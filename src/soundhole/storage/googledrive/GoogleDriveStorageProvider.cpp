@@ -11,6 +11,7 @@
 #include <soundhole/scripts/Scripts.hpp>
 #include <soundhole/utils/js/JSWrapClass.impl.hpp>
 #include <soundhole/utils/HttpClient.hpp>
+#include <soundhole/utils/RequestScheduler.hpp>
 #include <soundhole/utils/Utils.hpp>
 #include "mutators/GoogleDrivePlaylistMutatorDelegate.hpp"
 #include <cmath>
@@ -110,16 +111,32 @@ namespace sh {
 	#ifdef NODE_API_MODULE
 	template<typename Result>
 	Promise<Result> GoogleDriveStorageProvider::performAsyncJSAPIFunc(String funcName, Function<std::vector<napi_value>(napi_env)> createArgs, Function<Result(napi_env,Napi::Value)> mapper) {
-		return performAsyncFunc<Result>([=](napi_env env) {
-			return jsutils::jsValue<Napi::Object>(env, this->jsRef);
-		}, funcName, createArgs, mapper, {
-			.beforeFuncCall=[=](napi_env env) {
-				this->updateSessionFromJS(env);
-			},
-			.afterFuncFinish=[=](napi_env env) {
-				this->updateSessionFromJS(env);
-			}
-		});
+		auto perform = [=]() {
+			return performAsyncFunc<Result>([=](napi_env env) {
+				return jsutils::jsValue<Napi::Object>(env, this->jsRef);
+			}, funcName, createArgs, mapper, {
+				.beforeFuncCall=[=](napi_env env) {
+					this->updateSessionFromJS(env);
+				},
+				.afterFuncFinish=[=](napi_env env) {
+					this->updateSessionFromJS(env);
+				}
+			});
+		};
+		// the api requests are sent by the js client, so rate limit the calls into it instead of the http requests
+		auto scheduler = utils::RequestScheduler::shared();
+		if constexpr(std::is_void_v<Result>) {
+			return scheduler->scheduleTask(name(), utils::RequestPriority::INTERACTIVE, perform);
+		} else {
+			auto result = fgl::new$<Optional<Result>>();
+			return scheduler->scheduleTask(name(), utils::RequestPriority::INTERACTIVE, [=]() {
+				return perform().then([=](Result value) {
+					*result = value;
+				});
+			}).map([=]() -> Result {
+				return std::move(result->value());
+			});
+		}
 	}
 	#endif
 
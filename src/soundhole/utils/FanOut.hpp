@@ -0,0 +1,176 @@
+//
+//  FanOut.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <exception>
+#include <mutex>
+
+namespace sh::utils {
+	struct FanOutOptions {
+		/// the maximum number of tasks running at once
+		size_t maxConcurrent = 4;
+		/// whether to keep starting tasks after one fails. otherwise no new tasks are started after the first failure
+		bool continueOnError = false;
+	};
+
+	template<typename Result>
+	struct FanOutResult {
+		/// the result of each task, in the same order as the inputs. empty if the task failed or never started
+		ArrayList<Optional<Result>> values;
+		/// the error of each task, in the same order as the inputs. null if the task didn't fail
+		ArrayList<std::exception_ptr> errors;
+
+		bool failed() const {
+			for(auto& error : errors) {
+				if(error) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/// Throws the first error by input order, or returns every value
+		ArrayList<Result> valuesOrThrow() const {
+			for(auto& error : errors) {
+				if(error) {
+					std::rethrow_exception(error);
+				}
+			}
+			ArrayList<Result> results;
+			results.reserve(values.size());
+			for(auto& value : values) {
+				results.pushBack(value.value());
+			}
+			return results;
+		}
+	};
+
+	/// Runs a task for each input with bounded concurrency, keeping results in input order
+	template<typename Input, typename Result>
+	class FanOut {
+	public:
+		using Task = Function<Promise<Result>(const Input&)>;
+
+		/// Resolves once every started task has finished, with the value or error of each one
+		static Promise<FanOutResult<Result>> settled(ArrayList<Input> inputs, FanOutOptions options, Task task) {
+			auto state = fgl::new$<State>();
+			state->inputs = std::move(inputs);
+			state->task = task;
+			state->options = options;
+			state->nextIndex = 0;
+			state->stopped = false;
+			state->result.values.resize(state->inputs.size());
+			state->result.errors.resize(state->inputs.size());
+			size_t workerCount = std::min(std::max(options.maxConcurrent, (size_t)1), state->inputs.size());
+			ArrayList<Promise<void>> workers;
+			workers.reserve(workerCount);
+			for(size_t i=0; i<workerCount; i++) {
+				workers.pushBack(runWorker(state));
+			}
+			return Promise<void>::all(workers).map([=]() -> FanOutResult<Result> {
+				return std::move(state->result);
+			});
+		}
+
+		/// Resolves with every value in input order, or rejects with the first error by input order
+		static Promise<ArrayList<Result>> all(ArrayList<Input> inputs, FanOutOptions options, Task task) {
+			return settled(std::move(inputs), options, task).map([=](FanOutResult<Result> result) -> ArrayList<Result> {
+				return result.valuesOrThrow();
+			});
+		}
+
+	private:
+		struct State {
+			ArrayList<Input> inputs;
+			Task task;
+			FanOutOptions options;
+			size_t nextIndex;
+			bool stopped;
+			FanOutResult<Result> result;
+			std::mutex mutex;
+		};
+
+		static Optional<size_t> takeNextIndex($<State> state) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			if(state->stopped || state->nextIndex >= state->inputs.size()) {
+				return std::nullopt;
+			}
+			return state->nextIndex++;
+		}
+
+		static void fail($<State> state, size_t index, std::exception_ptr error) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->result.errors[index] = error;
+			if(!state->options.continueOnError) {
+				state->stopped = true;
+			}
+		}
+
+		/// Runs tasks one after another until there are no inputs left
+		static Promise<void> runWorker($<State> state) {
+			auto index = takeNextIndex(state);
+			if(!index) {
+				return Promise<void>::resolve();
+			}
+			size_t i = index.value();
+			Promise<Result> promise;
+			try {
+				promise = state->task(state->inputs[i]);
+			} catch(...) {
+				fail(state, i, std::current_exception());
+				return runWorker(state);
+			}
+			return promise.then([=](Result value) {
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->result.values[i] = std::move(value);
+			}).except([=](std::exception_ptr error) {
+				fail(state, i, error);
+			}).then([=]() {
+				return runWorker(state);
+			});
+		}
+	};
+
+	/// Splits items into chunks of a maximum size and runs a batch task for each chunk with bounded concurrency,
+	/// concatenating the results of every chunk in input order
+	template<typename Item, typename Result>
+	class ChunkedFanOut {
+	public:
+		using Task = Function<Promise<ArrayList<Result>>(ArrayList<Item>)>;
+
+		static ArrayList<ArrayList<Item>> chunks(const ArrayList<Item>& items, size_t chunkSize) {
+			chunkSize = std::max(chunkSize, (size_t)1);
+			ArrayList<ArrayList<Item>> chunks;
+			chunks.reserve((items.size() + chunkSize - 1) / chunkSize);
+			for(size_t i=0; i<items.size(); i+=chunkSize) {
+				chunks.pushBack(items.slice(i, std::min(chunkSize, items.size() - i)));
+			}
+			return chunks;
+		}
+
+		/// Resolves with the results of every chunk in input order, or rejects with the first error by input order
+		static Promise<ArrayList<Result>> all(const ArrayList<Item>& items, size_t chunkSize, FanOutOptions options, Task task) {
+			return FanOut<ArrayList<Item>,ArrayList<Result>>::all(chunks(items, chunkSize), options, [=](auto& chunk) {
+				return task(chunk);
+			}).map([=](ArrayList<ArrayList<Result>> chunkResults) -> ArrayList<Result> {
+				size_t totalCount = 0;
+				for(auto& results : chunkResults) {
+					totalCount += results.size();
+				}
+				ArrayList<Result> results;
+				results.reserve(totalCount);
+				for(auto& chunk : chunkResults) {
+					results.pushBackList(std::move(chunk));
+				}
+				return results;
+			});
+		}
+	};
+}
@@ -8,6 +8,10 @@
 
 #include <napi.h>
 #include "HttpClient.hpp"
+#include "NativeHttpClient.hpp"
+#include "HttpResponseCache.hpp"
+#include "RequestScheduler.hpp"
+#include <atomic>
 #include <stdexcept>
 #include <embed/nodejs/NodeJS.hpp>
 #include <soundhole/scripts/Scripts.hpp>
@@ -91,8 +95,48 @@ namespace sh::utils {
 	
 
 
-	#if !defined(TARGETPLATFORM_IOS) && !defined(TARGETPLATFORM_MAC)
+	std::atomic<HttpClientBackend> httpClientBackend = HttpClientBackend::NODEJS;
+
+	void setHttpClientBackend(HttpClientBackend backend) {
+		httpClientBackend = backend;
+	}
+
+	HttpClientBackend getHttpClientBackend() {
+		return httpClientBackend;
+	}
+
+	std::atomic<HttpResponseCache*> httpResponseCache = nullptr;
+
+	void setHttpResponseCache(HttpResponseCache* cache) {
+		httpResponseCache = cache;
+	}
+
+	HttpResponseCache* getHttpResponseCache() {
+		return httpResponseCache;
+	}
+
+	Promise<SharedHttpResponse> performScheduledHttpRequest(HttpRequest request) {
+		if(request.rateLimitGroup.empty()) {
+			return performUncachedHttpRequest(request);
+		}
+		return RequestScheduler::shared()->schedule(request.rateLimitGroup, request.priority, [=]() {
+			return performUncachedHttpRequest(request);
+		});
+	}
+
 	Promise<SharedHttpResponse> performHttpRequest(HttpRequest request) {
+		// the cache comes first so that cached responses don't count against rate limits
+		auto cache = getHttpResponseCache();
+		if(cache == nullptr) {
+			return performScheduledHttpRequest(request);
+		}
+		return cache->performRequest(request, performScheduledHttpRequest);
+	}
+
+
+
+	#if !defined(TARGETPLATFORM_IOS) && !defined(TARGETPLATFORM_MAC)
+	Promise<SharedHttpResponse> performNodeJSHttpRequest(HttpRequest request) {
 		return scripts::loadScriptsIfNeeded().then([=]() -> Promise<SharedHttpResponse> {
 			return Promise<SharedHttpResponse>([&](auto resolve, auto reject) {
 				try {
@@ -124,6 +168,17 @@ namespace sh::utils {
 							if(request.data.size() > 0) {
 								jsRequest.Set("data", Napi::Buffer<char>::Copy(env, request.data.data(), request.data.size()));
 							}
+							if(request.onData) {
+								auto onData = request.onData;
+								jsRequest.Set("onData", Napi::Function::New(env, [=](const Napi::CallbackInfo& info) {
+									auto chunk = info[0].As<Napi::Uint8Array>();
+									try {
+										onData(String((const char*)chunk.Data(), (size_t)chunk.ByteLength()));
+									} catch(std::exception& error) {
+										throw Napi::Error::New(info.Env(), error.what());
+									}
+								}));
+							}
 							performRequest.Call({ jsRequest, Napi::Function::New(env, [=](const Napi::CallbackInfo& info) {
 								Napi::Object errorObj = info[0].As<Napi::Object>();
 								Napi::Object responseObj = info[1].As<Napi::Object>();
@@ -151,8 +206,16 @@ namespace sh::utils {
 											response->headers.set((const std::string&)headerName, headerVal.As<Napi::String>());
 										}
 									}
-									auto dataBuffer = responseObj.Get("data").As<Napi::Uint8Array>().ArrayBuffer();
-									response->data = String((const char*)dataBuffer.Data(), (size_t)dataBuffer.ByteLength());
+									// copy the body chunks straight out of node's buffers. a Buffer may be a view into a larger pooled ArrayBuffer
+									auto chunks = responseObj.Get("chunks").As<Napi::Array>();
+									std::string data;
+									data.reserve((size_t)responseObj.Get("byteLength").ToNumber().Int64Value());
+									uint32_t chunkCount = chunks.Length();
+									for(uint32_t i=0; i<chunkCount; i++) {
+										auto chunk = chunks.Get(i).As<Napi::Uint8Array>();
+										data.append((const char*)chunk.Data(), (size_t)chunk.ByteLength());
+									}
+									response->data = String(std::move(data));
 									resolve(response);
 								} else {
 									reject(std::runtime_error((std::string)errorObj.ToString()));
@@ -171,6 +234,16 @@ namespace sh::utils {
 			});
 		});
 	}
+
+	Promise<SharedHttpResponse> performUncachedHttpRequest(HttpRequest request) {
+		switch(getHttpClientBackend()) {
+			case HttpClientBackend::NATIVE:
+				return NativeHttpClient::shared()->performRequest(request);
+			case HttpClientBackend::NODEJS:
+				return performNodeJSHttpRequest(request);
+		}
+		throw std::invalid_argument("Invalid HttpClientBackend value");
+	}
 	#endif
 
 
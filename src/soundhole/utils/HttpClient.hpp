@@ -41,11 +41,23 @@ namespace sh::utils {
 		ArrayList<String> get(String key) const;
 	};
 	
+	enum class RequestPriority {
+		// requests that the user is waiting on
+		INTERACTIVE,
+		// requests made by library synchronization and other background work
+		BACKGROUND
+	};
+	
 	struct HttpRequest {
 		URL url;
 		HttpMethod method;
 		HttpHeaders headers;
 		String data;
+		// when set, the response body is passed to this in chunks as it arrives instead of being stored in HttpResponse::data
+		Function<void(const String& chunk)> onData;
+		// when set, the request is rate limited by the shared RequestScheduler within this group
+		String rateLimitGroup;
+		RequestPriority priority = RequestPriority::INTERACTIVE;
 	};
 	
 	struct HttpResponse {
@@ -56,7 +68,25 @@ namespace sh::utils {
 	};
 	using SharedHttpResponse = std::shared_ptr<HttpResponse>;
 	
+	enum class HttpClientBackend {
+		// performs requests with the http module of the embedded node runtime
+		NODEJS,
+		// performs requests with NativeHttpClient on its own threads
+		NATIVE
+	};
+	
+	// Selects the backend used by performHttpRequest. Apple platforms always use NSURLSession
+	void setHttpClientBackend(HttpClientBackend backend);
+	HttpClientBackend getHttpClientBackend();
+	
+	class HttpResponseCache;
+	// Sets the cache that performHttpRequest serves GET requests from. The cache must outlive its use. nullptr disables caching
+	void setHttpResponseCache(HttpResponseCache* cache);
+	HttpResponseCache* getHttpResponseCache();
+	
 	Promise<SharedHttpResponse> performHttpRequest(HttpRequest request);
+	// Performs the request without going through the response cache
+	Promise<SharedHttpResponse> performUncachedHttpRequest(HttpRequest request);
 
 	Map<String,String> parseURLQueryParams(String url);
 
@@ -13,7 +13,7 @@
 
 namespace sh::utils {
 	#if defined(TARGETPLATFORM_IOS) || defined(TARGETPLATFORM_MAC)
-	Promise<SharedHttpResponse> performHttpRequest(HttpRequest req) {
+	Promise<SharedHttpResponse> performUncachedHttpRequest(HttpRequest req) {
 		NSURL* url = [NSURL URLWithString:[NSString stringWithUTF8String:req.url.toString().c_str()]];
 		if(url == nil) {
 			return Promise<SharedHttpResponse>::reject(std::logic_error("Invalid URL"));
@@ -65,6 +65,18 @@ namespace sh::utils {
 				if(data != nil) {
 					res->data = String((const char*)data.bytes, (size_t)data.length);
 				}
+				if(req.onData) {
+					// NSURLSession has already buffered the whole body, so pass it on as a single chunk
+					try {
+						if(!res->data.empty()) {
+							req.onData(res->data);
+						}
+					} catch(...) {
+						reject(std::current_exception());
+						return;
+					}
+					res->data = String();
+				}
 				resolve(res);
 			}] resume];
 		});
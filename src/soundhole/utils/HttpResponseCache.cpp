@@ -0,0 +1,618 @@
+//
+//  HttpResponseCache.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "HttpResponseCache.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+
+namespace sh::utils {
+	namespace {
+		constexpr const char* cacheFileExtension = ".response";
+		std::atomic<size_t> tmpFileCounter = 0;
+
+		double currentTime() {
+			return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+		}
+
+		std::string asciiLowercase(std::string str) {
+			for(auto& c : str) {
+				if(c >= 'A' && c <= 'Z') {
+					c = c - 'A' + 'a';
+				}
+			}
+			return str;
+		}
+
+		std::string trim(const std::string& str) {
+			size_t start = str.find_first_not_of(" \t");
+			if(start == std::string::npos) {
+				return std::string();
+			}
+			size_t end = str.find_last_not_of(" \t");
+			return str.substr(start, end - start + 1);
+		}
+
+		/// Gets a header's values regardless of the case of its name, since each http backend names headers differently
+		ArrayList<String> getHeader(const HttpHeaders& headers, const String& name) {
+			auto lowerName = asciiLowercase(name);
+			ArrayList<String> values;
+			for(auto& pair : headers.map) {
+				if(asciiLowercase(pair.first) != lowerName) {
+					continue;
+				}
+				if(pair.second.is<String>()) {
+					values.pushBack(pair.second.get<String>());
+				} else {
+					for(auto& value : pair.second.get<ArrayList<String>>()) {
+						values.pushBack(value);
+					}
+				}
+			}
+			return values;
+		}
+
+		String getHeaderString(const HttpHeaders& headers, const String& name) {
+			auto values = getHeader(headers, name);
+			String joined;
+			for(auto& value : values) {
+				if(!joined.empty()) {
+					joined += ", ";
+				}
+				joined += value;
+			}
+			return joined;
+		}
+
+		void removeHeader(HttpHeaders& headers, const String& name) {
+			auto lowerName = asciiLowercase(name);
+			for(auto it=headers.map.begin(); it!=headers.map.end();) {
+				if(asciiLowercase(it->first) == lowerName) {
+					it = headers.map.erase(it);
+				} else {
+					it++;
+				}
+			}
+		}
+
+		/// Splits a comma separated header into trimmed items
+		ArrayList<std::string> splitHeaderList(const std::string& value) {
+			ArrayList<std::string> items;
+			size_t start = 0;
+			while(start <= value.size()) {
+				size_t end = value.find(',', start);
+				if(end == std::string::npos) {
+					end = value.size();
+				}
+				auto item = trim(value.substr(start, end - start));
+				if(!item.empty()) {
+					items.pushBack(item);
+				}
+				start = end + 1;
+			}
+			return items;
+		}
+
+		struct CacheControl {
+			bool noStore = false;
+			bool noCache = false;
+			bool isPublic = false;
+			Optional<double> maxAge;
+		};
+
+		CacheControl parseCacheControl(const String& value) {
+			auto cacheControl = CacheControl();
+			for(auto& directive : splitHeaderList(value)) {
+				auto lowerDirective = asciiLowercase(directive);
+				if(lowerDirective == "no-store") {
+					cacheControl.noStore = true;
+				} else if(lowerDirective.rfind("no-cache", 0) == 0) {
+					cacheControl.noCache = true;
+				} else if(lowerDirective == "public") {
+					cacheControl.isPublic = true;
+				} else if(lowerDirective.rfind("max-age=", 0) == 0) {
+					auto seconds = lowerDirective.substr(8);
+					if(!seconds.empty() && seconds[0] == '"') {
+						seconds = seconds.substr(1, seconds.size() - 2);
+					}
+					char* end = nullptr;
+					double maxAge = std::strtod(seconds.c_str(), &end);
+					if(end != seconds.c_str()) {
+						cacheControl.maxAge = maxAge;
+					}
+				}
+			}
+			return cacheControl;
+		}
+
+		/// Parses an IMF-fixdate (ie "Sun, 06 Nov 1994 08:49:37 GMT") into seconds since the epoch
+		Optional<double> parseHttpDate(const String& value) {
+			if(value.empty()) {
+				return std::nullopt;
+			}
+			std::tm tm = {};
+			if(strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S", &tm) == nullptr) {
+				return std::nullopt;
+			}
+			return (double)timegm(&tm);
+		}
+
+		/// FNV-1a, since file names have to stay the same between runs
+		String hashString(const String& str) {
+			uint64_t hash = 14695981039346656037ULL;
+			for(unsigned char c : (const std::string&)str) {
+				hash ^= c;
+				hash *= 1099511628211ULL;
+			}
+			char buffer[17];
+			std::snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+			return String(buffer);
+		}
+
+		String authorizationHash(const HttpRequest& request) {
+			auto authorization = getHeaderString(request.headers, "Authorization");
+			if(authorization.empty()) {
+				return String();
+			}
+			return hashString(authorization);
+		}
+	}
+
+
+
+	#pragma mark Entry
+
+	Json HttpResponseCache::Entry::toJson() const {
+		Json::object headersJson;
+		for(auto& pair : headers.map) {
+			if(pair.second.is<String>()) {
+				headersJson[pair.first] = Json((const std::string&)pair.second.get<String>());
+			} else {
+				Json::array values;
+				for(auto& value : pair.second.get<ArrayList<String>>()) {
+					values.push_back(Json((const std::string&)value));
+				}
+				headersJson[pair.first] = values;
+			}
+		}
+		Json::object varyJson;
+		for(auto& pair : vary) {
+			varyJson[pair.first] = Json((const std::string&)pair.second);
+		}
+		return Json::object{
+			{ "url", (std::string)url },
+			{ "statusCode", statusCode },
+			{ "statusMessage", (std::string)statusMessage },
+			{ "headers", headersJson },
+			{ "storedAt", storedAt },
+			{ "lifetime", lifetime },
+			{ "etag", (std::string)etag },
+			{ "lastModified", (std::string)lastModified },
+			{ "authorization", (std::string)authorization },
+			{ "isPublic", isPublic },
+			{ "vary", varyJson }
+		};
+	}
+
+	HttpResponseCache::Entry HttpResponseCache::Entry::fromJson(const Json& json) {
+		auto entry = Entry{
+			.url = json["url"].string_value(),
+			.statusCode = json["statusCode"].int_value(),
+			.statusMessage = json["statusMessage"].string_value(),
+			.storedAt = json["storedAt"].number_value(),
+			.lifetime = json["lifetime"].number_value(),
+			.etag = json["etag"].string_value(),
+			.lastModified = json["lastModified"].string_value(),
+			.authorization = json["authorization"].string_value(),
+			.isPublic = json["isPublic"].bool_value()
+		};
+		for(auto& pair : json["headers"].object_items()) {
+			if(pair.second.is_array()) {
+				ArrayList<String> values;
+				for(auto& value : pair.second.array_items()) {
+					values.pushBack(value.string_value());
+				}
+				entry.headers.set(pair.first, values);
+			} else {
+				entry.headers.set(pair.first, String(pair.second.string_value()));
+			}
+		}
+		for(auto& pair : json["vary"].object_items()) {
+			entry.vary[pair.first] = pair.second.string_value();
+		}
+		return entry;
+	}
+
+	SharedHttpResponse HttpResponseCache::Entry::toResponse() const {
+		auto response = std::make_shared<HttpResponse>();
+		response->statusCode = statusCode;
+		response->statusMessage = statusMessage;
+		response->headers = headers;
+		response->data = data;
+		return response;
+	}
+
+
+
+	#pragma mark HttpResponseCache
+
+	HttpResponseCache::HttpResponseCache(Options options)
+	: options(options), totalSize(0), indexLoaded(false) {
+		if(this->options.path.empty()) {
+			this->options.path = getCacheDirectoryPath()+"/http_responses";
+		}
+	}
+
+	Promise<SharedHttpResponse> HttpResponseCache::performRequest(HttpRequest request, SendRequest send) {
+		if(!isCacheable(request)) {
+			return send(request);
+		}
+		return promiseThread([=]() {
+			return load(request);
+		}).then([=](Optional<Entry> entry) -> Promise<SharedHttpResponse> {
+			auto now = currentTime();
+			if(entry && isFresh(entry.value(), request, now)) {
+				std::unique_lock<std::mutex> lock(mutex);
+				currentStats.hits++;
+				currentStats.bytesSaved += entry->data.size();
+				return Promise<SharedHttpResponse>::resolve(entry->toResponse());
+			}
+			// revalidate the stored response if possible
+			auto sendingRequest = request;
+			if(entry && (!entry->etag.empty() || !entry->lastModified.empty())) {
+				if(!entry->etag.empty()) {
+					sendingRequest.headers.set("If-None-Match", entry->etag);
+				}
+				if(!entry->lastModified.empty()) {
+					sendingRequest.headers.set("If-Modified-Since", entry->lastModified);
+				}
+			} else {
+				entry = std::nullopt;
+			}
+			return send(sendingRequest).then([=](SharedHttpResponse response) -> Promise<SharedHttpResponse> {
+				if(entry && response->statusCode == 304) {
+					return promiseThread([=]() {
+						auto updatedEntry = entry.value();
+						updateEntry(updatedEntry, request, *response, currentTime());
+						try {
+							store(updatedEntry);
+						} catch(std::exception& error) {
+							FGL_WARN((String)"Failed to update cached response for "+request.url.toString()+": "+error.what());
+						}
+						std::unique_lock<std::mutex> lock(mutex);
+						currentStats.revalidations++;
+						currentStats.bytesSaved += updatedEntry.data.size();
+						return updatedEntry.toResponse();
+					});
+				}
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					currentStats.misses++;
+				}
+				auto newEntry = makeEntry(request, *response, currentTime());
+				if(!newEntry) {
+					if(entry) {
+						// the stored response no longer applies
+						return promiseThread([=]() {
+							remove(entry->url);
+							return response;
+						});
+					}
+					return Promise<SharedHttpResponse>::resolve(response);
+				}
+				return promiseThread([=]() {
+					try {
+						store(newEntry.value());
+					} catch(std::exception& error) {
+						FGL_WARN((String)"Failed to cache response for "+request.url.toString()+": "+error.what());
+					}
+					return response;
+				});
+			});
+		});
+	}
+
+	HttpResponseCache::Stats HttpResponseCache::stats() const {
+		std::unique_lock<std::mutex> lock(mutex);
+		return currentStats;
+	}
+
+	void HttpResponseCache::resetStats() {
+		std::unique_lock<std::mutex> lock(mutex);
+		currentStats = Stats();
+	}
+
+	void HttpResponseCache::clear() {
+		std::unique_lock<std::mutex> lock(mutex);
+		std::error_code error;
+		std::filesystem::remove_all((const std::string&)options.path, error);
+		index.clear();
+		totalSize = 0;
+		indexLoaded = true;
+	}
+
+
+
+	#pragma mark Freshness
+
+	bool HttpResponseCache::isCacheable(const HttpRequest& request) {
+		if(request.method != HttpMethod::GET || request.onData) {
+			return false;
+		}
+		// requests with their own conditions or ranges expect to see the server's response
+		for(auto header : { "If-None-Match", "If-Modified-Since", "Range" }) {
+			if(!getHeader(request.headers, header).empty()) {
+				return false;
+			}
+		}
+		auto cacheControl = parseCacheControl(getHeaderString(request.headers, "Cache-Control"));
+		return !cacheControl.noStore;
+	}
+
+	Optional<HttpResponseCache::Entry> HttpResponseCache::makeEntry(const HttpRequest& request, const HttpResponse& response, double now) {
+		if(response.statusCode != 200) {
+			return std::nullopt;
+		}
+		auto cacheControl = parseCacheControl(getHeaderString(response.headers, "Cache-Control"));
+		if(cacheControl.noStore) {
+			return std::nullopt;
+		}
+		auto entry = Entry{
+			.url = request.url.toString(),
+			.statusCode = response.statusCode,
+			.statusMessage = response.statusMessage,
+			.headers = response.headers,
+			.data = response.data,
+			.storedAt = now,
+			.lifetime = 0,
+			.etag = getHeaderString(response.headers, "ETag"),
+			.lastModified = getHeaderString(response.headers, "Last-Modified"),
+			.authorization = authorizationHash(request),
+			.isPublic = cacheControl.isPublic
+		};
+		// Vary
+		auto varyValue = getHeaderString(response.headers, "Vary");
+		for(auto& varyHeader : splitHeaderList(varyValue)) {
+			if(varyHeader == "*") {
+				return std::nullopt;
+			}
+			entry.vary[asciiLowercase(varyHeader)] = getHeaderString(request.headers, varyHeader);
+		}
+		// freshness lifetime
+		if(!cacheControl.noCache) {
+			if(cacheControl.maxAge) {
+				entry.lifetime = cacheControl.maxAge.value();
+			} else if(auto expires = parseHttpDate(getHeaderString(response.headers, "Expires"))) {
+				auto date = parseHttpDate(getHeaderString(response.headers, "Date")).valueOr(now);
+				entry.lifetime = expires.value() - date;
+			}
+			auto age = getHeaderString(response.headers, "Age");
+			if(!age.empty()) {
+				entry.lifetime -= std::strtod(age.c_str(), nullptr);
+			}
+		}
+		// a response that is never fresh is only worth storing if it can be revalidated
+		if(entry.lifetime <= 0 && entry.etag.empty() && entry.lastModified.empty()) {
+			return std::nullopt;
+		}
+		return entry;
+	}
+
+	void HttpResponseCache::updateEntry(Entry& entry, const HttpRequest& request, const HttpResponse& notModifiedResponse, double now) {
+		// a 304 carries updated metadata for the stored response
+		for(auto header : { "Cache-Control", "Expires", "Date", "ETag", "Last-Modified", "Age" }) {
+			auto values = getHeader(notModifiedResponse.headers, header);
+			if(!values.empty()) {
+				removeHeader(entry.headers, header);
+				entry.headers.set(header, values);
+			}
+		}
+		auto merged = HttpResponse{
+			.statusCode = entry.statusCode,
+			.statusMessage = entry.statusMessage,
+			.headers = entry.headers
+		};
+		auto updatedEntry = makeEntry(request, merged, now);
+		if(updatedEntry) {
+			updatedEntry->data = std::move(entry.data);
+			entry = std::move(updatedEntry.value());
+		} else {
+			entry.storedAt = now;
+			entry.lifetime = 0;
+			entry.authorization = authorizationHash(request);
+		}
+	}
+
+	bool HttpResponseCache::matchesRequest(const Entry& entry, const HttpRequest& request) {
+		if(entry.url != request.url.toString()) {
+			return false;
+		}
+		for(auto& pair : entry.vary) {
+			if(getHeaderString(request.headers, pair.first) != pair.second) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool HttpResponseCache::isFresh(const Entry& entry, const HttpRequest& request, double now) {
+		if(parseCacheControl(getHeaderString(request.headers, "Cache-Control")).noCache) {
+			return false;
+		}
+		// responses fetched with other credentials are only reused after the server confirms them
+		if(!entry.isPublic && entry.authorization != authorizationHash(request)) {
+			return false;
+		}
+		return (now - entry.storedAt) < entry.lifetime;
+	}
+
+
+
+	#pragma mark Storage
+
+	String HttpResponseCache::fileName(const String& url) {
+		return hashString(url)+cacheFileExtension;
+	}
+
+	String HttpResponseCache::filePath(const String& url) const {
+		return options.path+"/"+fileName(url);
+	}
+
+	Optional<HttpResponseCache::Entry> HttpResponseCache::load(const HttpRequest& request) {
+		auto url = request.url.toString();
+		auto name = fileName(url);
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			loadIndexIfNeeded();
+			auto it = index.find(name);
+			if(it == index.end()) {
+				return std::nullopt;
+			}
+			it->second.lastAccess = currentTime();
+		}
+		// file layout is a line of json metadata followed by the body
+		std::ifstream file((const std::string&)filePath(url), std::ios::binary);
+		if(!file.is_open()) {
+			return std::nullopt;
+		}
+		std::string metadata;
+		std::getline(file, metadata);
+		std::string error;
+		auto json = Json::parse(metadata, error);
+		if(!error.empty()) {
+			FGL_WARN("Failed to parse cached response metadata for "+url+": "+error);
+			file.close();
+			remove(url);
+			return std::nullopt;
+		}
+		auto entry = Entry::fromJson(json);
+		if(!matchesRequest(entry, request)) {
+			return std::nullopt;
+		}
+		std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		entry.data = String(std::move(data));
+		// keep the access time on disk for eviction order between launches
+		std::error_code fsError;
+		std::filesystem::last_write_time((const std::string&)filePath(url), std::filesystem::file_time_type::clock::now(), fsError);
+		return entry;
+	}
+
+	void HttpResponseCache::store(const Entry& entry) {
+		if(entry.data.size() > options.maxEntrySize) {
+			remove(entry.url);
+			return;
+		}
+		std::filesystem::create_directories((const std::string&)options.path);
+		auto path = filePath(entry.url);
+		auto name = fileName(entry.url);
+		// write to a temporary file first so that readers never see a partial response
+		auto tmpPath = path+".tmp"+std::to_string(tmpFileCounter++);
+		size_t fileSize = 0;
+		{
+			std::ofstream file((const std::string&)tmpPath, std::ios::binary | std::ios::trunc);
+			if(!file.is_open()) {
+				throw std::runtime_error("Failed to open "+tmpPath+" for writing");
+			}
+			auto metadata = entry.toJson().dump();
+			file.write(metadata.data(), metadata.size());
+			file.put('\n');
+			file.write(entry.data.data(), entry.data.size());
+			fileSize = metadata.size() + 1 + entry.data.size();
+			if(!file.good()) {
+				file.close();
+				std::error_code error;
+				std::filesystem::remove((const std::string&)tmpPath, error);
+				throw std::runtime_error("Failed to write "+tmpPath);
+			}
+		}
+		std::filesystem::rename((const std::string&)tmpPath, (const std::string&)path);
+		std::unique_lock<std::mutex> lock(mutex);
+		loadIndexIfNeeded();
+		auto it = index.find(name);
+		if(it != index.end()) {
+			totalSize -= it->second.size;
+		}
+		index[name] = IndexItem{
+			.size = fileSize,
+			.lastAccess = currentTime()
+		};
+		totalSize += fileSize;
+		currentStats.stores++;
+		evictIfNeeded();
+	}
+
+	void HttpResponseCache::remove(const String& url) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto it = index.find(fileName(url));
+		if(it != index.end()) {
+			totalSize -= it->second.size;
+			index.erase(it);
+		}
+		std::error_code error;
+		std::filesystem::remove((const std::string&)filePath(url), error);
+	}
+
+	void HttpResponseCache::loadIndexIfNeeded() {
+		if(indexLoaded) {
+			return;
+		}
+		indexLoaded = true;
+		std::error_code error;
+		auto dirIterator = std::filesystem::directory_iterator((const std::string&)options.path, error);
+		if(error) {
+			return;
+		}
+		auto nowFileTime = std::filesystem::file_time_type::clock::now();
+		auto now = currentTime();
+		for(auto& dirEntry : dirIterator) {
+			auto name = dirEntry.path().filename().string();
+			size_t extensionLength = std::strlen(cacheFileExtension);
+			if(!dirEntry.is_regular_file(error) || name.size() <= extensionLength || name.compare(name.size() - extensionLength, extensionLength, cacheFileExtension) != 0) {
+				continue;
+			}
+			auto size = (size_t)dirEntry.file_size(error);
+			auto modifiedAge = std::chrono::duration<double>(nowFileTime - dirEntry.last_write_time(error)).count();
+			index[name] = IndexItem{
+				.size = size,
+				.lastAccess = (now - modifiedAge)
+			};
+			totalSize += size;
+		}
+	}
+
+	void HttpResponseCache::evictIfNeeded() {
+		if(totalSize <= options.maxSize) {
+			return;
+		}
+		// evict down to 90% so that eviction doesn't happen on every store
+		size_t targetSize = options.maxSize - (options.maxSize / 10);
+		ArrayList<std::pair<double,String>> accessOrder;
+		accessOrder.reserve(index.size());
+		for(auto& pair : index) {
+			accessOrder.pushBack({ pair.second.lastAccess, pair.first });
+		}
+		std::sort(accessOrder.begin(), accessOrder.end());
+		for(auto& pair : accessOrder) {
+			if(totalSize <= targetSize) {
+				break;
+			}
+			auto it = index.find(pair.second);
+			totalSize -= it->second.size;
+			index.erase(it);
+			std::error_code error;
+			std::filesystem::remove((const std::string&)(options.path+"/"+pair.second), error);
+			currentStats.evictions++;
+		}
+	}
+}
@@ -0,0 +1,108 @@
+//
+//  HttpResponseCache.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include "HttpClient.hpp"
+#include <map>
+#include <mutex>
+
+namespace sh::utils {
+	/// A private, on-disk cache of GET responses.
+	/// Fresh responses are served without a request, and stale ones are revalidated with If-None-Match/If-Modified-Since.
+	class HttpResponseCache {
+	public:
+		struct Options {
+			/// the directory to store cached responses in
+			String path;
+			/// the total size of stored responses to stay under. the least recently used responses are evicted first
+			size_t maxSize = 64 * 1024 * 1024;
+			/// responses with larger bodies aren't stored
+			size_t maxEntrySize = 4 * 1024 * 1024;
+		};
+
+		struct Stats {
+			/// fresh responses served without a request
+			size_t hits = 0;
+			/// stale responses that the server confirmed with a 304
+			size_t revalidations = 0;
+			size_t misses = 0;
+			size_t stores = 0;
+			size_t evictions = 0;
+			/// body bytes served from the cache instead of the network
+			size_t bytesSaved = 0;
+		};
+
+		using SendRequest = Function<Promise<SharedHttpResponse>(HttpRequest)>;
+
+		HttpResponseCache(Options options);
+		HttpResponseCache(const HttpResponseCache&) = delete;
+		HttpResponseCache& operator=(const HttpResponseCache&) = delete;
+
+		/// Serves the request from the cache if possible, otherwise sends it with the given function and stores the response
+		Promise<SharedHttpResponse> performRequest(HttpRequest request, SendRequest send);
+
+		Stats stats() const;
+		void resetStats();
+		/// Removes all stored responses
+		void clear();
+
+	private:
+		struct Entry {
+			String url;
+			int statusCode;
+			String statusMessage;
+			HttpHeaders headers;
+			String data;
+			/// seconds since the epoch
+			double storedAt;
+			/// seconds that the response stays fresh after it was stored
+			double lifetime;
+			String etag;
+			String lastModified;
+			/// a hash of the Authorization header that the response was fetched with
+			String authorization;
+			bool isPublic;
+			/// values of the request headers named by the Vary response header
+			std::map<String,String> vary;
+
+			Json toJson() const;
+			static Entry fromJson(const Json& json);
+			SharedHttpResponse toResponse() const;
+		};
+
+		struct IndexItem {
+			/// size of the file, including metadata
+			size_t size;
+			double lastAccess;
+		};
+
+		static bool isCacheable(const HttpRequest& request);
+		static Optional<Entry> makeEntry(const HttpRequest& request, const HttpResponse& response, double now);
+		static void updateEntry(Entry& entry, const HttpRequest& request, const HttpResponse& notModifiedResponse, double now);
+		static bool matchesRequest(const Entry& entry, const HttpRequest& request);
+		static bool isFresh(const Entry& entry, const HttpRequest& request, double now);
+
+		static String fileName(const String& url);
+		String filePath(const String& url) const;
+		Optional<Entry> load(const HttpRequest& request);
+		void store(const Entry& entry);
+		void remove(const String& url);
+		void loadIndexIfNeeded();
+		void evictIfNeeded();
+
+		Options options;
+		/// stored responses, keyed by file name
+		std::map<String,IndexItem> index;
+		size_t totalSize;
+		bool indexLoaded;
+		Stats currentStats;
+		mutable std::mutex mutex;
+	};
+}
@@ -0,0 +1,944 @@
+//
+//  NativeHttpClient.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "NativeHttpClient.hpp"
+
+#if !defined(TARGETPLATFORM_IOS) && !defined(TARGETPLATFORM_MAC)
+
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <zlib.h>
+#if __has_include(<brotli/decode.h>)
+	#include <brotli/decode.h>
+	#define SOUNDHOLE_HTTP_BROTLI
+#endif
+
+namespace sh::utils {
+	struct NativeHttpClient::Endpoint {
+		std::string host;
+		std::string port;
+		bool secure;
+		bool hostIsAddress;
+		/// the path and query of the request
+		std::string target;
+		std::string hostHeader;
+		/// identifies the pool of connections that can serve this endpoint
+		String key;
+	};
+
+	struct NativeHttpClient::Connection {
+		String key;
+		int socket = -1;
+		SSL* ssl = nullptr;
+		/// bytes that were read from the socket but not consumed yet
+		std::string buffer;
+		size_t bufferOffset = 0;
+		size_t bytesReceived = 0;
+		bool reusable = false;
+		std::chrono::steady_clock::time_point lastUsed;
+	};
+
+	namespace {
+		constexpr size_t maxHeaderLineLength = 64 * 1024;
+		constexpr size_t readChunkSize = 16 * 1024;
+
+		std::string asciiLowercase(std::string str) {
+			for(auto& c : str) {
+				if(c >= 'A' && c <= 'Z') {
+					c = c - 'A' + 'a';
+				}
+			}
+			return str;
+		}
+
+		/// Canonicalizes a header name to the same form that NSURLSession uses (ie "content-type" -> "Content-Type")
+		std::string canonicalHeaderName(std::string name) {
+			bool upper = true;
+			for(auto& c : name) {
+				if(upper && c >= 'a' && c <= 'z') {
+					c = c - 'a' + 'A';
+				} else if(!upper && c >= 'A' && c <= 'Z') {
+					c = c - 'A' + 'a';
+				}
+				upper = (c == '-');
+			}
+			return name;
+		}
+
+		std::string trimHeaderValue(const std::string& value) {
+			size_t start = value.find_first_not_of(" \t");
+			if(start == std::string::npos) {
+				return std::string();
+			}
+			size_t end = value.find_last_not_of(" \t");
+			return value.substr(start, end - start + 1);
+		}
+
+		bool isIdempotent(HttpMethod method) {
+			switch(method) {
+				case HttpMethod::POST:
+				case HttpMethod::PATCH:
+				case HttpMethod::CONNECT:
+					return false;
+				default:
+					return true;
+			}
+		}
+
+		String sslErrorString() {
+			unsigned long error = ERR_get_error();
+			if(error == 0) {
+				return (String)"unknown error ("+std::strerror(errno)+")";
+			}
+			char buffer[256];
+			ERR_error_string_n(error, buffer, sizeof(buffer));
+			ERR_clear_error();
+			return String(buffer);
+		}
+
+		#ifdef TARGETPLATFORM_ANDROID
+		/// Android stores its CA certificates as one PEM file per certificate, but they're named with the old subject hash,
+		/// so the directory can't be given to OpenSSL as a lookup path
+		void loadCertificateDirectory(X509_STORE* store, const char* path) {
+			DIR* dir = opendir(path);
+			if(dir == nullptr) {
+				return;
+			}
+			while(auto entry = readdir(dir)) {
+				if(entry->d_name[0] == '.') {
+					continue;
+				}
+				std::string filePath = std::string(path) + "/" + entry->d_name;
+				FILE* file = fopen(filePath.c_str(), "r");
+				if(file == nullptr) {
+					continue;
+				}
+				while(X509* cert = PEM_read_X509(file, nullptr, nullptr, nullptr)) {
+					X509_STORE_add_cert(store, cert);
+					X509_free(cert);
+				}
+				fclose(file);
+			}
+			closedir(dir);
+			ERR_clear_error();
+		}
+		#endif
+
+		std::string inflateBody(const std::string& input, int windowBits) {
+			z_stream stream;
+			std::memset(&stream, 0, sizeof(stream));
+			if(inflateInit2(&stream, windowBits) != Z_OK) {
+				throw std::runtime_error("Failed to initialize zlib stream");
+			}
+			std::string output;
+			output.resize(std::max(input.size() * 4, readChunkSize));
+			size_t produced = 0;
+			stream.next_in = (Bytef*)input.data();
+			stream.avail_in = (uInt)input.size();
+			while(true) {
+				stream.next_out = (Bytef*)(output.data() + produced);
+				stream.avail_out = (uInt)(output.size() - produced);
+				int retVal = inflate(&stream, Z_NO_FLUSH);
+				produced = output.size() - stream.avail_out;
+				if(retVal == Z_STREAM_END) {
+					if(stream.avail_in > 0 && inflateReset(&stream) == Z_OK) {
+						// concatenated gzip members
+						continue;
+					}
+					break;
+				}
+				if(retVal == Z_BUF_ERROR && stream.avail_in == 0) {
+					inflateEnd(&stream);
+					throw std::runtime_error("Compressed response body was truncated");
+				}
+				if(retVal != Z_OK && retVal != Z_BUF_ERROR) {
+					String message = (stream.msg != nullptr) ? String(stream.msg) : (String)"error "+retVal;
+					inflateEnd(&stream);
+					throw std::runtime_error("Failed to decode compressed response body: "+message);
+				}
+				if(stream.avail_out == 0) {
+					output.resize(output.size() * 2);
+				}
+			}
+			inflateEnd(&stream);
+			output.resize(produced);
+			return output;
+		}
+
+		#ifdef SOUNDHOLE_HTTP_BROTLI
+		std::string brotliDecodeBody(const std::string& input) {
+			auto state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+			if(state == nullptr) {
+				throw std::runtime_error("Failed to initialize brotli decoder");
+			}
+			std::string output;
+			output.resize(std::max(input.size() * 4, readChunkSize));
+			size_t produced = 0;
+			size_t availIn = input.size();
+			auto nextIn = (const uint8_t*)input.data();
+			while(true) {
+				size_t availOut = output.size() - produced;
+				auto nextOut = (uint8_t*)(output.data() + produced);
+				auto result = BrotliDecoderDecompressStream(state, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+				produced = output.size() - availOut;
+				if(result == BROTLI_DECODER_RESULT_SUCCESS) {
+					break;
+				} else if(result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+					output.resize(output.size() * 2);
+				} else if(result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT) {
+					BrotliDecoderDestroyInstance(state);
+					throw std::runtime_error("Compressed response body was truncated");
+				} else {
+					String message = BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state));
+					BrotliDecoderDestroyInstance(state);
+					throw std::runtime_error("Failed to decode compressed response body: "+message);
+				}
+			}
+			BrotliDecoderDestroyInstance(state);
+			output.resize(produced);
+			return output;
+		}
+		#endif
+
+		/// Decodes a body with the given Content-Encoding. Returns false if the encoding isn't supported
+		bool decodeBody(std::string& body, const std::string& contentEncoding) {
+			// encodings are listed in the order they were applied
+			ArrayList<std::string> encodings;
+			size_t start = 0;
+			while(start <= contentEncoding.size()) {
+				size_t end = contentEncoding.find(',', start);
+				if(end == std::string::npos) {
+					end = contentEncoding.size();
+				}
+				auto encoding = asciiLowercase(trimHeaderValue(contentEncoding.substr(start, end - start)));
+				if(!encoding.empty() && encoding != "identity") {
+					encodings.pushBack(encoding);
+				}
+				start = end + 1;
+			}
+			for(auto& encoding : encodings) {
+				if(encoding != "gzip" && encoding != "x-gzip" && encoding != "deflate"
+				   #ifdef SOUNDHOLE_HTTP_BROTLI
+				   && encoding != "br"
+				   #endif
+				   ) {
+					return false;
+				}
+			}
+			for(size_t i=encodings.size(); i>0; i--) {
+				auto& encoding = encodings[i-1];
+				if(encoding == "deflate") {
+					// some servers send raw deflate data without the zlib wrapper
+					try {
+						body = inflateBody(body, 15);
+					} catch(std::runtime_error&) {
+						body = inflateBody(body, -15);
+					}
+				}
+				#ifdef SOUNDHOLE_HTTP_BROTLI
+				else if(encoding == "br") {
+					body = brotliDecodeBody(body);
+				}
+				#endif
+				else {
+					// detect the gzip or zlib header
+					body = inflateBody(body, 15 + 32);
+				}
+			}
+			return true;
+		}
+	}
+
+
+
+	#pragma mark Endpoint
+
+	NativeHttpClient::Endpoint NativeHttpClient::parseEndpoint(const URL& url) {
+		std::string urlString = (const std::string&)url.toString();
+		size_t schemeEnd = urlString.find("://");
+		if(schemeEnd == std::string::npos) {
+			throw std::invalid_argument("Invalid URL "+urlString);
+		}
+		auto endpoint = Endpoint();
+		auto scheme = asciiLowercase(urlString.substr(0, schemeEnd));
+		if(scheme == "https") {
+			endpoint.secure = true;
+		} else if(scheme == "http") {
+			endpoint.secure = false;
+		} else {
+			throw std::invalid_argument("Invalid protocol "+scheme+":");
+		}
+		size_t authorityStart = schemeEnd + 3;
+		size_t authorityEnd = urlString.find_first_of("/?#", authorityStart);
+		if(authorityEnd == std::string::npos) {
+			authorityEnd = urlString.size();
+		}
+		auto authority = urlString.substr(authorityStart, authorityEnd - authorityStart);
+		size_t userInfoEnd = authority.rfind('@');
+		if(userInfoEnd != std::string::npos) {
+			authority = authority.substr(userInfoEnd + 1);
+		}
+		// split host and port, allowing for bracketed ipv6 addresses
+		size_t portStart = std::string::npos;
+		if(!authority.empty() && authority[0] == '[') {
+			size_t bracketEnd = authority.find(']');
+			if(bracketEnd == std::string::npos) {
+				throw std::invalid_argument("Invalid URL "+urlString);
+			}
+			endpoint.host = authority.substr(1, bracketEnd - 1);
+			if(bracketEnd + 1 < authority.size() && authority[bracketEnd + 1] == ':') {
+				portStart = bracketEnd + 2;
+			}
+		} else {
+			size_t colon = authority.rfind(':');
+			endpoint.host = authority.substr(0, colon);
+			if(colon != std::string::npos) {
+				portStart = colon + 1;
+			}
+		}
+		if(endpoint.host.empty()) {
+			throw std::invalid_argument("URL "+urlString+" has no host");
+		}
+		auto defaultPort = endpoint.secure ? "443" : "80";
+		endpoint.port = (portStart != std::string::npos && portStart < authority.size()) ? authority.substr(portStart) : defaultPort;
+		in6_addr addr;
+		bool isIPv6 = (inet_pton(AF_INET6, endpoint.host.c_str(), &addr) == 1);
+		endpoint.hostIsAddress = (isIPv6 || inet_pton(AF_INET, endpoint.host.c_str(), &addr) == 1);
+		endpoint.hostHeader = isIPv6 ? ("["+endpoint.host+"]") : endpoint.host;
+		if(endpoint.port != defaultPort) {
+			endpoint.hostHeader += ":"+endpoint.port;
+		}
+		// path and query, without the fragment
+		size_t fragmentStart = urlString.find('#', authorityEnd);
+		endpoint.target = urlString.substr(authorityEnd, (fragmentStart == std::string::npos) ? std::string::npos : (fragmentStart - authorityEnd));
+		if(endpoint.target.empty() || endpoint.target[0] != '/') {
+			endpoint.target = "/" + endpoint.target;
+		}
+		endpoint.key = (String)scheme+"://"+endpoint.host+":"+endpoint.port;
+		return endpoint;
+	}
+
+
+
+	#pragma mark NativeHttpClient
+
+	NativeHttpClient* NativeHttpClient::shared() {
+		static NativeHttpClient client(Options{});
+		return &client;
+	}
+
+	NativeHttpClient::NativeHttpClient(Options options)
+	: options(options), sslContext(nullptr) {
+		sslContext = SSL_CTX_new(TLS_client_method());
+		if(sslContext == nullptr) {
+			throw std::runtime_error("Failed to create SSL context: "+sslErrorString());
+		}
+		SSL_CTX_set_min_proto_version(sslContext, TLS1_2_VERSION);
+		SSL_CTX_set_verify(sslContext, SSL_VERIFY_PEER, nullptr);
+		SSL_CTX_set_mode(sslContext, SSL_MODE_AUTO_RETRY);
+		SSL_CTX_set_default_verify_paths(sslContext);
+		#ifdef TARGETPLATFORM_ANDROID
+		loadCertificateDirectory(SSL_CTX_get_cert_store(sslContext), "/system/etc/security/cacerts");
+		#endif
+		if(!options.caFile.empty() || !options.caPath.empty()) {
+			auto caFile = options.caFile.empty() ? nullptr : options.caFile.c_str();
+			auto caPath = options.caPath.empty() ? nullptr : options.caPath.c_str();
+			if(SSL_CTX_load_verify_locations(sslContext, caFile, caPath) != 1) {
+				FGL_WARN("Failed to load CA certificates for NativeHttpClient: "+sslErrorString());
+			}
+		}
+		ERR_clear_error();
+	}
+
+	NativeHttpClient::~NativeHttpClient() {
+		closeIdleConnections();
+		SSL_CTX_free(sslContext);
+	}
+
+	Promise<SharedHttpResponse> NativeHttpClient::performRequest(HttpRequest request) {
+		return promiseThread([=]() {
+			return performRequestSync(request);
+		});
+	}
+
+	SharedHttpResponse NativeHttpClient::performRequestSync(const HttpRequest& request) {
+		auto endpoint = parseEndpoint(request.url);
+		for(size_t attempt=0; true; attempt++) {
+			auto connection = checkoutConnection(endpoint);
+			bool reused = (connection != nullptr);
+			if(connection == nullptr) {
+				connection = openConnection(endpoint);
+			}
+			size_t prevBytesReceived = connection->bytesReceived;
+			SharedHttpResponse response;
+			try {
+				response = sendRequest(connection, endpoint, request);
+			} catch(...) {
+				// a pooled connection may have been closed by the server while it was idle
+				bool stale = (reused && connection->bytesReceived == prevBytesReceived);
+				closeConnection(connection);
+				if(stale && attempt == 0 && isIdempotent(request.method)) {
+					continue;
+				}
+				throw;
+			}
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				currentStats.requestsSent++;
+				currentStats.bytesReceived += (connection->bytesReceived - prevBytesReceived);
+				currentStats.bodyBytesDecoded += response->data.size();
+			}
+			if(connection->reusable) {
+				checkinConnection(connection);
+			} else {
+				closeConnection(connection);
+			}
+			return response;
+		}
+	}
+
+	NativeHttpClient::Stats NativeHttpClient::stats() const {
+		std::unique_lock<std::mutex> lock(mutex);
+		return currentStats;
+	}
+
+	void NativeHttpClient::closeIdleConnections() {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto connections = std::move(idleConnections);
+		idleConnections = {};
+		lock.unlock();
+		for(auto& pair : connections) {
+			for(auto connection : pair.second) {
+				closeConnection(connection);
+			}
+		}
+	}
+
+
+
+	#pragma mark Connections
+
+	NativeHttpClient::Connection* NativeHttpClient::openConnection(const Endpoint& endpoint) {
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if(endpoint.hostIsAddress) {
+			hints.ai_flags |= AI_NUMERICHOST;
+		}
+		addrinfo* addresses = nullptr;
+		int retVal = getaddrinfo(endpoint.host.c_str(), endpoint.port.c_str(), &hints, &addresses);
+		if(retVal != 0) {
+			throw std::runtime_error((String)"Failed to resolve host "+endpoint.host+": "+gai_strerror(retVal));
+		}
+		// try each resolved address until one connects
+		int sock = -1;
+		String errorMsg;
+		for(auto address = addresses; address != nullptr; address = address->ai_next) {
+			sock = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC, address->ai_protocol);
+			if(sock < 0) {
+				errorMsg = std::strerror(errno);
+				continue;
+			}
+			int flags = fcntl(sock, F_GETFL, 0);
+			fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+			retVal = ::connect(sock, address->ai_addr, address->ai_addrlen);
+			if(retVal != 0 && errno == EINPROGRESS) {
+				pollfd pfd = { .fd=sock, .events=POLLOUT, .revents=0 };
+				retVal = ::poll(&pfd, 1, (int)options.connectTimeout.count());
+				if(retVal == 0) {
+					errno = ETIMEDOUT;
+					retVal = -1;
+				} else if(retVal > 0) {
+					int sockError = 0;
+					socklen_t sockErrorLength = sizeof(sockError);
+					getsockopt(sock, SOL_SOCKET, SO_ERROR, &sockError, &sockErrorLength);
+					errno = sockError;
+					retVal = (sockError == 0) ? 0 : -1;
+				}
+			}
+			if(retVal != 0) {
+				errorMsg = std::strerror(errno);
+				::close(sock);
+				sock = -1;
+				continue;
+			}
+			fcntl(sock, F_SETFL, flags);
+			break;
+		}
+		freeaddrinfo(addresses);
+		if(sock < 0) {
+			throw std::runtime_error((String)"Failed to connect to "+endpoint.host+":"+endpoint.port+": "+errorMsg);
+		}
+		int noDelay = 1;
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+		timeval ioTimeout = {
+			.tv_sec = (time_t)(options.ioTimeout.count() / 1000),
+			.tv_usec = (suseconds_t)((options.ioTimeout.count() % 1000) * 1000)
+		};
+		setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &ioTimeout, sizeof(ioTimeout));
+		setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &ioTimeout, sizeof(ioTimeout));
+
+		auto connection = new Connection();
+		connection->key = endpoint.key;
+		connection->socket = sock;
+		if(endpoint.secure) {
+			auto ssl = SSL_new(sslContext);
+			if(ssl == nullptr) {
+				closeConnection(connection);
+				throw std::runtime_error("Failed to create SSL connection: "+sslErrorString());
+			}
+			connection->ssl = ssl;
+			SSL_set_fd(ssl, sock);
+			if(endpoint.hostIsAddress) {
+				X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl), endpoint.host.c_str());
+			} else {
+				SSL_set_tlsext_host_name(ssl, endpoint.host.c_str());
+				SSL_set1_host(ssl, endpoint.host.c_str());
+			}
+			if(SSL_connect(ssl) != 1) {
+				long verifyResult = SSL_get_verify_result(ssl);
+				String errorMsg = (verifyResult != X509_V_OK) ? String(X509_verify_cert_error_string(verifyResult)) : sslErrorString();
+				closeConnection(connection);
+				throw std::runtime_error((String)"TLS handshake with "+endpoint.host+" failed: "+errorMsg);
+			}
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		currentStats.connectionsOpened++;
+		return connection;
+	}
+
+	NativeHttpClient::Connection* NativeHttpClient::checkoutConnection(const Endpoint& endpoint) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto it = idleConnections.find(endpoint.key);
+		if(it == idleConnections.end()) {
+			return nullptr;
+		}
+		auto& connections = it->second;
+		auto now = std::chrono::steady_clock::now();
+		Connection* connection = nullptr;
+		LinkedList<Connection*> expiredConnections;
+		while(!connections.empty()) {
+			// take the most recently used connection, since it's the least likely to have been closed by the server
+			auto idleConnection = connections.back();
+			connections.popBack();
+			// an idle connection should have nothing to read. if it does, the server closed it or sent garbage
+			pollfd pfd = { .fd=idleConnection->socket, .events=POLLIN, .revents=0 };
+			bool readable = (::poll(&pfd, 1, 0) != 0);
+			if(readable || (now - idleConnection->lastUsed) > options.idleTimeout) {
+				expiredConnections.pushBack(idleConnection);
+				continue;
+			}
+			connection = idleConnection;
+			currentStats.connectionsReused++;
+			break;
+		}
+		if(connections.empty()) {
+			idleConnections.erase(it);
+		}
+		lock.unlock();
+		for(auto expiredConnection : expiredConnections) {
+			closeConnection(expiredConnection);
+		}
+		return connection;
+	}
+
+	void NativeHttpClient::checkinConnection(Connection* connection) {
+		connection->lastUsed = std::chrono::steady_clock::now();
+		std::unique_lock<std::mutex> lock(mutex);
+		auto& connections = idleConnections[connection->key];
+		if(connections.size() >= options.maxIdleConnectionsPerHost) {
+			lock.unlock();
+			closeConnection(connection);
+			return;
+		}
+		connections.pushBack(connection);
+	}
+
+	void NativeHttpClient::closeConnection(Connection* connection) {
+		if(connection->ssl != nullptr) {
+			if(connection->reusable) {
+				SSL_shutdown(connection->ssl);
+			}
+			SSL_free(connection->ssl);
+			ERR_clear_error();
+		}
+		if(connection->socket >= 0) {
+			::close(connection->socket);
+		}
+		delete connection;
+	}
+
+
+
+	#pragma mark Requests
+
+	std::string NativeHttpClient::serializeRequest(const Endpoint& endpoint, const HttpRequest& request, bool* decodeResponse) const {
+		auto method = HttpMethod_toString(request.method);
+		std::string head;
+		head.reserve(512 + endpoint.target.size());
+		head += (const std::string&)method;
+		head += " ";
+		head += endpoint.target;
+		head += " HTTP/1.1\r\n";
+		bool hasHost = false;
+		bool hasContentLength = false;
+		bool hasTransferEncoding = false;
+		bool hasAcceptEncoding = false;
+		auto addHeader = [&](const std::string& name, const std::string& value) {
+			if(name.find_first_of("\r\n:") != std::string::npos || value.find_first_of("\r\n") != std::string::npos) {
+				throw std::invalid_argument("Invalid characters in HTTP header "+name);
+			}
+			head += name;
+			head += ": ";
+			head += value;
+			head += "\r\n";
+		};
+		for(auto& header : request.headers.map) {
+			auto& name = (const std::string&)header.first;
+			auto lowerName = asciiLowercase(name);
+			if(lowerName == "host") {
+				hasHost = true;
+			} else if(lowerName == "content-length") {
+				hasContentLength = true;
+			} else if(lowerName == "transfer-encoding") {
+				hasTransferEncoding = true;
+			} else if(lowerName == "accept-encoding") {
+				hasAcceptEncoding = true;
+			}
+			if(header.second.is<String>()) {
+				addHeader(name, (const std::string&)header.second.get<String>());
+			} else {
+				for(auto& value : header.second.get<ArrayList<String>>()) {
+					addHeader(name, (const std::string&)value);
+				}
+			}
+		}
+		if(!hasHost) {
+			addHeader("Host", endpoint.hostHeader);
+		}
+		if(!hasContentLength && !hasTransferEncoding) {
+			bool expectsBody = (request.method == HttpMethod::POST || request.method == HttpMethod::PUT || request.method == HttpMethod::PATCH);
+			if(expectsBody || !request.data.empty()) {
+				addHeader("Content-Length", std::to_string(request.data.size()));
+			}
+		}
+		// streamed bodies are passed on as they arrive, so they aren't requested compressed
+		*decodeResponse = (options.decompress && !hasAcceptEncoding && !request.onData);
+		if(*decodeResponse) {
+			#ifdef SOUNDHOLE_HTTP_BROTLI
+			addHeader("Accept-Encoding", "gzip, deflate, br");
+			#else
+			addHeader("Accept-Encoding", "gzip, deflate");
+			#endif
+		}
+		head += "\r\n";
+		return head;
+	}
+
+	SharedHttpResponse NativeHttpClient::sendRequest(Connection* connection, const Endpoint& endpoint, const HttpRequest& request) {
+		connection->reusable = false;
+		bool decodeResponse = false;
+		auto head = serializeRequest(endpoint, request, &decodeResponse);
+		if(request.data.empty()) {
+			writeAll(connection, head.data(), head.size());
+		} else if(request.data.size() <= readChunkSize) {
+			// small bodies go out in the same packet as the headers
+			head += (const std::string&)request.data;
+			writeAll(connection, head.data(), head.size());
+		} else {
+			writeAll(connection, head.data(), head.size());
+			writeAll(connection, request.data.data(), request.data.size());
+		}
+
+		auto response = std::make_shared<HttpResponse>();
+		bool http10 = false;
+		Optional<size_t> contentLength;
+		bool chunked = false;
+		bool connectionClose = false;
+		bool connectionKeepAlive = false;
+		std::string contentEncoding;
+		while(true) {
+			// status line
+			auto statusLine = readLine(connection);
+			if(statusLine.compare(0, 5, "HTTP/") != 0) {
+				throw std::runtime_error("Invalid HTTP status line: "+statusLine.substr(0, 100));
+			}
+			size_t codeStart = statusLine.find(' ');
+			if(codeStart == std::string::npos) {
+				throw std::runtime_error("Invalid HTTP status line: "+statusLine.substr(0, 100));
+			}
+			http10 = (statusLine.compare(0, codeStart, "HTTP/1.0") == 0);
+			size_t messageStart = statusLine.find(' ', codeStart + 1);
+			response->statusCode = std::atoi(statusLine.substr(codeStart + 1, messageStart - codeStart - 1).c_str());
+			response->statusMessage = (messageStart != std::string::npos) ? statusLine.substr(messageStart + 1) : std::string();
+			response->headers = HttpHeaders();
+			contentLength = std::nullopt;
+			chunked = false;
+			connectionClose = false;
+			connectionKeepAlive = false;
+			contentEncoding.clear();
+			// headers
+			while(true) {
+				auto line = readLine(connection);
+				if(line.empty()) {
+					break;
+				}
+				size_t colon = line.find(':');
+				if(colon == std::string::npos || colon == 0) {
+					throw std::runtime_error("Invalid HTTP header line: "+line.substr(0, 100));
+				}
+				auto name = canonicalHeaderName(trimHeaderValue(line.substr(0, colon)));
+				auto value = trimHeaderValue(line.substr(colon + 1));
+				if(name == "Content-Length") {
+					char* end = nullptr;
+					auto length = std::strtoull(value.c_str(), &end, 10);
+					if(value.empty() || end == nullptr || *end != '\0') {
+						throw std::runtime_error("Invalid Content-Length "+value);
+					}
+					contentLength = (size_t)length;
+				} else if(name == "Transfer-Encoding") {
+					chunked = (asciiLowercase(value).find("chunked") != std::string::npos);
+				} else if(name == "Connection") {
+					auto lowerValue = asciiLowercase(value);
+					connectionClose = (lowerValue.find("close") != std::string::npos);
+					connectionKeepAlive = (lowerValue.find("keep-alive") != std::string::npos);
+				} else if(name == "Content-Encoding") {
+					contentEncoding = value;
+				}
+				if(response->headers.map.find(name) != response->headers.map.end()) {
+					response->headers.add(name, value);
+				} else {
+					response->headers.set(name, value);
+				}
+			}
+			// skip interim responses
+			if(response->statusCode >= 100 && response->statusCode < 200 && response->statusCode != 101) {
+				continue;
+			}
+			break;
+		}
+
+		// body
+		bool reusable = http10 ? connectionKeepAlive : !connectionClose;
+		bool hasBody = !(request.method == HttpMethod::HEAD || response->statusCode == 204 || response->statusCode == 304
+			|| (response->statusCode >= 100 && response->statusCode < 200));
+		std::string body;
+		// reads the next part of the body into the response, or passes it to onData if the request is streamed
+		auto readBodyPart = [&](size_t length) {
+			if(!request.onData) {
+				size_t prevSize = body.size();
+				body.resize(prevSize + length);
+				readExactly(connection, body.data() + prevSize, length);
+				return;
+			}
+			std::string chunk;
+			while(length > 0) {
+				size_t chunkLength = std::min(length, readChunkSize);
+				chunk.resize(chunkLength);
+				readExactly(connection, chunk.data(), chunkLength);
+				request.onData(String(chunk));
+				length -= chunkLength;
+			}
+		};
+		if(!hasBody) {
+			//
+		} else if(chunked) {
+			while(true) {
+				auto sizeLine = readLine(connection);
+				char* end = nullptr;
+				size_t chunkSize = (size_t)std::strtoull(sizeLine.c_str(), &end, 16);
+				if(end == sizeLine.c_str()) {
+					throw std::runtime_error("Invalid chunk size "+sizeLine.substr(0, 100));
+				}
+				if(chunkSize == 0) {
+					// trailers
+					while(!readLine(connection).empty());
+					break;
+				}
+				readBodyPart(chunkSize);
+				if(!readLine(connection).empty()) {
+					throw std::runtime_error("Missing line break after chunk");
+				}
+			}
+		} else if(contentLength) {
+			// read straight into the response buffer
+			readBodyPart(contentLength.value());
+		} else {
+			// body is delimited by the server closing the connection
+			reusable = false;
+			while(true) {
+				size_t prevSize = body.size();
+				body.resize(prevSize + readChunkSize);
+				size_t bytesRead = readSome(connection, body.data() + prevSize, readChunkSize);
+				body.resize(prevSize + bytesRead);
+				if(bytesRead == 0) {
+					break;
+				}
+				if(request.onData) {
+					request.onData(String(body));
+					body.clear();
+				}
+			}
+		}
+		if(connection->bufferOffset < connection->buffer.size()) {
+			// the server sent more than the response
+			reusable = false;
+		}
+
+		if(decodeResponse && !contentEncoding.empty() && decodeBody(body, contentEncoding)) {
+			response->headers.map.erase("Content-Encoding");
+			if(response->headers.map.find("Content-Length") != response->headers.map.end()) {
+				response->headers.set("Content-Length", std::to_string(body.size()));
+			}
+		}
+		response->data = String(std::move(body));
+		connection->reusable = reusable;
+		return response;
+	}
+
+
+
+	#pragma mark Socket IO
+
+	size_t NativeHttpClient::readSocket(Connection* connection, char* buffer, size_t maxLength) {
+		if(connection->ssl != nullptr) {
+			while(true) {
+				int retVal = SSL_read(connection->ssl, buffer, (int)std::min(maxLength, (size_t)INT_MAX));
+				if(retVal > 0) {
+					connection->bytesReceived += (size_t)retVal;
+					return (size_t)retVal;
+				}
+				int error = SSL_get_error(connection->ssl, retVal);
+				if(error == SSL_ERROR_ZERO_RETURN) {
+					return 0;
+				} else if(error == SSL_ERROR_SYSCALL) {
+					if(ERR_peek_error() == 0 && (retVal == 0 || errno == 0)) {
+						// closed without a close_notify, which many servers do
+						return 0;
+					} else if(errno == EINTR) {
+						continue;
+					}
+				} else if(error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+					throw std::runtime_error("Timed out reading from "+connection->key);
+				}
+				throw std::runtime_error("Failed to read from "+connection->key+": "+sslErrorString());
+			}
+		}
+		while(true) {
+			ssize_t retVal = ::recv(connection->socket, buffer, maxLength, 0);
+			if(retVal >= 0) {
+				connection->bytesReceived += (size_t)retVal;
+				return (size_t)retVal;
+			}
+			if(errno == EINTR) {
+				continue;
+			} else if(errno == EAGAIN || errno == EWOULDBLOCK) {
+				throw std::runtime_error("Timed out reading from "+connection->key);
+			}
+			throw std::runtime_error("Failed to read from "+connection->key+": "+std::strerror(errno));
+		}
+	}
+
+	size_t NativeHttpClient::readSome(Connection* connection, char* buffer, size_t maxLength) {
+		auto& connBuffer = connection->buffer;
+		if(connection->bufferOffset < connBuffer.size()) {
+			size_t length = std::min(maxLength, connBuffer.size() - connection->bufferOffset);
+			std::memcpy(buffer, connBuffer.data() + connection->bufferOffset, length);
+			connection->bufferOffset += length;
+			if(connection->bufferOffset == connBuffer.size()) {
+				connBuffer.clear();
+				connection->bufferOffset = 0;
+			}
+			return length;
+		}
+		return readSocket(connection, buffer, maxLength);
+	}
+
+	void NativeHttpClient::readExactly(Connection* connection, char* buffer, size_t length) {
+		size_t offset = 0;
+		while(offset < length) {
+			size_t bytesRead = readSome(connection, buffer + offset, length - offset);
+			if(bytesRead == 0) {
+				throw std::runtime_error("Connection to "+connection->key+" closed before the response was complete");
+			}
+			offset += bytesRead;
+		}
+	}
+
+	std::string NativeHttpClient::readLine(Connection* connection) {
+		auto& buffer = connection->buffer;
+		while(true) {
+			size_t lineEnd = buffer.find("\r\n", connection->bufferOffset);
+			if(lineEnd != std::string::npos) {
+				auto line = buffer.substr(connection->bufferOffset, lineEnd - connection->bufferOffset);
+				connection->bufferOffset = lineEnd + 2;
+				if(connection->bufferOffset == buffer.size()) {
+					buffer.clear();
+					connection->bufferOffset = 0;
+				}
+				return line;
+			}
+			if((buffer.size() - connection->bufferOffset) > maxHeaderLineLength) {
+				throw std::runtime_error("HTTP header line from "+connection->key+" is too long");
+			}
+			// drop the consumed bytes and read more
+			buffer.erase(0, connection->bufferOffset);
+			connection->bufferOffset = 0;
+			size_t prevSize = buffer.size();
+			buffer.resize(prevSize + readChunkSize);
+			size_t bytesRead = readSocket(connection, buffer.data() + prevSize, readChunkSize);
+			buffer.resize(prevSize + bytesRead);
+			if(bytesRead == 0) {
+				throw std::runtime_error("Connection to "+connection->key+" closed before the response was complete");
+			}
+		}
+	}
+
+	void NativeHttpClient::writeAll(Connection* connection, const char* data, size_t length) {
+		size_t offset = 0;
+		while(offset < length) {
+			size_t remaining = length - offset;
+			if(connection->ssl != nullptr) {
+				// SSL writes go through write(), which relies on node having set SIGPIPE to be ignored for the process
+				int retVal = SSL_write(connection->ssl, data + offset, (int)std::min(remaining, (size_t)INT_MAX));
+				if(retVal <= 0) {
+					throw std::runtime_error("Failed to write to "+connection->key+": "+sslErrorString());
+				}
+				offset += (size_t)retVal;
+			} else {
+				ssize_t retVal = ::send(connection->socket, data + offset, remaining, MSG_NOSIGNAL);
+				if(retVal < 0) {
+					if(errno == EINTR) {
+						continue;
+					}
+					throw std::runtime_error("Failed to write to "+connection->key+": "+std::strerror(errno));
+				}
+				offset += (size_t)retVal;
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,94 @@
+//
+//  NativeHttpClient.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include "HttpClient.hpp"
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#if !defined(TARGETPLATFORM_IOS) && !defined(TARGETPLATFORM_MAC)
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+namespace sh::utils {
+	/// An HTTP/1.1 client that runs requests on its own threads instead of the node main loop.
+	/// Connections are kept alive and pooled per host, and compressed responses are decoded.
+	class NativeHttpClient {
+	public:
+		struct Options {
+			/// the maximum number of idle connections to keep open for each scheme, host, and port
+			size_t maxIdleConnectionsPerHost = 6;
+			/// idle connections older than this are closed instead of being reused
+			std::chrono::milliseconds idleTimeout = std::chrono::seconds(30);
+			std::chrono::milliseconds connectTimeout = std::chrono::seconds(15);
+			/// the maximum time to wait on a single read or write
+			std::chrono::milliseconds ioTimeout = std::chrono::seconds(60);
+			/// send Accept-Encoding and decode gzip, deflate, and brotli responses.
+			/// requests that set their own Accept-Encoding header always get the raw body
+			bool decompress = true;
+			/// a CA bundle file and/or directory used to verify TLS certificates, in addition to the system defaults
+			String caFile;
+			String caPath;
+		};
+
+		struct Stats {
+			size_t requestsSent = 0;
+			size_t connectionsOpened = 0;
+			size_t connectionsReused = 0;
+			/// bytes read from the socket, including headers
+			size_t bytesReceived = 0;
+			/// bytes of response bodies after decoding
+			size_t bodyBytesDecoded = 0;
+		};
+
+		static NativeHttpClient* shared();
+
+		NativeHttpClient(Options options);
+		NativeHttpClient(const NativeHttpClient&) = delete;
+		NativeHttpClient& operator=(const NativeHttpClient&) = delete;
+		~NativeHttpClient();
+
+		Promise<SharedHttpResponse> performRequest(HttpRequest request);
+		/// Performs the request on the calling thread
+		SharedHttpResponse performRequestSync(const HttpRequest& request);
+
+		Stats stats() const;
+		void closeIdleConnections();
+
+	private:
+		struct Endpoint;
+		struct Connection;
+
+		static Endpoint parseEndpoint(const URL& url);
+
+		Connection* openConnection(const Endpoint& endpoint);
+		Connection* checkoutConnection(const Endpoint& endpoint);
+		void checkinConnection(Connection* connection);
+		void closeConnection(Connection* connection);
+
+		SharedHttpResponse sendRequest(Connection* connection, const Endpoint& endpoint, const HttpRequest& request);
+		std::string serializeRequest(const Endpoint& endpoint, const HttpRequest& request, bool* decodeResponse) const;
+
+		size_t readSocket(Connection* connection, char* buffer, size_t maxLength);
+		size_t readSome(Connection* connection, char* buffer, size_t maxLength);
+		void readExactly(Connection* connection, char* buffer, size_t length);
+		std::string readLine(Connection* connection);
+		void writeAll(Connection* connection, const char* data, size_t length);
+
+		Options options;
+		SSL_CTX* sslContext;
+		std::map<String,LinkedList<Connection*>> idleConnections;
+		Stats currentStats;
+		mutable std::mutex mutex;
+	};
+}
+
+#endif
@@ -0,0 +1,277 @@
+//
+//  RequestScheduler.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "RequestScheduler.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <strings.h>
+
+namespace sh::utils {
+	RequestScheduler* RequestScheduler::shared() {
+		// never destroyed, so that requests finishing during exit don't touch a destroyed scheduler
+		static auto scheduler = new RequestScheduler();
+		return scheduler;
+	}
+
+	RequestScheduler::RequestScheduler()
+	: stopped(false) {
+		thread = std::thread([=]() {
+			run();
+		});
+	}
+
+	RequestScheduler::~RequestScheduler() {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			stopped = true;
+		}
+		condition.notify_all();
+		thread.join();
+	}
+
+	void RequestScheduler::setGroupOptions(const String& groupName, GroupOptions options) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto& group = getGroup(groupName);
+		group.options = options;
+		group.tokens = std::min(group.tokens, options.burst);
+		lock.unlock();
+		condition.notify_all();
+	}
+
+	RequestScheduler::Group& RequestScheduler::getGroup(const String& name) {
+		auto it = groups.find(name);
+		if(it == groups.end()) {
+			auto options = GroupOptions();
+			it = groups.insert({ name, Group{
+				.options = options,
+				.tokens = options.burst,
+				.lastRefill = Clock::now(),
+				.pausedUntil = Clock::time_point::min()
+			} }).first;
+		}
+		return it->second;
+	}
+
+	Promise<SharedHttpResponse> RequestScheduler::schedule(const String& groupName, RequestPriority priority, SendRequest send) {
+		return Promise<SharedHttpResponse>([=](auto resolve, auto reject) {
+			std::unique_lock<std::mutex> lock(mutex);
+			auto& group = getGroup(groupName);
+			auto request = QueuedRequest{
+				.send = send,
+				.resolve = resolve,
+				.reject = reject,
+				.priority = priority,
+				.queuedAt = Clock::now(),
+				.attempts = 0
+			};
+			if(priority == RequestPriority::INTERACTIVE) {
+				group.interactiveQueue.pushBack(request);
+				group.stats.interactiveQueueDepth++;
+			} else {
+				group.backgroundQueue.pushBack(request);
+				group.stats.backgroundQueueDepth++;
+			}
+			lock.unlock();
+			condition.notify_all();
+		});
+	}
+
+	Promise<void> RequestScheduler::scheduleTask(const String& groupName, RequestPriority priority, Function<Promise<void>()> task) {
+		auto throttledError = fgl::new$<std::exception_ptr>();
+		return schedule(groupName, priority, [=]() {
+			// report the task's outcome as a response, so that throttled tasks pause the group and get retried
+			return Promise<SharedHttpResponse>([=](auto resolve, auto reject) {
+				task().then([=]() {
+					resolve(taskResponse(200));
+				}, [=](std::exception_ptr error) {
+					if(isThrottledError(error)) {
+						*throttledError = error;
+						resolve(taskResponse(429));
+					} else {
+						reject(error);
+					}
+				});
+			});
+		}).then([=](SharedHttpResponse response) {
+			if(response->statusCode == 429) {
+				// out of retries
+				std::rethrow_exception(*throttledError);
+			}
+		});
+	}
+
+	SharedHttpResponse RequestScheduler::taskResponse(int statusCode) {
+		auto response = std::make_shared<HttpResponse>();
+		response->statusCode = statusCode;
+		return response;
+	}
+
+	bool RequestScheduler::isThrottledError(std::exception_ptr errorPtr) {
+		try {
+			std::rethrow_exception(errorPtr);
+		} catch(Error& error) {
+			auto code = error.getDetail("code").maybeAs<String>();
+			return code && code.value() == "429";
+		} catch(...) {
+			return false;
+		}
+	}
+
+	std::map<String,RequestScheduler::GroupStats> RequestScheduler::stats() const {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto now = Clock::now();
+		std::map<String,GroupStats> groupStats;
+		for(auto& pair : groups) {
+			auto stats = pair.second.stats;
+			if(pair.second.pausedUntil > now) {
+				stats.pausedFor = std::chrono::duration_cast<std::chrono::milliseconds>(pair.second.pausedUntil - now);
+			}
+			groupStats.insert({ pair.first, stats });
+		}
+		return groupStats;
+	}
+
+
+
+	#pragma mark Dispatching
+
+	void RequestScheduler::run() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while(!stopped) {
+			auto now = Clock::now();
+			auto nextWake = Clock::time_point::max();
+			LinkedList<std::pair<String,QueuedRequest>> readyRequests;
+			for(auto& pair : groups) {
+				auto& group = pair.second;
+				// refill the bucket
+				double elapsed = std::chrono::duration<double>(now - group.lastRefill).count();
+				group.tokens = std::min(group.options.burst, group.tokens + (elapsed * group.options.requestsPerSecond));
+				group.lastRefill = now;
+				if(group.interactiveQueue.empty() && group.backgroundQueue.empty()) {
+					continue;
+				}
+				if(group.pausedUntil > now) {
+					nextWake = std::min(nextWake, group.pausedUntil);
+					continue;
+				}
+				// take as many requests as there are tokens, interactive first
+				while(group.tokens >= 1.0 && (!group.interactiveQueue.empty() || !group.backgroundQueue.empty())) {
+					auto& queue = !group.interactiveQueue.empty() ? group.interactiveQueue : group.backgroundQueue;
+					auto request = std::move(queue.front());
+					queue.popFront();
+					if(request.priority == RequestPriority::INTERACTIVE) {
+						group.stats.interactiveQueueDepth--;
+					} else {
+						group.stats.backgroundQueueDepth--;
+					}
+					group.tokens -= 1.0;
+					group.stats.requestsSent++;
+					group.stats.totalThrottleTime += std::chrono::duration_cast<std::chrono::milliseconds>(now - request.queuedAt);
+					readyRequests.pushBack({ pair.first, std::move(request) });
+				}
+				if(!group.interactiveQueue.empty() || !group.backgroundQueue.empty()) {
+					auto secondsUntilToken = (1.0 - group.tokens) / std::max(group.options.requestsPerSecond, 0.001);
+					nextWake = std::min(nextWake, now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(secondsUntilToken)));
+				}
+			}
+			if(!readyRequests.empty()) {
+				// send outside of the lock, since sending may call back into the scheduler
+				lock.unlock();
+				for(auto& pair : readyRequests) {
+					send(pair.first, std::move(pair.second));
+				}
+				lock.lock();
+				continue;
+			}
+			if(nextWake == Clock::time_point::max()) {
+				condition.wait(lock);
+			} else {
+				condition.wait_until(lock, nextWake);
+			}
+		}
+	}
+
+	void RequestScheduler::send(String groupName, QueuedRequest request) {
+		request.attempts++;
+		Promise<SharedHttpResponse> promise;
+		try {
+			promise = request.send();
+		} catch(...) {
+			request.reject(std::current_exception());
+			return;
+		}
+		promise.then([=](SharedHttpResponse response) {
+			handleResponse(groupName, request, response);
+		}, [=](std::exception_ptr error) {
+			request.reject(error);
+		});
+	}
+
+	void RequestScheduler::handleResponse(String groupName, QueuedRequest request, SharedHttpResponse response) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto& group = getGroup(groupName);
+		auto delay = retryAfter(group, *response);
+		if(!delay) {
+			lock.unlock();
+			request.resolve(response);
+			return;
+		}
+		group.stats.throttledResponses++;
+		auto now = Clock::now();
+		group.pausedUntil = std::max(group.pausedUntil, now + delay.value());
+		if(request.attempts > group.options.maxRetries) {
+			lock.unlock();
+			request.resolve(response);
+			return;
+		}
+		// retry ahead of the requests that were queued after it
+		group.stats.retries++;
+		if(request.priority == RequestPriority::INTERACTIVE) {
+			group.interactiveQueue.pushFront(request);
+			group.stats.interactiveQueueDepth++;
+		} else {
+			group.backgroundQueue.pushFront(request);
+			group.stats.backgroundQueueDepth++;
+		}
+		lock.unlock();
+		condition.notify_all();
+	}
+
+	Optional<RequestScheduler::Clock::duration> RequestScheduler::retryAfter(const Group& group, const HttpResponse& response) const {
+		ArrayList<String> retryAfterValues;
+		for(auto& pair : response.headers.map) {
+			auto& name = (const std::string&)pair.first;
+			if(name.size() == 11 && strncasecmp(name.c_str(), "retry-after", 11) == 0) {
+				retryAfterValues = response.headers.get(pair.first);
+				break;
+			}
+		}
+		if(response.statusCode != 429 && !(response.statusCode == 503 && !retryAfterValues.empty())) {
+			return std::nullopt;
+		}
+		Clock::duration delay = group.options.defaultRetryAfter;
+		if(!retryAfterValues.empty()) {
+			auto& value = (const std::string&)retryAfterValues.front();
+			char* end = nullptr;
+			double seconds = std::strtod(value.c_str(), &end);
+			if(end != value.c_str()) {
+				delay = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(std::max(seconds, 0.0)));
+			} else {
+				// Retry-After can also be an http date
+				std::tm tm = {};
+				if(strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S", &tm) != nullptr) {
+					auto retryTime = std::chrono::system_clock::from_time_t(timegm(&tm));
+					auto remaining = retryTime - std::chrono::system_clock::now();
+					delay = std::chrono::duration_cast<Clock::duration>(std::max(remaining, std::chrono::system_clock::duration::zero()));
+				}
+			}
+		}
+		return std::min(delay, std::chrono::duration_cast<Clock::duration>(group.options.maxRetryAfter));
+	}
+}
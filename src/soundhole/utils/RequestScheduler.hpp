@@ -0,0 +1,105 @@
+//
+//  RequestScheduler.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include "HttpClient.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace sh::utils {
+	/// Limits the rate of requests sent to each group (usually one per provider) with a token bucket.
+	/// Interactive requests are always sent before queued background requests of the same group, and
+	/// throttled responses (429, or 503 with Retry-After) pause the group and are retried automatically.
+	class RequestScheduler {
+	public:
+		struct GroupOptions {
+			/// the rate that the bucket refills at
+			double requestsPerSecond = 10;
+			/// the number of requests that can be sent at once after the group has been idle
+			double burst = 10;
+			/// the maximum number of times to retry a throttled request before returning the throttled response
+			size_t maxRetries = 3;
+			/// the pause used when a throttled response has no Retry-After header
+			std::chrono::milliseconds defaultRetryAfter = std::chrono::seconds(2);
+			/// longer Retry-After values are clamped to this
+			std::chrono::milliseconds maxRetryAfter = std::chrono::seconds(60);
+		};
+
+		struct GroupStats {
+			size_t interactiveQueueDepth = 0;
+			size_t backgroundQueueDepth = 0;
+			size_t requestsSent = 0;
+			size_t throttledResponses = 0;
+			size_t retries = 0;
+			/// total time that requests spent waiting for the rate limit or a Retry-After pause
+			std::chrono::milliseconds totalThrottleTime = std::chrono::milliseconds::zero();
+			/// the remaining time of a Retry-After pause
+			std::chrono::milliseconds pausedFor = std::chrono::milliseconds::zero();
+		};
+
+		using SendRequest = Function<Promise<SharedHttpResponse>()>;
+
+		static RequestScheduler* shared();
+
+		RequestScheduler();
+		RequestScheduler(const RequestScheduler&) = delete;
+		RequestScheduler& operator=(const RequestScheduler&) = delete;
+		~RequestScheduler();
+
+		void setGroupOptions(const String& group, GroupOptions options);
+
+		/// Queues a request in the given group. send may be called more than once if the request is throttled
+		Promise<SharedHttpResponse> schedule(const String& group, RequestPriority priority, SendRequest send);
+		/// Queues a task that doesn't go through HttpClient (ie: a call into a JS api client) in the given group.
+		/// The task is retried like a throttled request if it fails with an error whose "code" detail is 429
+		Promise<void> scheduleTask(const String& group, RequestPriority priority, Function<Promise<void>()> task);
+
+		std::map<String,GroupStats> stats() const;
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct QueuedRequest {
+			SendRequest send;
+			Function<void(SharedHttpResponse)> resolve;
+			Function<void(std::exception_ptr)> reject;
+			RequestPriority priority;
+			Clock::time_point queuedAt;
+			size_t attempts;
+		};
+
+		struct Group {
+			GroupOptions options;
+			double tokens;
+			Clock::time_point lastRefill;
+			Clock::time_point pausedUntil;
+			LinkedList<QueuedRequest> interactiveQueue;
+			LinkedList<QueuedRequest> backgroundQueue;
+			GroupStats stats;
+		};
+
+		Group& getGroup(const String& name);
+		void run();
+		void send(String groupName, QueuedRequest request);
+		void handleResponse(String groupName, QueuedRequest request, SharedHttpResponse response);
+		Optional<Clock::duration> retryAfter(const Group& group, const HttpResponse& response) const;
+		static SharedHttpResponse taskResponse(int statusCode);
+		static bool isThrottledError(std::exception_ptr error);
+
+		std::map<String,Group> groups;
+		std::thread thread;
+		bool stopped;
+		mutable std::mutex mutex;
+		std::condition_variable condition;
+	};
+}
@@ -0,0 +1,265 @@
+//
+//  StateJournal.cpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#include "StateJournal.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace sh::utils {
+	namespace {
+		std::atomic<size_t> tmpFileCounter = 0;
+
+		void writeAllToFD(int fd, const String& path, const char* data, size_t size) {
+			while(size > 0) {
+				auto written = ::write(fd, data, size);
+				if(written < 0) {
+					if(errno == EINTR) {
+						continue;
+					}
+					throw std::runtime_error("Failed to write "+path+": "+std::strerror(errno));
+				}
+				data += written;
+				size -= (size_t)written;
+			}
+		}
+
+		void syncDirectory(const String& path) {
+			auto dirPath = std::filesystem::path((const std::string&)path).parent_path();
+			if(dirPath.empty()) {
+				dirPath = ".";
+			}
+			int fd = ::open(dirPath.c_str(), O_RDONLY);
+			if(fd < 0) {
+				return;
+			}
+			::fsync(fd);
+			::close(fd);
+		}
+	}
+
+	StateJournal::StateJournal(String path)
+	: StateJournal(path, Options()) {
+		//
+	}
+
+	StateJournal::StateJournal(String path, Options options)
+	: _path(path), options(options), loaded(false), generation(0), journalStarted(false), entryCount(0), journalSize(0) {
+		//
+	}
+
+	const String& StateJournal::path() const {
+		return _path;
+	}
+
+	String StateJournal::journalPath() const {
+		return _path+".journal";
+	}
+
+
+
+	#pragma mark Reading
+
+	StateJournal::Contents StateJournal::read() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return readContents();
+	}
+
+	void StateJournal::loadIfNeeded() {
+		if(!loaded) {
+			readContents();
+		}
+	}
+
+	StateJournal::Contents StateJournal::readContents() {
+		loaded = true;
+		generation = 0;
+		journalStarted = false;
+		entryCount = 0;
+		journalSize = 0;
+		auto contents = Contents{
+			.snapshot = Json()
+		};
+
+		// read snapshot
+		std::error_code fsError;
+		if(std::filesystem::exists((const std::string&)_path, fsError)) {
+			std::ifstream file((const std::string&)_path, std::ios::binary);
+			std::stringstream buffer;
+			buffer << file.rdbuf();
+			std::string jsonError;
+			auto json = Json::parse(buffer.str(), jsonError);
+			if(json.is_object() && json["generation"].is_number() && !json["state"].is_null()) {
+				generation = (size_t)json["generation"].number_value();
+				contents.snapshot = json["state"];
+			} else if(!json.is_null()) {
+				// snapshot written before the journal existed. it counts as generation 0,
+				// so the journal started on top of it is replayed until the first compaction
+				contents.snapshot = json;
+			}
+		}
+		auto journalPath = this->journalPath();
+		if(!std::filesystem::exists((const std::string&)journalPath, fsError)) {
+			return contents;
+		}
+
+		// read journal
+		std::ifstream file((const std::string&)journalPath, std::ios::binary);
+		std::string line;
+		size_t validSize = 0;
+		bool validHeader = false;
+		bool tornTail = false;
+		while(std::getline(file, line)) {
+			if(file.eof()) {
+				// the last line wasn't terminated, so its append was interrupted
+				tornTail = true;
+				break;
+			}
+			std::string jsonError;
+			auto json = Json::parse(line, jsonError);
+			if(json.is_null() || !jsonError.empty()) {
+				tornTail = true;
+				break;
+			}
+			if(!validHeader) {
+				if(!json["generation"].is_number() || (size_t)json["generation"].number_value() != generation) {
+					// journal belongs to a different snapshot
+					return contents;
+				}
+				validHeader = true;
+			} else {
+				contents.entries.pushBack(json);
+				entryCount++;
+			}
+			validSize += line.size() + 1;
+		}
+		file.close();
+		if(!validHeader) {
+			return contents;
+		}
+		if(tornTail) {
+			// drop the partial entry so that later appends start on a clean line
+			::truncate(journalPath.c_str(), (off_t)validSize);
+		}
+		journalStarted = true;
+		journalSize = validSize;
+		return contents;
+	}
+
+
+
+	#pragma mark Writing
+
+	void StateJournal::writeSnapshot(const Json& snapshot) {
+		std::unique_lock<std::mutex> lock(mutex);
+		loadIfNeeded();
+		generation++;
+		auto data = Json(Json::object{
+			{ "generation", (double)generation },
+			{ "state", snapshot }
+		}).dump();
+		writeFileAtomically(_path, data);
+		// an interrupted write leaves the old journal behind, which gets ignored since its generation no longer matches
+		startJournal();
+	}
+
+	void StateJournal::append(const LinkedList<Json>& entries) {
+		if(entries.size() == 0) {
+			return;
+		}
+		std::string data;
+		for(auto& entry : entries) {
+			data += entry.dump();
+			data += '\n';
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		loadIfNeeded();
+		if(!journalStarted) {
+			startJournal();
+		}
+		auto journalPath = this->journalPath();
+		int fd = ::open(journalPath.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+		if(fd < 0) {
+			throw std::runtime_error("Failed to open "+journalPath+" for appending: "+std::strerror(errno));
+		}
+		try {
+			writeAllToFD(fd, journalPath, data.data(), data.size());
+		} catch(...) {
+			::close(fd);
+			throw;
+		}
+		::fsync(fd);
+		::close(fd);
+		entryCount += entries.size();
+		journalSize += data.size();
+	}
+
+	void StateJournal::append(const Json& entry) {
+		append(LinkedList<Json>{ entry });
+	}
+
+	bool StateJournal::needsCompaction() const {
+		std::unique_lock<std::mutex> lock(mutex);
+		return entryCount >= options.maxEntries || journalSize >= options.maxSize;
+	}
+
+	void StateJournal::clear() {
+		std::unique_lock<std::mutex> lock(mutex);
+		loadIfNeeded();
+		std::error_code fsError;
+		std::filesystem::remove((const std::string&)journalPath(), fsError);
+		std::filesystem::remove((const std::string&)_path, fsError);
+		// with no snapshot left, the next journal has to start from generation 0 to be read back
+		generation = 0;
+		journalStarted = false;
+		entryCount = 0;
+		journalSize = 0;
+	}
+
+	void StateJournal::startJournal() {
+		auto header = Json(Json::object{
+			{ "generation", (double)generation }
+		}).dump() + "\n";
+		writeFileAtomically(journalPath(), header);
+		journalStarted = true;
+		entryCount = 0;
+		journalSize = header.size();
+	}
+
+	void StateJournal::writeFileAtomically(const String& path, const String& data) {
+		auto dirPath = std::filesystem::path((const std::string&)path).parent_path();
+		if(!dirPath.empty()) {
+			std::filesystem::create_directories(dirPath);
+		}
+		// write and sync a temporary file, then rename it over the destination, so readers see either the old or the new file
+		auto tmpPath = path+".tmp"+std::to_string(tmpFileCounter++);
+		int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if(fd < 0) {
+			throw std::runtime_error("Failed to open "+tmpPath+" for writing: "+std::strerror(errno));
+		}
+		try {
+			writeAllToFD(fd, tmpPath, data.data(), data.size());
+			if(::fsync(fd) != 0) {
+				throw std::runtime_error("Failed to sync "+tmpPath+": "+std::strerror(errno));
+			}
+		} catch(...) {
+			::close(fd);
+			std::error_code fsError;
+			std::filesystem::remove((const std::string&)tmpPath, fsError);
+			throw;
+		}
+		::close(fd);
+		std::filesystem::rename((const std::string&)tmpPath, (const std::string&)path);
+		syncDirectory(path);
+	}
+}
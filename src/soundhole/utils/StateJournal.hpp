@@ -0,0 +1,73 @@
+//
+//  StateJournal.hpp
+//  SoundHoleCore
+//
+//  Created by Luis Finke on 10/17/26.
+//  Copyright © 2026 Luis Finke. All rights reserved.
+//
+
+#pragma once
+
+#include <soundhole/common.hpp>
+#include <mutex>
+
+namespace sh::utils {
+	/// Persists a Json state as a snapshot plus an append-only journal of changes made after it.
+	/// Snapshots are replaced atomically, and journal entries are flushed to disk as they're appended,
+	/// so an interrupted write never leaves a partially written state behind.
+	class StateJournal {
+	public:
+		struct Options {
+			/// the number of journal entries after which the state should be compacted into a new snapshot
+			size_t maxEntries = 512;
+			/// the journal size in bytes after which the state should be compacted into a new snapshot
+			size_t maxSize = 256 * 1024;
+		};
+
+		struct Contents {
+			/// the last written snapshot, or null if there isn't one
+			Json snapshot;
+			/// the entries appended after the snapshot, in the order they were appended
+			LinkedList<Json> entries;
+		};
+
+		StateJournal(String path);
+		StateJournal(String path, Options options);
+		StateJournal(const StateJournal&) = delete;
+		StateJournal& operator=(const StateJournal&) = delete;
+
+		const String& path() const;
+
+		/// Reads the snapshot and the entries appended after it.
+		/// An incomplete entry at the end of the journal (from an interrupted append) is discarded
+		Contents read();
+		/// Atomically replaces the snapshot and starts a new empty journal
+		void writeSnapshot(const Json& snapshot);
+		/// Appends entries to the journal and flushes them to disk
+		void append(const LinkedList<Json>& entries);
+		void append(const Json& entry);
+		/// Tells whether the journal has grown enough that a new snapshot should be written
+		bool needsCompaction() const;
+		/// Removes the snapshot and the journal
+		void clear();
+
+	private:
+		String journalPath() const;
+		/// Reads the generation and size of the journal, if not read yet. The journal must be locked
+		void loadIfNeeded();
+		Contents readContents();
+		void startJournal();
+
+		static void writeFileAtomically(const String& path, const String& data);
+
+		String _path;
+		Options options;
+		bool loaded;
+		/// incremented for every snapshot, so that a journal left over from an older snapshot is never replayed
+		size_t generation;
+		bool journalStarted;
+		size_t entryCount;
+		size_t journalSize;
+		mutable std::mutex mutex;
+	};
+}